@@ -0,0 +1,136 @@
+// malloc/free hook 的单次调用开销：同样的分配序列分别直接调用 libc 和经过 hook，
+// hook 分为未捕获、FULL、RAW_PC 和按字节采样（RAW_PC + 512 KB）四种状态，
+// RAW_PC 另外分别固定使用帧指针和 DWARF 展开。
+//
+//   bazel run -c opt //benchmarks:hook_benchmark -- --benchmark_out=hook.json --benchmark_out_format=json
+
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <string>
+#include <dlfcn.h>
+
+#include "capture/capture.h"
+#include "logger/logger.h"
+
+namespace {
+
+using memory_tracer::capture::Capture;
+using memory_tracer::capture::CaptureMode;
+using memory_tracer::capture::UnwinderType;
+using memory_tracer::capture::UnwindOptions;
+
+constexpr size_t kSampledInterval = 512 * 1024;
+
+using MallocFunc = void* (*)(size_t);
+using FreeFunc = void (*)(void*);
+
+MallocFunc g_libc_malloc = nullptr;
+FreeFunc g_libc_free = nullptr;
+
+// 直接从 libc 取 malloc/free，绕过可执行文件和 libcapture.so 中的 hook
+bool ResolveLibcFunctions() {
+    void* libc = dlopen("libc.so.6", RTLD_LAZY | RTLD_NOLOAD);
+    if (libc == nullptr) {
+        return false;
+    }
+    g_libc_malloc = reinterpret_cast<MallocFunc>(dlsym(libc, "malloc"));
+    g_libc_free = reinterpret_cast<FreeFunc>(dlsym(libc, "free"));
+    return g_libc_malloc != nullptr && g_libc_free != nullptr;
+}
+
+void StartCapture(CaptureMode mode, size_t sample_interval, UnwinderType unwinder = UnwinderType::AUTO) {
+    Capture& capture = Capture::GetInstance();
+    UnwindOptions options = capture.GetUnwindOptions(mode);
+    options.unwinder = unwinder;
+    capture.SetUnwindOptions(mode, options);
+    capture.SetCaptureMode(mode);
+    capture.SetSamplingInterval(sample_interval);
+    capture.StartCapture();
+}
+
+void StartFull(const benchmark::State&) { StartCapture(CaptureMode::FULL, 0); }
+void StartRawPc(const benchmark::State&) { StartCapture(CaptureMode::RAW_PC, 0); }
+void StartRawPcFramePointer(const benchmark::State&) {
+    StartCapture(CaptureMode::RAW_PC, 0, UnwinderType::FRAME_POINTER);
+}
+void StartRawPcDwarf(const benchmark::State&) { StartCapture(CaptureMode::RAW_PC, 0, UnwinderType::DWARF); }
+void StartSampled(const benchmark::State&) { StartCapture(CaptureMode::RAW_PC, kSampledInterval); }
+
+void StopCapture(const benchmark::State&) {
+    Capture& capture = Capture::GetInstance();
+    capture.StopCapture();
+    capture.Clear();
+}
+
+void BM_LibcMallocFree(benchmark::State& state) {
+    size_t size = static_cast<size_t>(state.range(0));
+    for (auto _ : state) {
+        void* ptr = g_libc_malloc(size);
+        benchmark::DoNotOptimize(ptr);
+        g_libc_free(ptr);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_HookedMallocFree(benchmark::State& state) {
+    size_t size = static_cast<size_t>(state.range(0));
+    uint64_t dropped_before = Capture::GetInstance().GetDroppedEventCount();
+    for (auto _ : state) {
+        void* ptr = std::malloc(size);
+        benchmark::DoNotOptimize(ptr);
+        std::free(ptr);
+    }
+    state.SetItemsProcessed(state.iterations());
+    if (state.thread_index() == 0) {
+        // 线程缓冲区写满时丢弃的事件，非零说明合并线程跟不上分配速度
+        state.counters["dropped_events"] =
+            static_cast<double>(Capture::GetInstance().GetDroppedEventCount() - dropped_before);
+    }
+}
+
+// 分配大小 × 线程数，多线程时以墙钟时间衡量竞争
+void SizesAndThreads(benchmark::internal::Benchmark* benchmark) {
+    benchmark->RangeMultiplier(16)->Range(16, 64 << 10)->ThreadRange(1, 128)->UseRealTime();
+}
+
+BENCHMARK(BM_LibcMallocFree)->Apply(SizesAndThreads);
+BENCHMARK(BM_HookedMallocFree)->Name("BM_HookedMallocFree/idle")->Apply(SizesAndThreads);
+BENCHMARK(BM_HookedMallocFree)->Name("BM_HookedMallocFree/full")->Apply(SizesAndThreads)
+    ->Setup(StartFull)->Teardown(StopCapture);
+BENCHMARK(BM_HookedMallocFree)->Name("BM_HookedMallocFree/raw_pc")->Apply(SizesAndThreads)
+    ->Setup(StartRawPc)->Teardown(StopCapture);
+BENCHMARK(BM_HookedMallocFree)->Name("BM_HookedMallocFree/raw_pc_fp")->Apply(SizesAndThreads)
+    ->Setup(StartRawPcFramePointer)->Teardown(StopCapture);
+BENCHMARK(BM_HookedMallocFree)->Name("BM_HookedMallocFree/raw_pc_dwarf")->Apply(SizesAndThreads)
+    ->Setup(StartRawPcDwarf)->Teardown(StopCapture);
+BENCHMARK(BM_HookedMallocFree)->Name("BM_HookedMallocFree/sampled")->Apply(SizesAndThreads)
+    ->Setup(StartSampled)->Teardown(StopCapture);
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (!ResolveLibcFunctions()) {
+        return 1;
+    }
+    memory_tracer::logger::Logger::GetInstance().SetLogLevel(memory_tracer::logger::LogLevel::WARN);
+
+    // 事件只经过合并线程，不在内存中累积记录
+    Capture& capture = Capture::GetInstance();
+    capture.Initialize();
+    capture.SetRetainAllocations(false);
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::AddCustomContext("capture_max_stack_depth", std::to_string(capture.GetMaxStackDepth()));
+    benchmark::AddCustomContext("capture_unwinder", memory_tracer::capture::GetUnwinderTypeName(
+        capture.GetUnwindOptions(CaptureMode::RAW_PC).unwinder));
+    benchmark::AddCustomContext("sampled_interval_bytes", std::to_string(kSampledInterval));
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    capture.Shutdown();
+    return 0;
+}
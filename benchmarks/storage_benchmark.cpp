@@ -0,0 +1,368 @@
+// Storage 的写入吞吐、查询延迟和导出/导入吞吐。查询在 1M 和 10M 条合成记录上测量，
+// 行存与列存各测一遍；同一数据集上的基准连续运行，数据集只构造一次。
+//
+//   bazel run -c opt //benchmarks:storage_benchmark -- --benchmark_out=storage.json --benchmark_out_format=json
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+#include "capture/capture.h"
+#include "logger/logger.h"
+#include "storage/storage.h"
+
+namespace {
+
+using memory_tracer::capture::AllocationInfo;
+using memory_tracer::capture::AllocationKind;
+using memory_tracer::capture::CaptureEvent;
+using memory_tracer::capture::EventType;
+using memory_tracer::storage::Storage;
+using memory_tracer::storage::StorageLayout;
+
+constexpr const char* kDataDir = "/tmp/memory_tracer_benchmark";
+constexpr size_t kFunctionCount = 512;
+constexpr size_t kFileCount = 64;
+constexpr uint32_t kThreadCount = 32;
+constexpr uint64_t kStackCount = 4096;
+constexpr uint64_t kTimestampStep = 1000;   // 每条记录间隔 1 微秒，1M 条覆盖 1 秒
+constexpr size_t kEventBatchSize = 1024;
+
+const char* LayoutName(StorageLayout layout) {
+    return layout == StorageLayout::COLUMNAR ? "columnar" : "row";
+}
+
+// 合成记录：函数、文件、线程和调用栈按固定周期轮换，大小在 16 B ~ 64 KB 之间
+class RecordGenerator {
+public:
+    RecordGenerator() {
+        for (size_t i = 0; i < kFunctionCount; ++i) {
+            functions_.push_back("bench::function_" + std::to_string(i));
+        }
+        for (size_t i = 0; i < kFileCount; ++i) {
+            files_.push_back("src/bench/file_" + std::to_string(i) + ".cpp");
+        }
+    }
+
+    void Fill(uint64_t index, AllocationInfo* info) const {
+        info->timestamp = index * kTimestampStep;
+        info->address = GetAddress(index);
+        info->size = static_cast<size_t>(16) << (index % 13);
+        info->function = functions_[index % kFunctionCount];
+        info->file = files_[index % kFileCount];
+        info->line = static_cast<int>(index % 1000);
+        info->thread_id = static_cast<uint32_t>(index % kThreadCount) + 1;
+        info->stack_id = index % kStackCount + 1;
+        info->kind = AllocationKind::MALLOC;
+        info->sample_interval = 0;
+    }
+
+    static void* GetAddress(uint64_t index) {
+        return reinterpret_cast<void*>(static_cast<uintptr_t>(0x100000000ULL + index * 64));
+    }
+
+    const std::string& GetFunction(size_t index) const { return functions_[index % kFunctionCount]; }
+
+private:
+    std::vector<std::string> functions_;
+    std::vector<std::string> files_;
+};
+
+const RecordGenerator& GetGenerator() {
+    static const RecordGenerator generator;
+    return generator;
+}
+
+// 当前已载入的数据集，参数不同时重新构造
+size_t g_loaded_records = 0;
+StorageLayout g_loaded_layout = StorageLayout::ROW;
+
+// 载入 records 条记录，其中奇数序号的记录已释放，作为 GetLeaks 的一半命中
+void EnsureDataset(size_t records, StorageLayout layout) {
+    if (g_loaded_records == records && g_loaded_layout == layout) {
+        return;
+    }
+    Storage& storage = Storage::GetInstance();
+    storage.Clear();
+    storage.SetLayout(layout);
+    storage.SetMaxAllocations(records);
+
+    const RecordGenerator& generator = GetGenerator();
+    AllocationInfo info;
+    for (uint64_t i = 0; i < records; ++i) {
+        generator.Fill(i, &info);
+        storage.AddAllocation(info);
+    }
+    for (uint64_t i = 1; i < records; i += 2) {
+        storage.RecordDeallocation(RecordGenerator::GetAddress(i));
+    }
+    g_loaded_records = records;
+    g_loaded_layout = layout;
+}
+
+void InvalidateDataset() {
+    g_loaded_records = 0;
+}
+
+uint64_t GetFileSize(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+}
+
+// ---- 写入 ----
+
+void BM_AddAllocation(benchmark::State& state) {
+    auto layout = static_cast<StorageLayout>(state.range(0));
+    Storage& storage = Storage::GetInstance();
+    InvalidateDataset();
+    storage.Clear();
+    storage.SetLayout(layout);
+    // 写满后持续淘汰最旧的记录，测量的是稳态吞吐
+    storage.SetMaxAllocations(1000000);
+
+    const RecordGenerator& generator = GetGenerator();
+    AllocationInfo info;
+    uint64_t index = 0;
+    for (auto _ : state) {
+        generator.Fill(index++, &info);
+        benchmark::DoNotOptimize(storage.AddAllocation(info));
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetLabel(LayoutName(layout));
+    storage.Clear();
+}
+
+void BM_AddEvents(benchmark::State& state) {
+    auto layout = static_cast<StorageLayout>(state.range(0));
+    Storage& storage = Storage::GetInstance();
+    InvalidateDataset();
+    storage.Clear();
+    storage.SetLayout(layout);
+    storage.SetMaxAllocations(1000000);
+
+    // 每批一半分配、一半释放此前的分配，与合并线程投递的事件流相同
+    std::vector<CaptureEvent> events(kEventBatchSize);
+    uint64_t index = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (size_t i = 0; i < kEventBatchSize; ++i) {
+            CaptureEvent& event = events[i];
+            bool is_free = (i & 1) != 0;
+            uint64_t record = is_free ? index - 1 : index++;
+            event.timestamp = index * kTimestampStep + i;
+            event.address = RecordGenerator::GetAddress(record);
+            event.size = static_cast<size_t>(16) << (record % 13);
+            event.stack_id = record % kStackCount + 1;
+            event.thread_id = static_cast<uint32_t>(record % kThreadCount) + 1;
+            event.sample_interval = 0;
+            event.type = is_free ? EventType::FREE : EventType::ALLOC;
+            event.kind = AllocationKind::MALLOC;
+        }
+        state.ResumeTiming();
+        storage.AddEvents(events.data(), events.size());
+    }
+    state.SetItemsProcessed(state.iterations() * kEventBatchSize);
+    state.SetLabel(LayoutName(layout));
+    storage.Clear();
+}
+
+BENCHMARK(BM_AddAllocation)->Arg(static_cast<int>(StorageLayout::ROW))->Arg(static_cast<int>(StorageLayout::COLUMNAR));
+BENCHMARK(BM_AddEvents)->Arg(static_cast<int>(StorageLayout::ROW))->Arg(static_cast<int>(StorageLayout::COLUMNAR));
+
+// ---- 查询 ----
+
+void BM_QueryByFunction(benchmark::State& state, size_t records, StorageLayout layout) {
+    EnsureDataset(records, layout);
+    Storage& storage = Storage::GetInstance();
+    size_t function = 0;
+    for (auto _ : state) {
+        auto result = storage.QueryByFunction(GetGenerator().GetFunction(function++));
+        benchmark::DoNotOptimize(result.total_count);
+    }
+}
+
+void BM_QueryBySizeRange(benchmark::State& state, size_t records, StorageLayout layout) {
+    EnsureDataset(records, layout);
+    Storage& storage = Storage::GetInstance();
+    for (auto _ : state) {
+        // 13 种大小中命中 1 种
+        auto result = storage.QueryBySizeRange(4096, 4096);
+        benchmark::DoNotOptimize(result.total_count);
+    }
+}
+
+void BM_QueryByTimeRange(benchmark::State& state, size_t records, StorageLayout layout) {
+    EnsureDataset(records, layout);
+    Storage& storage = Storage::GetInstance();
+    uint64_t end = records * kTimestampStep;
+    for (auto _ : state) {
+        // 中间 1% 的时间窗口
+        auto result = storage.QueryByTimeRange(end / 2, end / 2 + end / 100);
+        benchmark::DoNotOptimize(result.total_count);
+    }
+}
+
+void BM_QueryByThread(benchmark::State& state, size_t records, StorageLayout layout) {
+    EnsureDataset(records, layout);
+    Storage& storage = Storage::GetInstance();
+    uint32_t thread_id = 0;
+    for (auto _ : state) {
+        auto result = storage.QueryByThread(thread_id++ % kThreadCount + 1);
+        benchmark::DoNotOptimize(result.total_count);
+    }
+}
+
+void BM_VisitByFunction(benchmark::State& state, size_t records, StorageLayout layout) {
+    EnsureDataset(records, layout);
+    Storage& storage = Storage::GetInstance();
+    size_t function = 0;
+    for (auto _ : state) {
+        auto aggregate = storage.VisitByFunction(GetGenerator().GetFunction(function++));
+        benchmark::DoNotOptimize(aggregate.total_count);
+    }
+}
+
+void BM_GetLeaks(benchmark::State& state, size_t records, StorageLayout layout) {
+    EnsureDataset(records, layout);
+    Storage& storage = Storage::GetInstance();
+    for (auto _ : state) {
+        auto leaks = storage.GetLeaks();
+        benchmark::DoNotOptimize(leaks.data());
+    }
+}
+
+void BM_GetAllocationTimeline(benchmark::State& state, size_t records, StorageLayout layout) {
+    EnsureDataset(records, layout);
+    Storage& storage = Storage::GetInstance();
+    for (auto _ : state) {
+        // 10 ms 一个桶，1M 条记录为 100 个桶
+        auto timeline = storage.GetAllocationTimeline(10000000);
+        benchmark::DoNotOptimize(timeline.size());
+    }
+}
+
+// ---- 导出/导入 ----
+
+void BM_ExportToTrace(benchmark::State& state, size_t records, StorageLayout layout) {
+    EnsureDataset(records, layout);
+    std::string path = std::string(kDataDir) + "/benchmark.trace";
+    uint64_t bytes = 0;
+    for (auto _ : state) {
+        Storage::GetInstance().ExportToTrace(path);
+        bytes += GetFileSize(path);
+    }
+    state.SetItemsProcessed(state.iterations() * records);
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+}
+
+void BM_ImportFromTrace(benchmark::State& state, size_t records, StorageLayout layout) {
+    EnsureDataset(records, layout);
+    Storage& storage = Storage::GetInstance();
+    std::string path = std::string(kDataDir) + "/benchmark.trace";
+    storage.ExportToTrace(path);
+    uint64_t bytes = GetFileSize(path);
+    for (auto _ : state) {
+        state.PauseTiming();
+        storage.Clear();
+        state.ResumeTiming();
+        storage.ImportFromTrace(path);
+    }
+    state.SetItemsProcessed(state.iterations() * records);
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+    std::remove(path.c_str());
+    InvalidateDataset();
+}
+
+void BM_ExportToJson(benchmark::State& state, size_t records, StorageLayout layout) {
+    EnsureDataset(records, layout);
+    std::string path = std::string(kDataDir) + "/benchmark.json";
+    uint64_t bytes = 0;
+    for (auto _ : state) {
+        Storage::GetInstance().ExportToJson(path);
+        bytes += GetFileSize(path);
+    }
+    state.SetItemsProcessed(state.iterations() * records);
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+}
+
+void BM_ImportFromJson(benchmark::State& state, size_t records, StorageLayout layout) {
+    EnsureDataset(records, layout);
+    Storage& storage = Storage::GetInstance();
+    std::string path = std::string(kDataDir) + "/benchmark.json";
+    storage.ExportToJson(path);
+    uint64_t bytes = GetFileSize(path);
+    for (auto _ : state) {
+        state.PauseTiming();
+        storage.Clear();
+        state.ResumeTiming();
+        storage.ImportFromJson(path);
+    }
+    state.SetItemsProcessed(state.iterations() * records);
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+    std::remove(path.c_str());
+    InvalidateDataset();
+}
+
+using DatasetBenchmark = void (*)(benchmark::State&, size_t, StorageLayout);
+
+// 按数据集分组注册，保证同一数据集上的基准相邻运行。导入会替换数据集，放在每组最后
+void RegisterDatasetBenchmarks() {
+    static const struct {
+        const char* name;
+        DatasetBenchmark function;
+        size_t max_records;   // 超过该规模的数据集不运行（如 JSON 导出）
+    } kBenchmarks[] = {
+        {"BM_QueryByFunction", &BM_QueryByFunction, SIZE_MAX},
+        {"BM_QueryBySizeRange", &BM_QueryBySizeRange, SIZE_MAX},
+        {"BM_QueryByTimeRange", &BM_QueryByTimeRange, SIZE_MAX},
+        {"BM_QueryByThread", &BM_QueryByThread, SIZE_MAX},
+        {"BM_VisitByFunction", &BM_VisitByFunction, SIZE_MAX},
+        {"BM_GetLeaks", &BM_GetLeaks, SIZE_MAX},
+        {"BM_GetAllocationTimeline", &BM_GetAllocationTimeline, SIZE_MAX},
+        {"BM_ExportToTrace", &BM_ExportToTrace, SIZE_MAX},
+        {"BM_ExportToJson", &BM_ExportToJson, 1000000},
+        {"BM_ImportFromTrace", &BM_ImportFromTrace, SIZE_MAX},
+        {"BM_ImportFromJson", &BM_ImportFromJson, 1000000},
+    };
+    const size_t kRecordCounts[] = {1000000, 10000000};
+    const StorageLayout kLayouts[] = {StorageLayout::ROW, StorageLayout::COLUMNAR};
+
+    for (size_t records : kRecordCounts) {
+        for (StorageLayout layout : kLayouts) {
+            for (const auto& entry : kBenchmarks) {
+                if (records > entry.max_records) {
+                    continue;
+                }
+                std::string name = std::string(entry.name) + "/" + LayoutName(layout) + "/records:" +
+                                   std::to_string(records);
+                benchmark::RegisterBenchmark(name.c_str(), entry.function, records, layout)
+                    ->Unit(benchmark::kMillisecond)
+                    ->UseRealTime();
+            }
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    memory_tracer::logger::Logger::GetInstance().SetLogLevel(memory_tracer::logger::LogLevel::WARN);
+    mkdir(kDataDir, 0755);
+    Storage::GetInstance().Initialize(kDataDir);
+
+    RegisterDatasetBenchmarks();
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    // 不在退出时把合成数据保存到数据目录
+    Storage::GetInstance().Clear();
+    return 0;
+}
@@ -0,0 +1,151 @@
+// 进程外收集器：从共享内存环读取被追踪进程的事件，在本进程中运行存储、统计、可视化和指标导出，
+// 追踪器的内存、锁和 CPU 不再与被追踪的服务竞争。一个收集器可以同时收集同一主机上的多个进程。
+//
+//   LD_PRELOAD=libmemory_tracer_preload.so MT_TRANSPORT=shm ./service &
+//   ./collector --metrics-port 9464 --flamegraph memory.svg
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "logger/logger.h"
+#include "metrics/metrics.h"
+#include "stats/stats.h"
+#include "storage/storage.h"
+#include "transport/transport.h"
+#include "visualization/visualization.h"
+
+namespace {
+
+std::atomic<bool> g_stop{false};
+
+void HandleSignal(int) {
+    g_stop = true;
+}
+
+struct CollectorArgs {
+    std::string prefix = memory_tracer::transport::kDefaultShmPrefix;
+    std::vector<std::string> attach;
+    std::string data_dir = "./data";
+    int metrics_port = 9464;            // -1 表示不启动指标导出
+    int report_interval_s = 0;          // 0 表示只在退出时输出报告
+    std::string flamegraph;
+};
+
+void PrintUsage(const char* program) {
+    std::cout << "Usage: " << program << " [options]\n"
+              << "  --prefix NAME          discover /dev/shm/NAME.<pid> rings (default memory_tracer, empty disables)\n"
+              << "  --attach NAME          attach a ring by name, may be repeated\n"
+              << "  --data-dir DIR         storage data directory (default ./data)\n"
+              << "  --metrics-port PORT    Prometheus endpoint port, -1 disables (default 9464)\n"
+              << "  --report-interval SEC  print a summary every SEC seconds\n"
+              << "  --flamegraph FILE      write a flame graph on exit\n";
+}
+
+bool ParseArgs(int argc, char* argv[], CollectorArgs* args) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            return false;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return false;
+        }
+        const char* value = argv[++i];
+        if (arg == "--prefix") {
+            args->prefix = value;
+        } else if (arg == "--attach") {
+            args->attach.push_back(value);
+        } else if (arg == "--data-dir") {
+            args->data_dir = value;
+        } else if (arg == "--metrics-port") {
+            args->metrics_port = std::atoi(value);
+        } else if (arg == "--report-interval") {
+            args->report_interval_s = std::atoi(value);
+        } else if (arg == "--flamegraph") {
+            args->flamegraph = value;
+        } else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    CollectorArgs args;
+    if (!ParseArgs(argc, argv, &args)) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    std::signal(SIGINT, HandleSignal);
+    std::signal(SIGTERM, HandleSignal);
+
+    memory_tracer::logger::Logger::GetInstance().StartAsync();
+    memory_tracer::storage::Storage::GetInstance().Initialize(args.data_dir);
+    memory_tracer::stats::Stats::GetInstance().Initialize();
+    memory_tracer::visualization::Visualization::GetInstance().Initialize();
+
+    auto& collector = memory_tracer::transport::ShmCollector::GetInstance();
+    collector.AddEventListener([](const memory_tracer::capture::CaptureEvent* events, size_t count) {
+        memory_tracer::storage::Storage::GetInstance().AddEvents(events, count);
+    });
+    collector.AddEventListener([](const memory_tracer::capture::CaptureEvent* events, size_t count) {
+        memory_tracer::stats::Stats::GetInstance().AddEvents(events, count);
+    });
+    for (const auto& name : args.attach) {
+        if (!collector.Attach(name)) {
+            std::cerr << "Failed to attach " << name << std::endl;
+        }
+    }
+
+    if (args.metrics_port >= 0) {
+        memory_tracer::metrics::ExporterOptions options;
+        options.port = static_cast<uint16_t>(args.metrics_port);
+        if (!memory_tracer::metrics::MetricsExporter::GetInstance().Start(options)) {
+            std::cerr << "Failed to start metrics exporter" << std::endl;
+        }
+    }
+
+    memory_tracer::transport::CollectorOptions options;
+    options.prefix = args.prefix;
+    collector.Start(options);
+
+    auto last_report = std::chrono::steady_clock::now();
+    while (!g_stop) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        auto now = std::chrono::steady_clock::now();
+        if (args.report_interval_s > 0 && now - last_report >= std::chrono::seconds(args.report_interval_s)) {
+            last_report = now;
+            std::cout << memory_tracer::stats::Stats::GetInstance().GetSummary()
+                      << "  producers: " << collector.GetProducerCount()
+                      << ", dropped events: " << collector.GetDroppedCount() << std::endl;
+        }
+    }
+
+    collector.Stop();
+    memory_tracer::metrics::MetricsExporter::GetInstance().Stop();
+
+    auto& visualization = memory_tracer::visualization::Visualization::GetInstance();
+    visualization.DrawFunctionAllocationChart(10);
+    visualization.DrawMemoryTimeline();
+    std::cout << visualization.ExportReportToText() << std::endl;
+    if (!args.flamegraph.empty()) {
+        visualization.ExportFlameGraph(args.flamegraph);
+    }
+
+    visualization.Shutdown();
+    memory_tracer::stats::Stats::GetInstance().Shutdown();
+    memory_tracer::storage::Storage::GetInstance().Shutdown();
+    return 0;
+}
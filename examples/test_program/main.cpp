@@ -8,6 +8,7 @@
 #include "capture/capture.h"
 #include "logger/logger.h"
 #include "storage/storage.h"
+#include "storage/trace_file.h"
 #include "stats/stats.h"
 #include "visualization/visualization.h"
 
@@ -76,7 +77,48 @@ void WorkerThread(int id) {
     }
 }
 
+// 回放已保存的二进制 trace，同时写入存储和统计模块
+int ReplayTrace(const std::string& filepath) {
+    memory_tracer::storage::Storage::GetInstance().Initialize("./data");
+    memory_tracer::stats::Stats::GetInstance().Initialize();
+    memory_tracer::visualization::Visualization::GetInstance().Initialize();
+
+    memory_tracer::storage::TraceReader reader;
+    if (!reader.Open(filepath)) {
+        std::cerr << "Failed to open trace: " << filepath << std::endl;
+        return 1;
+    }
+
+    memory_tracer::storage::TraceHandler handler;
+    handler.on_allocation = [](const memory_tracer::capture::AllocationInfo& info) {
+        memory_tracer::storage::Storage::GetInstance().AddAllocation(info);
+        memory_tracer::stats::Stats::GetInstance().AddAllocation(info);
+    };
+    handler.on_free = [](uint64_t timestamp, void* address) {
+        memory_tracer::storage::Storage::GetInstance().RecordDeallocation(address);
+        memory_tracer::stats::Stats::GetInstance().RecordDeallocation(address, timestamp);
+    };
+    if (!reader.Replay(handler)) {
+        std::cerr << "Trace is incomplete, showing the replayed part." << std::endl;
+    }
+
+    memory_tracer::visualization::Visualization::GetInstance().DrawFunctionAllocationChart(10);
+    memory_tracer::visualization::Visualization::GetInstance().DrawSizeDistributionHistogram();
+    memory_tracer::visualization::Visualization::GetInstance().DrawMemoryTimeline();
+    memory_tracer::visualization::Visualization::GetInstance().DrawShortLivedSitesChart(10);
+    std::cout << memory_tracer::visualization::Visualization::GetInstance().ExportReportToText() << std::endl;
+
+    memory_tracer::visualization::Visualization::GetInstance().Shutdown();
+    memory_tracer::stats::Stats::GetInstance().Shutdown();
+    memory_tracer::storage::Storage::GetInstance().Clear();
+    return 0;
+}
+
 int main(int argc, char* argv[]) {
+    if (argc > 2 && std::strcmp(argv[1], "--replay") == 0) {
+        return ReplayTrace(argv[2]);
+    }
+
     std::cout << "=== Memory Tracer Test Program ===" << std::endl;
     std::cout << "This program demonstrates memory tracking capabilities." << std::endl;
     std::cout << std::endl;
@@ -86,6 +128,8 @@ int main(int argc, char* argv[]) {
 
     memory_tracer::logger::Logger::GetInstance().SetLogFile("memory_tracer.log");
     memory_tracer::logger::Logger::GetInstance().SetLogLevel(memory_tracer::logger::LogLevel::INFO);
+    // 日志格式化与 I/O 放到后台线程，避免干扰被测程序
+    memory_tracer::logger::Logger::GetInstance().StartAsync();
 
     memory_tracer::storage::Storage::GetInstance().Initialize("./data");
     memory_tracer::stats::Stats::GetInstance().Initialize();
@@ -93,6 +137,12 @@ int main(int argc, char* argv[]) {
 
     // 初始化捕获模块（这会 hook malloc/free）
     MT_CAPTURE_INIT();
+
+    // 统计模块直接消费捕获事件流，释放事件同步更新未释放的字节数
+    memory_tracer::capture::Capture::GetInstance().AddEventListener(
+        [](const memory_tracer::capture::CaptureEvent* events, size_t count) {
+            memory_tracer::stats::Stats::GetInstance().AddEvents(events, count);
+        });
     MT_CAPTURE_START();
 
     std::cout << "Starting memory capture..." << std::endl;
@@ -122,12 +172,11 @@ int main(int argc, char* argv[]) {
     std::cout << "\nStopping memory capture..." << std::endl;
     MT_CAPTURE_STOP();
 
-    // 获取捕获的数据并添加到存储和统计模块
+    // 获取捕获的数据并添加到存储模块
     std::cout << "Processing captured data..." << std::endl;
     const auto& allocations = memory_tracer::capture::Capture::GetInstance().GetAllocations();
 
     memory_tracer::storage::Storage::GetInstance().AddAllocations(allocations);
-    memory_tracer::stats::Stats::GetInstance().AddAllocations(allocations);
 
     // 生成可视化图表
     std::cout << "\n=== Memory Statistics ===" << std::endl;
@@ -147,6 +196,9 @@ int main(int argc, char* argv[]) {
     // 5. 内存使用时间线
     memory_tracer::visualization::Visualization::GetInstance().DrawMemoryTimeline();
 
+    // 6. 短生命周期分配的调用点
+    memory_tracer::visualization::Visualization::GetInstance().DrawShortLivedSitesChart(10);
+
     // 导出 JSON 报告
     std::cout << "Exporting JSON report..." << std::endl;
     memory_tracer::storage::Storage::GetInstance().ExportToJson("memory_report.json");
@@ -178,6 +230,7 @@ int main(int argc, char* argv[]) {
 
     std::cout << "\n=== Test Completed ===" << std::endl;
     std::cout << "Check memory_tracer.log and memory_report.json for detailed information." << std::endl;
+    std::cout << "Replay the saved trace with: " << argv[0] << " --replay ./data/allocations.trace" << std::endl;
 
     return 0;
 }
@@ -1,12 +1,28 @@
 #include "capture/capture.h"
+#include "capture/symbolizer.h"
+#include "capture/stack_table.h"
+#include "capture/live_table.h"
+#include "capture/internal_allocator.h"
+#include "capture/tracer_stats.h"
+#include "capture/unwinder.h"
+#include "thread_event_buffer.h"
 #include "logger/logger.h"
-#include <backward.hpp>
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <thread>
 #include <mutex>
-#include <map>
+#include <new>
 #include <dlfcn.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdarg>
+#include <cstddef>
 #include <cstring>
+#include <cmath>
+#include <limits>
 
 namespace memory_tracer {
 namespace capture {
@@ -15,47 +31,158 @@ namespace capture {
 static void* (*real_malloc)(size_t) = nullptr;
 static void (*real_free)(void*) = nullptr;
 static void* (*real_realloc)(void*, size_t) = nullptr;
+static void* (*real_calloc)(size_t, size_t) = nullptr;
+static int (*real_posix_memalign)(void**, size_t, size_t) = nullptr;
+static void* (*real_aligned_alloc)(size_t, size_t) = nullptr;
+static void* (*real_memalign)(size_t, size_t) = nullptr;
+static void* (*real_valloc)(size_t) = nullptr;
+static void* (*real_pvalloc)(size_t) = nullptr;
+static void* (*real_mmap)(void*, size_t, int, int, int, off_t) = nullptr;
+static int (*real_munmap)(void*, size_t) = nullptr;
+static void* (*real_mremap)(void*, size_t, size_t, int, ...) = nullptr;
+
+template <typename Function>
+static void ResolveSymbol(Function& function, const char* name) {
+    function = reinterpret_cast<Function>(dlsym(RTLD_NEXT, name));
+}
+
+// dlsym 自身也会申请内存，解析完成前的请求由静态引导区满足
+static constexpr size_t kBootstrapSize = 64 * 1024;
+static constexpr size_t kBootstrapHeader = 16;
+alignas(16) static unsigned char g_bootstrap_buffer[kBootstrapSize];
+static std::atomic<size_t> g_bootstrap_used{0};
+
+static void* BootstrapAllocate(size_t size) {
+    size_t total = kBootstrapHeader + ((size + 15) & ~size_t(15));
+    size_t offset = g_bootstrap_used.fetch_add(total);
+    if (offset + total > kBootstrapSize) {
+        return nullptr;
+    }
+    // 块头记录大小，供 realloc 迁移
+    unsigned char* block = g_bootstrap_buffer + offset;
+    std::memcpy(block, &size, sizeof(size));
+    return block + kBootstrapHeader;
+}
+
+static bool IsBootstrapPointer(void* ptr) {
+    return ptr >= g_bootstrap_buffer && ptr < g_bootstrap_buffer + kBootstrapSize;
+}
+
+static size_t GetBootstrapSize(void* ptr) {
+    size_t size = 0;
+    std::memcpy(&size, static_cast<unsigned char*>(ptr) - kBootstrapHeader, sizeof(size));
+    return size;
+}
+
+// 解析原始分配函数；解析过程中（包括 dlsym 内部的重入）返回 false
+static bool ResolveRealFunctions() {
+    static std::atomic<int> state{0};  // 0 未解析，1 解析中，2 已完成
+    int expected = 0;
+    if (state.compare_exchange_strong(expected, 1)) {
+        ResolveSymbol(real_malloc, "malloc");
+        ResolveSymbol(real_free, "free");
+        ResolveSymbol(real_realloc, "realloc");
+        ResolveSymbol(real_calloc, "calloc");
+        ResolveSymbol(real_posix_memalign, "posix_memalign");
+        ResolveSymbol(real_aligned_alloc, "aligned_alloc");
+        ResolveSymbol(real_memalign, "memalign");
+        ResolveSymbol(real_valloc, "valloc");
+        ResolveSymbol(real_pvalloc, "pvalloc");
+        ResolveSymbol(real_mmap, "mmap");
+        ResolveSymbol(real_munmap, "munmap");
+        ResolveSymbol(real_mremap, "mremap");
+        state = 2;
+    }
+    return state.load() == 2 && real_malloc && real_free && real_realloc;
+}
+
+// 采样器的线程本地状态，initial-exec 保证访问时不会分配内存
+static thread_local int64_t t_bytes_until_sample __attribute__((tls_model("initial-exec"))) = 0;
+static thread_local uint64_t t_sampler_state __attribute__((tls_model("initial-exec"))) = 0;
+
+// 当前线程的事件缓冲区。线程退出后缓冲区交由合并线程回收，此后该线程的事件直接计为丢弃
+static thread_local ThreadEventBuffer* t_thread_buffer __attribute__((tls_model("initial-exec"))) = nullptr;
+static thread_local bool t_thread_buffer_exited __attribute__((tls_model("initial-exec"))) = false;
+
+// 线程退出时将缓冲区标记为退役，退役的缓冲区排空后可能随时被合并线程释放
+struct ThreadBufferHandle {
+    ~ThreadBufferHandle() {
+        ThreadEventBuffer* buffer = t_thread_buffer;
+        t_thread_buffer_exited = true;
+        t_thread_buffer = nullptr;
+        if (buffer) buffer->Retire();
+    }
+};
+
+// 释放路径的抽样计时
+static thread_local uint32_t t_free_timing_tick __attribute__((tls_model("initial-exec"))) = 0;
+static constexpr uint32_t kFreeTimingPeriod = 64;
 
 class Capture::Impl {
 public:
-    Impl() : capturing_(false) {
-        // 初始化 backward-cpp
-        backward::StackTrace st;
+    Impl()
+        : initialized_(false),
+          capturing_(false),
+          mode_(CaptureMode::FULL),
+          sample_interval_(0),
+          retain_allocations_(true),
+          allocation_callback_(nullptr),
+          retired_dropped_(0),
+          exited_dropped_(0),
+          drain_running_(false) {
+        UnwindOptions defaults;
+        for (UnwindState& state : unwind_) {
+            state.unwinder = defaults.unwinder;
+            state.max_depth = defaults.max_depth;
+            state.skip_frames = defaults.skip_frames;
+        }
+        // 调用栈表和符号表先于本单例构造完成，析构在后，退出时最后一批事件仍能取到调用栈
+        StackTable::GetInstance();
+        Symbolizer::GetInstance();
     }
 
-    void Initialize() {
-        std::lock_guard<std::mutex> lock(mutex_);
+    ~Impl() {
+        StopDrainThread();
+        for (ThreadEventBuffer* buffer : buffers_) {
+            buffer->~ThreadEventBuffer();
+            internal::ArenaDeallocate(buffer, sizeof(ThreadEventBuffer));
+        }
+    }
 
+    void Initialize() {
         // 加载原始 malloc/free 函数
-        real_malloc = reinterpret_cast<void*(*)(size_t)>(dlsym(RTLD_NEXT, "malloc"));
-        real_free = reinterpret_cast<void(*)(void*)>(dlsym(RTLD_NEXT, "free"));
-        real_realloc = reinterpret_cast<void*(*)(void*, size_t)>(dlsym(RTLD_NEXT, "realloc"));
-
-        if (!real_malloc || !real_free || !real_realloc) {
+        if (!ResolveRealFunctions()) {
             LOG_ERROR("Failed to load original memory functions");
             return;
         }
 
+        // 自我观测在构造时标定计时时钟，放在初始化阶段而不是第一次读取快照时
+        TracerStats::GetInstance();
+        StartDrainThread();
+        // 日志后台线程的分配属于追踪器自身
+        logger::Logger::GetInstance().SetThreadInitializer([]() { thread_local TracerScope scope; });
+        initialized_ = true;
         LOG_INFO("Memory capture module initialized");
     }
 
     void Shutdown() {
+        // 析构时会再次调用，此时日志模块可能已先行析构
+        if (!initialized_.exchange(false)) return;
         StopCapture();
-        std::lock_guard<std::mutex> lock(mutex_);
-        allocations_.clear();
-        active_allocations_.clear();
+        StopDrainThread();
+        Clear();
         LOG_INFO("Memory capture module shutdown");
     }
 
     void StartCapture() {
-        std::lock_guard<std::mutex> lock(mutex_);
         capturing_ = true;
         LOG_INFO("Memory capture started");
     }
 
     void StopCapture() {
-        std::lock_guard<std::mutex> lock(mutex_);
         capturing_ = false;
+        // 合并停止前已写入缓冲区的事件
+        DrainBuffers();
         LOG_INFO("Memory capture stopped");
     }
 
@@ -63,56 +190,314 @@ public:
         return capturing_;
     }
 
+    void SetCaptureMode(CaptureMode mode) {
+        mode_ = mode;
+    }
+
+    CaptureMode GetCaptureMode() const {
+        return mode_;
+    }
+
+    void SetSamplingInterval(size_t bytes) {
+        if (bytes > std::numeric_limits<uint32_t>::max()) {
+            bytes = std::numeric_limits<uint32_t>::max();
+        }
+        sample_interval_ = static_cast<uint32_t>(bytes);
+        LOG_INFO("Sampling interval set to {} bytes", bytes);
+    }
+
+    size_t GetSamplingInterval() const {
+        return sample_interval_;
+    }
+
+    void SetMaxStackDepth(size_t depth) {
+        depth = ClampStackDepth(depth);
+        for (UnwindState& state : unwind_) {
+            state.max_depth = static_cast<uint32_t>(depth);
+        }
+        LOG_INFO("Max stack depth set to {} frames", depth);
+    }
+
+    size_t GetMaxStackDepth() const {
+        return GetUnwindState(mode_).max_depth;
+    }
+
+    void SetUnwindOptions(CaptureMode mode, const UnwindOptions& options) {
+        UnwindState& state = GetUnwindState(mode);
+        state.unwinder = options.unwinder;
+        state.max_depth = static_cast<uint32_t>(ClampStackDepth(options.max_depth));
+        state.skip_frames = options.skip_frames;
+        LOG_INFO("{} mode unwinder set to {}: depth {} frames, skip {} frames",
+                 mode == CaptureMode::FULL ? "FULL" : "RAW_PC", GetUnwinderTypeName(options.unwinder),
+                 state.max_depth.load(), options.skip_frames);
+    }
+
+    UnwindOptions GetUnwindOptions(CaptureMode mode) const {
+        const UnwindState& state = GetUnwindState(mode);
+        UnwindOptions options;
+        options.unwinder = state.unwinder;
+        options.max_depth = state.max_depth;
+        options.skip_frames = state.skip_frames;
+        return options;
+    }
+
+    void SetRetainAllocations(bool retain) {
+        std::lock_guard<std::mutex> lock(drain_mutex_);
+        retain_allocations_ = retain;
+        if (!retain) {
+            allocations_.clear();
+            allocations_.shrink_to_fit();
+        }
+    }
+
     const std::vector<AllocationInfo>& GetAllocations() const {
         return allocations_;
     }
 
+    void Flush() {
+        DrainBuffers();
+    }
+
+    uint64_t GetDroppedEventCount() const {
+        std::lock_guard<std::mutex> lock(registry_mutex_);
+        uint64_t dropped = retired_dropped_ + exited_dropped_.load(std::memory_order_relaxed);
+        for (const auto& buffer : buffers_) {
+            dropped += buffer->GetDroppedCount();
+        }
+        return dropped;
+    }
+
     void Clear() {
-        std::lock_guard<std::mutex> lock(mutex_);
+        std::lock_guard<std::mutex> lock(drain_mutex_);
         allocations_.clear();
-        active_allocations_.clear();
+        active_allocations_.Clear();
+        live_blocks_.Clear();
+        deferred_frees_.clear();
     }
 
     void SetAllocationCallback(AllocationCallback callback) {
+        std::lock_guard<std::mutex> lock(drain_mutex_);
         allocation_callback_ = callback;
     }
 
-    void RecordAllocation(void* address, size_t size, const char* function, const char* file, int line) {
-        if (!capturing_) return;
+    void AddEventListener(EventBatchCallback callback) {
+        std::lock_guard<std::mutex> lock(drain_mutex_);
+        listeners_.push_back(callback);
+    }
 
-        AllocationInfo info;
-        info.timestamp = GetTimestamp();
-        info.address = address;
-        info.size = size;
-        info.function = function ? function : "unknown";
-        info.file = file ? file : "unknown";
-        info.line = line;
-        info.thread_id = GetThreadId();
+    void RecordAllocation(void* address, size_t size, AllocationKind kind, void* hook_frame) {
+        if (!capturing_.load(std::memory_order_relaxed)) return;
+        uint32_t interval = sample_interval_.load(std::memory_order_relaxed);
+        if (interval && !ShouldSample(size, interval)) return;
+        ScopedTracerTimer timer(TracerTimer::RECORD_ALLOCATION);
+        ThreadEventBuffer* buffer = GetThreadBuffer();
+        if (!buffer) {
+            exited_dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        CountTracerEvent(TracerCounter::ALLOCATIONS_RECORDED);
 
-        CaptureStackTrace(info);
+        CaptureEvent event;
+        event.timestamp = GetTimestamp();
+        event.address = address;
+        event.size = size;
+        event.stack_id = CaptureStackTrace(hook_frame);
+        event.thread_id = GetThreadId();
+        event.sample_interval = interval;
+        event.type = EventType::ALLOC;
+        event.kind = kind;
 
-        std::lock_guard<std::mutex> lock(mutex_);
-        allocations_.push_back(info);
-        active_allocations_[address] = allocations_.size() - 1;
+        live_blocks_.Insert(address, {size, event.stack_id, interval, kind});
+        buffer->Push(event);
+    }
 
-        if (allocation_callback_) {
-            allocation_callback_(info);
+    // 热路径上登记的存活内存块，释放事件据此携带大小和调用栈
+    struct LiveBlock {
+        size_t size;
+        StackId stack_id;
+        uint32_t sample_interval;
+        AllocationKind kind;
+    };
+
+    // 已从登记表取出、尚未提交的释放
+    struct PendingFree {
+        LiveBlock block;
+        uint64_t timestamp;
+        bool record;      // 取出时正在捕获，提交时产生释放事件
+    };
+
+    void RecordDeallocation(void* address) {
+        // 每次释放都会经过这里，读时钟的开销不可忽略，只抽样计时
+        ScopedTracerTimer timer(TracerTimer::RECORD_DEALLOCATION,
+            capturing_.load(std::memory_order_relaxed) && ++t_free_timing_tick % kFreeTimingPeriod == 0);
+        PendingFree pending;
+        if (TakeLiveBlock(address, &pending)) {
+            CommitDeallocation(address, pending);
         }
     }
 
-    void RecordDeallocation(void* address) {
-        if (!capturing_) return;
+    // 取出地址的登记并记下释放时间。只有被记录过的内存块才产生释放事件，即便已停止捕获也要清理
+    bool TakeLiveBlock(void* address, PendingFree* pending) {
+        if (!live_blocks_.Erase(address, &pending->block)) return false;
+        pending->record = capturing_.load(std::memory_order_relaxed);
+        pending->timestamp = pending->record ? GetTimestamp() : 0;
+        return true;
+    }
 
-        std::lock_guard<std::mutex> lock(mutex_);
-        auto it = active_allocations_.find(address);
-        if (it != active_allocations_.end()) {
-            // 标记为已释放
-            allocations_[it->second].address = nullptr;
-            active_allocations_.erase(it);
+    void CommitDeallocation(void* address, const PendingFree& pending) {
+        if (!pending.record) return;
+        ThreadEventBuffer* buffer = GetThreadBuffer();
+        if (!buffer) {
+            exited_dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
         }
+        CountTracerEvent(TracerCounter::FREES_RECORDED);
+
+        CaptureEvent event;
+        event.timestamp = pending.timestamp;
+        event.address = address;
+        event.size = pending.block.size;
+        event.stack_id = pending.block.stack_id;
+        event.thread_id = GetThreadId();
+        event.sample_interval = pending.block.sample_interval;
+        event.type = EventType::FREE;
+        event.kind = pending.block.kind;
+
+        buffer->Push(event);
+    }
+
+    // 释放未真正发生（realloc 失败），把登记放回去
+    void RestoreLiveBlock(void* address, const PendingFree& pending) {
+        live_blocks_.Insert(address, pending.block);
     }
 
 private:
+
+    // 线程已退出（TLS 析构之后仍有释放经过 hook）时返回 nullptr
+    ThreadEventBuffer* GetThreadBuffer() {
+        if (t_thread_buffer || t_thread_buffer_exited) {
+            return t_thread_buffer;
+        }
+        {
+            // 每个线程只在首次分配时注册一次
+            CountedLockGuard<std::mutex> lock(registry_mutex_, TracerCounter::CAPTURE_LOCK_CONTENTIONS);
+            void* memory = internal::ArenaAllocate(sizeof(ThreadEventBuffer));
+            buffers_.push_back(new (memory) ThreadEventBuffer(kThreadBufferCapacity));
+            t_thread_buffer = buffers_.back();
+        }
+        thread_local ThreadBufferHandle handle;
+        (void)handle;
+        return t_thread_buffer;
+    }
+
+    void StartDrainThread() {
+        if (drain_running_) {
+            return;
+        }
+
+        drain_running_ = true;
+        drain_thread_ = std::thread([this]() {
+            // 合并线程及其调用的监听器产生的分配都属于追踪器自身
+            TracerScope scope;
+            while (drain_running_) {
+                DrainBuffers();
+                std::this_thread::sleep_for(std::chrono::milliseconds(kDrainIntervalMs));
+            }
+        });
+    }
+
+    void StopDrainThread() {
+        if (drain_running_) {
+            drain_running_ = false;
+            if (drain_thread_.joinable()) {
+                drain_thread_.join();
+            }
+            DrainBuffers();
+        }
+    }
+
+    // 取出所有线程缓冲区的事件，按时间戳合并后写入记录并通知监听器
+    void DrainBuffers() {
+        CountedLockGuard<std::mutex> lock(drain_mutex_, TracerCounter::CAPTURE_LOCK_CONTENTIONS);
+
+        batch_.clear();
+        {
+            CountedLockGuard<std::mutex> registry_lock(registry_mutex_, TracerCounter::CAPTURE_LOCK_CONTENTIONS);
+            for (auto it = buffers_.begin(); it != buffers_.end();) {
+                (*it)->Drain(batch_);
+                if ((*it)->IsRetired() && (*it)->Empty()) {
+                    retired_dropped_ += (*it)->GetDroppedCount();
+                    (*it)->~ThreadEventBuffer();
+                    internal::ArenaDeallocate(*it, sizeof(ThreadEventBuffer));
+                    it = buffers_.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+
+        std::stable_sort(batch_.begin(), batch_.end(),
+            [](const CaptureEvent& a, const CaptureEvent& b) { return a.timestamp < b.timestamp; });
+
+        // 上一轮未匹配的释放事件可能对应本轮才到达的分配，按时间戳归并后重试一次
+        std::vector<CaptureEvent> deferred;
+        deferred.swap(deferred_frees_);
+
+        applied_.clear();
+        size_t next_deferred = 0;
+        for (const auto& event : batch_) {
+            while (next_deferred < deferred.size() && deferred[next_deferred].timestamp <= event.timestamp) {
+                ApplyDeallocation(deferred[next_deferred++], false);
+            }
+            if (event.type == EventType::ALLOC) {
+                ApplyAllocation(event);
+            } else {
+                ApplyDeallocation(event, true);
+            }
+        }
+        while (next_deferred < deferred.size()) {
+            ApplyDeallocation(deferred[next_deferred++], false);
+        }
+
+        if (!applied_.empty()) {
+            for (auto listener : listeners_) {
+                listener(applied_.data(), applied_.size());
+            }
+        }
+    }
+
+    void ApplyAllocation(const CaptureEvent& event) {
+        applied_.push_back(event);
+        if (!retain_allocations_) {
+            // 不保留记录时只登记地址，用于配对释放事件
+            active_allocations_.Insert(event.address, kNotRetained);
+            if (allocation_callback_) {
+                allocation_callback_(MakeAllocationInfo(event));
+            }
+            return;
+        }
+
+        allocations_.push_back(MakeAllocationInfo(event));
+        active_allocations_.Insert(event.address, allocations_.size() - 1);
+
+        if (allocation_callback_) {
+            allocation_callback_(allocations_.back());
+        }
+    }
+
+    void ApplyDeallocation(const CaptureEvent& event, bool can_defer) {
+        size_t index = 0;
+        if (active_allocations_.Erase(event.address, &index)) {
+            // 标记为已释放
+            if (index != kNotRetained && index < allocations_.size()) {
+                allocations_[index].address = nullptr;
+            }
+            applied_.push_back(event);
+        } else if (can_defer) {
+            deferred_frees_.push_back(event);
+        }
+    }
+
     uint64_t GetTimestamp() const {
         return std::chrono::duration_cast<std::chrono::nanoseconds>(
             std::chrono::high_resolution_clock::now().time_since_epoch()
@@ -120,93 +505,499 @@ private:
     }
 
     uint32_t GetThreadId() const {
-        std::hash<std::thread::id> hasher;
-        return static_cast<uint32_t>(hasher(std::this_thread::get_id()));
+        thread_local uint32_t thread_id = static_cast<uint32_t>(
+            std::hash<std::thread::id>()(std::this_thread::get_id()));
+        return thread_id;
     }
 
-    void CaptureStackTrace(AllocationInfo& info) {
-        backward::StackTrace st;
-        st.load_here(32);
+    // 按字节的泊松采样：倒数耗尽时采中当前分配并抽取下一个指数分布的间隔，
+    // 未采中的分配只做一次减法和分支
+    bool ShouldSample(size_t size, uint32_t interval) {
+        t_bytes_until_sample -= static_cast<int64_t>(size);
+        if (t_bytes_until_sample > 0) return false;
 
-        backward::Resolver resolver;
-        resolver.load_stacktrace(st);
+        if (t_sampler_state == 0) {
+            // 线程首次采样时播种，并从一个完整的间隔开始倒数
+            t_sampler_state = (reinterpret_cast<uintptr_t>(&t_sampler_state) ^ GetTimestamp()) | 1;
+            t_bytes_until_sample = NextSampleDistance(interval) - static_cast<int64_t>(size);
+            if (t_bytes_until_sample > 0) return false;
+        }
 
-        for (size_t i = 0; i < st.size(); ++i) {
-            backward::ResolvedTrace trace = resolver.resolve(st[i]);
-            std::string frame = trace.object_function;
-            if (!frame.empty()) {
-                info.stack_trace.push_back(frame);
-            }
+        t_bytes_until_sample = NextSampleDistance(interval);
+        return true;
+    }
+
+    static int64_t NextSampleDistance(uint32_t interval) {
+        // xorshift64*，取高 53 位得到 (0, 1] 上的均匀分布
+        t_sampler_state ^= t_sampler_state >> 12;
+        t_sampler_state ^= t_sampler_state << 25;
+        t_sampler_state ^= t_sampler_state >> 27;
+        uint64_t bits = (t_sampler_state * 0x2545f4914f6cdd1dULL) >> 11;
+        double uniform = (static_cast<double>(bits) + 1.0) / 9007199254740992.0;
+        double distance = -std::log(uniform) * interval;
+        return distance < 1.0 ? 1 : static_cast<int64_t>(distance);
+    }
+
+    StackId CaptureStackTrace(void* hook_frame) {
+        // 热路径上只做展开，记录原始返回地址
+        ScopedTracerTimer timer(TracerTimer::CAPTURE_STACK_TRACE);
+        CaptureMode mode = mode_.load(std::memory_order_relaxed);
+        const UnwindState& state = GetUnwindState(mode);
+        void* frames[kMaxStackFrames];
+        size_t frame_count = internal::UnwindStack(state.unwinder.load(std::memory_order_relaxed), hook_frame, frames,
+                                                   state.max_depth.load(std::memory_order_relaxed),
+                                                   state.skip_frames.load(std::memory_order_relaxed));
+
+        bool is_new = false;
+        StackId stack_id = StackTable::GetInstance().Intern(frames, frame_count, &is_new);
+
+        if (is_new) {
+            CountTracerEvent(TracerCounter::STACKS_INTERNED);
         }
+
+        // FULL 模式在调用栈首次出现时预先解析，同一地址只解析一次
+        if (mode == CaptureMode::FULL && is_new) {
+            ScopedTracerTimer symbolize_timer(TracerTimer::SYMBOLIZE);
+            Symbolizer::GetInstance().Resolve(frames, frame_count);
+        }
+        return stack_id;
+    }
+
+    // 每种捕获模式各自的展开参数
+    struct UnwindState {
+        std::atomic<UnwinderType> unwinder;
+        std::atomic<uint32_t> max_depth;
+        std::atomic<uint32_t> skip_frames;
+    };
+
+    UnwindState& GetUnwindState(CaptureMode mode) {
+        return unwind_[mode == CaptureMode::FULL ? 0 : 1];
+    }
+
+    const UnwindState& GetUnwindState(CaptureMode mode) const {
+        return unwind_[mode == CaptureMode::FULL ? 0 : 1];
     }
 
-    bool capturing_;
+    static size_t ClampStackDepth(size_t depth) {
+        return std::min(std::max<size_t>(depth, 1), kMaxStackFrames);
+    }
+
+    static constexpr size_t kThreadBufferCapacity = 8192;
+    static constexpr int kDrainIntervalMs = 10;
+    // 不保留记录时登记在 active_allocations_ 中的占位下标
+    static constexpr size_t kNotRetained = SIZE_MAX;
+
+    std::atomic<bool> initialized_;
+    std::atomic<bool> capturing_;
+    std::atomic<CaptureMode> mode_;
+    std::atomic<uint32_t> sample_interval_;
+    UnwindState unwind_[2];
+    LiveTable<LiveBlock> live_blocks_;
+
+    // 以下成员由 drain_mutex_ 保护，只在合并时访问
     std::vector<AllocationInfo> allocations_;
-    std::map<void*, size_t> active_allocations_;
-    mutable std::mutex mutex_;
+    bool retain_allocations_;
+    LiveTable<size_t> active_allocations_;
+    std::vector<CaptureEvent> batch_;
+    std::vector<CaptureEvent> applied_;
+    std::vector<CaptureEvent> deferred_frees_;
     AllocationCallback allocation_callback_;
+    std::vector<EventBatchCallback> listeners_;
+    std::mutex drain_mutex_;
+
+    // 线程缓冲区注册表，只在线程首次分配和合并时加锁
+    std::vector<ThreadEventBuffer*, internal::ArenaAllocator<ThreadEventBuffer*>> buffers_;
+    uint64_t retired_dropped_;
+    std::atomic<uint64_t> exited_dropped_;  // 线程退出后仍产生的事件
+    mutable std::mutex registry_mutex_;
+
+    std::atomic<bool> drain_running_;
+    std::thread drain_thread_;
 };
 
+AllocationInfo MakeAllocationInfo(const CaptureEvent& event) {
+    AllocationInfo info;
+    info.timestamp = event.timestamp;
+    info.address = event.address;
+    info.size = event.size;
+    info.function = GetAllocationKindName(event.kind);
+    info.file = "unknown";
+    info.line = 0;
+    info.thread_id = event.thread_id;
+    info.stack_id = event.stack_id;
+    info.kind = event.kind;
+    info.sample_interval = event.sample_interval;
+    return info;
+}
+
+double GetSampleWeight(size_t size, uint32_t sample_interval) {
+    if (sample_interval == 0 || size == 0) {
+        return 1.0;
+    }
+    return -1.0 / std::expm1(-static_cast<double>(size) / sample_interval);
+}
+
+const char* GetAllocationKindName(AllocationKind kind) {
+    switch (kind) {
+        case AllocationKind::MALLOC: return "malloc";
+        case AllocationKind::CALLOC: return "calloc";
+        case AllocationKind::REALLOC: return "realloc";
+        case AllocationKind::ALIGNED_ALLOC: return "aligned_alloc";
+        case AllocationKind::POSIX_MEMALIGN: return "posix_memalign";
+        case AllocationKind::MEMALIGN: return "memalign";
+        case AllocationKind::VALLOC: return "valloc";
+        case AllocationKind::PVALLOC: return "pvalloc";
+        case AllocationKind::NEW: return "operator new";
+        case AllocationKind::NEW_ARRAY: return "operator new[]";
+        case AllocationKind::NEW_ALIGNED: return "operator new(align)";
+        case AllocationKind::NEW_ARRAY_ALIGNED: return "operator new[](align)";
+        case AllocationKind::MMAP: return "mmap";
+    }
+    return "unknown";
+}
+
 // 全局实例
-Capture::Impl* g_capture_impl = nullptr;
+struct HookState {
+    static Capture::Impl* impl;
+    using PendingFree = Capture::Impl::PendingFree;
+};
+Capture::Impl* HookState::impl = nullptr;
 
-// Hook 的 malloc 实现
-extern "C" void* malloc(size_t size) {
-    if (!real_malloc) {
-        // 初始化期间直接调用原始函数
-        return __libc_malloc(size);
+// 追踪器内部的分配不记录，也不会递归，只计入追踪器自身的开销
+// hook_frame 为对外 hook 函数自身的帧地址，调用栈从调用 hook 的位置开始记录
+static void TrackAllocation(void* ptr, size_t size, AllocationKind kind, void* hook_frame) {
+    if (ptr && TracerScope::IsActive()) {
+        CountTracerEvent(TracerCounter::TRACER_ALLOCATIONS);
+        CountTracerEvent(TracerCounter::TRACER_ALLOCATED_BYTES, size);
+        return;
     }
+    if (ptr && HookState::impl) {
+        TracerScope scope;
+        HookState::impl->RecordAllocation(ptr, size, kind, hook_frame);
+    }
+}
 
-    void* ptr = real_malloc(size);
+// 先注销再释放，避免地址被其他线程复用后误删其登记
+static void TrackDeallocation(void* ptr) {
+    if (ptr && HookState::impl && !TracerScope::IsActive()) {
+        TracerScope scope;
+        HookState::impl->RecordDeallocation(ptr);
+    }
+}
+
+// realloc 的释放分两步：调用前取出旧块登记，结果确定后再提交或恢复
+static bool TakeTrackedBlock(void* ptr, HookState::PendingFree* pending) {
+    if (ptr && HookState::impl && !TracerScope::IsActive()) {
+        TracerScope scope;
+        return HookState::impl->TakeLiveBlock(ptr, pending);
+    }
+    return false;
+}
+
+static void FinishTrackedBlock(void* ptr, const HookState::PendingFree& pending, bool freed) {
+    TracerScope scope;
+    if (freed) {
+        HookState::impl->CommitDeallocation(ptr, pending);
+    } else {
+        HookState::impl->RestoreLiveBlock(ptr, pending);
+    }
+}
 
-    if (g_capture_impl) {
-        g_capture_impl->RecordAllocation(ptr, size, "malloc", nullptr, 0);
+// Hook 的 malloc 实现
+extern "C" void* malloc(size_t size) {
+    if (!real_malloc && !ResolveRealFunctions()) {
+        // 解析原始函数期间使用引导区
+        return BootstrapAllocate(size);
     }
 
+    void* ptr = real_malloc(size);
+    TrackAllocation(ptr, size, AllocationKind::MALLOC, __builtin_frame_address(0));
     return ptr;
 }
 
 // Hook 的 free 实现
 extern "C" void free(void* ptr) {
-    if (!real_free) {
-        __libc_free(ptr);
+    if (!ptr || IsBootstrapPointer(ptr)) {
         return;
     }
-
-    if (g_capture_impl && ptr) {
-        g_capture_impl->RecordDeallocation(ptr);
+    if (!real_free && !ResolveRealFunctions()) {
+        return;
     }
 
+    TrackDeallocation(ptr);
     real_free(ptr);
 }
 
+// Hook 的 calloc 实现
+extern "C" void* calloc(size_t count, size_t size) {
+    if (!real_calloc && !ResolveRealFunctions()) {
+        // dlerror 等内部状态通过 calloc 申请，引导区从未被写过，天然为零
+        size_t total = 0;
+        if (__builtin_mul_overflow(count, size, &total)) {
+            return nullptr;
+        }
+        return BootstrapAllocate(total);
+    }
+
+    void* ptr = real_calloc(count, size);
+    TrackAllocation(ptr, count * size, AllocationKind::CALLOC, __builtin_frame_address(0));
+    return ptr;
+}
+
 // Hook 的 realloc 实现
 extern "C" void* realloc(void* ptr, size_t size) {
-    if (!real_realloc) {
-        return __libc_realloc(ptr, size);
+    if (IsBootstrapPointer(ptr)) {
+        // 引导区的内存迁移到正常堆上
+        void* new_ptr = malloc(size);
+        if (new_ptr) {
+            size_t old_size = GetBootstrapSize(ptr);
+            std::memcpy(new_ptr, ptr, old_size < size ? old_size : size);
+        }
+        return new_ptr;
+    }
+    if (!real_realloc && !ResolveRealFunctions()) {
+        return ptr ? nullptr : BootstrapAllocate(size);
     }
 
+    // 释放时间取在 realloc 之前，旧地址被其他线程复用时其分配事件排在本次释放之后。
+    // realloc 失败（size 为 0 时除外）时旧块仍然有效，不产生释放事件
+    HookState::PendingFree pending;
+    bool tracked = TakeTrackedBlock(ptr, &pending);
     void* new_ptr = real_realloc(ptr, size);
+    if (tracked) {
+        FinishTrackedBlock(ptr, pending, new_ptr != nullptr || size == 0);
+    }
+    TrackAllocation(new_ptr, size, AllocationKind::REALLOC, __builtin_frame_address(0));
+    return new_ptr;
+}
+
+// 对齐分配在解析完成前不会出现，失败时按各自的约定返回
+extern "C" int posix_memalign(void** memptr, size_t alignment, size_t size) {
+    if (!real_posix_memalign && !ResolveRealFunctions()) {
+        return ENOMEM;
+    }
+
+    int result = real_posix_memalign(memptr, alignment, size);
+    if (result == 0) {
+        TrackAllocation(*memptr, size, AllocationKind::POSIX_MEMALIGN, __builtin_frame_address(0));
+    }
+    return result;
+}
+
+extern "C" void* aligned_alloc(size_t alignment, size_t size) {
+    if (!real_aligned_alloc && !ResolveRealFunctions()) {
+        return nullptr;
+    }
+
+    void* ptr = real_aligned_alloc(alignment, size);
+    TrackAllocation(ptr, size, AllocationKind::ALIGNED_ALLOC, __builtin_frame_address(0));
+    return ptr;
+}
+
+extern "C" void* memalign(size_t alignment, size_t size) {
+    if (!real_memalign && !ResolveRealFunctions()) {
+        return nullptr;
+    }
+
+    void* ptr = real_memalign(alignment, size);
+    TrackAllocation(ptr, size, AllocationKind::MEMALIGN, __builtin_frame_address(0));
+    return ptr;
+}
+
+extern "C" void* valloc(size_t size) {
+    if (!real_valloc && !ResolveRealFunctions()) {
+        return nullptr;
+    }
+
+    void* ptr = real_valloc(size);
+    TrackAllocation(ptr, size, AllocationKind::VALLOC, __builtin_frame_address(0));
+    return ptr;
+}
+
+extern "C" void* pvalloc(size_t size) {
+    if (!real_pvalloc && !ResolveRealFunctions()) {
+        return nullptr;
+    }
+
+    void* ptr = real_pvalloc(size);
+    TrackAllocation(ptr, size, AllocationKind::PVALLOC, __builtin_frame_address(0));
+    return ptr;
+}
+
+// Hook 的 mmap 实现：只记录匿名映射，文件映射不属于堆内存
+// glibc 的 malloc 内部直接发起系统调用申请大块内存，不会经过这里
+// 强制内联，避免尾调用使 hook_frame 指向已退出的帧
+static inline __attribute__((always_inline)) void* MapMemory(void* addr, size_t length, int prot, int flags, int fd,
+                                                             off_t offset, void* hook_frame) {
+    if (!real_mmap && !ResolveRealFunctions()) {
+        return reinterpret_cast<void*>(syscall(SYS_mmap, addr, length, prot, flags, fd, offset));
+    }
+
+    void* ptr = real_mmap(addr, length, prot, flags, fd, offset);
+    if (ptr != MAP_FAILED && (flags & MAP_ANONYMOUS)) {
+        TrackAllocation(ptr, length, AllocationKind::MMAP, hook_frame);
+    }
+    return ptr;
+}
+
+extern "C" void* mmap(void* addr, size_t length, int prot, int flags, int fd, off_t offset) {
+    return MapMemory(addr, length, prot, flags, fd, offset, __builtin_frame_address(0));
+}
+
+#ifdef __USE_LARGEFILE64
+extern "C" void* mmap64(void* addr, size_t length, int prot, int flags, int fd, off64_t offset) {
+    return MapMemory(addr, length, prot, flags, fd, static_cast<off_t>(offset), __builtin_frame_address(0));
+}
+#endif
+
+// 只有起始地址与某次 mmap 完全一致时才视为释放，部分解除映射不拆分登记。
+// 与 realloc 相同，登记先取出，解除映射失败时放回
+extern "C" int munmap(void* addr, size_t length) {
+    if (!real_munmap && !ResolveRealFunctions()) {
+        return static_cast<int>(syscall(SYS_munmap, addr, length));
+    }
+
+    HookState::PendingFree pending;
+    bool tracked = TakeTrackedBlock(addr, &pending);
+    int result = real_munmap(addr, length);
+    if (tracked) {
+        FinishTrackedBlock(addr, pending, result == 0);
+    }
+    return result;
+}
+
+// 被记录的映射移动或改变大小后视为释放旧映射、在新地址重新映射，新记录的调用栈为 mremap 的调用点。
+// 未被记录的映射（文件映射、未采中的映射）不产生记录
+extern "C" void* mremap(void* old_address, size_t old_size, size_t new_size, int flags, ...) {
+    void* new_address = nullptr;
+    if (flags & MREMAP_FIXED) {
+        va_list args;
+        va_start(args, flags);
+        new_address = va_arg(args, void*);
+        va_end(args);
+    }
+    if (!real_mremap && !ResolveRealFunctions()) {
+        return reinterpret_cast<void*>(syscall(SYS_mremap, old_address, old_size, new_size, flags, new_address));
+    }
+
+    HookState::PendingFree pending;
+    bool tracked = TakeTrackedBlock(old_address, &pending);
+    void* ptr = real_mremap(old_address, old_size, new_size, flags, new_address);
+    if (tracked) {
+        bool unmapped = ptr != MAP_FAILED;
+#ifdef MREMAP_DONTUNMAP
+        // 旧映射保留在原地址
+        unmapped = unmapped && !(flags & MREMAP_DONTUNMAP);
+#endif
+        FinishTrackedBlock(old_address, pending, unmapped);
+        if (ptr != MAP_FAILED) {
+            TrackAllocation(ptr, new_size, AllocationKind::MMAP, __builtin_frame_address(0));
+        }
+    }
+    return ptr;
+}
+
+// operator new 系列：失败时按标准循环调用 new_handler。强制内联的原因同 MapMemory
+static inline __attribute__((always_inline)) void* AllocateForNew(size_t size, size_t alignment, AllocationKind kind,
+                                                                  bool nothrow, void* hook_frame) {
+    if (size == 0) size = 1;
+    while (true) {
+        void* ptr = nullptr;
+        if (alignment > alignof(std::max_align_t)) {
+            if (!real_posix_memalign && !ResolveRealFunctions()) {
+                ptr = nullptr;
+            } else if (real_posix_memalign(&ptr, alignment, size) != 0) {
+                ptr = nullptr;
+            }
+        } else if (!real_malloc && !ResolveRealFunctions()) {
+            ptr = BootstrapAllocate(size);
+        } else {
+            ptr = real_malloc(size);
+        }
 
-    if (g_capture_impl) {
         if (ptr) {
-            g_capture_impl->RecordDeallocation(ptr);
+            TrackAllocation(ptr, size, kind, hook_frame);
+            return ptr;
         }
-        if (new_ptr) {
-            g_capture_impl->RecordAllocation(new_ptr, size, "realloc", nullptr, 0);
+
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) {
+            if (nothrow) return nullptr;
+            throw std::bad_alloc();
+        }
+        if (nothrow) {
+            try {
+                handler();
+            } catch (...) {
+                return nullptr;
+            }
+        } else {
+            handler();
         }
     }
+}
 
-    return new_ptr;
+} // namespace capture
+} // namespace memory_tracer
+
+using memory_tracer::capture::AllocateForNew;
+using memory_tracer::capture::AllocationKind;
+
+void* operator new(size_t size) {
+    return AllocateForNew(size, 0, AllocationKind::NEW, false, __builtin_frame_address(0));
+}
+void* operator new[](size_t size) {
+    return AllocateForNew(size, 0, AllocationKind::NEW_ARRAY, false, __builtin_frame_address(0));
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return AllocateForNew(size, 0, AllocationKind::NEW, true, __builtin_frame_address(0));
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return AllocateForNew(size, 0, AllocationKind::NEW_ARRAY, true, __builtin_frame_address(0));
+}
+void* operator new(size_t size, std::align_val_t alignment) {
+    return AllocateForNew(size, static_cast<size_t>(alignment), AllocationKind::NEW_ALIGNED, false,
+                          __builtin_frame_address(0));
+}
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return AllocateForNew(size, static_cast<size_t>(alignment), AllocationKind::NEW_ARRAY_ALIGNED, false,
+                          __builtin_frame_address(0));
+}
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return AllocateForNew(size, static_cast<size_t>(alignment), AllocationKind::NEW_ALIGNED, true,
+                          __builtin_frame_address(0));
+}
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return AllocateForNew(size, static_cast<size_t>(alignment), AllocationKind::NEW_ARRAY_ALIGNED, true,
+                          __builtin_frame_address(0));
 }
 
-Capture::Capture() : pimpl_(std::make_unique<Impl>()) {
-    g_capture_impl = pimpl_.get();
+// 所有 delete 都归结到 free；带大小的版本仍需查存活表以取得调用栈
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete[](void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { free(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { free(ptr); }
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { free(ptr); }
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept { free(ptr); }
+
+namespace memory_tracer {
+namespace capture {
+
+Capture::Capture() {
+    TracerScope scope;
+    pimpl_ = std::make_unique<Impl>();
+    HookState::impl = pimpl_.get();
 }
 
 Capture::~Capture() {
     Shutdown();
-    g_capture_impl = nullptr;
+    HookState::impl = nullptr;
 }
 
 Capture& Capture::GetInstance() {
@@ -214,14 +1005,29 @@ Capture& Capture::GetInstance() {
     return instance;
 }
 
-void Capture::Initialize() { pimpl_->Initialize(); }
-void Capture::Shutdown() { pimpl_->Shutdown(); }
-void Capture::StartCapture() { pimpl_->StartCapture(); }
-void Capture::StopCapture() { pimpl_->StopCapture(); }
+void Capture::Initialize() { TracerScope scope; pimpl_->Initialize(); }
+void Capture::Shutdown() { TracerScope scope; pimpl_->Shutdown(); }
+void Capture::StartCapture() { TracerScope scope; pimpl_->StartCapture(); }
+void Capture::StopCapture() { TracerScope scope; pimpl_->StopCapture(); }
 bool Capture::IsCapturing() const { return pimpl_->IsCapturing(); }
+void Capture::SetCaptureMode(CaptureMode mode) { pimpl_->SetCaptureMode(mode); }
+CaptureMode Capture::GetCaptureMode() const { return pimpl_->GetCaptureMode(); }
+void Capture::SetSamplingInterval(size_t bytes) { TracerScope scope; pimpl_->SetSamplingInterval(bytes); }
+size_t Capture::GetSamplingInterval() const { return pimpl_->GetSamplingInterval(); }
+void Capture::SetMaxStackDepth(size_t depth) { TracerScope scope; pimpl_->SetMaxStackDepth(depth); }
+size_t Capture::GetMaxStackDepth() const { return pimpl_->GetMaxStackDepth(); }
+void Capture::SetUnwindOptions(CaptureMode mode, const UnwindOptions& options) {
+    TracerScope scope;
+    pimpl_->SetUnwindOptions(mode, options);
+}
+UnwindOptions Capture::GetUnwindOptions(CaptureMode mode) const { return pimpl_->GetUnwindOptions(mode); }
+void Capture::SetRetainAllocations(bool retain) { TracerScope scope; pimpl_->SetRetainAllocations(retain); }
 const std::vector<AllocationInfo>& Capture::GetAllocations() const { return pimpl_->GetAllocations(); }
-void Capture::Clear() { pimpl_->Clear(); }
+void Capture::Flush() { TracerScope scope; pimpl_->Flush(); }
+uint64_t Capture::GetDroppedEventCount() const { return pimpl_->GetDroppedEventCount(); }
+void Capture::Clear() { TracerScope scope; pimpl_->Clear(); }
 void Capture::SetAllocationCallback(AllocationCallback callback) { pimpl_->SetAllocationCallback(callback); }
+void Capture::AddEventListener(EventBatchCallback callback) { TracerScope scope; pimpl_->AddEventListener(callback); }
 
 } // namespace capture
 } // namespace memory_tracer
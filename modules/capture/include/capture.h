@@ -8,6 +8,57 @@
 namespace memory_tracer {
 namespace capture {
 
+// 单条调用栈最多记录的帧数
+constexpr size_t kMaxStackFrames = 32;
+
+enum class CaptureMode {
+    FULL,     // 调用栈首次出现时即完成符号化
+    RAW_PC    // 只记录原始返回地址，符号化延迟到报告/导出时进行
+};
+
+// 调用栈展开方式。每次被采中的分配都完整展开一次，没有影子栈：同一调用点反复分配时，
+// 省下的只是 StackTable 线程本地缓存命中后的加锁与查表（DWARF 另有按调用链校验的结果缓存）
+enum class UnwinderType : uint8_t {
+    FRAME_POINTER,  // 沿帧指针链展开，要求程序及其依赖库保留帧指针（-fno-omit-frame-pointer）
+    DWARF,          // 由 _Unwind_Backtrace 按 .eh_frame 展开，不依赖帧指针，但慢一个数量级
+    AUTO            // 帧指针优先；调用点首次出现时用 DWARF 校验，帧指针链不完整的调用点此后改用 DWARF
+};
+
+// 展开方式名称（静态字符串）
+const char* GetUnwinderTypeName(UnwinderType type);
+
+// 按名称（fp/dwarf/auto，不区分大小写）解析展开方式，无法识别时返回 false
+bool ParseUnwinderType(const char* name, UnwinderType* type);
+
+// 调用栈展开参数，FULL 与 RAW_PC 模式各有一份
+struct UnwindOptions {
+    UnwinderType unwinder;
+    uint32_t max_depth;     // 最多记录的帧数（1~kMaxStackFrames）
+    uint32_t skip_frames;   // 从分配调用点起再跳过的帧数，用于略去业务自己的分配封装
+
+    UnwindOptions() : unwinder(UnwinderType::AUTO), max_depth(kMaxStackFrames), skip_frames(0) {}
+};
+
+// 分配接口类型
+enum class AllocationKind : uint8_t {
+    MALLOC,
+    CALLOC,
+    REALLOC,
+    ALIGNED_ALLOC,
+    POSIX_MEMALIGN,
+    MEMALIGN,
+    VALLOC,
+    PVALLOC,
+    NEW,
+    NEW_ARRAY,
+    NEW_ALIGNED,
+    NEW_ARRAY_ALIGNED,
+    MMAP              // 匿名 mmap 映射，单独统计
+};
+
+// 分配接口名称（静态字符串）
+const char* GetAllocationKindName(AllocationKind kind);
+
 struct AllocationInfo {
     uint64_t timestamp;      // 纳秒时间戳
     void* address;           // 内存地址
@@ -16,11 +67,38 @@ struct AllocationInfo {
     std::string file;        // 源文件
     int line;                // 行号
     uint32_t thread_id;      // 线程ID
-    std::vector<std::string> stack_trace;  // 调用栈
+    uint64_t stack_id;       // 调用栈 ID（见 StackTable）
+    AllocationKind kind;     // 分配接口类型
+    uint32_t sample_interval;  // 采样时的平均采样间隔（字节），0 表示未采样
+
+    AllocationInfo()
+        : timestamp(0), address(nullptr), size(0), line(0), thread_id(0), stack_id(0),
+          kind(AllocationKind::MALLOC), sample_interval(0) {}
+};
 
-    AllocationInfo() : address(nullptr), size(0), line(0), thread_id(0) {}
+enum class EventType : uint8_t {
+    ALLOC,
+    FREE
 };
 
+// 捕获事件：定长 POD，由分配线程写入线程本地环形缓冲区
+struct CaptureEvent {
+    uint64_t timestamp;      // 纳秒时间戳
+    void* address;           // 内存地址
+    size_t size;             // 分配大小（FREE 事件为被释放块的大小）
+    uint64_t stack_id;       // 调用栈 ID（FREE 事件为分配时的调用栈）
+    uint32_t thread_id;      // 线程ID
+    uint32_t sample_interval;  // 平均采样间隔（字节），0 表示全量记录
+    EventType type;
+    AllocationKind kind;     // 分配接口类型（FREE 事件同分配时）
+};
+
+// 带采样间隔 T 的分配被采中的概率为 1 - exp(-size / T)，返回其倒数作为估计权重
+double GetSampleWeight(size_t size, uint32_t sample_interval);
+
+// 将分配事件转换为分配记录
+AllocationInfo MakeAllocationInfo(const CaptureEvent& event);
+
 class Capture {
 public:
     static Capture& GetInstance();
@@ -40,16 +118,48 @@ public:
     // 是否正在捕获
     bool IsCapturing() const;
 
-    // 获取捕获到的内存分配信息
+    // 设置捕获模式（默认 FULL）
+    void SetCaptureMode(CaptureMode mode);
+    CaptureMode GetCaptureMode() const;
+
+    // 设置按字节的泊松采样间隔：平均每分配 bytes 字节采样一次，0 表示全量记录（默认）
+    // 未被采中的分配不展开调用栈也不产生记录
+    void SetSamplingInterval(size_t bytes);
+    size_t GetSamplingInterval() const;
+
+    // 设置调用栈展开的最大帧数（1~kMaxStackFrames，默认 kMaxStackFrames），对两种模式同时生效，
+    // 只影响之后的分配。Get 返回当前模式的设置
+    void SetMaxStackDepth(size_t depth);
+    size_t GetMaxStackDepth() const;
+
+    // 设置某一捕获模式的展开方式、帧数和跳过的帧数（默认 AUTO、kMaxStackFrames、0）
+    void SetUnwindOptions(CaptureMode mode, const UnwindOptions& options);
+    UnwindOptions GetUnwindOptions(CaptureMode mode) const;
+
+    // 是否在内存中保留分配记录供 GetAllocations 使用（默认保留）。
+    // 只通过事件监听器消费时可关闭，长时间运行时记录不会无限增长
+    void SetRetainAllocations(bool retain);
+
+    // 获取捕获到的内存分配信息（合并线程会并发写入，应在 StopCapture 之后调用）
     const std::vector<AllocationInfo>& GetAllocations() const;
 
+    // 立即合并所有线程缓冲区中的事件
+    void Flush();
+
+    // 因线程缓冲区写满而丢弃的事件数
+    uint64_t GetDroppedEventCount() const;
+
     // 清空捕获信息
     void Clear();
 
-    // 设置回调函数，当有新的内存分配时调用
+    // 设置回调函数，当有新的内存分配时调用（在合并线程中执行）
     using AllocationCallback = void(*)(const AllocationInfo&);
     void SetAllocationCallback(AllocationCallback callback);
 
+    // 注册事件批量监听器，合并线程按时间顺序投递分配/释放事件
+    using EventBatchCallback = void(*)(const CaptureEvent* events, size_t count);
+    void AddEventListener(EventBatchCallback callback);
+
 private:
     Capture();
     ~Capture();
@@ -58,6 +168,9 @@ private:
 
     class Impl;
     std::unique_ptr<Impl> pimpl_;
+
+    // malloc/free hook 需要直接访问实现
+    friend struct HookState;
 };
 
 // 便捷宏
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace memory_tracer {
+namespace capture {
+
+// 轻量自旋锁，临界区只有几次内存访问
+class SpinLock {
+public:
+    void lock() {
+        while (flag_.test_and_set(std::memory_order_acquire)) {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#endif
+        }
+    }
+
+    void unlock() { flag_.clear(std::memory_order_release); }
+
+private:
+    std::atomic_flag flag_ = ATOMIC_FLAG_INIT;
+};
+
+// 追踪器内部作用域：作用域内本线程的内存分配直接交给原始分配器，
+// 既不会被记录为用户分配，也不会递归进入 hook
+class TracerScope {
+public:
+    TracerScope();
+    ~TracerScope();
+    TracerScope(const TracerScope&) = delete;
+    TracerScope& operator=(const TracerScope&) = delete;
+
+    // 当前线程是否处于追踪器内部
+    static bool IsActive();
+
+private:
+    bool previous_;
+};
+
+namespace internal {
+
+// 追踪器私有的 mmap 内存池，供内部数据结构使用
+// 小块按大小分级复用，大块直接映射
+void* ArenaAllocate(size_t size);
+void ArenaDeallocate(void* ptr, size_t size);
+
+// 内存池已向系统申请的字节数
+size_t GetArenaReservedBytes();
+
+// 内存池中正在使用的字节数
+size_t GetArenaUsedBytes();
+
+// 基于内存池的 STL 分配器
+template <typename T>
+struct ArenaAllocator {
+    using value_type = T;
+
+    ArenaAllocator() noexcept = default;
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>&) noexcept {}
+
+    T* allocate(size_t n) {
+        void* ptr = ArenaAllocate(n * sizeof(T));
+        if (!ptr) throw std::bad_alloc();
+        return static_cast<T*>(ptr);
+    }
+
+    void deallocate(T* ptr, size_t n) noexcept {
+        ArenaDeallocate(ptr, n * sizeof(T));
+    }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>&) const noexcept { return true; }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>&) const noexcept { return false; }
+};
+
+} // namespace internal
+} // namespace capture
+} // namespace memory_tracer
@@ -0,0 +1,240 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <type_traits>
+
+#include "capture/internal_allocator.h"
+
+namespace memory_tracer {
+namespace capture {
+
+// 以地址为键的存活内存块表
+// 按地址哈希分片，每个分片是一张开放寻址（线性探测）哈希表，
+// 槽位数组由追踪器内存池分配，不会回到被 hook 的 malloc
+template <typename Value>
+class LiveTable {
+    static_assert(std::is_trivially_copyable<Value>::value, "LiveTable value must be trivially copyable");
+
+public:
+    explicit LiveTable(size_t shard_count = 64, size_t initial_capacity = 1024)
+        : shard_bits_(Log2(RoundUpToPowerOfTwo(shard_count))),
+          shard_count_(size_t(1) << shard_bits_),
+          shards_(static_cast<Shard*>(internal::ArenaAllocate(sizeof(Shard) * shard_count_))) {
+        size_t capacity = RoundUpToPowerOfTwo(initial_capacity < 16 ? 16 : initial_capacity);
+        for (size_t i = 0; i < shard_count_; ++i) {
+            new (&shards_[i]) Shard();
+            shards_[i].slots = AllocateSlots(capacity);
+            shards_[i].capacity = capacity;
+        }
+    }
+
+    ~LiveTable() {
+        for (size_t i = 0; i < shard_count_; ++i) {
+            FreeSlots(shards_[i].slots, shards_[i].capacity);
+        }
+        internal::ArenaDeallocate(shards_, sizeof(Shard) * shard_count_);
+    }
+
+    LiveTable(const LiveTable&) = delete;
+    LiveTable& operator=(const LiveTable&) = delete;
+
+    // 插入或覆盖，返回是否为新键
+    bool Insert(void* key, const Value& value) {
+        uint64_t hash = Hash(key);
+        Shard& shard = GetShard(hash);
+        std::lock_guard<SpinLock> lock(shard.lock);
+
+        if ((shard.size + shard.tombstones + 1) * 4 > shard.capacity * 3) {
+            Rehash(shard, shard.size * 2 >= shard.capacity ? shard.capacity * 2 : shard.capacity);
+        }
+
+        size_t mask = shard.capacity - 1;
+        size_t index = hash & mask;
+        Slot* tombstone = nullptr;
+        while (true) {
+            Slot& slot = shard.slots[index];
+            if (slot.key == key) {
+                slot.value = value;
+                return false;
+            }
+            if (slot.key == kEmptyKey) {
+                Slot& target = tombstone ? *tombstone : slot;
+                if (tombstone) shard.tombstones--;
+                target.key = key;
+                target.value = value;
+                shard.size++;
+                return true;
+            }
+            if (slot.key == kTombstoneKey && !tombstone) {
+                tombstone = &slot;
+            }
+            index = (index + 1) & mask;
+        }
+    }
+
+    bool Find(void* key, Value* value) const {
+        uint64_t hash = Hash(key);
+        Shard& shard = GetShard(hash);
+        std::lock_guard<SpinLock> lock(shard.lock);
+
+        const Slot* slot = Lookup(shard, key, hash);
+        if (!slot) return false;
+        if (value) *value = slot->value;
+        return true;
+    }
+
+    // 删除键，value 返回被删除的值
+    bool Erase(void* key, Value* value = nullptr) {
+        uint64_t hash = Hash(key);
+        Shard& shard = GetShard(hash);
+        std::lock_guard<SpinLock> lock(shard.lock);
+
+        Slot* slot = const_cast<Slot*>(Lookup(shard, key, hash));
+        if (!slot) return false;
+        if (value) *value = slot->value;
+        slot->key = kTombstoneKey;
+        shard.size--;
+        shard.tombstones++;
+        return true;
+    }
+
+    template <typename Func>
+    void ForEach(Func func) const {
+        for (size_t i = 0; i < shard_count_; ++i) {
+            Shard& shard = shards_[i];
+            std::lock_guard<SpinLock> lock(shard.lock);
+            for (size_t j = 0; j < shard.capacity; ++j) {
+                const Slot& slot = shard.slots[j];
+                if (slot.key != kEmptyKey && slot.key != kTombstoneKey) {
+                    func(slot.key, slot.value);
+                }
+            }
+        }
+    }
+
+    size_t Size() const {
+        size_t total = 0;
+        for (size_t i = 0; i < shard_count_; ++i) {
+            std::lock_guard<SpinLock> lock(shards_[i].lock);
+            total += shards_[i].size;
+        }
+        return total;
+    }
+
+    void Clear() {
+        for (size_t i = 0; i < shard_count_; ++i) {
+            Shard& shard = shards_[i];
+            std::lock_guard<SpinLock> lock(shard.lock);
+            std::memset(static_cast<void*>(shard.slots), 0, shard.capacity * sizeof(Slot));
+            shard.size = 0;
+            shard.tombstones = 0;
+        }
+    }
+
+private:
+    struct Slot {
+        void* key;
+        Value value;
+    };
+
+    struct alignas(64) Shard {
+        SpinLock lock;
+        Slot* slots = nullptr;
+        size_t capacity = 0;
+        size_t size = 0;
+        size_t tombstones = 0;
+    };
+
+    static constexpr void* kEmptyKey = nullptr;
+    static inline void* const kTombstoneKey = reinterpret_cast<void*>(uintptr_t(1));
+
+    static uint64_t Hash(void* key) {
+        uint64_t h = reinterpret_cast<uintptr_t>(key) >> 4;
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    // 高位选分片，低位选槽位
+    Shard& GetShard(uint64_t hash) const {
+        return shards_[shard_bits_ ? (hash >> (64 - shard_bits_)) : 0];
+    }
+
+    static const Slot* Lookup(const Shard& shard, void* key, uint64_t hash) {
+        size_t mask = shard.capacity - 1;
+        size_t index = hash & mask;
+        while (true) {
+            const Slot& slot = shard.slots[index];
+            if (slot.key == key) return &slot;
+            if (slot.key == kEmptyKey) return nullptr;
+            index = (index + 1) & mask;
+        }
+    }
+
+    // 扩容或清理墓碑：分配新的槽位数组并重新插入
+    static void Rehash(Shard& shard, size_t new_capacity) {
+        Slot* new_slots = AllocateSlots(new_capacity);
+        if (!new_slots) {
+            return;
+        }
+
+        Slot* old_slots = shard.slots;
+        size_t old_capacity = shard.capacity;
+
+        shard.slots = new_slots;
+        shard.capacity = new_capacity;
+        shard.tombstones = 0;
+
+        size_t mask = new_capacity - 1;
+        for (size_t i = 0; i < old_capacity; ++i) {
+            const Slot& slot = old_slots[i];
+            if (slot.key == kEmptyKey || slot.key == kTombstoneKey) continue;
+            size_t index = Hash(slot.key) & mask;
+            while (shard.slots[index].key != kEmptyKey) {
+                index = (index + 1) & mask;
+            }
+            shard.slots[index] = slot;
+        }
+
+        FreeSlots(old_slots, old_capacity);
+    }
+
+    // 空键为 nullptr，清零即全部为空槽
+    static Slot* AllocateSlots(size_t capacity) {
+        void* memory = internal::ArenaAllocate(capacity * sizeof(Slot));
+        if (memory) std::memset(memory, 0, capacity * sizeof(Slot));
+        return static_cast<Slot*>(memory);
+    }
+
+    static void FreeSlots(Slot* slots, size_t capacity) {
+        if (slots) internal::ArenaDeallocate(slots, capacity * sizeof(Slot));
+    }
+
+    static size_t RoundUpToPowerOfTwo(size_t value) {
+        size_t result = 1;
+        while (result < value) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    static size_t Log2(size_t value) {
+        size_t result = 0;
+        while ((size_t(1) << result) < value) {
+            ++result;
+        }
+        return result;
+    }
+
+    const size_t shard_bits_;
+    const size_t shard_count_;
+    Shard* shards_;
+};
+
+} // namespace capture
+} // namespace memory_tracer
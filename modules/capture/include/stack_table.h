@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace memory_tracer {
+namespace capture {
+
+// 调用栈 ID，由原始帧数组的哈希得到，0 表示无调用栈
+using StackId = uint64_t;
+constexpr StackId kInvalidStackId = 0;
+
+// 全局调用栈表：每个不同的调用栈只存储一次
+class StackTable {
+public:
+    static StackTable& GetInstance();
+
+    // 登记一个调用栈，返回其 ID；is_new 返回是否首次出现
+    StackId Intern(void* const* frames, size_t count, bool* is_new = nullptr);
+
+    // 获取调用栈的原始帧，未知 ID 返回空
+    std::vector<void*> GetFrames(StackId id) const;
+
+    // 获取符号化后的调用栈（跳过无法解析的帧）
+    std::vector<std::string> Symbolize(StackId id) const;
+
+    // 已登记的调用栈数量
+    size_t GetStackCount() const;
+
+    // 清空调用栈表（之前返回的 ID 全部失效）
+    void Clear();
+
+private:
+    StackTable();
+    ~StackTable();
+    StackTable(const StackTable&) = delete;
+    StackTable& operator=(const StackTable&) = delete;
+
+    class Impl;
+    std::unique_ptr<Impl> pimpl_;
+};
+
+} // namespace capture
+} // namespace memory_tracer
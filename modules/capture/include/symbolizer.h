@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace memory_tracer {
+namespace capture {
+
+struct AllocationInfo;
+
+// 符号解析器：按 PC 缓存解析结果，每个地址只解析一次。FULL 模式在调用栈首次出现时解析，
+// 其他模式在报告与导出首次用到该地址时解析
+// Stats / Visualization / Storage 共享同一份缓存
+class Symbolizer {
+public:
+    static Symbolizer& GetInstance();
+
+    // 解析单个地址，无法解析时返回空字符串
+    std::string Resolve(void* pc);
+
+    // 解析一组地址，跳过无法解析的帧
+    std::vector<std::string> Resolve(void* const* frames, size_t count);
+
+    // 直接登记地址的符号（用于导入其他进程的数据）
+    void AddSymbol(void* pc, const std::string& name);
+
+    // 删除 [begin, end) 内地址的缓存（收集器复用生产者序号前清除旧进程的符号）
+    void RemoveSymbols(void* begin, void* end);
+
+    // 已缓存的地址数量
+    size_t GetCacheSize() const;
+
+    // 清空缓存
+    void Clear();
+
+private:
+    Symbolizer();
+    ~Symbolizer();
+    Symbolizer(const Symbolizer&) = delete;
+    Symbolizer& operator=(const Symbolizer&) = delete;
+
+    class Impl;
+    std::unique_ptr<Impl> pimpl_;
+};
+
+// 获取分配记录的符号化调用栈，按 PC 延迟解析
+std::vector<std::string> ResolveStackTrace(const AllocationInfo& info);
+
+} // namespace capture
+} // namespace memory_tracer
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace memory_tracer {
+namespace capture {
+
+// 追踪器自身的计数器
+enum class TracerCounter : uint32_t {
+    ALLOCATIONS_RECORDED,       // 被记录的分配
+    FREES_RECORDED,             // 产生释放事件的释放
+    STACKS_INTERNED,            // 首次出现的调用栈
+    STACK_CACHE_HITS,           // 命中线程本地调用栈缓存、无需查调用栈表的展开
+    DWARF_UNWINDS,              // 经 _Unwind_Backtrace 的展开（含 AUTO 方式对新调用点的校验）
+    DWARF_CACHE_HITS,           // 由 DWARF 缓存直接给出结果、无需展开的次数
+    TRACER_ALLOCATIONS,         // 追踪器内部经过 malloc 的分配次数
+    TRACER_ALLOCATED_BYTES,     // 追踪器内部经过 malloc 的分配字节数（累计）
+    CAPTURE_LOCK_CONTENTIONS,   // Capture 合并/注册锁的竞争次数
+    STORAGE_LOCK_CONTENTIONS,   // Storage 写入锁的竞争次数
+    STATS_LOCK_CONTENTIONS,     // Stats 分片锁的竞争次数
+    COUNT
+};
+
+// 追踪器热路径上的计时点
+enum class TracerTimer : uint32_t {
+    RECORD_ALLOCATION,          // 被采中分配的记录（含调用栈展开）
+    RECORD_DEALLOCATION,        // 捕获期间的释放路径（每个线程每 64 次释放计时一次）
+    CAPTURE_STACK_TRACE,        // 调用栈展开与登记（含 FULL 模式的符号化）
+    SYMBOLIZE,                  // FULL 模式下新调用栈的符号化
+    STORAGE_ADD_ALLOCATION,     // Storage::AddAllocation
+    STORAGE_ADD_EVENTS,         // Storage::AddEvents（每批一次）
+    STATS_ADD_ALLOCATION,       // Stats::AddAllocation
+    STATS_ADD_EVENTS,           // Stats::AddEvents（每批一次）
+    COUNT
+};
+
+constexpr size_t kTracerCounterCount = static_cast<size_t>(TracerCounter::COUNT);
+constexpr size_t kTracerTimerCount = static_cast<size_t>(TracerTimer::COUNT);
+
+// 计时直方图的桶数，第 i 个桶为 [2^i, 2^(i+1)) 个时钟周期
+constexpr size_t kTracerTimerBuckets = 40;
+
+const char* GetTracerCounterName(TracerCounter counter);
+const char* GetTracerTimerName(TracerTimer timer);
+
+struct TracerTimerStats {
+    uint64_t count;
+    double total_ns;
+    double mean_ns;
+    double p50_ns;     // 分位数为所在桶的上界
+    double p99_ns;
+    double max_ns;     // 自启动以来的最大值，Reset 不清零
+
+    TracerTimerStats() : count(0), total_ns(0), mean_ns(0), p50_ns(0), p99_ns(0), max_ns(0) {}
+};
+
+struct TracerStatsSnapshot {
+    uint64_t counters[kTracerCounterCount];
+    TracerTimerStats timers[kTracerTimerCount];
+    uint64_t dropped_events;          // 线程缓冲区写满丢弃的事件
+    size_t arena_reserved_bytes;      // 内部内存池向系统申请的字节数
+    size_t arena_used_bytes;          // 内部内存池正在使用的字节数
+    double cycles_per_ns;             // 计时时钟与纳秒的换算比例
+
+    TracerStatsSnapshot()
+        : counters(), dropped_events(0), arena_reserved_bytes(0), arena_used_bytes(0), cycles_per_ns(1.0) {}
+
+    uint64_t Get(TracerCounter counter) const { return counters[static_cast<size_t>(counter)]; }
+    const TracerTimerStats& Get(TracerTimer timer) const { return timers[static_cast<size_t>(timer)]; }
+};
+
+// 追踪器的自我观测：每个线程各自累加计数器和计时直方图（只由本线程写入，无原子读改写），
+// 读取快照时汇总所有线程。计时使用 rdtsc（非 x86 平台为单调时钟），可整体关闭
+class TracerStats {
+public:
+    static TracerStats& GetInstance();
+
+    // 汇总各线程的计数与计时，扣除上次 Reset 时的基线
+    TracerStatsSnapshot GetSnapshot();
+
+    // 以当前值为基线重新开始统计
+    void Reset();
+
+    // 开启/关闭热路径计时（默认开启），计数器不受影响
+    void SetTimingEnabled(bool enabled);
+    bool IsTimingEnabled() const;
+
+private:
+    TracerStats();
+    ~TracerStats();
+    TracerStats(const TracerStats&) = delete;
+    TracerStats& operator=(const TracerStats&) = delete;
+
+    class Impl;
+    std::unique_ptr<Impl> pimpl_;
+};
+
+namespace internal {
+
+// 热路径接口，可在 hook 内部调用，不会经过被 hook 的 malloc
+void CountTracerEvent(TracerCounter counter, uint64_t value);
+void RecordTracerCycles(TracerTimer timer, uint64_t cycles);
+bool IsTracerTimingEnabled();
+
+inline uint64_t ReadCycleCounter() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+} // namespace internal
+
+inline void CountTracerEvent(TracerCounter counter, uint64_t value = 1) {
+    internal::CountTracerEvent(counter, value);
+}
+
+// 作用域计时：构造到析构之间的时钟周期计入对应直方图，sampled 为 false 时不计时
+class ScopedTracerTimer {
+public:
+    explicit ScopedTracerTimer(TracerTimer timer, bool sampled = true)
+        : timer_(timer), start_(sampled && internal::IsTracerTimingEnabled() ? internal::ReadCycleCounter() : 0) {}
+
+    ~ScopedTracerTimer() {
+        if (start_ != 0) {
+            internal::RecordTracerCycles(timer_, internal::ReadCycleCounter() - start_);
+        }
+    }
+
+    ScopedTracerTimer(const ScopedTracerTimer&) = delete;
+    ScopedTracerTimer& operator=(const ScopedTracerTimer&) = delete;
+
+private:
+    TracerTimer timer_;
+    uint64_t start_;
+};
+
+// 先尝试加锁，失败时计一次竞争再阻塞等待
+template <typename Mutex>
+class CountedLockGuard {
+public:
+    CountedLockGuard(Mutex& mutex, TracerCounter counter) : mutex_(mutex) {
+        if (!mutex_.try_lock()) {
+            CountTracerEvent(counter);
+            mutex_.lock();
+        }
+    }
+
+    ~CountedLockGuard() { mutex_.unlock(); }
+
+    CountedLockGuard(const CountedLockGuard&) = delete;
+    CountedLockGuard& operator=(const CountedLockGuard&) = delete;
+
+private:
+    Mutex& mutex_;
+};
+
+} // namespace capture
+} // namespace memory_tracer
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "capture/capture.h"
+#include <cstddef>
+
+namespace memory_tracer {
+namespace capture {
+namespace internal {
+
+// 从 hook 函数的帧（__builtin_frame_address(0)）向外展开，第一帧为调用 hook 的位置，
+// 追踪器自身的帧不会出现在结果中。记录的是调用指令所在地址（返回地址 - 1）。
+// 可在 hook 内部调用，不会经过被 hook 的 malloc。返回写入 frames 的帧数
+size_t UnwindStack(UnwinderType type, void* hook_frame, void** frames, size_t max_depth, size_t skip_frames);
+
+} // namespace internal
+} // namespace capture
+} // namespace memory_tracer
@@ -0,0 +1,168 @@
+#include "capture/internal_allocator.h"
+#include <mutex>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace memory_tracer {
+namespace capture {
+
+// initial-exec 模型保证访问 TLS 时不会触发 __tls_get_addr 内部的 malloc
+static thread_local bool t_in_tracer __attribute__((tls_model("initial-exec"))) = false;
+
+TracerScope::TracerScope() : previous_(t_in_tracer) {
+    t_in_tracer = true;
+}
+
+TracerScope::~TracerScope() {
+    t_in_tracer = previous_;
+}
+
+bool TracerScope::IsActive() {
+    return t_in_tracer;
+}
+
+namespace internal {
+namespace {
+
+// 16B ~ 4KB 按 2 的幂分级
+constexpr size_t kMinClassShift = 4;
+constexpr size_t kMaxClassShift = 12;
+constexpr size_t kClassCount = kMaxClassShift - kMinClassShift + 1;
+constexpr size_t kChunkSize = 1 << 20;
+constexpr size_t kCacheLineSize = 64;
+
+struct FreeBlock {
+    FreeBlock* next;
+};
+
+class Arena {
+public:
+    void* Allocate(size_t size) {
+        if (size == 0) size = 1;
+        if (size > (size_t(1) << kMaxClassShift)) {
+            return MapLarge(size);
+        }
+
+        size_t size_class = GetSizeClass(size);
+        size_t block_size = size_t(1) << (size_class + kMinClassShift);
+
+        std::lock_guard<SpinLock> lock(lock_);
+        FreeBlock* block = free_lists_[size_class];
+        if (block) {
+            free_lists_[size_class] = block->next;
+            used_bytes_ += block_size;
+            return block;
+        }
+
+        // 按块大小对齐（最多到缓存行），保证 alignas(64) 的结构体可以直接放入
+        size_t alignment = block_size < kCacheLineSize ? block_size : kCacheLineSize;
+        uintptr_t start = (bump_ + alignment - 1) & ~(alignment - 1);
+        if (start + block_size > bump_end_) {
+            if (!RefillChunk()) {
+                return nullptr;
+            }
+            start = bump_;
+        }
+
+        bump_ = start + block_size;
+        used_bytes_ += block_size;
+        return reinterpret_cast<void*>(start);
+    }
+
+    void Deallocate(void* ptr, size_t size) {
+        if (!ptr) return;
+        if (size == 0) size = 1;
+        if (size > (size_t(1) << kMaxClassShift)) {
+            UnmapLarge(ptr, size);
+            return;
+        }
+
+        size_t size_class = GetSizeClass(size);
+        size_t block_size = size_t(1) << (size_class + kMinClassShift);
+
+        std::lock_guard<SpinLock> lock(lock_);
+        FreeBlock* block = static_cast<FreeBlock*>(ptr);
+        block->next = free_lists_[size_class];
+        free_lists_[size_class] = block;
+        used_bytes_ -= block_size;
+    }
+
+    size_t GetReservedBytes() const { return reserved_bytes_.load(std::memory_order_relaxed); }
+    size_t GetUsedBytes() const { return used_bytes_.load(std::memory_order_relaxed); }
+
+private:
+    static size_t GetSizeClass(size_t size) {
+        if (size <= (size_t(1) << kMinClassShift)) {
+            return 0;
+        }
+        size_t shift = 64 - __builtin_clzll(size - 1);
+        return shift - kMinClassShift;
+    }
+
+    static size_t RoundUpToPage(size_t size) {
+        static const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        return (size + page_size - 1) & ~(page_size - 1);
+    }
+
+    // 直接发起系统调用，绕开被 hook 的 mmap
+    static void* MapPages(size_t size) {
+        return reinterpret_cast<void*>(
+            syscall(SYS_mmap, nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    }
+
+    bool RefillChunk() {
+        // 当前块剩余的空间直接放弃
+        void* chunk = MapPages(kChunkSize);
+        if (chunk == MAP_FAILED) {
+            return false;
+        }
+        reserved_bytes_ += kChunkSize;
+        bump_ = reinterpret_cast<uintptr_t>(chunk);
+        bump_end_ = bump_ + kChunkSize;
+        return true;
+    }
+
+    void* MapLarge(size_t size) {
+        size_t mapped = RoundUpToPage(size);
+        void* ptr = MapPages(mapped);
+        if (ptr == MAP_FAILED) {
+            return nullptr;
+        }
+        reserved_bytes_ += mapped;
+        used_bytes_ += mapped;
+        return ptr;
+    }
+
+    void UnmapLarge(void* ptr, size_t size) {
+        size_t mapped = RoundUpToPage(size);
+        syscall(SYS_munmap, ptr, mapped);
+        reserved_bytes_ -= mapped;
+        used_bytes_ -= mapped;
+    }
+
+    SpinLock lock_;
+    FreeBlock* free_lists_[kClassCount] = {};
+    uintptr_t bump_ = 0;
+    uintptr_t bump_end_ = 0;
+    std::atomic<size_t> reserved_bytes_{0};
+    std::atomic<size_t> used_bytes_{0};
+};
+
+// 内存池本身不经过任何分配器，且永不析构，保证进程退出阶段仍可使用
+Arena& GetArena() {
+    alignas(Arena) static unsigned char storage[sizeof(Arena)];
+    static Arena* arena = new (storage) Arena();
+    return *arena;
+}
+
+} // namespace
+
+void* ArenaAllocate(size_t size) { return GetArena().Allocate(size); }
+void ArenaDeallocate(void* ptr, size_t size) { GetArena().Deallocate(ptr, size); }
+size_t GetArenaReservedBytes() { return GetArena().GetReservedBytes(); }
+size_t GetArenaUsedBytes() { return GetArena().GetUsedBytes(); }
+
+} // namespace internal
+} // namespace capture
+} // namespace memory_tracer
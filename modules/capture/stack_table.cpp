@@ -0,0 +1,181 @@
+#include "capture/stack_table.h"
+#include "capture/capture.h"
+#include "capture/symbolizer.h"
+#include "capture/internal_allocator.h"
+#include "capture/tracer_stats.h"
+#include <atomic>
+#include <unordered_map>
+#include <shared_mutex>
+#include <mutex>
+#include <cstring>
+
+namespace memory_tracer {
+namespace capture {
+
+namespace {
+
+// 线程本地的调用栈缓存：按帧的哈希直接映射，同一调用点反复分配时不加锁也不查表。
+// 命中时仍比较帧内容，与表中的探测一致，哈希相同的不同调用栈不会共用 ID
+constexpr size_t kThreadCacheSize = 32;
+
+struct ThreadCacheEntry {
+    uint64_t hash;
+    StackId id;
+    uint32_t count;
+    uint32_t generation;    // 调用栈表清空后旧的缓存全部失效
+    void* frames[kMaxStackFrames];
+};
+
+thread_local ThreadCacheEntry t_stack_cache[kThreadCacheSize] __attribute__((tls_model("initial-exec")));
+
+} // namespace
+
+class StackTable::Impl {
+public:
+    Impl() : generation_(1) {}
+
+    StackId Intern(void* const* frames, size_t count, bool* is_new) {
+        if (is_new) *is_new = false;
+        if (count == 0) {
+            return kInvalidStackId;
+        }
+
+        uint64_t hash = HashFrames(frames, count);
+        uint32_t generation = generation_.load(std::memory_order_acquire);
+        ThreadCacheEntry& cached = t_stack_cache[hash & (kThreadCacheSize - 1)];
+        if (cached.generation == generation && cached.hash == hash && cached.count == count &&
+            std::memcmp(cached.frames, frames, count * sizeof(void*)) == 0) {
+            CountTracerEvent(TracerCounter::STACK_CACHE_HITS);
+            return cached.id;
+        }
+
+        StackId id = hash;
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex_);
+            StackId found = Find(id, frames, count);
+            if (found != kInvalidStackId) {
+                FillCache(&cached, hash, found, frames, count, generation);
+                return found;
+            }
+        }
+
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        // 加写锁期间可能已被其他线程插入
+        StackId found = Find(id, frames, count);
+        if (found != kInvalidStackId) {
+            FillCache(&cached, hash, found, frames, count, generation);
+            return found;
+        }
+
+        // 哈希冲突时继续探测下一个可用 ID
+        while (id == kInvalidStackId || entries_.count(id)) {
+            id = Mix(id + 1);
+        }
+
+        entries_[id] = {frame_pool_.size(), count};
+        frame_pool_.insert(frame_pool_.end(), frames, frames + count);
+        FillCache(&cached, hash, id, frames, count, generation);
+        if (is_new) *is_new = true;
+        return id;
+    }
+
+    std::vector<void*> GetFrames(StackId id) const {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto it = entries_.find(id);
+        if (it == entries_.end()) {
+            return {};
+        }
+        auto begin = frame_pool_.begin() + it->second.offset;
+        return std::vector<void*>(begin, begin + it->second.count);
+    }
+
+    size_t GetStackCount() const {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        return entries_.size();
+    }
+
+    void Clear() {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        entries_.clear();
+        frame_pool_.clear();
+        generation_.fetch_add(1, std::memory_order_acq_rel);
+    }
+
+private:
+    struct Entry {
+        size_t offset;  // 在 frame_pool_ 中的起始位置
+        size_t count;
+    };
+
+    static void FillCache(ThreadCacheEntry* entry, uint64_t hash, StackId id, void* const* frames, size_t count,
+                          uint32_t generation) {
+        // 读取回放的调用栈可能超过捕获上限，这些不进缓存
+        if (count > kMaxStackFrames) {
+            return;
+        }
+        entry->hash = hash;
+        entry->id = id;
+        entry->count = static_cast<uint32_t>(count);
+        entry->generation = generation;
+        std::memcpy(entry->frames, frames, count * sizeof(void*));
+    }
+
+    static uint64_t Mix(uint64_t h) {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    static StackId HashFrames(void* const* frames, size_t count) {
+        uint64_t h = 0x9e3779b97f4a7c15ULL ^ count;
+        for (size_t i = 0; i < count; ++i) {
+            h = Mix(h ^ reinterpret_cast<uintptr_t>(frames[i]));
+        }
+        return h;
+    }
+
+    // 从 id 开始沿探测序列查找内容相同的调用栈
+    StackId Find(StackId id, void* const* frames, size_t count) const {
+        while (id == kInvalidStackId || entries_.count(id)) {
+            auto it = entries_.find(id);
+            if (it != entries_.end() && it->second.count == count &&
+                std::memcmp(frame_pool_.data() + it->second.offset, frames, count * sizeof(void*)) == 0) {
+                return id;
+            }
+            id = Mix(id + 1);
+        }
+        return kInvalidStackId;
+    }
+
+    // 调用栈表属于追踪器自身的数据，放在内部内存池中
+    std::unordered_map<StackId, Entry, std::hash<StackId>, std::equal_to<StackId>,
+                       internal::ArenaAllocator<std::pair<const StackId, Entry>>> entries_;
+    std::vector<void*, internal::ArenaAllocator<void*>> frame_pool_;
+    mutable std::shared_mutex mutex_;
+    std::atomic<uint32_t> generation_;
+};
+
+StackTable::StackTable() : pimpl_(std::make_unique<Impl>()) {}
+StackTable::~StackTable() = default;
+
+StackTable& StackTable::GetInstance() {
+    static StackTable instance;
+    return instance;
+}
+
+StackId StackTable::Intern(void* const* frames, size_t count, bool* is_new) {
+    return pimpl_->Intern(frames, count, is_new);
+}
+std::vector<void*> StackTable::GetFrames(StackId id) const { return pimpl_->GetFrames(id); }
+std::vector<std::string> StackTable::Symbolize(StackId id) const {
+    std::vector<void*> frames = pimpl_->GetFrames(id);
+    return Symbolizer::GetInstance().Resolve(frames.data(), frames.size());
+}
+size_t StackTable::GetStackCount() const { return pimpl_->GetStackCount(); }
+void StackTable::Clear() { pimpl_->Clear(); }
+
+} // namespace capture
+} // namespace memory_tracer
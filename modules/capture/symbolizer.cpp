@@ -0,0 +1,111 @@
+#include "capture/symbolizer.h"
+#include "capture/capture.h"
+#include "capture/stack_table.h"
+#include "capture/internal_allocator.h"
+#include <backward.hpp>
+#include <unordered_map>
+#include <shared_mutex>
+#include <mutex>
+
+namespace memory_tracer {
+namespace capture {
+
+class Symbolizer::Impl {
+public:
+    std::string Resolve(void* pc) {
+        {
+            std::shared_lock<std::shared_mutex> lock(cache_mutex_);
+            auto it = cache_.find(pc);
+            if (it != cache_.end()) {
+                return it->second;
+            }
+        }
+
+        std::string name = ResolveUncached(pc);
+
+        std::unique_lock<std::shared_mutex> lock(cache_mutex_);
+        cache_.emplace(pc, name);
+        return name;
+    }
+
+    std::vector<std::string> Resolve(void* const* frames, size_t count) {
+        std::vector<std::string> result;
+        result.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            std::string name = Resolve(frames[i]);
+            if (!name.empty()) {
+                result.push_back(std::move(name));
+            }
+        }
+        return result;
+    }
+
+    void AddSymbol(void* pc, const std::string& name) {
+        std::unique_lock<std::shared_mutex> lock(cache_mutex_);
+        cache_[pc] = name;
+    }
+
+    void RemoveSymbols(void* begin, void* end) {
+        std::unique_lock<std::shared_mutex> lock(cache_mutex_);
+        for (auto it = cache_.begin(); it != cache_.end();) {
+            if (it->first >= begin && it->first < end) {
+                it = cache_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    size_t GetCacheSize() const {
+        std::shared_lock<std::shared_mutex> lock(cache_mutex_);
+        return cache_.size();
+    }
+
+    void Clear() {
+        std::unique_lock<std::shared_mutex> lock(cache_mutex_);
+        cache_.clear();
+    }
+
+private:
+    std::string ResolveUncached(void* pc) {
+        // backward 的解析器不是线程安全的，整个进程共用一个实例
+        std::lock_guard<std::mutex> lock(resolver_mutex_);
+        resolver_.load_addresses(&pc, 1);
+        backward::ResolvedTrace trace = resolver_.resolve(backward::ResolvedTrace(backward::Trace(pc, 0)));
+        if (!trace.object_function.empty()) {
+            return trace.object_function;
+        }
+        return trace.source.function;
+    }
+
+    std::unordered_map<void*, std::string, std::hash<void*>, std::equal_to<void*>,
+                       internal::ArenaAllocator<std::pair<void* const, std::string>>> cache_;
+    mutable std::shared_mutex cache_mutex_;
+
+    backward::TraceResolver resolver_;
+    std::mutex resolver_mutex_;
+};
+
+Symbolizer::Symbolizer() : pimpl_(std::make_unique<Impl>()) {}
+Symbolizer::~Symbolizer() = default;
+
+Symbolizer& Symbolizer::GetInstance() {
+    static Symbolizer instance;
+    return instance;
+}
+
+std::string Symbolizer::Resolve(void* pc) { return pimpl_->Resolve(pc); }
+std::vector<std::string> Symbolizer::Resolve(void* const* frames, size_t count) {
+    return pimpl_->Resolve(frames, count);
+}
+void Symbolizer::AddSymbol(void* pc, const std::string& name) { pimpl_->AddSymbol(pc, name); }
+void Symbolizer::RemoveSymbols(void* begin, void* end) { pimpl_->RemoveSymbols(begin, end); }
+size_t Symbolizer::GetCacheSize() const { return pimpl_->GetCacheSize(); }
+void Symbolizer::Clear() { pimpl_->Clear(); }
+
+std::vector<std::string> ResolveStackTrace(const AllocationInfo& info) {
+    return StackTable::GetInstance().Symbolize(info.stack_id);
+}
+
+} // namespace capture
+} // namespace memory_tracer
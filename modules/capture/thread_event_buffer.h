@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "capture/capture.h"
+#include "capture/internal_allocator.h"
+
+namespace memory_tracer {
+namespace capture {
+
+// 线程本地的单生产者/单消费者环形缓冲区
+// 生产者为分配线程，消费者为 Capture 的合并线程，全程无锁
+class ThreadEventBuffer {
+public:
+    explicit ThreadEventBuffer(size_t capacity)
+        : capacity_(RoundUpToPowerOfTwo(capacity)),
+          mask_(capacity_ - 1),
+          slots_(static_cast<CaptureEvent*>(internal::ArenaAllocate(capacity_ * sizeof(CaptureEvent)))),
+          head_(0),
+          tail_(0),
+          dropped_(0),
+          retired_(false) {}
+
+    ~ThreadEventBuffer() {
+        internal::ArenaDeallocate(slots_, capacity_ * sizeof(CaptureEvent));
+    }
+
+    ThreadEventBuffer(const ThreadEventBuffer&) = delete;
+    ThreadEventBuffer& operator=(const ThreadEventBuffer&) = delete;
+
+    // 写入一个事件，缓冲区已满时丢弃并计数
+    bool Push(const CaptureEvent& event) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        size_t tail = tail_.load(std::memory_order_acquire);
+        if (head - tail >= capacity_) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        slots_[head & mask_] = event;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 取出当前所有可读事件，返回取出的数量
+    template <typename Output>
+    size_t Drain(Output& output) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t head = head_.load(std::memory_order_acquire);
+        for (size_t i = tail; i != head; ++i) {
+            output.push_back(slots_[i & mask_]);
+        }
+        tail_.store(head, std::memory_order_release);
+        return head - tail;
+    }
+
+    bool Empty() const {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+    uint64_t GetDroppedCount() const { return dropped_.load(std::memory_order_relaxed); }
+
+    // 所属线程退出后标记为退役，由合并线程在取空后回收
+    void Retire() { retired_.store(true, std::memory_order_release); }
+    bool IsRetired() const { return retired_.load(std::memory_order_acquire); }
+
+private:
+    static size_t RoundUpToPowerOfTwo(size_t value) {
+        size_t result = 1;
+        while (result < value) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    const size_t capacity_;
+    const size_t mask_;
+    CaptureEvent* slots_;
+
+    // 读写位置分别独占缓存行，避免伪共享
+    alignas(64) std::atomic<size_t> head_;
+    alignas(64) std::atomic<size_t> tail_;
+    alignas(64) std::atomic<uint64_t> dropped_;
+    std::atomic<bool> retired_;
+};
+
+} // namespace capture
+} // namespace memory_tracer
@@ -0,0 +1,347 @@
+#include "capture/tracer_stats.h"
+#include "capture/capture.h"
+#include "capture/internal_allocator.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <new>
+#include <thread>
+
+namespace memory_tracer {
+namespace capture {
+
+namespace {
+
+// 单个线程的计数与计时，只由所属线程写入；读取方只做 relaxed 读取
+struct ThreadSlot {
+    struct Timer {
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> cycles;
+        std::atomic<uint64_t> max_cycles;
+        std::atomic<uint64_t> buckets[kTracerTimerBuckets];
+    };
+
+    std::atomic<uint64_t> counters[kTracerCounterCount];
+    Timer timers[kTracerTimerCount];
+    ThreadSlot* next;
+    bool in_use;
+};
+
+// 汇总后的原始值（时钟周期）
+struct RawStats {
+    struct Timer {
+        uint64_t count = 0;
+        uint64_t cycles = 0;
+        uint64_t max_cycles = 0;
+        uint64_t buckets[kTracerTimerBuckets] = {};
+    };
+
+    uint64_t counters[kTracerCounterCount] = {};
+    Timer timers[kTracerTimerCount];
+    uint64_t dropped_events = 0;
+};
+
+// 只有所属线程写入，读改写无需原子指令
+inline void Bump(std::atomic<uint64_t>& value, uint64_t delta) {
+    value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+// hook 可能在静态初始化之前调用，以下全局量均为常量初始化
+std::mutex g_registry_mutex;
+ThreadSlot* g_slots = nullptr;            // 所有槽位（含空闲），只增不减
+ThreadSlot g_retired_slot;                // 已退出线程的累计值，由 g_registry_mutex 保护
+std::atomic<bool> g_timing_enabled{true};
+
+thread_local ThreadSlot* t_slot __attribute__((tls_model("initial-exec"))) = nullptr;
+thread_local bool t_exited __attribute__((tls_model("initial-exec"))) = false;
+
+void ResetSlot(ThreadSlot* slot) {
+    for (auto& counter : slot->counters) {
+        counter.store(0, std::memory_order_relaxed);
+    }
+    for (auto& timer : slot->timers) {
+        timer.count.store(0, std::memory_order_relaxed);
+        timer.cycles.store(0, std::memory_order_relaxed);
+        timer.max_cycles.store(0, std::memory_order_relaxed);
+        for (auto& bucket : timer.buckets) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+// 把槽位的值并入 target（调用方持有 g_registry_mutex）
+void MergeSlot(const ThreadSlot& slot, ThreadSlot* target) {
+    for (size_t i = 0; i < kTracerCounterCount; ++i) {
+        Bump(target->counters[i], slot.counters[i].load(std::memory_order_relaxed));
+    }
+    for (size_t i = 0; i < kTracerTimerCount; ++i) {
+        const ThreadSlot::Timer& from = slot.timers[i];
+        ThreadSlot::Timer& to = target->timers[i];
+        Bump(to.count, from.count.load(std::memory_order_relaxed));
+        Bump(to.cycles, from.cycles.load(std::memory_order_relaxed));
+        to.max_cycles.store(std::max(to.max_cycles.load(std::memory_order_relaxed),
+                                     from.max_cycles.load(std::memory_order_relaxed)),
+                            std::memory_order_relaxed);
+        for (size_t b = 0; b < kTracerTimerBuckets; ++b) {
+            Bump(to.buckets[b], from.buckets[b].load(std::memory_order_relaxed));
+        }
+    }
+}
+
+void AddToRaw(const ThreadSlot& slot, RawStats* raw) {
+    for (size_t i = 0; i < kTracerCounterCount; ++i) {
+        raw->counters[i] += slot.counters[i].load(std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < kTracerTimerCount; ++i) {
+        const ThreadSlot::Timer& from = slot.timers[i];
+        RawStats::Timer& to = raw->timers[i];
+        to.count += from.count.load(std::memory_order_relaxed);
+        to.cycles += from.cycles.load(std::memory_order_relaxed);
+        to.max_cycles = std::max(to.max_cycles, from.max_cycles.load(std::memory_order_relaxed));
+        for (size_t b = 0; b < kTracerTimerBuckets; ++b) {
+            to.buckets[b] += from.buckets[b].load(std::memory_order_relaxed);
+        }
+    }
+}
+
+// 线程退出时把槽位并入退役累计值并归还，之后该线程的计数直接丢弃
+struct SlotHandle {
+    ~SlotHandle() {
+        ThreadSlot* slot = t_slot;
+        t_exited = true;
+        t_slot = nullptr;
+        if (slot == nullptr) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(g_registry_mutex);
+        MergeSlot(*slot, &g_retired_slot);
+        ResetSlot(slot);
+        slot->in_use = false;
+    }
+};
+
+ThreadSlot* AcquireSlot() {
+    ThreadSlot* slot = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(g_registry_mutex);
+        for (ThreadSlot* it = g_slots; it != nullptr; it = it->next) {
+            if (!it->in_use) {
+                slot = it;
+                break;
+            }
+        }
+        if (slot == nullptr) {
+            void* memory = internal::ArenaAllocate(sizeof(ThreadSlot));
+            if (memory == nullptr) {
+                return nullptr;
+            }
+            slot = new (memory) ThreadSlot();
+            ResetSlot(slot);
+            slot->next = g_slots;
+            g_slots = slot;
+        }
+        slot->in_use = true;
+    }
+    // 先登记槽位：注册线程退出回调时的分配会再次计数
+    t_slot = slot;
+    thread_local SlotHandle handle;
+    (void)handle;
+    return slot;
+}
+
+inline ThreadSlot* GetSlot() {
+    ThreadSlot* slot = t_slot;
+    if (__builtin_expect(slot != nullptr, 1)) {
+        return slot;
+    }
+    return t_exited ? nullptr : AcquireSlot();
+}
+
+size_t GetBucketIndex(uint64_t cycles) {
+    if (cycles == 0) {
+        return 0;
+    }
+    size_t index = 63 - static_cast<size_t>(__builtin_clzll(cycles));
+    return std::min(index, kTracerTimerBuckets - 1);
+}
+
+double EstimateQuantile(const RawStats::Timer& timer, double q) {
+    if (timer.count == 0) {
+        return 0;
+    }
+    uint64_t target = static_cast<uint64_t>(q * static_cast<double>(timer.count));
+    uint64_t cumulative = 0;
+    for (size_t b = 0; b < kTracerTimerBuckets; ++b) {
+        cumulative += timer.buckets[b];
+        if (cumulative > target) {
+            return std::min(static_cast<double>(uint64_t(1) << (b + 1)), static_cast<double>(timer.max_cycles));
+        }
+    }
+    return static_cast<double>(timer.max_cycles);
+}
+
+} // namespace
+
+namespace internal {
+
+void CountTracerEvent(TracerCounter counter, uint64_t value) {
+    ThreadSlot* slot = GetSlot();
+    if (slot != nullptr) {
+        Bump(slot->counters[static_cast<size_t>(counter)], value);
+    }
+}
+
+void RecordTracerCycles(TracerTimer timer, uint64_t cycles) {
+    ThreadSlot* slot = GetSlot();
+    if (slot == nullptr) {
+        return;
+    }
+    ThreadSlot::Timer& entry = slot->timers[static_cast<size_t>(timer)];
+    Bump(entry.count, 1);
+    Bump(entry.cycles, cycles);
+    Bump(entry.buckets[GetBucketIndex(cycles)], 1);
+    if (cycles > entry.max_cycles.load(std::memory_order_relaxed)) {
+        entry.max_cycles.store(cycles, std::memory_order_relaxed);
+    }
+}
+
+bool IsTracerTimingEnabled() {
+    return g_timing_enabled.load(std::memory_order_relaxed);
+}
+
+} // namespace internal
+
+const char* GetTracerCounterName(TracerCounter counter) {
+    switch (counter) {
+        case TracerCounter::ALLOCATIONS_RECORDED: return "allocations_recorded";
+        case TracerCounter::FREES_RECORDED: return "frees_recorded";
+        case TracerCounter::STACKS_INTERNED: return "stacks_interned";
+        case TracerCounter::STACK_CACHE_HITS: return "stack_cache_hits";
+        case TracerCounter::DWARF_UNWINDS: return "dwarf_unwinds";
+        case TracerCounter::DWARF_CACHE_HITS: return "dwarf_cache_hits";
+        case TracerCounter::TRACER_ALLOCATIONS: return "tracer_allocations";
+        case TracerCounter::TRACER_ALLOCATED_BYTES: return "tracer_allocated_bytes";
+        case TracerCounter::CAPTURE_LOCK_CONTENTIONS: return "capture_lock_contentions";
+        case TracerCounter::STORAGE_LOCK_CONTENTIONS: return "storage_lock_contentions";
+        case TracerCounter::STATS_LOCK_CONTENTIONS: return "stats_lock_contentions";
+        case TracerCounter::COUNT: break;
+    }
+    return "unknown";
+}
+
+const char* GetTracerTimerName(TracerTimer timer) {
+    switch (timer) {
+        case TracerTimer::RECORD_ALLOCATION: return "record_allocation";
+        case TracerTimer::RECORD_DEALLOCATION: return "record_deallocation";
+        case TracerTimer::CAPTURE_STACK_TRACE: return "capture_stack_trace";
+        case TracerTimer::SYMBOLIZE: return "symbolize";
+        case TracerTimer::STORAGE_ADD_ALLOCATION: return "storage_add_allocation";
+        case TracerTimer::STORAGE_ADD_EVENTS: return "storage_add_events";
+        case TracerTimer::STATS_ADD_ALLOCATION: return "stats_add_allocation";
+        case TracerTimer::STATS_ADD_EVENTS: return "stats_add_events";
+        case TracerTimer::COUNT: break;
+    }
+    return "unknown";
+}
+
+class TracerStats::Impl {
+public:
+    Impl() : cycles_per_ns_(CalibrateCyclesPerNs()) {}
+
+    TracerStatsSnapshot GetSnapshot() {
+        RawStats raw = Collect();
+        std::lock_guard<std::mutex> lock(mutex_);
+        const double cycles_per_ns = cycles_per_ns_;
+
+        TracerStatsSnapshot snapshot;
+        snapshot.cycles_per_ns = cycles_per_ns;
+        for (size_t i = 0; i < kTracerCounterCount; ++i) {
+            snapshot.counters[i] = raw.counters[i] - baseline_.counters[i];
+        }
+        for (size_t i = 0; i < kTracerTimerCount; ++i) {
+            RawStats::Timer timer = raw.timers[i];
+            const RawStats::Timer& base = baseline_.timers[i];
+            timer.count -= base.count;
+            timer.cycles -= base.cycles;
+            for (size_t b = 0; b < kTracerTimerBuckets; ++b) {
+                timer.buckets[b] -= base.buckets[b];
+            }
+
+            TracerTimerStats& stats = snapshot.timers[i];
+            stats.count = timer.count;
+            stats.total_ns = timer.cycles / cycles_per_ns;
+            stats.mean_ns = timer.count > 0 ? stats.total_ns / timer.count : 0;
+            stats.p50_ns = EstimateQuantile(timer, 0.5) / cycles_per_ns;
+            stats.p99_ns = EstimateQuantile(timer, 0.99) / cycles_per_ns;
+            stats.max_ns = timer.max_cycles / cycles_per_ns;
+        }
+        snapshot.dropped_events = raw.dropped_events - baseline_.dropped_events;
+        snapshot.arena_reserved_bytes = internal::GetArenaReservedBytes();
+        snapshot.arena_used_bytes = internal::GetArenaUsedBytes();
+        return snapshot;
+    }
+
+    void Reset() {
+        RawStats raw = Collect();
+        std::lock_guard<std::mutex> lock(mutex_);
+        baseline_ = raw;
+    }
+
+    void SetTimingEnabled(bool enabled) {
+        g_timing_enabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    bool IsTimingEnabled() const {
+        return g_timing_enabled.load(std::memory_order_relaxed);
+    }
+
+private:
+    static RawStats Collect() {
+        RawStats raw;
+        {
+            std::lock_guard<std::mutex> lock(g_registry_mutex);
+            AddToRaw(g_retired_slot, &raw);
+            for (ThreadSlot* slot = g_slots; slot != nullptr; slot = slot->next) {
+                AddToRaw(*slot, &raw);
+            }
+        }
+        raw.dropped_events = Capture::GetInstance().GetDroppedEventCount();
+        return raw;
+    }
+
+    // 构造时用单调时钟标定计时时钟的频率（约 10 ms），读取快照时不再等待
+    static double CalibrateCyclesPerNs() {
+#if defined(__x86_64__) || defined(__i386__)
+        auto start_time = std::chrono::steady_clock::now();
+        uint64_t start_cycles = internal::ReadCycleCounter();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        uint64_t end_cycles = internal::ReadCycleCounter();
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start_time).count();
+        return elapsed > 0 ? static_cast<double>(end_cycles - start_cycles) / elapsed : 1.0;
+#else
+        return 1.0;
+#endif
+    }
+
+    std::mutex mutex_;
+    RawStats baseline_;
+    const double cycles_per_ns_;
+};
+
+TracerStats::TracerStats() : pimpl_(std::make_unique<Impl>()) {}
+TracerStats::~TracerStats() = default;
+
+TracerStats& TracerStats::GetInstance() {
+    static TracerStats instance;
+    return instance;
+}
+
+TracerStatsSnapshot TracerStats::GetSnapshot() { TracerScope scope; return pimpl_->GetSnapshot(); }
+void TracerStats::Reset() { TracerScope scope; pimpl_->Reset(); }
+void TracerStats::SetTimingEnabled(bool enabled) { pimpl_->SetTimingEnabled(enabled); }
+bool TracerStats::IsTimingEnabled() const { return pimpl_->IsTimingEnabled(); }
+
+} // namespace capture
+} // namespace memory_tracer
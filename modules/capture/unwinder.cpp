@@ -0,0 +1,410 @@
+#include "capture/unwinder.h"
+#include "capture/internal_allocator.h"
+#include "capture/tracer_stats.h"
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <pthread.h>
+#include <strings.h>
+#include <unwind.h>
+
+namespace memory_tracer {
+namespace capture {
+
+namespace {
+
+// 相邻两帧的最大间距，超过时视为帧指针链已损坏
+constexpr uintptr_t kMaxFrameBytes = 1 << 20;
+
+// 校验时允许帧指针链在尾部比 DWARF 少的帧数（libc 的线程/进程入口通常不保留帧指针）
+constexpr size_t kTailTolerance = 3;
+
+// AUTO 方式按调用点缓存校验结果：开放寻址，只增不删，写满后新调用点不再校验
+constexpr size_t kSiteCacheSize = 4096;
+constexpr size_t kSiteProbeLimit = 8;
+
+enum SiteVerdict : uint8_t {
+    SITE_UNKNOWN = 0,
+    SITE_FRAME_POINTER = 1,   // 帧指针链与 DWARF 一致
+    SITE_DWARF = 2            // 帧指针链缺帧或提前中断
+};
+
+struct SiteEntry {
+    std::atomic<uintptr_t> pc;
+    std::atomic<uint8_t> verdict;
+};
+
+// hook 可能在静态初始化之前调用，以下全局量均为常量初始化
+SiteEntry g_sites[kSiteCacheSize];
+
+// 本线程栈的范围，首次展开时查询；low == high 表示查询失败
+thread_local uintptr_t t_stack_low __attribute__((tls_model("initial-exec"))) = 0;
+thread_local uintptr_t t_stack_high __attribute__((tls_model("initial-exec"))) = 0;
+
+void GetStackBounds(uintptr_t* low, uintptr_t* high) {
+    if (t_stack_high == 0) {
+        // 主线程的查询会读取 /proc/self/maps 并申请内存，调用方已处于 TracerScope 内
+        uintptr_t stack_low = 1;
+        uintptr_t stack_high = 1;
+        pthread_attr_t attr;
+        if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+            void* address = nullptr;
+            size_t size = 0;
+            if (pthread_attr_getstack(&attr, &address, &size) == 0) {
+                stack_low = reinterpret_cast<uintptr_t>(address);
+                stack_high = stack_low + size;
+            }
+            pthread_attr_destroy(&attr);
+        }
+        t_stack_low = stack_low;
+        t_stack_high = stack_high;
+    }
+    *low = t_stack_low;
+    *high = t_stack_high;
+}
+
+// 返回地址指向调用指令之后，减一后落在调用指令内，符号化得到的行号才是调用处
+inline void* CallSite(uintptr_t return_address) {
+    return reinterpret_cast<void*>(return_address - 1);
+}
+
+// x86-64 与 AArch64 的帧记录均为 [上一帧的帧指针, 返回地址]
+size_t WalkFramePointers(void* hook_frame, void** frames, size_t max_depth, size_t skip_frames) {
+    uintptr_t low = 0;
+    uintptr_t high = 0;
+    GetStackBounds(&low, &high);
+
+    uintptr_t fp = reinterpret_cast<uintptr_t>(hook_frame);
+    if (fp < low || fp >= high) {
+        // 信号栈上或栈范围未知时只取 hook 自身帧记录中的返回地址
+        high = fp + 2 * sizeof(void*);
+    }
+
+    size_t count = 0;
+    while (count < max_depth) {
+        const uintptr_t* record = reinterpret_cast<const uintptr_t*>(fp);
+        uintptr_t return_address = record[1];
+        if (return_address == 0) {
+            break;
+        }
+        if (skip_frames > 0) {
+            --skip_frames;
+        } else {
+            frames[count++] = CallSite(return_address);
+        }
+
+        // 下一帧必须按指针对齐、严格向栈底方向增长且整条帧记录仍在栈内
+        uintptr_t next = record[0];
+        if (next <= fp || next - fp > kMaxFrameBytes || (next & (sizeof(void*) - 1)) != 0 ||
+            next > high - 2 * sizeof(void*)) {
+            break;
+        }
+        fp = next;
+    }
+    return count;
+}
+
+// DWARF 展开结果的线程本地缓存，以调用点和 hook 帧地址为键。复用前逐帧核对栈上保存返回地址的位置
+// 仍是原来的值：起点相同且每一帧的返回地址都没变时，重新展开得到的结果必然相同。
+// 只在 x86-64 上启用，该平台的返回地址固定保存在被调函数的 CFA - 8 处
+#if defined(__x86_64__)
+constexpr bool kDwarfCacheSupported = true;
+#else
+constexpr bool kDwarfCacheSupported = false;
+#endif
+constexpr size_t kDwarfCacheEntries = 8;
+
+struct DwarfCacheEntry {
+    uintptr_t caller_pc;                    // 0 表示空
+    uintptr_t hook_frame;
+    uint32_t max_depth;
+    uint32_t skip_frames;
+    uint32_t walked;                        // 需要核对的帧数（含跳过的帧）
+    uint32_t count;                         // 记录的帧数
+    uintptr_t returns[kMaxStackFrames];     // 每一帧的返回地址
+    uint32_t slot_offsets[kMaxStackFrames]; // 返回地址的保存位置相对 hook 帧的偏移
+};
+
+struct DwarfCache {
+    DwarfCacheEntry entries[kDwarfCacheEntries];
+    size_t next_victim;
+};
+
+thread_local DwarfCache* t_dwarf_cache __attribute__((tls_model("initial-exec"))) = nullptr;
+thread_local bool t_dwarf_cache_exited __attribute__((tls_model("initial-exec"))) = false;
+
+// 线程退出时归还缓存，之后该线程的展开不再缓存
+struct DwarfCacheHandle {
+    ~DwarfCacheHandle() {
+        DwarfCache* cache = t_dwarf_cache;
+        t_dwarf_cache_exited = true;
+        t_dwarf_cache = nullptr;
+        if (cache != nullptr) {
+            internal::ArenaDeallocate(cache, sizeof(DwarfCache));
+        }
+    }
+};
+
+DwarfCache* GetDwarfCache() {
+    if (t_dwarf_cache != nullptr || t_dwarf_cache_exited) {
+        return t_dwarf_cache;
+    }
+    void* memory = internal::ArenaAllocate(sizeof(DwarfCache));
+    if (memory == nullptr) {
+        return nullptr;
+    }
+    t_dwarf_cache = new (memory) DwarfCache();
+    thread_local DwarfCacheHandle handle;
+    (void)handle;
+    return t_dwarf_cache;
+}
+
+// 同一调用点可能经不同的外层路径到达，各占一项，逐项核对
+bool LookupDwarfCache(DwarfCache* cache, uintptr_t caller_pc, uintptr_t hook_frame, void** frames,
+                      size_t max_depth, size_t skip_frames, size_t* count) {
+    for (const DwarfCacheEntry& entry : cache->entries) {
+        if (entry.caller_pc != caller_pc || entry.hook_frame != hook_frame || entry.max_depth != max_depth ||
+            entry.skip_frames != skip_frames) {
+            continue;
+        }
+        // 保存位置都在 hook 帧之上、仍属于本线程栈中外层调用者的区域
+        bool matched = true;
+        for (uint32_t i = 0; i < entry.walked && matched; ++i) {
+            matched = *reinterpret_cast<const uintptr_t*>(hook_frame + entry.slot_offsets[i]) == entry.returns[i];
+        }
+        if (!matched) {
+            continue;
+        }
+        for (uint32_t i = 0; i < entry.count; ++i) {
+            frames[i] = CallSite(entry.returns[entry.skip_frames + i]);
+        }
+        *count = entry.count;
+        return true;
+    }
+    return false;
+}
+
+struct DwarfWalk {
+    uintptr_t hook_frame;
+    uintptr_t caller_pc;    // hook 的返回地址，展开到这一帧才开始记录
+    bool started;
+    size_t skip_frames;
+    void** frames;
+    size_t count;
+    size_t max_depth;
+
+    // 供缓存核对：每一帧的返回地址及其保存位置，信号帧或位置对不上时本次结果不缓存
+    uintptr_t returns[kMaxStackFrames];
+    uint32_t slot_offsets[kMaxStackFrames];
+    size_t walked;
+    bool cacheable;
+};
+
+// 回调中的 CFA 是被调函数的 CFA（即本帧调用时的栈指针），本帧的返回地址保存在它之下
+void RecordReturnSlot(DwarfWalk* walk, _Unwind_Context* context, uintptr_t ip, bool before_instruction) {
+    if (!walk->cacheable) {
+        return;
+    }
+    uintptr_t slot = _Unwind_GetCFA(context) - sizeof(uintptr_t);
+    if (before_instruction || walk->walked >= kMaxStackFrames || slot < walk->hook_frame ||
+        slot - walk->hook_frame > UINT32_MAX || *reinterpret_cast<const uintptr_t*>(slot) != ip) {
+        walk->cacheable = false;
+        return;
+    }
+    walk->returns[walk->walked] = ip;
+    walk->slot_offsets[walk->walked] = static_cast<uint32_t>(slot - walk->hook_frame);
+    ++walk->walked;
+}
+
+_Unwind_Reason_Code DwarfCallback(_Unwind_Context* context, void* arg) {
+    DwarfWalk* walk = static_cast<DwarfWalk*>(arg);
+    int before_instruction = 0;
+    uintptr_t ip = _Unwind_GetIPInfo(context, &before_instruction);
+    if (ip == 0) {
+        return _URC_END_OF_STACK;
+    }
+    if (!walk->started) {
+        // 跳过追踪器自身和 hook 的帧
+        if (ip != walk->caller_pc) {
+            return _URC_NO_REASON;
+        }
+        walk->started = true;
+    }
+    RecordReturnSlot(walk, context, ip, before_instruction != 0);
+    if (walk->skip_frames > 0) {
+        --walk->skip_frames;
+        return _URC_NO_REASON;
+    }
+    // 信号帧的地址就是被中断的指令，不需要减一
+    walk->frames[walk->count++] = before_instruction ? reinterpret_cast<void*>(ip) : CallSite(ip);
+    return walk->count < walk->max_depth ? _URC_NO_REASON : _URC_END_OF_STACK;
+}
+
+size_t WalkDwarf(void* hook_frame, void** frames, size_t max_depth, size_t skip_frames) {
+    uintptr_t frame = reinterpret_cast<uintptr_t>(hook_frame);
+    uintptr_t caller_pc = reinterpret_cast<const uintptr_t*>(hook_frame)[1];
+    DwarfCache* cache = kDwarfCacheSupported ? GetDwarfCache() : nullptr;
+    size_t count = 0;
+    if (cache != nullptr && LookupDwarfCache(cache, caller_pc, frame, frames, max_depth, skip_frames, &count)) {
+        CountTracerEvent(TracerCounter::DWARF_CACHE_HITS);
+        return count;
+    }
+
+    CountTracerEvent(TracerCounter::DWARF_UNWINDS);
+    DwarfWalk walk;
+    walk.hook_frame = frame;
+    walk.caller_pc = caller_pc;
+    walk.started = false;
+    walk.skip_frames = skip_frames;
+    walk.frames = frames;
+    walk.count = 0;
+    walk.max_depth = max_depth;
+    walk.walked = 0;
+    walk.cacheable = cache != nullptr;
+    _Unwind_Backtrace(&DwarfCallback, &walk);
+
+    if (walk.cacheable && walk.count > 0) {
+        DwarfCacheEntry* entry = &cache->entries[cache->next_victim];
+        cache->next_victim = (cache->next_victim + 1) % kDwarfCacheEntries;
+        entry->caller_pc = caller_pc;
+        entry->hook_frame = frame;
+        entry->max_depth = static_cast<uint32_t>(max_depth);
+        entry->skip_frames = static_cast<uint32_t>(skip_frames);
+        entry->walked = static_cast<uint32_t>(walk.walked);
+        entry->count = static_cast<uint32_t>(walk.count);
+        std::memcpy(entry->returns, walk.returns, walk.walked * sizeof(uintptr_t));
+        std::memcpy(entry->slot_offsets, walk.slot_offsets, walk.walked * sizeof(uint32_t));
+    }
+    return walk.count;
+}
+
+// 没有 .eh_frame 等无法展开时退回帧指针
+size_t WalkDwarfOrFramePointers(void* hook_frame, void** frames, size_t max_depth, size_t skip_frames) {
+    size_t count = WalkDwarf(hook_frame, frames, max_depth, skip_frames);
+    return count > 0 ? count : WalkFramePointers(hook_frame, frames, max_depth, skip_frames);
+}
+
+size_t SiteSlot(uintptr_t pc) {
+    uint64_t h = static_cast<uint64_t>(pc) * 0x9e3779b97f4a7c15ULL;
+    return static_cast<size_t>(h >> 52) & (kSiteCacheSize - 1);
+}
+
+uint8_t LookupSite(uintptr_t pc) {
+    size_t slot = SiteSlot(pc);
+    for (size_t i = 0; i < kSiteProbeLimit; ++i) {
+        SiteEntry& entry = g_sites[(slot + i) & (kSiteCacheSize - 1)];
+        uintptr_t key = entry.pc.load(std::memory_order_acquire);
+        if (key == pc) {
+            return entry.verdict.load(std::memory_order_relaxed);
+        }
+        if (key == 0) {
+            return SITE_UNKNOWN;
+        }
+    }
+    // 探测序列已满，不再校验，按帧指针处理
+    return SITE_FRAME_POINTER;
+}
+
+void StoreSite(uintptr_t pc, uint8_t verdict) {
+    size_t slot = SiteSlot(pc);
+    for (size_t i = 0; i < kSiteProbeLimit; ++i) {
+        SiteEntry& entry = g_sites[(slot + i) & (kSiteCacheSize - 1)];
+        uintptr_t key = entry.pc.load(std::memory_order_acquire);
+        if (key == 0 && entry.pc.compare_exchange_strong(key, pc, std::memory_order_acq_rel)) {
+            key = pc;
+        }
+        if (key == pc) {
+            // 其他线程可能同时校验同一调用点，结论相同，后写覆盖即可
+            entry.verdict.store(verdict, std::memory_order_relaxed);
+            return;
+        }
+    }
+}
+
+// 两种结果在共同部分一致，且帧指针链在尾部只少了入口处的几帧（DWARF 提前停止时以帧指针为准）
+bool FramePointerChainComplete(void* const* fp_frames, size_t fp_count, void* const* dwarf_frames,
+                               size_t dwarf_count) {
+    if (dwarf_count > fp_count + kTailTolerance) {
+        return false;
+    }
+    size_t common = fp_count < dwarf_count ? fp_count : dwarf_count;
+    return std::memcmp(fp_frames, dwarf_frames, common * sizeof(void*)) == 0;
+}
+
+size_t WalkAuto(void* hook_frame, void** frames, size_t max_depth, size_t skip_frames) {
+    uintptr_t caller_pc = reinterpret_cast<const uintptr_t*>(hook_frame)[1];
+    uint8_t verdict = LookupSite(caller_pc);
+    if (verdict == SITE_DWARF) {
+        return WalkDwarfOrFramePointers(hook_frame, frames, max_depth, skip_frames);
+    }
+
+    size_t count = WalkFramePointers(hook_frame, frames, max_depth, skip_frames);
+    if (verdict == SITE_FRAME_POINTER) {
+        return count;
+    }
+
+    // 调用点首次出现：与 DWARF 的结果比较，结论按调用点缓存
+    void* dwarf_frames[kMaxStackFrames];
+    size_t dwarf_count = WalkDwarf(hook_frame, dwarf_frames, max_depth, skip_frames);
+    if (dwarf_count == 0 || FramePointerChainComplete(frames, count, dwarf_frames, dwarf_count)) {
+        StoreSite(caller_pc, SITE_FRAME_POINTER);
+        return count;
+    }
+    StoreSite(caller_pc, SITE_DWARF);
+    std::memcpy(frames, dwarf_frames, dwarf_count * sizeof(void*));
+    return dwarf_count;
+}
+
+} // namespace
+
+const char* GetUnwinderTypeName(UnwinderType type) {
+    switch (type) {
+        case UnwinderType::FRAME_POINTER: return "fp";
+        case UnwinderType::DWARF: return "dwarf";
+        case UnwinderType::AUTO: return "auto";
+    }
+    return "unknown";
+}
+
+bool ParseUnwinderType(const char* name, UnwinderType* type) {
+    if (name == nullptr) {
+        return false;
+    }
+    if (strcasecmp(name, "fp") == 0 || strcasecmp(name, "frame_pointer") == 0) {
+        *type = UnwinderType::FRAME_POINTER;
+    } else if (strcasecmp(name, "dwarf") == 0) {
+        *type = UnwinderType::DWARF;
+    } else if (strcasecmp(name, "auto") == 0) {
+        *type = UnwinderType::AUTO;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+namespace internal {
+
+size_t UnwindStack(UnwinderType type, void* hook_frame, void** frames, size_t max_depth, size_t skip_frames) {
+    if (hook_frame == nullptr || max_depth == 0) {
+        return 0;
+    }
+    if (max_depth > kMaxStackFrames) {
+        max_depth = kMaxStackFrames;
+    }
+
+    switch (type) {
+        case UnwinderType::FRAME_POINTER:
+            return WalkFramePointers(hook_frame, frames, max_depth, skip_frames);
+        case UnwinderType::DWARF:
+            return WalkDwarfOrFramePointers(hook_frame, frames, max_depth, skip_frames);
+        case UnwinderType::AUTO:
+            return WalkAuto(hook_frame, frames, max_depth, skip_frames);
+    }
+    return 0;
+}
+
+} // namespace internal
+
+} // namespace capture
+} // namespace memory_tracer
@@ -1,7 +1,16 @@
 #pragma once
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
 #include <string>
+#include <string_view>
 #include <memory>
+#include <tuple>
+#include <type_traits>
+#include <fmt/format.h>
 
 namespace memory_tracer {
 namespace logger {
@@ -15,13 +24,225 @@ enum class LogLevel {
     FATAL
 };
 
+// 异步模式下队列已满时的处理方式
+enum class OverflowPolicy {
+    DROP,    // 丢弃新记录并计数（默认），写日志的线程从不等待
+    BLOCK    // 等待后台线程腾出槽位
+};
+
+struct AsyncOptions {
+    size_t queue_size;               // 队列槽位数，向上取整为 2 的幂，每个槽位 512 字节
+    OverflowPolicy overflow_policy;
+
+    AsyncOptions() : queue_size(8192), overflow_policy(OverflowPolicy::DROP) {}
+};
+
+namespace detail {
+
+struct LogRecord;
+using FormatFunc = void (*)(const LogRecord& record, fmt::memory_buffer* out);
+
+constexpr size_t kPayloadSize = 464;
+
+// 一条未格式化的日志：格式串只保存指针（必须是字符串字面量），参数按值编码到 payload，
+// 由 format_func 在输出时解码并格式化。定长、可以直接按字节复制
+struct LogRecord {
+    FormatFunc format_func;
+    const char* format;
+    int64_t timestamp_ns;     // system_clock
+    uint64_t thread_id;
+    LogLevel level;
+    uint32_t payload_size;
+    bool truncated;           // 有字符串参数被截断
+    bool complete;            // 全部参数都已写入，否则只输出格式串
+    uint8_t payload[kPayloadSize];
+};
+
+class PayloadWriter {
+public:
+    PayloadWriter(uint8_t* data, size_t capacity)
+        : data_(data), capacity_(capacity), size_(0), truncated_(false), complete_(true) {}
+
+    template <typename T>
+    void WriteValue(const T& value) {
+        if (size_ + sizeof(T) > capacity_) {
+            complete_ = false;
+            return;
+        }
+        std::memcpy(data_ + size_, &value, sizeof(T));
+        size_ += sizeof(T);
+    }
+
+    // 长度 + 内容，放不下时截断
+    void WriteString(const char* str, size_t length) {
+        if (size_ + sizeof(uint32_t) > capacity_) {
+            complete_ = false;
+            return;
+        }
+        size_t room = capacity_ - size_ - sizeof(uint32_t);
+        if (length > room) {
+            length = room;
+            truncated_ = true;
+        }
+        uint32_t stored = static_cast<uint32_t>(length);
+        std::memcpy(data_ + size_, &stored, sizeof(stored));
+        std::memcpy(data_ + size_ + sizeof(stored), str, length);
+        size_ += sizeof(stored) + length;
+    }
+
+    size_t Size() const { return size_; }
+    bool Truncated() const { return truncated_; }
+    bool Complete() const { return complete_; }
+
+private:
+    uint8_t* data_;
+    size_t capacity_;
+    size_t size_;
+    bool truncated_;
+    bool complete_;
+};
+
+class PayloadReader {
+public:
+    explicit PayloadReader(const uint8_t* data) : data_(data) {}
+
+    template <typename T>
+    T Read() {
+        if constexpr (std::is_same_v<T, std::string_view>) {
+            uint32_t length = 0;
+            std::memcpy(&length, data_, sizeof(length));
+            std::string_view value(reinterpret_cast<const char*>(data_ + sizeof(length)), length);
+            data_ += sizeof(length) + length;
+            return value;
+        } else {
+            T value;
+            std::memcpy(&value, data_, sizeof(T));
+            data_ += sizeof(T);
+            return value;
+        }
+    }
+
+private:
+    const uint8_t* data_;
+};
+
+// 参数的编码方式，Stored 为解码后交给 fmt 的类型：
+// 算术类型和指针按值保存，字符串复制内容，其他类型在写入时先格式化为字符串
+template <typename T, typename Enable = void>
+struct ArgCodec {
+    using Stored = std::string_view;
+    static void Encode(PayloadWriter* writer, const T& value) {
+        char buffer[kPayloadSize];
+        auto result = fmt::format_to_n(buffer, sizeof(buffer), "{}", value);
+        writer->WriteString(buffer, result.size < sizeof(buffer) ? result.size : sizeof(buffer));
+    }
+};
+
+template <typename T>
+struct ArgCodec<T, std::enable_if_t<std::is_arithmetic_v<T>>> {
+    using Stored = T;
+    static void Encode(PayloadWriter* writer, T value) { writer->WriteValue(value); }
+};
+
+template <typename T>
+struct ArgCodec<T, std::enable_if_t<std::is_enum_v<T>>> {
+    using Stored = std::underlying_type_t<T>;
+    static void Encode(PayloadWriter* writer, T value) { writer->WriteValue(static_cast<Stored>(value)); }
+};
+
+template <typename T>
+struct ArgCodec<T*, std::enable_if_t<!std::is_same_v<std::remove_cv_t<T>, char>>> {
+    using Stored = const void*;
+    static void Encode(PayloadWriter* writer, const T* value) { writer->WriteValue(static_cast<const void*>(value)); }
+};
+
+template <>
+struct ArgCodec<const char*> {
+    using Stored = std::string_view;
+    static void Encode(PayloadWriter* writer, const char* value) {
+        if (!value) value = "(null)";
+        writer->WriteString(value, std::strlen(value));
+    }
+};
+
+template <>
+struct ArgCodec<char*> : ArgCodec<const char*> {};
+
+template <>
+struct ArgCodec<std::string> {
+    using Stored = std::string_view;
+    static void Encode(PayloadWriter* writer, const std::string& value) { writer->WriteString(value.data(), value.size()); }
+};
+
+template <>
+struct ArgCodec<std::string_view> {
+    using Stored = std::string_view;
+    static void Encode(PayloadWriter* writer, std::string_view value) { writer->WriteString(value.data(), value.size()); }
+};
+
+template <typename T>
+using StoredType = typename ArgCodec<std::decay_t<T>>::Stored;
+
+template <typename... Args>
+void FormatRecord(const LogRecord& record, fmt::memory_buffer* out) {
+    PayloadReader reader(record.payload);
+    // 花括号初始化保证按编码顺序从左到右读取
+    std::tuple<StoredType<Args>...> values{reader.Read<StoredType<Args>>()...};
+    std::apply([&](const auto&... decoded) {
+        fmt::vformat_to(std::back_inserter(*out), fmt::string_view(record.format), fmt::make_format_args(decoded...));
+    }, values);
+}
+
+template <typename... Args>
+void EncodeRecord(LogRecord* record, LogLevel level, const char* format, const Args&... args) {
+    record->format_func = &FormatRecord<Args...>;
+    record->format = format;
+    record->level = level;
+    PayloadWriter writer(record->payload, sizeof(record->payload));
+    (ArgCodec<std::decay_t<Args>>::Encode(&writer, args), ...);
+    record->payload_size = static_cast<uint32_t>(writer.Size());
+    record->truncated = writer.Truncated();
+    record->complete = writer.Complete();
+}
+
+} // namespace detail
+
+// 默认同步输出。StartAsync 之后 LOG_* 只把格式串指针和按值编码的参数复制进预先分配的无锁队列，
+// 格式化和 I/O 在后台线程进行，写日志的线程不分配内存、不等待输出
 class Logger {
 public:
     static Logger& GetInstance();
 
     void SetLogLevel(LogLevel level);
+    LogLevel GetLogLevel() const;
     void SetLogFile(const std::string& filepath);
 
+    // 开启异步模式，队列在此时分配
+    void StartAsync(const AsyncOptions& options = AsyncOptions());
+
+    // 输出队列中剩余的记录并回到同步模式
+    void StopAsync();
+    bool IsAsync() const;
+
+    // 异步模式下因队列已满被丢弃的记录数
+    uint64_t GetDroppedCount() const;
+
+    // 后台线程启动时调用一次（如把日志线程标记为追踪器内部线程，使其分配不被记录）
+    void SetThreadInitializer(void (*initializer)());
+
+    // 运行期级别判断，LOG_* 在编码参数之前调用
+    bool ShouldLog(LogLevel level) const {
+        return static_cast<int>(level) >= level_.load(std::memory_order_relaxed);
+    }
+
+    // 按 fmt 语法格式化，format 必须是字符串字面量：异步模式下直到后台线程输出时才读取
+    template <typename... Args>
+    void Write(LogLevel level, const char* format, const Args&... args) {
+        detail::LogRecord record;
+        detail::EncodeRecord(&record, level, format, args...);
+        Submit(&record);
+    }
+
     void Log(LogLevel level, const std::string& message);
     void Trace(const std::string& message);
     void Debug(const std::string& message);
@@ -30,6 +251,7 @@ public:
     void Error(const std::string& message);
     void Fatal(const std::string& message);
 
+    // 异步模式下等待此前提交的记录输出后再刷新
     void Flush();
 
 private:
@@ -38,16 +260,36 @@ private:
     Logger(const Logger&) = delete;
     Logger& operator=(const Logger&) = delete;
 
+    void Submit(detail::LogRecord* record);
+
+    std::atomic<int> level_;
+
     class Impl;
     std::unique_ptr<Impl> pimpl_;
 };
 
-#define LOG_TRACE(msg) memory_tracer::logger::Logger::GetInstance().Trace(msg)
-#define LOG_DEBUG(msg) memory_tracer::logger::Logger::GetInstance().Debug(msg)
-#define LOG_INFO(msg)  memory_tracer::logger::Logger::GetInstance().Info(msg)
-#define LOG_WARN(msg)  memory_tracer::logger::Logger::GetInstance().Warn(msg)
-#define LOG_ERROR(msg) memory_tracer::logger::Logger::GetInstance().Error(msg)
-#define LOG_FATAL(msg) memory_tracer::logger::Logger::GetInstance().Fatal(msg)
+// 编译期级别：低于 MT_LOG_ACTIVE_LEVEL 的 LOG_* 不生成代码，参数也不会求值
+// （如 -DMT_LOG_ACTIVE_LEVEL=2 只保留 INFO 及以上）
+#ifndef MT_LOG_ACTIVE_LEVEL
+#define MT_LOG_ACTIVE_LEVEL 0
+#endif
+
+#define MT_LOG(level, ...)                                                           \
+    do {                                                                             \
+        if constexpr (static_cast<int>(level) >= MT_LOG_ACTIVE_LEVEL) {              \
+            auto& mt_logger = memory_tracer::logger::Logger::GetInstance();          \
+            if (mt_logger.ShouldLog(level)) {                                        \
+                mt_logger.Write(level, __VA_ARGS__);                                 \
+            }                                                                        \
+        }                                                                            \
+    } while (0)
+
+#define LOG_TRACE(...) MT_LOG(memory_tracer::logger::LogLevel::TRACE, __VA_ARGS__)
+#define LOG_DEBUG(...) MT_LOG(memory_tracer::logger::LogLevel::DEBUG, __VA_ARGS__)
+#define LOG_INFO(...)  MT_LOG(memory_tracer::logger::LogLevel::INFO, __VA_ARGS__)
+#define LOG_WARN(...)  MT_LOG(memory_tracer::logger::LogLevel::WARN, __VA_ARGS__)
+#define LOG_ERROR(...) MT_LOG(memory_tracer::logger::LogLevel::ERROR, __VA_ARGS__)
+#define LOG_FATAL(...) MT_LOG(memory_tracer::logger::LogLevel::FATAL, __VA_ARGS__)
 
 } // namespace logger
 } // namespace memory_tracer
@@ -2,30 +2,72 @@
 #include <spdlog/spdlog.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/sinks/basic_file_sink.h>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstddef>
 #include <memory>
 #include <mutex>
+#include <thread>
+#include <vector>
 
 namespace memory_tracer {
 namespace logger {
 
+namespace {
+
+// 后台线程空闲时的最长等待，也是漏掉唤醒时的最大输出延迟
+constexpr std::chrono::milliseconds kWakeInterval(10);
+
+// 当前线程是日志后台线程，此时直接同步输出，避免等待自己
+thread_local bool t_consumer = false;
+
+size_t RoundUpToPowerOfTwo(size_t value) {
+    size_t result = 2;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+} // namespace
+
 class Logger::Impl {
 public:
-    Impl() {
+    Impl()
+        : capacity_(0),
+          overflow_policy_(OverflowPolicy::DROP),
+          async_(false),
+          running_(false),
+          sleeping_(false),
+          writers_(0),
+          enqueue_pos_(0),
+          dequeue_pos_(0),
+          processed_(0),
+          dropped_(0),
+          reported_dropped_(0),
+          thread_initializer_(nullptr) {
         console_sink_ = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
         console_sink_->set_level(spdlog::level::debug);
         console_sink_->set_pattern("[%Y-%m-%d %H:%M:%S.%e] [%^%l%$] [thread %t] %v");
 
-        std::vector<spdlog::sink_ptr> sinks = {console_sink_};
-        logger_ = std::make_shared<spdlog::logger>("memory_tracer", sinks.begin(), sinks.end());
+        sinks_ = {console_sink_};
+        logger_ = std::make_shared<spdlog::logger>("memory_tracer", sinks_.begin(), sinks_.end());
         logger_->set_level(spdlog::level::debug);
         logger_->flush_on(spdlog::level::err);
 
         spdlog::set_default_logger(logger_);
     }
 
+    ~Impl() {
+        StopAsync();
+        FlushSinks();
+    }
+
     void SetLogLevel(LogLevel level) {
         spdlog::level::level_enum spdlog_level = MapLogLevel(level);
         logger_->set_level(spdlog_level);
+        std::lock_guard<std::mutex> lock(sinks_mutex_);
         if (console_sink_) {
             console_sink_->set_level(spdlog_level);
         }
@@ -35,33 +77,260 @@ public:
     }
 
     void SetLogFile(const std::string& filepath) {
-        std::lock_guard<std::mutex> lock(mutex_);
+        std::lock_guard<std::mutex> lock(sinks_mutex_);
         try {
             file_sink_ = std::make_shared<spdlog::sinks::basic_file_sink_mt>(filepath, true);
             file_sink_->set_pattern("[%Y-%m-%d %H:%M:%S.%e] [%^%l%$] [thread %t] %v");
+            file_sink_->set_level(console_sink_->level());
+            sinks_.push_back(file_sink_);
             logger_->sinks().push_back(file_sink_);
         } catch (const std::exception& e) {
             logger_->error("Failed to set log file {}: {}", filepath, e.what());
         }
     }
 
-    void Log(LogLevel level, const std::string& message) {
-        spdlog::level::level_enum spdlog_level = MapLogLevel(level);
-        logger_->log(spdlog_level, message);
+    void StartAsync(const AsyncOptions& options) {
+        std::lock_guard<std::mutex> lock(control_mutex_);
+        if (async_.load()) {
+            return;
+        }
+
+        capacity_ = RoundUpToPowerOfTwo(options.queue_size);
+        slots_ = std::make_unique<Slot[]>(capacity_);
+        for (size_t i = 0; i < capacity_; ++i) {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        enqueue_pos_.store(0, std::memory_order_relaxed);
+        dequeue_pos_ = 0;
+        processed_.store(0, std::memory_order_relaxed);
+        overflow_policy_ = options.overflow_policy;
+
+        running_.store(true);
+        consumer_ = std::thread([this]() { ConsumerLoop(); });
+        async_.store(true);
+    }
+
+    void StopAsync() {
+        std::lock_guard<std::mutex> lock(control_mutex_);
+        if (!async_.exchange(false)) {
+            return;
+        }
+
+        // 之后提交的记录同步输出；等待已经进入异步路径的写入方完成入队
+        while (writers_.load() != 0) {
+            std::this_thread::yield();
+        }
+        running_.store(false);
+        Wake();
+        consumer_.join();
+        slots_.reset();
+        capacity_ = 0;
     }
 
-    void Trace(const std::string& message) { logger_->trace(message); }
-    void Debug(const std::string& message) { logger_->debug(message); }
-    void Info(const std::string& message) { logger_->info(message); }
-    void Warn(const std::string& message) { logger_->warn(message); }
-    void Error(const std::string& message) { logger_->error(message); }
-    void Fatal(const std::string& message) { logger_->critical(message); }
+    bool IsAsync() const {
+        return async_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t GetDroppedCount() const {
+        return dropped_.load(std::memory_order_relaxed);
+    }
+
+    void SetThreadInitializer(void (*initializer)()) {
+        thread_initializer_.store(initializer);
+    }
+
+    void Submit(detail::LogRecord* record) {
+        record->timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        record->thread_id = spdlog::details::os::thread_id();
+
+        if (!t_consumer) {
+            // writers_ 与 async_ 配对，保证 StopAsync 返回前所有异步写入都已入队
+            writers_.fetch_add(1);
+            if (async_.load()) {
+                Enqueue(*record);
+                writers_.fetch_sub(1);
+                return;
+            }
+            writers_.fetch_sub(1);
+        }
+        WriteRecord(*record);
+    }
 
     void Flush() {
-        logger_->flush();
+        if (!t_consumer) {
+            std::lock_guard<std::mutex> lock(control_mutex_);
+            if (async_.load()) {
+                uint64_t target = enqueue_pos_.load();
+                while (processed_.load(std::memory_order_acquire) < target) {
+                    Wake();
+                    std::this_thread::sleep_for(std::chrono::microseconds(100));
+                }
+            }
+        }
+        FlushSinks();
     }
 
 private:
+    // 有界多生产者队列（Vyukov）：sequence 等于位置时槽位可写，等于位置 + 1 时可读
+    struct Slot {
+        std::atomic<uint64_t> sequence;
+        detail::LogRecord record;
+    };
+
+    bool Push(const detail::LogRecord& record) {
+        uint64_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = slots_[pos & (capacity_ - 1)];
+            uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+            int64_t diff = static_cast<int64_t>(sequence) - static_cast<int64_t>(pos);
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    // 只复制已使用的参数部分
+                    std::memcpy(&slot.record, &record, offsetof(detail::LogRecord, payload) + record.payload_size);
+                    slot.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void Enqueue(const detail::LogRecord& record) {
+        if (!Push(record)) {
+            if (overflow_policy_ == OverflowPolicy::DROP) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            do {
+                Wake();
+                std::this_thread::yield();
+            } while (!Push(record));
+        }
+        // 后台线程空闲时只由第一个写入方唤醒
+        if (sleeping_.load() && sleeping_.exchange(false)) {
+            Wake();
+        }
+    }
+
+    void Wake() {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        wake_cv_.notify_one();
+    }
+
+    bool HasPending() const {
+        const Slot& slot = slots_[dequeue_pos_ & (capacity_ - 1)];
+        return slot.sequence.load(std::memory_order_acquire) == dequeue_pos_ + 1;
+    }
+
+    // 输出队列中所有已发布的记录，返回输出条数
+    size_t Drain() {
+        size_t count = 0;
+        while (HasPending()) {
+            Slot& slot = slots_[dequeue_pos_ & (capacity_ - 1)];
+            WriteRecord(slot.record);
+            slot.sequence.store(dequeue_pos_ + capacity_, std::memory_order_release);
+            dequeue_pos_++;
+            processed_.store(dequeue_pos_, std::memory_order_release);
+            count++;
+        }
+        return count;
+    }
+
+    void ReportDropped() {
+        uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+        if (dropped == reported_dropped_) {
+            return;
+        }
+        fmt::memory_buffer buffer;
+        fmt::format_to(std::back_inserter(buffer), "Dropped {} log records because the async queue was full",
+                       dropped - reported_dropped_);
+        reported_dropped_ = dropped;
+        WriteMessage(LogLevel::WARN, std::chrono::system_clock::now(), spdlog::details::os::thread_id(),
+                     fmt::string_view(buffer.data(), buffer.size()));
+    }
+
+    void ConsumerLoop() {
+        t_consumer = true;
+        void (*initialized)() = nullptr;
+        while (true) {
+            // 初始化回调可能在后台线程启动之后才注册
+            void (*initializer)() = thread_initializer_.load();
+            if (initializer && initializer != initialized) {
+                initializer();
+                initialized = initializer;
+            }
+
+            bool stopping = !running_.load();
+            size_t count = Drain();
+            ReportDropped();
+            if (count > 0) {
+                continue;
+            }
+            if (stopping) {
+                break;
+            }
+
+            std::unique_lock<std::mutex> lock(wake_mutex_);
+            sleeping_.store(true);
+            wake_cv_.wait_for(lock, kWakeInterval, [this]() { return !running_.load() || HasPending(); });
+            sleeping_.store(false);
+        }
+        FlushSinks();
+    }
+
+    void WriteRecord(const detail::LogRecord& record) {
+        fmt::memory_buffer buffer;
+        auto out = std::back_inserter(buffer);
+        if (record.complete) {
+            try {
+                record.format_func(record, &buffer);
+            } catch (const std::exception& e) {
+                buffer.clear();
+                fmt::format_to(out, "{} [format error: {}]", record.format, e.what());
+            }
+        } else {
+            fmt::format_to(out, "{} [arguments dropped: record too large]", record.format);
+        }
+        if (record.truncated) {
+            fmt::format_to(out, " [truncated]");
+        }
+
+        spdlog::log_clock::time_point time(std::chrono::duration_cast<spdlog::log_clock::duration>(
+            std::chrono::nanoseconds(record.timestamp_ns)));
+        WriteMessage(record.level, time, record.thread_id, fmt::string_view(buffer.data(), buffer.size()));
+    }
+
+    // 保留记录产生时的时间和线程，直接交给各个 sink
+    void WriteMessage(LogLevel level, spdlog::log_clock::time_point time, size_t thread_id, fmt::string_view message) {
+        spdlog::level::level_enum spdlog_level = MapLogLevel(level);
+        spdlog::details::log_msg msg(time, spdlog::source_loc{}, logger_->name(), spdlog_level,
+                                     spdlog::string_view_t(message.data(), message.size()));
+        msg.thread_id = thread_id;
+
+        std::lock_guard<std::mutex> lock(sinks_mutex_);
+        for (auto& sink : sinks_) {
+            if (sink->should_log(spdlog_level)) {
+                sink->log(msg);
+            }
+        }
+        if (spdlog_level >= spdlog::level::err) {
+            for (auto& sink : sinks_) {
+                sink->flush();
+            }
+        }
+    }
+
+    void FlushSinks() {
+        std::lock_guard<std::mutex> lock(sinks_mutex_);
+        for (auto& sink : sinks_) {
+            sink->flush();
+        }
+    }
+
     spdlog::level::level_enum MapLogLevel(LogLevel level) {
         switch (level) {
             case LogLevel::TRACE: return spdlog::level::trace;
@@ -77,26 +346,68 @@ private:
     std::shared_ptr<spdlog::logger> logger_;
     std::shared_ptr<spdlog::sinks::stdout_color_sink_mt> console_sink_;
     std::shared_ptr<spdlog::sinks::basic_file_sink_mt> file_sink_;
-    std::mutex mutex_;
+    std::vector<spdlog::sink_ptr> sinks_;
+    std::mutex sinks_mutex_;
+
+    // 异步模式
+    std::mutex control_mutex_;             // StartAsync / StopAsync / Flush 互斥
+    std::unique_ptr<Slot[]> slots_;
+    size_t capacity_;
+    OverflowPolicy overflow_policy_;
+    std::atomic<bool> async_;
+    std::atomic<bool> running_;
+    std::atomic<bool> sleeping_;
+    std::atomic<size_t> writers_;          // 正在走异步路径的写入方
+    std::atomic<uint64_t> enqueue_pos_;
+    uint64_t dequeue_pos_;                 // 只由后台线程访问
+    std::atomic<uint64_t> processed_;      // 已输出的位置，供 Flush 等待
+    std::atomic<uint64_t> dropped_;
+    uint64_t reported_dropped_;
+    std::atomic<void (*)()> thread_initializer_;
+    std::mutex wake_mutex_;
+    std::condition_variable wake_cv_;
+    std::thread consumer_;
 };
 
-Logger::Logger() : pimpl_(std::make_unique<Impl>()) {}
-Logger::~Logger() = default;
+Logger::Logger() : level_(static_cast<int>(LogLevel::DEBUG)), pimpl_(std::make_unique<Impl>()) {}
+
+Logger::~Logger() {
+    pimpl_.reset();
+    // 之后（其他静态对象析构时）的日志在级别判断处被丢弃
+    level_.store(INT_MAX);
+}
 
 Logger& Logger::GetInstance() {
     static Logger instance;
     return instance;
 }
 
-void Logger::SetLogLevel(LogLevel level) { pimpl_->SetLogLevel(level); }
+void Logger::SetLogLevel(LogLevel level) {
+    level_.store(static_cast<int>(level), std::memory_order_relaxed);
+    pimpl_->SetLogLevel(level);
+}
+
+LogLevel Logger::GetLogLevel() const { return static_cast<LogLevel>(level_.load(std::memory_order_relaxed)); }
 void Logger::SetLogFile(const std::string& filepath) { pimpl_->SetLogFile(filepath); }
-void Logger::Log(LogLevel level, const std::string& message) { pimpl_->Log(level, message); }
-void Logger::Trace(const std::string& message) { pimpl_->Trace(message); }
-void Logger::Debug(const std::string& message) { pimpl_->Debug(message); }
-void Logger::Info(const std::string& message) { pimpl_->Info(message); }
-void Logger::Warn(const std::string& message) { pimpl_->Warn(message); }
-void Logger::Error(const std::string& message) { pimpl_->Error(message); }
-void Logger::Fatal(const std::string& message) { pimpl_->Fatal(message); }
+void Logger::StartAsync(const AsyncOptions& options) { pimpl_->StartAsync(options); }
+void Logger::StopAsync() { pimpl_->StopAsync(); }
+bool Logger::IsAsync() const { return pimpl_->IsAsync(); }
+uint64_t Logger::GetDroppedCount() const { return pimpl_->GetDroppedCount(); }
+void Logger::SetThreadInitializer(void (*initializer)()) { pimpl_->SetThreadInitializer(initializer); }
+void Logger::Submit(detail::LogRecord* record) { pimpl_->Submit(record); }
+
+void Logger::Log(LogLevel level, const std::string& message) {
+    if (ShouldLog(level)) {
+        Write(level, "{}", message);
+    }
+}
+
+void Logger::Trace(const std::string& message) { Log(LogLevel::TRACE, message); }
+void Logger::Debug(const std::string& message) { Log(LogLevel::DEBUG, message); }
+void Logger::Info(const std::string& message) { Log(LogLevel::INFO, message); }
+void Logger::Warn(const std::string& message) { Log(LogLevel::WARN, message); }
+void Logger::Error(const std::string& message) { Log(LogLevel::ERROR, message); }
+void Logger::Fatal(const std::string& message) { Log(LogLevel::FATAL, message); }
 void Logger::Flush() { pimpl_->Flush(); }
 
 } // namespace logger
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace memory_tracer {
+namespace metrics {
+
+struct ExporterOptions {
+    std::string host;              // TCP 监听地址，为空时不监听 TCP
+    uint16_t port;                 // TCP 端口，0 表示由系统分配（用 GetPort 查询）
+    std::string unix_socket_path;  // Unix 域套接字路径，非空时同时监听
+    int refresh_interval_ms;       // 函数排行与速率的刷新间隔
+    int top_k;                     // 导出的函数排行条数
+
+    ExporterOptions() : host("127.0.0.1"), port(9464), refresh_interval_ms(1000), top_k(10) {}
+};
+
+// 内嵌的 Prometheus（OpenMetrics 文本格式）导出端点，GET /metrics 返回当前指标。
+// 计数器、仪表和大小直方图在抓取时直接读取 Stats 的无锁累计量；函数排行和速率由导出线程按刷新间隔预先计算，
+// 抓取只复制最近一次的结果，因此抓取不会取 Stats 的分片锁，也不会阻塞正在分配的线程
+class MetricsExporter {
+public:
+    static MetricsExporter& GetInstance();
+
+    // 监听并启动导出线程，失败时返回 false
+    bool Start(const ExporterOptions& options = ExporterOptions());
+
+    void Stop();
+    bool IsRunning() const;
+
+    // 实际监听的 TCP 端口，未监听时为 0
+    uint16_t GetPort() const;
+
+    // 生成文本格式的全部指标，与 /metrics 的响应相同
+    std::string RenderMetrics();
+
+private:
+    MetricsExporter();
+    ~MetricsExporter();
+    MetricsExporter(const MetricsExporter&) = delete;
+    MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+    class Impl;
+    std::unique_ptr<Impl> pimpl_;
+};
+
+} // namespace metrics
+} // namespace memory_tracer
@@ -0,0 +1,536 @@
+#include "metrics/metrics.h"
+#include "stats/stats.h"
+#include "capture/internal_allocator.h"
+#include "capture/tracer_stats.h"
+#include "logger/logger.h"
+#include <fmt/format.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace memory_tracer {
+namespace metrics {
+
+namespace {
+
+// 请求头的最大长度和读取超时，超出时直接关闭连接
+constexpr size_t kMaxRequestSize = 8192;
+constexpr int kRequestTimeoutMs = 1000;
+
+const double kQuantiles[] = {0.5, 0.9, 0.99};
+
+using Buffer = fmt::memory_buffer;
+
+void WriteHeader(Buffer* out, const char* name, const char* type, const char* help) {
+    fmt::format_to(std::back_inserter(*out), "# HELP {} {}\n# TYPE {} {}\n", name, help, name, type);
+}
+
+template <typename T>
+void WriteMetric(Buffer* out, const char* name, const char* type, const char* help, T value) {
+    WriteHeader(out, name, type, help);
+    fmt::format_to(std::back_inserter(*out), "{} {}\n", name, value);
+}
+
+// 标签值转义反斜杠、双引号和换行
+void WriteLabelValue(Buffer* out, const std::string& value) {
+    for (char c : value) {
+        switch (c) {
+            case '\\': out->append(std::string_view("\\\\")); break;
+            case '"':  out->append(std::string_view("\\\"")); break;
+            case '\n': out->append(std::string_view("\\n")); break;
+            default:   out->push_back(c); break;
+        }
+    }
+}
+
+// 第 i 个大小桶的上界 2^i
+double GetBucketUpperBound(size_t index) {
+    return static_cast<double>(uint64_t(1) << index);
+}
+
+// 由大小桶估计分位数，返回所在桶的上界
+double EstimateQuantile(const std::vector<double>& buckets, double total, double q) {
+    if (total <= 0) {
+        return 0;
+    }
+    double target = q * total;
+    double cumulative = 0;
+    for (size_t i = 0; i + 1 < buckets.size(); ++i) {
+        cumulative += buckets[i];
+        if (cumulative >= target) {
+            return GetBucketUpperBound(i);
+        }
+    }
+    return GetBucketUpperBound(buckets.size() - 1);
+}
+
+void CloseSocket(int* fd) {
+    if (*fd >= 0) {
+        close(*fd);
+        *fd = -1;
+    }
+}
+
+} // namespace
+
+class MetricsExporter::Impl {
+public:
+    Impl() : running_(false), tcp_fd_(-1), unix_fd_(-1), port_(0), has_last_snapshot_(false) {
+        wake_fds_[0] = -1;
+        wake_fds_[1] = -1;
+    }
+
+    ~Impl() {
+        Stop();
+    }
+
+    bool Start(const ExporterOptions& options) {
+        std::lock_guard<std::mutex> lock(control_mutex_);
+        if (running_.load()) {
+            LOG_WARN("Metrics exporter is already running");
+            return true;
+        }
+        // 导出线程可能已因错误自行退出
+        JoinServeThread();
+        options_ = options;
+        options_.refresh_interval_ms = std::max(options_.refresh_interval_ms, 1);
+
+        if (!options_.host.empty() && !ListenTcp()) {
+            CloseSockets();
+            return false;
+        }
+        if (!options_.unix_socket_path.empty() && !ListenUnix()) {
+            CloseSockets();
+            return false;
+        }
+        if (tcp_fd_ < 0 && unix_fd_ < 0) {
+            LOG_ERROR("Metrics exporter has no listen address configured");
+            return false;
+        }
+        if (pipe(wake_fds_) != 0) {
+            LOG_ERROR("Failed to create metrics exporter wakeup pipe: {}", std::strerror(errno));
+            CloseSockets();
+            return false;
+        }
+
+        has_last_snapshot_ = false;
+        Refresh();
+        running_.store(true);
+        thread_ = std::thread([this]() { ServeLoop(); });
+        if (tcp_fd_ >= 0) {
+            LOG_INFO("Metrics exporter listening on http://{}:{}/metrics", options_.host, port_.load());
+        }
+        if (unix_fd_ >= 0) {
+            LOG_INFO("Metrics exporter listening on unix:{}", options_.unix_socket_path);
+        }
+        return true;
+    }
+
+    void Stop() {
+        std::lock_guard<std::mutex> lock(control_mutex_);
+        if (!running_.exchange(false)) {
+            JoinServeThread();
+            return;
+        }
+        char byte = 0;
+        if (write(wake_fds_[1], &byte, 1) < 0) {
+            LOG_WARN("Failed to wake metrics exporter: {}", std::strerror(errno));
+        }
+        JoinServeThread();
+        LOG_INFO("Metrics exporter stopped");
+    }
+
+    bool IsRunning() const {
+        return running_.load();
+    }
+
+    uint16_t GetPort() const {
+        return running_.load() ? port_.load() : 0;
+    }
+
+    std::string RenderMetrics() {
+        Buffer out;
+        Render(&out);
+        return std::string(out.data(), out.size());
+    }
+
+private:
+    // 导出线程按刷新间隔预先计算的部分，抓取时只读取 shared_ptr 指向的不可变结果
+    struct Rankings {
+        std::vector<stats::FunctionStats> top_live;
+        std::vector<stats::FunctionStats> top_allocated;
+        double allocation_rate = 0;      // 最近一个刷新间隔内每秒的分配次数
+        double free_rate = 0;
+        double allocated_bytes_rate = 0;
+        double freed_bytes_rate = 0;
+        capture::TracerStatsSnapshot tracer;   // 汇总时要取追踪器的注册锁和 Capture 的缓冲区锁
+    };
+
+    bool ListenTcp() {
+        tcp_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (tcp_fd_ < 0) {
+            LOG_ERROR("Failed to create metrics socket: {}", std::strerror(errno));
+            return false;
+        }
+        int reuse = 1;
+        setsockopt(tcp_fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        sockaddr_in addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(options_.port);
+        if (inet_pton(AF_INET, options_.host.c_str(), &addr.sin_addr) != 1) {
+            LOG_ERROR("Invalid metrics listen address: {}", options_.host);
+            return false;
+        }
+        if (bind(tcp_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(tcp_fd_, 16) != 0) {
+            LOG_ERROR("Failed to listen on {}:{}: {}", options_.host, options_.port, std::strerror(errno));
+            return false;
+        }
+
+        socklen_t length = sizeof(addr);
+        getsockname(tcp_fd_, reinterpret_cast<sockaddr*>(&addr), &length);
+        port_ = ntohs(addr.sin_port);
+        return true;
+    }
+
+    bool ListenUnix() {
+        sockaddr_un addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (options_.unix_socket_path.size() >= sizeof(addr.sun_path)) {
+            LOG_ERROR("Metrics socket path is too long: {}", options_.unix_socket_path);
+            return false;
+        }
+        std::memcpy(addr.sun_path, options_.unix_socket_path.c_str(), options_.unix_socket_path.size());
+
+        unix_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (unix_fd_ < 0) {
+            LOG_ERROR("Failed to create metrics socket: {}", std::strerror(errno));
+            return false;
+        }
+        // 清理上次运行残留的套接字文件
+        unlink(options_.unix_socket_path.c_str());
+        if (bind(unix_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(unix_fd_, 16) != 0) {
+            LOG_ERROR("Failed to listen on {}: {}", options_.unix_socket_path, std::strerror(errno));
+            return false;
+        }
+        return true;
+    }
+
+    void CloseSockets() {
+        CloseSocket(&tcp_fd_);
+        if (unix_fd_ >= 0) {
+            CloseSocket(&unix_fd_);
+            unlink(options_.unix_socket_path.c_str());
+        }
+        port_ = 0;
+    }
+
+    // 调用方持有 control_mutex_；导出线程已退出或正在退出
+    void JoinServeThread() {
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+        CloseSockets();
+        CloseSocket(&wake_fds_[0]);
+        CloseSocket(&wake_fds_[1]);
+    }
+
+    void ServeLoop() {
+        // 导出线程的分配属于追踪器自身
+        capture::TracerScope scope;
+
+        auto interval = std::chrono::milliseconds(options_.refresh_interval_ms);
+        auto next_refresh = std::chrono::steady_clock::now() + interval;
+        while (running_.load()) {
+            pollfd fds[3];
+            nfds_t count = 0;
+            fds[count++] = {wake_fds_[0], POLLIN, 0};
+            if (tcp_fd_ >= 0) {
+                fds[count++] = {tcp_fd_, POLLIN, 0};
+            }
+            if (unix_fd_ >= 0) {
+                fds[count++] = {unix_fd_, POLLIN, 0};
+            }
+
+            auto now = std::chrono::steady_clock::now();
+            int timeout = static_cast<int>(std::max<int64_t>(
+                0, std::chrono::duration_cast<std::chrono::milliseconds>(next_refresh - now).count()));
+            int ready = poll(fds, count, timeout);
+            if (ready < 0 && errno != EINTR) {
+                LOG_ERROR("Metrics exporter poll failed: {}", std::strerror(errno));
+                // 不再接受连接：关闭监听端口，抓取方立即失败而不是在 backlog 中等到超时。
+                // Stop 先一步清除 running_ 时由它负责关闭
+                if (running_.exchange(false)) {
+                    CloseSockets();
+                }
+                break;
+            }
+            if (fds[0].revents & POLLIN) {
+                break;
+            }
+            for (nfds_t i = 1; ready > 0 && i < count; ++i) {
+                if (fds[i].revents & POLLIN) {
+                    int client = accept4(fds[i].fd, nullptr, nullptr, SOCK_CLOEXEC);
+                    if (client >= 0) {
+                        HandleConnection(client);
+                        close(client);
+                    }
+                }
+            }
+
+            if (std::chrono::steady_clock::now() >= next_refresh) {
+                Refresh();
+                next_refresh = std::chrono::steady_clock::now() + interval;
+            }
+        }
+    }
+
+    // 每个连接只处理一个请求，响应后关闭
+    void HandleConnection(int client) {
+        timeval timeout;
+        timeout.tv_sec = kRequestTimeoutMs / 1000;
+        timeout.tv_usec = (kRequestTimeoutMs % 1000) * 1000;
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        std::string request;
+        char chunk[1024];
+        while (request.find("\r\n\r\n") == std::string::npos && request.size() < kMaxRequestSize) {
+            ssize_t received = recv(client, chunk, sizeof(chunk), 0);
+            if (received <= 0) {
+                break;
+            }
+            request.append(chunk, static_cast<size_t>(received));
+        }
+
+        size_t line_end = request.find("\r\n");
+        if (line_end == std::string::npos) {
+            return;
+        }
+        std::string line = request.substr(0, line_end);
+        size_t method_end = line.find(' ');
+        size_t path_end = method_end == std::string::npos ? std::string::npos : line.find(' ', method_end + 1);
+        if (path_end == std::string::npos) {
+            SendResponse(client, "400 Bad Request", "text/plain", "Bad request\n");
+            return;
+        }
+        std::string method = line.substr(0, method_end);
+        std::string path = line.substr(method_end + 1, path_end - method_end - 1);
+        path = path.substr(0, path.find('?'));
+
+        if (method != "GET" && method != "HEAD") {
+            SendResponse(client, "405 Method Not Allowed", "text/plain", "Method not allowed\n");
+        } else if (path == "/metrics") {
+            Buffer body;
+            Render(&body);
+            SendResponse(client, "200 OK", "text/plain; version=0.0.4; charset=utf-8",
+                         std::string_view(body.data(), body.size()), method == "HEAD");
+        } else if (path == "/") {
+            SendResponse(client, "200 OK", "text/plain", "Memory tracer metrics: /metrics\n", method == "HEAD");
+        } else {
+            SendResponse(client, "404 Not Found", "text/plain", "Not found\n");
+        }
+    }
+
+    static void SendResponse(int client, const char* status, const char* content_type, std::string_view body,
+                             bool head_only = false) {
+        Buffer response;
+        fmt::format_to(std::back_inserter(response),
+                       "HTTP/1.1 {}\r\nContent-Type: {}\r\nContent-Length: {}\r\nConnection: close\r\n\r\n",
+                       status, content_type, body.size());
+        if (!head_only) {
+            response.append(body);
+        }
+
+        size_t sent = 0;
+        while (sent < response.size()) {
+            ssize_t written = send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+            if (written <= 0) {
+                return;
+            }
+            sent += static_cast<size_t>(written);
+        }
+    }
+
+    // 在导出线程上计算排行、速率和追踪器自身的开销，这一步会短暂地逐个取 Stats 的分片锁
+    void Refresh() {
+        auto rankings = std::make_shared<Rankings>();
+        stats::Stats& stats = stats::Stats::GetInstance();
+        rankings->top_live = stats.GetTopFunctions(stats::FunctionRanking::LIVE_BYTES, options_.top_k);
+        rankings->top_allocated = stats.GetTopFunctions(stats::FunctionRanking::TOTAL_BYTES, options_.top_k);
+
+        stats::MetricsSnapshot snapshot = stats.GetMetricsSnapshot();
+        auto now = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(now - last_refresh_time_).count();
+        // Reset 之后累计量变小，本次不计算速率
+        if (has_last_snapshot_ && seconds > 0 && snapshot.allocation_count >= last_snapshot_.allocation_count) {
+            rankings->allocation_rate = (snapshot.allocation_count - last_snapshot_.allocation_count) / seconds;
+            rankings->free_rate = (snapshot.free_count - last_snapshot_.free_count) / seconds;
+            rankings->allocated_bytes_rate = (snapshot.allocated_bytes - last_snapshot_.allocated_bytes) / seconds;
+            rankings->freed_bytes_rate = (snapshot.freed_bytes - last_snapshot_.freed_bytes) / seconds;
+        }
+        last_snapshot_ = snapshot;
+        last_refresh_time_ = now;
+        has_last_snapshot_ = true;
+        rankings->tracer = capture::TracerStats::GetInstance().GetSnapshot();
+
+        std::atomic_store(&rankings_, std::shared_ptr<const Rankings>(std::move(rankings)));
+    }
+
+    void Render(Buffer* out) {
+        stats::MetricsSnapshot snapshot = stats::Stats::GetInstance().GetMetricsSnapshot();
+        std::shared_ptr<const Rankings> rankings = std::atomic_load(&rankings_);
+        auto it = std::back_inserter(*out);
+
+        WriteMetric(out, "memory_tracer_allocations_total", "counter",
+                    "Allocations observed (sample-weighted estimate).", snapshot.allocation_count);
+        WriteMetric(out, "memory_tracer_allocated_bytes_total", "counter",
+                    "Bytes allocated (sample-weighted estimate).", snapshot.allocated_bytes);
+        WriteMetric(out, "memory_tracer_frees_total", "counter",
+                    "Frees matched to a tracked allocation (sample-weighted estimate).", snapshot.free_count);
+        WriteMetric(out, "memory_tracer_freed_bytes_total", "counter",
+                    "Bytes freed (sample-weighted estimate).", snapshot.freed_bytes);
+        WriteMetric(out, "memory_tracer_live_bytes", "gauge", "Bytes currently allocated and not freed.",
+                    snapshot.live_bytes);
+        WriteMetric(out, "memory_tracer_peak_live_bytes", "gauge", "Highest live bytes observed.",
+                    snapshot.peak_bytes);
+        WriteMetric(out, "memory_tracer_live_blocks", "gauge", "Tracked allocations not freed yet.",
+                    snapshot.live_blocks);
+        WriteMetric(out, "memory_tracer_sample_interval_bytes", "gauge",
+                    "Mean sampling interval in bytes, 0 when every allocation is recorded.",
+                    snapshot.sample_interval);
+
+        // 大小直方图，桶上界为 2 的幂
+        WriteHeader(out, "memory_tracer_allocation_size_bytes", "histogram", "Allocation size distribution.");
+        double cumulative = 0;
+        for (size_t i = 0; i + 1 < snapshot.size_buckets.size(); ++i) {
+            cumulative += snapshot.size_buckets[i];
+            fmt::format_to(it, "memory_tracer_allocation_size_bytes_bucket{{le=\"{}\"}} {}\n",
+                           uint64_t(1) << i, cumulative);
+        }
+        cumulative += snapshot.size_buckets.back();
+        fmt::format_to(it, "memory_tracer_allocation_size_bytes_bucket{{le=\"+Inf\"}} {}\n", cumulative);
+        fmt::format_to(it, "memory_tracer_allocation_size_bytes_sum {}\n", snapshot.allocated_bytes);
+        fmt::format_to(it, "memory_tracer_allocation_size_bytes_count {}\n", cumulative);
+
+        WriteHeader(out, "memory_tracer_allocation_size_quantile_bytes", "gauge",
+                    "Allocation size quantiles (upper bound of the power-of-two bucket).");
+        for (double q : kQuantiles) {
+            fmt::format_to(it, "memory_tracer_allocation_size_quantile_bytes{{quantile=\"{}\"}} {}\n", q,
+                           EstimateQuantile(snapshot.size_buckets, cumulative, q));
+        }
+
+        if (rankings) {
+            WriteMetric(out, "memory_tracer_allocation_rate", "gauge",
+                        "Allocations per second over the last refresh interval.", rankings->allocation_rate);
+            WriteMetric(out, "memory_tracer_free_rate", "gauge",
+                        "Frees per second over the last refresh interval.", rankings->free_rate);
+            WriteMetric(out, "memory_tracer_allocated_bytes_rate", "gauge",
+                        "Bytes allocated per second over the last refresh interval.", rankings->allocated_bytes_rate);
+            WriteMetric(out, "memory_tracer_freed_bytes_rate", "gauge",
+                        "Bytes freed per second over the last refresh interval.", rankings->freed_bytes_rate);
+
+            WriteHeader(out, "memory_tracer_function_live_bytes", "gauge",
+                        "Live bytes of the top functions by live bytes.");
+            for (const auto& function : rankings->top_live) {
+                out->append(std::string_view("memory_tracer_function_live_bytes{function=\""));
+                WriteLabelValue(out, function.function_name);
+                fmt::format_to(it, "\"}} {}\n", function.current_allocated);
+            }
+            WriteHeader(out, "memory_tracer_function_allocated_bytes", "gauge",
+                        "Total bytes allocated by the top functions by allocated bytes.");
+            for (const auto& function : rankings->top_allocated) {
+                out->append(std::string_view("memory_tracer_function_allocated_bytes{function=\""));
+                WriteLabelValue(out, function.function_name);
+                fmt::format_to(it, "\"}} {}\n", function.estimated_bytes);
+            }
+        }
+
+        WriteMetric(out, "memory_tracer_internal_arena_bytes", "gauge",
+                    "Memory reserved by the tracer's internal arena.", capture::internal::GetArenaReservedBytes());
+
+        // 追踪器自身的开销，取刷新时缓存的快照
+        if (rankings) {
+            const capture::TracerStatsSnapshot& tracer = rankings->tracer;
+            WriteMetric(out, "memory_tracer_internal_arena_used_bytes", "gauge",
+                        "Memory in use inside the tracer's internal arena.", tracer.arena_used_bytes);
+            WriteMetric(out, "memory_tracer_dropped_events_total", "counter",
+                        "Capture events dropped because a thread buffer was full.", tracer.dropped_events);
+            WriteMetric(out, "memory_tracer_self_allocated_bytes_total", "counter",
+                        "Bytes the tracer itself allocated through malloc.",
+                        tracer.Get(capture::TracerCounter::TRACER_ALLOCATED_BYTES));
+            WriteHeader(out, "memory_tracer_self_events_total", "counter", "Tracer self-instrumentation counters.");
+            for (size_t i = 0; i < capture::kTracerCounterCount; ++i) {
+                auto counter = static_cast<capture::TracerCounter>(i);
+                if (counter == capture::TracerCounter::TRACER_ALLOCATED_BYTES) {
+                    continue;
+                }
+                fmt::format_to(it, "memory_tracer_self_events_total{{event=\"{}\"}} {}\n",
+                               capture::GetTracerCounterName(counter), tracer.counters[i]);
+            }
+            WriteHeader(out, "memory_tracer_self_duration_seconds", "summary",
+                        "Time spent in tracer hot paths (quantiles are power-of-two bucket upper bounds).");
+            for (size_t i = 0; i < capture::kTracerTimerCount; ++i) {
+                const capture::TracerTimerStats& timer = tracer.timers[i];
+                const char* name = capture::GetTracerTimerName(static_cast<capture::TracerTimer>(i));
+                fmt::format_to(it, "memory_tracer_self_duration_seconds{{timer=\"{}\",quantile=\"0.5\"}} {}\n", name,
+                               timer.p50_ns / 1e9);
+                fmt::format_to(it, "memory_tracer_self_duration_seconds{{timer=\"{}\",quantile=\"0.99\"}} {}\n", name,
+                               timer.p99_ns / 1e9);
+                fmt::format_to(it, "memory_tracer_self_duration_seconds_sum{{timer=\"{}\"}} {}\n", name,
+                               timer.total_ns / 1e9);
+                fmt::format_to(it, "memory_tracer_self_duration_seconds_count{{timer=\"{}\"}} {}\n", name, timer.count);
+            }
+        }
+        WriteMetric(out, "memory_tracer_log_dropped_total", "counter",
+                    "Log records dropped because the async log queue was full.",
+                    logger::Logger::GetInstance().GetDroppedCount());
+    }
+
+    ExporterOptions options_;
+    std::mutex control_mutex_;      // Start / Stop 互斥
+    std::atomic<bool> running_;
+    std::thread thread_;
+    int tcp_fd_;
+    int unix_fd_;
+    int wake_fds_[2];               // Stop 通过管道唤醒 poll
+    std::atomic<uint16_t> port_;
+
+    std::shared_ptr<const Rankings> rankings_;   // 只用 atomic_load / atomic_store 访问
+
+    // 只由导出线程（及 Start 中的首次刷新）访问
+    stats::MetricsSnapshot last_snapshot_;
+    std::chrono::steady_clock::time_point last_refresh_time_;
+    bool has_last_snapshot_;
+};
+
+MetricsExporter::MetricsExporter() : pimpl_(std::make_unique<Impl>()) {}
+MetricsExporter::~MetricsExporter() = default;
+
+MetricsExporter& MetricsExporter::GetInstance() {
+    static MetricsExporter instance;
+    return instance;
+}
+
+bool MetricsExporter::Start(const ExporterOptions& options) { capture::TracerScope scope; return pimpl_->Start(options); }
+void MetricsExporter::Stop() { capture::TracerScope scope; pimpl_->Stop(); }
+bool MetricsExporter::IsRunning() const { return pimpl_->IsRunning(); }
+uint16_t MetricsExporter::GetPort() const { return pimpl_->GetPort(); }
+std::string MetricsExporter::RenderMetrics() { capture::TracerScope scope; return pimpl_->RenderMetrics(); }
+
+} // namespace metrics
+} // namespace memory_tracer
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace memory_tracer {
+namespace parallel {
+
+// 分区区间 [begin, end)
+struct Range {
+    size_t begin;
+    size_t end;
+};
+
+// 查询与报告共用的线程池：调用方把输入切成若干分区，各分区独立计算部分结果后按分区顺序合并。
+// 工作线程在第一次需要时创建，调用方线程也参与执行；并行度为 1、分区只有一个，
+// 或在分区任务内部再次调用时直接在当前线程串行执行
+class Executor {
+public:
+    static Executor& GetInstance();
+
+    // 0 表示使用硬件线程数，1 表示始终串行
+    void SetParallelism(size_t parallelism);
+    size_t GetParallelism() const;
+
+    // 把 [0, count) 切成不超过并行度的分区，除最后一个外长度都是 grain 的整数倍，
+    // 且不小于 grain；count 为 0 时返回一个空区间
+    std::vector<Range> Split(size_t count, size_t grain) const;
+
+    // 执行 func(0) ... func(task_count - 1)，全部完成后返回；任务抛出的第一个异常在此重新抛出
+    void Run(size_t task_count, const std::function<void(size_t)>& func);
+
+private:
+    Executor();
+    ~Executor();
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+
+    class Impl;
+    std::unique_ptr<Impl> pimpl_;
+};
+
+// 按 grain 切分 [0, count)，并行执行 map(begin, end, &partial) 得到各分区的部分结果，
+// 再按分区顺序执行 merge(&result, std::move(partial))，因此顺序相关的合并（如拼接）结果与串行一致
+template <typename Partial, typename Map, typename Merge>
+Partial MapReduce(size_t count, size_t grain, Map map, Merge merge) {
+    Executor& executor = Executor::GetInstance();
+    std::vector<Range> ranges = executor.Split(count, grain);
+    std::vector<Partial> partials(ranges.size());
+    executor.Run(ranges.size(), [&](size_t i) { map(ranges[i].begin, ranges[i].end, &partials[i]); });
+
+    Partial result = std::move(partials[0]);
+    for (size_t i = 1; i < partials.size(); ++i) {
+        merge(&result, std::move(partials[i]));
+    }
+    return result;
+}
+
+} // namespace parallel
+} // namespace memory_tracer
@@ -0,0 +1,214 @@
+#include "parallel/parallel.h"
+#include "capture/internal_allocator.h"
+#include "logger/logger.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+namespace memory_tracer {
+namespace parallel {
+
+namespace {
+
+// 当前线程正在执行分区任务，再次调用 Run 时串行执行，避免嵌套等待耗尽线程池
+thread_local bool t_in_task = false;
+
+size_t GetHardwareParallelism() {
+    unsigned int count = std::thread::hardware_concurrency();
+    return count > 0 ? count : 1;
+}
+
+} // namespace
+
+class Executor::Impl {
+public:
+    Impl() : parallelism_(GetHardwareParallelism()), stopping_(false) {}
+
+    ~Impl() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        work_cv_.notify_all();
+        for (auto& worker : workers_) {
+            if (worker.joinable()) {
+                worker.join();
+            }
+        }
+    }
+
+    void SetParallelism(size_t parallelism) {
+        parallelism_.store(parallelism == 0 ? GetHardwareParallelism() : parallelism, std::memory_order_relaxed);
+        LOG_INFO("Parallelism set to {}", GetParallelism());
+    }
+
+    size_t GetParallelism() const {
+        return parallelism_.load(std::memory_order_relaxed);
+    }
+
+    std::vector<Range> Split(size_t count, size_t grain) const {
+        grain = std::max<size_t>(grain, 1);
+        size_t partitions = std::min(GetParallelism(), (count + grain - 1) / grain);
+        if (t_in_task || partitions <= 1) {
+            return {{0, count}};
+        }
+
+        // 分区长度向上取整到 grain 的整数倍
+        size_t length = (count + partitions - 1) / partitions;
+        length = (length + grain - 1) / grain * grain;
+        std::vector<Range> ranges;
+        for (size_t begin = 0; begin < count; begin += length) {
+            ranges.push_back({begin, std::min(begin + length, count)});
+        }
+        return ranges;
+    }
+
+    void Run(size_t task_count, const std::function<void(size_t)>& func) {
+        if (task_count == 0) {
+            return;
+        }
+        if (t_in_task || task_count == 1 || GetParallelism() <= 1) {
+            RunSerial(task_count, func);
+            return;
+        }
+
+        auto job = std::make_shared<Job>(func, task_count);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            StartWorkers(std::min(GetParallelism(), task_count) - 1);
+            jobs_.push_back(job);
+        }
+        work_cv_.notify_all();
+
+        // 调用方线程也领取任务，之后等待工作线程完成已领取的部分
+        t_in_task = true;
+        while (RunTask(*job)) {
+        }
+        t_in_task = false;
+        {
+            std::unique_lock<std::mutex> lock(job->mutex);
+            job->done_cv.wait(lock, [&]() { return job->done == job->count; });
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = std::find(jobs_.begin(), jobs_.end(), job);
+            if (it != jobs_.end()) {
+                jobs_.erase(it);
+            }
+        }
+
+        if (job->error) {
+            std::rethrow_exception(job->error);
+        }
+    }
+
+private:
+    struct Job {
+        Job(const std::function<void(size_t)>& func, size_t count) : func(func), count(count), next(0), done(0) {}
+
+        const std::function<void(size_t)>& func;
+        const size_t count;
+        std::atomic<size_t> next;   // 下一个待领取的任务
+        size_t done;                // 已完成的任务数，由 mutex 保护
+        std::exception_ptr error;
+        std::mutex mutex;
+        std::condition_variable done_cv;
+    };
+
+    static void RunSerial(size_t task_count, const std::function<void(size_t)>& func) {
+        bool previous = t_in_task;
+        t_in_task = true;
+        try {
+            for (size_t i = 0; i < task_count; ++i) {
+                func(i);
+            }
+        } catch (...) {
+            t_in_task = previous;
+            throw;
+        }
+        t_in_task = previous;
+    }
+
+    // 领取并执行一个任务，没有剩余任务时返回 false
+    static bool RunTask(Job& job) {
+        size_t index = job.next.fetch_add(1, std::memory_order_relaxed);
+        if (index >= job.count) {
+            return false;
+        }
+
+        std::exception_ptr error;
+        try {
+            job.func(index);
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> lock(job.mutex);
+        if (error && !job.error) {
+            job.error = error;
+        }
+        if (++job.done == job.count) {
+            job.done_cv.notify_all();
+        }
+        return true;
+    }
+
+    // 调用方持有 mutex_
+    void StartWorkers(size_t count) {
+        while (workers_.size() < count) {
+            workers_.emplace_back([this]() { WorkerLoop(); });
+        }
+    }
+
+    void WorkerLoop() {
+        // 工作线程产生的分配属于追踪器自身
+        capture::TracerScope scope;
+        t_in_task = true;
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            work_cv_.wait(lock, [this]() { return stopping_ || !jobs_.empty(); });
+            if (stopping_) {
+                return;
+            }
+
+            std::shared_ptr<Job> job = jobs_.front();
+            if (job->next.load(std::memory_order_relaxed) >= job->count) {
+                // 任务已被领完，剩下的只是等待，不再分发
+                jobs_.pop_front();
+                continue;
+            }
+            lock.unlock();
+            while (RunTask(*job)) {
+            }
+            lock.lock();
+        }
+    }
+
+    std::atomic<size_t> parallelism_;
+    std::mutex mutex_;
+    std::condition_variable work_cv_;
+    std::deque<std::shared_ptr<Job>> jobs_;
+    std::vector<std::thread> workers_;
+    bool stopping_;
+};
+
+Executor::Executor() : pimpl_(std::make_unique<Impl>()) {}
+Executor::~Executor() = default;
+
+Executor& Executor::GetInstance() {
+    static Executor instance;
+    return instance;
+}
+
+void Executor::SetParallelism(size_t parallelism) { capture::TracerScope scope; pimpl_->SetParallelism(parallelism); }
+size_t Executor::GetParallelism() const { return pimpl_->GetParallelism(); }
+std::vector<Range> Executor::Split(size_t count, size_t grain) const { capture::TracerScope scope; return pimpl_->Split(count, grain); }
+void Executor::Run(size_t task_count, const std::function<void(size_t)>& func) { capture::TracerScope scope; pimpl_->Run(task_count, func); }
+
+} // namespace parallel
+} // namespace memory_tracer
@@ -0,0 +1,297 @@
+// LD_PRELOAD 注入入口：加载时在构造函数中安装 hook 并开始捕获，事件流直接写入分段 trace，
+// 进程退出时写出剩余事件并封存分段。全部配置来自环境变量，被注入的程序无需任何改动：
+//
+//   LD_PRELOAD=libmemory_tracer_preload.so MT_SAMPLE_INTERVAL=512k MT_OUTPUT_DIR=/tmp/mt ./service
+//
+// MT_SAMPLE_INTERVAL   平均每分配多少字节采样一次（可带 k/m/g 后缀），0 表示全量记录，默认 512k
+// MT_OUTPUT_DIR        输出目录，分段写入 <目录>/<pid>/segment-<序号>.trace，默认 ./memory_tracer
+// MT_STACK_DEPTH       调用栈最多展开的帧数，默认 32
+// MT_STACK_SKIP        从分配调用点起再跳过的帧数（如业务自己的分配器封装），默认 0
+// MT_UNWINDER          fp（帧指针）、dwarf（_Unwind_Backtrace）或 auto（默认，帧指针优先，按调用点校验）
+// MT_FLUSH_INTERVAL_MS 分段写出并刷新到文件的周期，默认 1000
+// MT_SEGMENT_BYTES     单个分段的大小上限（可带 k/m/g 后缀），默认 64m
+// MT_MAX_SEGMENTS      保留的分段数，0 表示全部保留，默认 0
+// MT_CAPTURE_MODE      raw（默认，只记录返回地址）或 full（首次出现时符号化）
+// MT_LOG_LEVEL         trace/debug/info/warn/error，默认 warn
+// MT_TRANSPORT         file（默认，写分段 trace）或 shm（写入共享内存环，由独立的 collector 进程消费）
+// MT_SHM_PREFIX        shm 模式下的共享内存名前缀，默认 memory_tracer
+// MT_SHM_BYTES         shm 模式下环的大小（可带 k/m/g 后缀），默认 64m
+// MT_DISABLE           非空且不为 0 时不启动
+
+#include "capture/capture.h"
+#include "capture/internal_allocator.h"
+#include "logger/logger.h"
+#include "storage/storage.h"
+#include "transport/transport.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace memory_tracer {
+namespace preload {
+namespace {
+
+struct PreloadOptions {
+    size_t sample_interval;
+    std::string output_dir;
+    size_t stack_depth;
+    size_t stack_skip;
+    capture::UnwinderType unwinder;
+    uint64_t flush_interval_ms;
+    uint64_t segment_bytes;
+    size_t max_segments;
+    capture::CaptureMode capture_mode;
+    logger::LogLevel log_level;
+    bool use_shm;
+    transport::PublisherOptions publisher_options;
+
+    PreloadOptions()
+        : sample_interval(512 * 1024), output_dir("./memory_tracer"), stack_depth(capture::kMaxStackFrames),
+          stack_skip(0), unwinder(capture::UnwinderType::AUTO), flush_interval_ms(1000), segment_bytes(64ULL << 20), max_segments(0),
+          capture_mode(capture::CaptureMode::RAW_PC), log_level(logger::LogLevel::WARN), use_shm(false) {}
+};
+
+// 是否已启动，退出时只清理启动成功的实例。
+// 构造函数可能先于本文件的动态初始化执行，这里只用常量初始化的全局量
+bool g_started = false;
+bool g_use_shm = false;
+char g_trace_dir[PATH_MAX] = {};
+
+// 解析无符号整数，支持 k/m/g 后缀；变量不存在时返回 false，格式错误时告警并返回 false
+bool ReadUnsigned(const char* name, uint64_t* value) {
+    const char* text = std::getenv(name);
+    if (text == nullptr || *text == '\0') {
+        return false;
+    }
+
+    errno = 0;
+    char* end = nullptr;
+    unsigned long long parsed = std::strtoull(text, &end, 10);
+    int shift = 0;
+    if (end != text) {
+        switch (*end) {
+            case 'k': case 'K': shift = 10; ++end; break;
+            case 'm': case 'M': shift = 20; ++end; break;
+            case 'g': case 'G': shift = 30; ++end; break;
+            default: break;
+        }
+    }
+    if (end == text || *end != '\0' || errno == ERANGE || text[0] == '-' || parsed > (UINT64_MAX >> shift)) {
+        LOG_WARN("Ignoring invalid {}={}", name, text);
+        return false;
+    }
+    *value = static_cast<uint64_t>(parsed) << shift;
+    return true;
+}
+
+bool ReadLogLevel(logger::LogLevel* level) {
+    const char* text = std::getenv("MT_LOG_LEVEL");
+    if (text == nullptr || *text == '\0') {
+        return false;
+    }
+    static const struct {
+        const char* name;
+        logger::LogLevel level;
+    } kLevels[] = {
+        {"trace", logger::LogLevel::TRACE}, {"debug", logger::LogLevel::DEBUG}, {"info", logger::LogLevel::INFO},
+        {"warn", logger::LogLevel::WARN}, {"error", logger::LogLevel::ERROR}, {"fatal", logger::LogLevel::FATAL},
+    };
+    for (const auto& entry : kLevels) {
+        if (strcasecmp(text, entry.name) == 0) {
+            *level = entry.level;
+            return true;
+        }
+    }
+    LOG_WARN("Ignoring invalid MT_LOG_LEVEL={}", text);
+    return false;
+}
+
+PreloadOptions ReadOptions() {
+    PreloadOptions options;
+    uint64_t value = 0;
+
+    // 先确定日志级别，之后的告警按该级别输出
+    ReadLogLevel(&options.log_level);
+    logger::Logger::GetInstance().SetLogLevel(options.log_level);
+
+    if (ReadUnsigned("MT_SAMPLE_INTERVAL", &value)) {
+        options.sample_interval = value;
+    }
+    if (const char* dir = std::getenv("MT_OUTPUT_DIR")) {
+        if (*dir != '\0') {
+            options.output_dir = dir;
+        }
+    }
+    if (ReadUnsigned("MT_STACK_DEPTH", &value)) {
+        options.stack_depth = value;
+    }
+    if (ReadUnsigned("MT_STACK_SKIP", &value)) {
+        options.stack_skip = value;
+    }
+    if (const char* unwinder = std::getenv("MT_UNWINDER")) {
+        if (*unwinder != '\0' && !capture::ParseUnwinderType(unwinder, &options.unwinder)) {
+            LOG_WARN("Ignoring invalid MT_UNWINDER={}", unwinder);
+        }
+    }
+    if (ReadUnsigned("MT_FLUSH_INTERVAL_MS", &value) && value > 0) {
+        options.flush_interval_ms = value;
+    }
+    if (ReadUnsigned("MT_SEGMENT_BYTES", &value) && value > 0) {
+        options.segment_bytes = value;
+    }
+    if (ReadUnsigned("MT_MAX_SEGMENTS", &value)) {
+        options.max_segments = value;
+    }
+    if (const char* mode = std::getenv("MT_CAPTURE_MODE")) {
+        if (strcasecmp(mode, "full") == 0) {
+            options.capture_mode = capture::CaptureMode::FULL;
+        } else if (*mode != '\0' && strcasecmp(mode, "raw") != 0) {
+            LOG_WARN("Ignoring invalid MT_CAPTURE_MODE={}", mode);
+        }
+    }
+    if (const char* mode = std::getenv("MT_TRANSPORT")) {
+        if (strcasecmp(mode, "shm") == 0) {
+            options.use_shm = true;
+        } else if (*mode != '\0' && strcasecmp(mode, "file") != 0) {
+            LOG_WARN("Ignoring invalid MT_TRANSPORT={}", mode);
+        }
+    }
+    if (const char* prefix = std::getenv("MT_SHM_PREFIX")) {
+        if (*prefix != '\0') {
+            options.publisher_options.prefix = prefix;
+        }
+    }
+    if (ReadUnsigned("MT_SHM_BYTES", &value) && value > 0) {
+        options.publisher_options.ring_bytes = value;
+    }
+    return options;
+}
+
+bool IsDisabled() {
+    const char* text = std::getenv("MT_DISABLE");
+    return text != nullptr && *text != '\0' && std::strcmp(text, "0") != 0;
+}
+
+// 复制 /proc/self/maps，离线符号化时据此把返回地址还原到模块和偏移
+void WriteMemoryMaps(const char* dir) {
+    std::string path = std::string(dir) + "/maps";
+    int in = open("/proc/self/maps", O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        return;
+    }
+    int out = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out < 0) {
+        close(in);
+        LOG_WARN("Failed to write {}: {}", path, std::strerror(errno));
+        return;
+    }
+    char buffer[8192];
+    ssize_t n = 0;
+    while ((n = read(in, buffer, sizeof(buffer))) > 0) {
+        if (write(out, buffer, static_cast<size_t>(n)) != n) {
+            break;
+        }
+    }
+    close(in);
+    close(out);
+}
+
+void OnEvents(const capture::CaptureEvent* events, size_t count) {
+    storage::Storage::GetInstance().AddEvents(events, count);
+}
+
+void StopPreload() {
+    if (!g_started) {
+        return;
+    }
+    g_started = false;
+    capture::TracerScope scope;
+
+    // 停止捕获会合并线程缓冲区中剩余的事件，之后封存最后一个分段或关闭共享内存环
+    capture::Capture::GetInstance().StopCapture();
+    if (g_use_shm) {
+        auto& publisher = transport::ShmPublisher::GetInstance();
+        LOG_INFO("Memory tracer preload stopped, {} events dropped on {}", publisher.GetDroppedCount(),
+                 publisher.GetName());
+        publisher.Stop();
+        logger::Logger::GetInstance().Flush();
+        return;
+    }
+    storage::Storage& storage = storage::Storage::GetInstance();
+    storage.StopSegmentWriter();
+    WriteMemoryMaps(g_trace_dir);
+    LOG_INFO("Memory tracer preload stopped, trace written to {}, {} events dropped", g_trace_dir,
+             storage.GetSegmentDroppedEventCount());
+    logger::Logger::GetInstance().Flush();
+}
+
+__attribute__((constructor)) void StartPreload() {
+    capture::TracerScope scope;
+    if (IsDisabled()) {
+        return;
+    }
+
+    PreloadOptions options = ReadOptions();
+
+    // 日志格式化与 I/O 放到后台线程，避免干扰被注入的程序
+    logger::Logger::GetInstance().StartAsync();
+
+    capture::Capture& capture = capture::Capture::GetInstance();
+    capture.Initialize();
+    if (options.use_shm) {
+        // 事件交给收集器进程，存储与统计都不在本进程中运行；Start 会注册 Capture 的事件监听器
+        if (!transport::ShmPublisher::GetInstance().Start(options.publisher_options)) {
+            return;
+        }
+        g_use_shm = true;
+    } else {
+        mkdir(options.output_dir.c_str(), 0755);
+        std::string trace_dir = options.output_dir + "/" + std::to_string(getpid());
+        if (trace_dir.size() >= sizeof(g_trace_dir)) {
+            LOG_ERROR("Output directory is too long: {}", options.output_dir);
+            return;
+        }
+        std::memcpy(g_trace_dir, trace_dir.c_str(), trace_dir.size() + 1);
+
+        // 事件只写入分段，不在内存中保留记录，长时间运行时内存占用有上界
+        storage::Storage& storage = storage::Storage::GetInstance();
+        storage.Initialize(g_trace_dir);
+        storage::SegmentOptions segment_options;
+        segment_options.flush_interval_ms = options.flush_interval_ms;
+        segment_options.max_segment_bytes = options.segment_bytes;
+        segment_options.max_segments = options.max_segments;
+        segment_options.retain_records = false;
+        storage.StartSegmentWriter(segment_options);
+        capture.AddEventListener(&OnEvents);
+        WriteMemoryMaps(g_trace_dir);
+    }
+
+    capture.SetCaptureMode(options.capture_mode);
+    capture.SetSamplingInterval(options.sample_interval);
+    capture::UnwindOptions unwind_options;
+    unwind_options.unwinder = options.unwinder;
+    unwind_options.max_depth = static_cast<uint32_t>(std::min<size_t>(options.stack_depth, capture::kMaxStackFrames));
+    unwind_options.skip_frames = static_cast<uint32_t>(std::min<size_t>(options.stack_skip, UINT32_MAX));
+    capture.SetUnwindOptions(options.capture_mode, unwind_options);
+    capture.SetRetainAllocations(false);
+    capture.StartCapture();
+
+    // 在各单例之后注册，先于它们的析构执行
+    g_started = true;
+    std::atexit(StopPreload);
+    LOG_INFO("Memory tracer preloaded: sample interval {} bytes, stack depth {}, unwinder {}, writing to {}",
+             options.sample_interval, capture.GetMaxStackDepth(), capture::GetUnwinderTypeName(options.unwinder),
+             g_use_shm ? transport::ShmPublisher::GetInstance().GetName() : std::string(g_trace_dir));
+}
+
+} // namespace
+} // namespace preload
+} // namespace memory_tracer
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace memory_tracer {
+namespace stats {
+
+// 对数-线性分配大小直方图（HDR 风格）：以 2 的幂划分主桶，每个主桶再线性划分 16 个子桶，
+// 小于 16 字节的大小各占一个子桶。落桶只需一次 clz，相对误差不超过 1/16，
+// 内存只与出现过的最大数量级有关，与不同大小的个数无关。计数为采样加权后的估计值
+class SizeHistogram {
+public:
+    static constexpr int kSubBucketBits = 4;
+    static constexpr size_t kSubBucketCount = size_t(1) << kSubBucketBits;
+
+    SizeHistogram();
+
+    void Record(size_t size, double weight = 1.0);
+
+    // 合并另一个直方图（如其他分片或其他函数）
+    void Merge(const SizeHistogram& other);
+
+    void Clear();
+    bool Empty() const { return count_ == 0; }
+
+    double GetCount() const { return count_; }
+    double GetTotalBytes() const { return total_bytes_; }
+    size_t GetMin() const { return Empty() ? 0 : min_; }
+    size_t GetMax() const { return max_; }
+
+    // 分位数（q 取 [0, 1]），返回所在子桶的上界，不超过记录过的最大值
+    size_t GetQuantile(double q) const;
+
+    // 区间 [min_size, max_size) 内的次数和字节数；边界为 0、SIZE_MAX 或不小于 16 的 2 的幂时结果精确
+    void Sum(size_t min_size, size_t max_size, double* count, double* bytes) const;
+
+    // 依次回调非空子桶 func(lower, upper, count)，区间为 [lower, upper)
+    template <typename Func>
+    void ForEachBucket(Func func) const {
+        for (size_t i = 0; i < counts_.size(); ++i) {
+            if (counts_[i] > 0) {
+                func(GetLowerBound(i), GetUpperBound(i), counts_[i]);
+            }
+        }
+    }
+
+private:
+    static size_t GetIndex(size_t size) {
+        if (size < kSubBucketCount) {
+            return size;
+        }
+        int exponent = 63 - __builtin_clzll(size);
+        size_t major = exponent - kSubBucketBits + 1;
+        return (major << kSubBucketBits) | ((size >> (exponent - kSubBucketBits)) & (kSubBucketCount - 1));
+    }
+
+    static size_t GetLowerBound(size_t index);
+    static size_t GetUpperBound(size_t index);
+
+    std::vector<double> counts_;        // 子桶计数，按出现过的最大下标增长
+    std::vector<double> major_bytes_;   // 每个主桶的字节数（精确值）
+    double count_;
+    double total_bytes_;
+    size_t min_;
+    size_t max_;
+};
+
+} // namespace stats
+} // namespace memory_tracer
@@ -3,32 +3,136 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <memory>
 #include <functional>
 
 #include "storage/storage.h"
+#include "capture/stack_table.h"
+#include "stats/size_histogram.h"
 
 namespace memory_tracer {
 namespace stats {
 
+// 采样记录按 1/p 加权还原，以下计数和字节数均为无偏估计值
 struct FunctionStats {
     std::string function_name;
     size_t allocation_count;      // 分配次数
     size_t total_allocated;       // 总分配大小
-    size_t current_allocated;     // 当前分配大小（未释放）
-    size_t peak_allocated;        // 峰值分配大小
+    size_t current_allocated;     // 当前未释放的字节数
+    size_t peak_allocated;        // 未释放字节数的历史峰值
     double avg_size;              // 平均分配大小
-    std::map<size_t, size_t> size_distribution;  // 大小分布
-
-    FunctionStats() : allocation_count(0), total_allocated(0), current_allocated(0), peak_allocated(0), avg_size(0.0) {}
+    size_t sampled_count;         // 实际记录数（未采样时等于 allocation_count）
+    double estimated_count;       // 分配次数估计（未取整）
+    double estimated_bytes;       // 分配字节数估计（未取整）
+    SizeHistogram size_histogram;  // 分配大小分布，可取 p50/p99/max
+
+    FunctionStats()
+        : allocation_count(0), total_allocated(0), current_allocated(0), peak_allocated(0), avg_size(0.0),
+          sampled_count(0), estimated_count(0.0), estimated_bytes(0.0) {}
 };
 
 struct FileStats {
     std::string file_path;
     size_t allocation_count;
     size_t total_allocated;
-    size_t current_allocated;
-    std::map<std::string, size_t> function_counts;  // 各函数分配次数
+    size_t current_allocated;     // 当前未释放的字节数
+    std::map<std::string, size_t> function_counts;  // 各函数分配次数（按实际记录数）
+    double estimated_count;
+    double estimated_bytes;
+
+    FileStats()
+        : allocation_count(0), total_allocated(0), current_allocated(0),
+          estimated_count(0.0), estimated_bytes(0.0) {}
+};
+
+// 采样估计的整体精度，全量记录时误差为 0
+struct SamplingStats {
+    size_t sample_interval;       // 最近一条记录的平均采样间隔（字节），0 表示全量
+    size_t sampled_records;       // 实际记录数
+    double estimated_count;       // 分配次数估计
+    double estimated_bytes;       // 分配字节数估计
+    double count_error;           // 分配次数 95% 置信区间半宽
+    double bytes_error;           // 分配字节数 95% 置信区间半宽
+
+    SamplingStats()
+        : sample_interval(0), sampled_records(0), estimated_count(0.0), estimated_bytes(0.0),
+          count_error(0.0), bytes_error(0.0) {}
+};
+
+// 全部分配合计的未释放内存（采样加权）
+struct LiveStats {
+    size_t current_bytes;         // 当前未释放的字节数
+    size_t peak_bytes;            // 未释放字节数的历史峰值
+    size_t live_blocks;           // 当前未释放的记录数
+
+    LiveStats() : current_bytes(0), peak_bytes(0), live_blocks(0) {}
+};
+
+// 指标快照的分配大小桶：第 i 个桶为 (2^(i-1), 2^i] 字节（第 0 个桶为 0~1 字节），最后一个桶为更大的分配
+constexpr size_t kMetricSizeBucketCount = 42;
+
+// 可无锁读取的累计指标（采样加权），供监控抓取。写入方在分片锁内顺带更新原子量，
+// 读取时不取任何锁，各分片之间不是同一时刻的一致快照
+struct MetricsSnapshot {
+    double allocation_count;      // 累计分配次数
+    double allocated_bytes;       // 累计分配字节数
+    double free_count;            // 累计释放次数（只计入有对应分配的释放）
+    double freed_bytes;           // 累计释放字节数
+    size_t live_bytes;            // 当前未释放的字节数
+    size_t peak_bytes;            // 未释放字节数的历史峰值
+    size_t live_blocks;           // 当前未释放的记录数
+    size_t sample_interval;       // 最近一条记录的平均采样间隔（字节），0 表示全量
+    std::vector<double> size_buckets;   // 各大小桶的分配次数（不累加）
+
+    MetricsSnapshot()
+        : allocation_count(0.0), allocated_bytes(0.0), free_count(0.0), freed_bytes(0.0), live_bytes(0),
+          peak_bytes(0), live_blocks(0), sample_interval(0), size_buckets(kMetricSizeBucketCount, 0.0) {}
+};
+
+// 时间线上的一个桶（采样加权）。由分配/释放事件增量维护，不需要扫描原始记录
+struct TimelinePoint {
+    uint64_t timestamp;           // 桶的起始时间（纳秒）
+    double allocation_count;      // 桶内的分配次数
+    double free_count;            // 桶内的释放次数（只计入有对应分配的释放）
+    size_t allocated_bytes;       // 桶内分配的字节数
+    size_t freed_bytes;           // 桶内释放的字节数
+    size_t live_bytes;            // 桶结束时的未释放字节数
+
+    TimelinePoint()
+        : timestamp(0), allocation_count(0.0), free_count(0.0), allocated_bytes(0), freed_bytes(0),
+          live_bytes(0) {}
+};
+
+// 调用点（调用栈）的生命周期与周转统计，计数为采样加权后的估计值
+// 速率按整个采集时段计算
+struct LifetimeStats {
+    capture::StackId stack_id;
+    double allocation_count;          // 分配次数
+    double allocated_bytes;           // 分配字节数
+    double freed_count;               // 已释放（且有释放时间）的次数
+    double freed_bytes;
+    double short_lived_count;         // 生命周期短于阈值的次数
+    double short_lived_bytes;
+    double allocation_rate;           // 每秒分配次数
+    double churn_bytes_per_sec;       // 每秒释放字节数
+    double short_lived_bytes_per_sec; // 每秒短生命周期字节数
+    SizeHistogram lifetime_histogram; // 已释放分配的生命周期（纳秒）
+
+    LifetimeStats()
+        : stack_id(0), allocation_count(0.0), allocated_bytes(0.0), freed_count(0.0), freed_bytes(0.0),
+          short_lived_count(0.0), short_lived_bytes(0.0), allocation_rate(0.0), churn_bytes_per_sec(0.0),
+          short_lived_bytes_per_sec(0.0) {}
+};
+
+// 一个调用栈的分配合计（采样加权），用于导出火焰图等调用栈剖面
+struct StackStats {
+    capture::StackId stack_id;
+    double allocation_count;
+    double allocated_bytes;
+    double live_bytes;            // 当前未释放的字节数
+
+    StackStats() : stack_id(0), allocation_count(0.0), allocated_bytes(0.0), live_bytes(0.0) {}
 };
 
 struct SizeBucketStats {
@@ -36,11 +140,22 @@ struct SizeBucketStats {
     size_t max_size;
     size_t count;
     size_t total_size;
+    bool mmap_backed;             // 是否为匿名 mmap 映射的区间
 
-    SizeBucketStats() : min_size(0), max_size(0), count(0), total_size(0) {}
-    SizeBucketStats(size_t min, size_t max) : min_size(min), max_size(max), count(0), total_size(0) {}
+    SizeBucketStats() : min_size(0), max_size(0), count(0), total_size(0), mmap_backed(false) {}
+    SizeBucketStats(size_t min, size_t max, bool mmap = false)
+        : min_size(min), max_size(max), count(0), total_size(0), mmap_backed(mmap) {}
 };
 
+// 函数排行依据
+enum class FunctionRanking {
+    TOTAL_BYTES,        // 总分配字节数
+    ALLOCATION_COUNT,   // 分配次数
+    LIVE_BYTES          // 当前未释放字节数
+};
+
+// 统计按地址分片增量聚合：写入只锁地址所在的分片，释放事件在同一分片内找到对应的分配；
+// 读取时合并全部分片
 class Stats {
 public:
     static Stats& GetInstance();
@@ -57,24 +172,63 @@ public:
     // 批量添加内存分配记录
     void AddAllocations(const std::vector<capture::AllocationInfo>& allocations);
 
-    // 按函数统计
+    // 记录内存释放；不带释放时间时不计入生命周期统计
+    void RecordDeallocation(void* address);
+    void RecordDeallocation(void* address, uint64_t timestamp);
+
+    // 写入捕获事件流，可直接注册为 Capture 的事件监听器
+    void AddEvents(const capture::CaptureEvent* events, size_t count);
+
+    // 按函数统计，按总分配大小排序；limit 不超过 1024 时只合并排行摘要中的候选函数
     std::vector<FunctionStats> GetFunctionStats(int limit = 0);
 
+    // 按指定依据取前 limit 个函数，代价与不同函数的个数无关（limit 为 0 时退化为全部排序）
+    std::vector<FunctionStats> GetTopFunctions(FunctionRanking ranking, int limit);
+
     // 获取指定函数的统计信息
     FunctionStats GetFunctionStats(const std::string& function_name);
 
-    // 按文件统计
+    // 按文件统计，按总分配大小排序
     std::vector<FileStats> GetFileStats(int limit = 0);
 
-    // 按大小分布统计
+    // 按大小分布统计，堆分配在前，匿名 mmap 映射单独分桶在后
     std::vector<SizeBucketStats> GetSizeDistributionStats();
 
+    // 全部分配（含 mmap 映射）合并后的大小直方图
+    SizeHistogram GetSizeHistogram();
+
+    // 获取采样率与估计误差
+    SamplingStats GetSamplingStats();
+
+    // 获取当前与峰值未释放内存
+    LiveStats GetLiveStats();
+
+    // 无锁读取累计指标，不会阻塞写入方，也不会被写入方阻塞
+    MetricsSnapshot GetMetricsSnapshot() const;
+
+    // 按 bucket_size_ns 聚合的内存时间线，从最早的非空桶到最新的桶。内部按 1 秒 / 1 分钟 / 1 小时三级
+    // 环形保留最近 10 分钟 / 1 天 / 30 天，取不超过 bucket_size_ns 的最粗一级再合并，代价只与桶数有关
+    std::vector<TimelinePoint> GetTimeline(uint64_t bucket_size_ns = 1000000000);
+
+    // 短生命周期阈值（纳秒，默认 100 微秒），修改后只影响之后的释放
+    void SetShortLivedThreshold(uint64_t threshold_ns);
+    uint64_t GetShortLivedThreshold() const;
+
+    // 按短生命周期字节数排序的调用点，适合改用内存池、arena 或栈上缓冲的候选
+    std::vector<LifetimeStats> GetShortLivedSites(int limit = 10);
+
     // 获取内存热点（分配最多的地方）
     std::vector<std::pair<std::string, size_t>> GetMemoryHotspots(int limit = 10);
 
-    // 获取调用栈统计
+    // 获取调用栈统计（键为符号化后的调用栈）
     std::map<std::string, size_t> GetCallStackStats();
 
+    // 获取按调用栈 ID 统计的分配次数（不做符号化）
+    std::unordered_map<capture::StackId, size_t> GetCallStackStatsById();
+
+    // 全部调用栈的分配次数、字节数与未释放字节数（不做符号化），按调用栈 ID 升序
+    std::vector<StackStats> GetStackStats();
+
     // 生成统计报告
     std::string GenerateReport();
 
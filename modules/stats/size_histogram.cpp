@@ -0,0 +1,130 @@
+#include "stats/size_histogram.h"
+#include <algorithm>
+#include <cstdint>
+
+namespace memory_tracer {
+namespace stats {
+
+SizeHistogram::SizeHistogram() : count_(0), total_bytes_(0), min_(SIZE_MAX), max_(0) {}
+
+void SizeHistogram::Record(size_t size, double weight) {
+    size_t index = GetIndex(size);
+    if (index >= counts_.size()) {
+        counts_.resize(index + 1, 0.0);
+    }
+    counts_[index] += weight;
+
+    size_t major = index >> kSubBucketBits;
+    if (major >= major_bytes_.size()) {
+        major_bytes_.resize(major + 1, 0.0);
+    }
+    major_bytes_[major] += weight * static_cast<double>(size);
+
+    count_ += weight;
+    total_bytes_ += weight * static_cast<double>(size);
+    min_ = std::min(min_, size);
+    max_ = std::max(max_, size);
+}
+
+void SizeHistogram::Merge(const SizeHistogram& other) {
+    if (other.counts_.size() > counts_.size()) {
+        counts_.resize(other.counts_.size(), 0.0);
+    }
+    for (size_t i = 0; i < other.counts_.size(); ++i) {
+        counts_[i] += other.counts_[i];
+    }
+    if (other.major_bytes_.size() > major_bytes_.size()) {
+        major_bytes_.resize(other.major_bytes_.size(), 0.0);
+    }
+    for (size_t i = 0; i < other.major_bytes_.size(); ++i) {
+        major_bytes_[i] += other.major_bytes_[i];
+    }
+    count_ += other.count_;
+    total_bytes_ += other.total_bytes_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+}
+
+void SizeHistogram::Clear() {
+    counts_.clear();
+    major_bytes_.clear();
+    count_ = 0;
+    total_bytes_ = 0;
+    min_ = SIZE_MAX;
+    max_ = 0;
+}
+
+size_t SizeHistogram::GetQuantile(double q) const {
+    if (Empty()) {
+        return 0;
+    }
+    if (q >= 1.0) {
+        return max_;
+    }
+
+    double target = std::max(q, 0.0) * count_;
+    double seen = 0;
+    for (size_t i = 0; i < counts_.size(); ++i) {
+        seen += counts_[i];
+        if (counts_[i] > 0 && seen >= target) {
+            return std::min(GetUpperBound(i) - 1, max_);
+        }
+    }
+    return max_;
+}
+
+void SizeHistogram::Sum(size_t min_size, size_t max_size, double* count, double* bytes) const {
+    *count = 0;
+    *bytes = 0;
+    for (size_t major = 0; major < major_bytes_.size(); ++major) {
+        size_t first = major << kSubBucketBits;
+        size_t last = std::min(first + kSubBucketCount, counts_.size());
+        size_t lower = GetLowerBound(first);
+        size_t upper = GetUpperBound(first + kSubBucketCount - 1);
+        if (upper <= min_size || lower >= max_size) {
+            continue;
+        }
+
+        if (lower >= min_size && upper <= max_size) {
+            // 整个主桶在区间内，字节数取精确值
+            for (size_t i = first; i < last; ++i) {
+                *count += counts_[i];
+            }
+            *bytes += major_bytes_[major];
+            continue;
+        }
+
+        // 区间边界落在主桶内部，按子桶中点估计字节数
+        for (size_t i = first; i < last; ++i) {
+            size_t sub_lower = GetLowerBound(i);
+            if (sub_lower >= min_size && sub_lower < max_size) {
+                size_t sub_upper = GetUpperBound(i);
+                *count += counts_[i];
+                *bytes += counts_[i] * (static_cast<double>(sub_lower) + static_cast<double>(sub_upper - sub_lower) / 2);
+            }
+        }
+    }
+}
+
+size_t SizeHistogram::GetLowerBound(size_t index) {
+    size_t major = index >> kSubBucketBits;
+    size_t sub = index & (kSubBucketCount - 1);
+    if (major == 0) {
+        return sub;
+    }
+    return (kSubBucketCount + sub) << (major - 1);
+}
+
+size_t SizeHistogram::GetUpperBound(size_t index) {
+    size_t major = index >> kSubBucketBits;
+    if (major == 0) {
+        return index + 1;
+    }
+    size_t lower = GetLowerBound(index);
+    size_t width = size_t(1) << (major - 1);
+    // 最高的子桶上界超出 size_t
+    return lower > SIZE_MAX - width ? SIZE_MAX : lower + width;
+}
+
+} // namespace stats
+} // namespace memory_tracer
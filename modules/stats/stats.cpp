@@ -1,9 +1,19 @@
 #include "stats/stats.h"
+#include "timeline.h"
+#include "top_k.h"
+#include "capture/live_table.h"
+#include "capture/stack_table.h"
+#include "capture/internal_allocator.h"
+#include "capture/tracer_stats.h"
 #include "logger/logger.h"
+#include "parallel/parallel.h"
 #include <sstream>
 #include <algorithm>
 #include <iomanip>
+#include <atomic>
 #include <mutex>
+#include <cmath>
+#include <unordered_set>
 
 namespace memory_tracer {
 namespace stats {
@@ -20,115 +30,275 @@ public:
     }
 
     void AddAllocation(const capture::AllocationInfo& info) {
-        std::lock_guard<std::mutex> lock(mutex_);
+        capture::ScopedTracerTimer timer(capture::TracerTimer::STATS_ADD_ALLOCATION);
+        // 采样记录代表 weight 次同样的分配
+        double weight = capture::GetSampleWeight(info.size, info.sample_interval);
+        double bytes = weight * static_cast<double>(info.size);
+        int64_t scaled_bytes = static_cast<int64_t>(std::llround(bytes));
+
+        Shard& shard = GetShard(info.address);
+        capture::CountedLockGuard<std::mutex> lock(shard.mutex, capture::TracerCounter::STATS_LOCK_CONTENTIONS);
+
+        NameEntry* function = InternName(shard, info.function);
+        NameEntry* file = InternName(shard, info.file);
 
         // 按函数统计
-        auto& func_stats = function_stats_[info.function];
-        func_stats.function_name = info.function;
-        func_stats.allocation_count++;
-        func_stats.total_allocated += info.size;
-        func_stats.current_allocated += info.size;
-        func_stats.avg_size = static_cast<double>(func_stats.total_allocated) / func_stats.allocation_count;
+        auto& func = shard.functions[function->id];
+        func.sampled_count++;
+        func.estimated_count += weight;
+        func.estimated_bytes += bytes;
+        func.size_histogram.Record(info.size, weight);
+        AddLive(function, scaled_bytes);
+        shard.top_function_bytes.Add(function->id, bytes);
+        shard.top_function_counts.Add(function->id, weight);
+        shard.top_function_live.Add(function->id, static_cast<double>(scaled_bytes));
 
-        // 更新峰值
-        if (info.size > func_stats.peak_allocated) {
-            func_stats.peak_allocated = info.size;
+        // 大小分布，mmap 映射与堆分配分开统计
+        if (info.kind == capture::AllocationKind::MMAP) {
+            shard.mmap_sizes.Record(info.size, weight);
+        } else {
+            shard.heap_sizes.Record(info.size, weight);
         }
 
-        // 大小分布
-        size_t bucket = info.size;
-        func_stats.size_distribution[bucket]++;
-
         // 按文件统计
-        auto& file_stats = file_stats_[info.file];
-        file_stats.file_path = info.file;
-        file_stats.allocation_count++;
-        file_stats.total_allocated += info.size;
-        file_stats.function_counts[info.function]++;
-
-        // 调用栈统计
-        std::string stack_key = BuildStackKey(info.stack_trace);
-        call_stack_stats_[stack_key]++;
-
-        // 总体统计
-        total_allocations_++;
-        total_memory_allocated_ += info.size;
-
-        // 记录分配用于追踪释放
-        allocation_tracking_[info.address] = {
-            info.function,
-            info.size,
-            info.stack_trace
-        };
+        auto& file_counters = shard.files[file->id];
+        file_counters.estimated_count += weight;
+        file_counters.estimated_bytes += bytes;
+        file_counters.live_bytes += scaled_bytes;
+        file_counters.function_counts[function->id]++;
+        shard.top_file_bytes.Add(file->id, bytes);
+
+        // 调用点统计
+        auto& site = shard.sites[info.stack_id];
+        site.allocation_count += weight;
+        site.allocated_bytes += bytes;
+        site.live_bytes += scaled_bytes;
+        if (info.timestamp != 0) {
+            shard.first_timestamp = std::min(shard.first_timestamp, info.timestamp);
+            shard.last_timestamp = std::max(shard.last_timestamp, info.timestamp);
+        }
+
+        // 总体统计；Horvitz-Thompson 方差估计，每条记录贡献 (1 - p) / p^2 = w(w - 1)
+        shard.total_allocations += weight;
+        shard.total_memory_allocated += bytes;
+        shard.count_variance += weight * (weight - 1.0);
+        shard.bytes_variance += weight * (weight - 1.0) * static_cast<double>(info.size) * info.size;
+        shard.sampled_records++;
+        sample_interval_.store(info.sample_interval, std::memory_order_relaxed);
+        AddLive(&total_live_, scaled_bytes);
+        shard.metrics.AddAllocation(info.size, weight, bytes);
+        shard.timeline.RecordAllocation(info.timestamp, weight, scaled_bytes);
+
+        // 记录分配用于追踪释放，同一地址的分配和释放落在同一个分片
+        shard.live.Insert(info.address, {function, file->id, scaled_bytes, info.stack_id, info.timestamp, weight});
     }
 
-    void RecordDeallocation(void* address) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        auto it = allocation_tracking_.find(address);
-        if (it != allocation_tracking_.end()) {
-            const auto& tracking = it->second;
-            auto& func_stats = function_stats_[tracking.function];
-            if (func_stats.current_allocated >= tracking.size) {
-                func_stats.current_allocated -= tracking.size;
-            }
+    // timestamp 为 0 时不记录生命周期
+    void RecordDeallocation(void* address, uint64_t timestamp) {
+        Shard& shard = GetShard(address);
+        capture::CountedLockGuard<std::mutex> lock(shard.mutex, capture::TracerCounter::STATS_LOCK_CONTENTIONS);
+        AllocationTracking tracking;
+        if (!shard.live.Erase(address, &tracking)) {
+            return;
+        }
+        AddLive(tracking.function, -tracking.bytes);
+        shard.top_function_live.Subtract(tracking.function->id, static_cast<double>(tracking.bytes));
+        AddLive(&total_live_, -tracking.bytes);
+        shard.files[tracking.file_id].live_bytes -= tracking.bytes;
+        shard.metrics.AddFree(tracking.weight, static_cast<double>(tracking.bytes));
+        shard.timeline.RecordFree(timestamp, tracking.weight, tracking.bytes);
+        auto& site = shard.sites[tracking.stack_id];
+        site.live_bytes -= tracking.bytes;
 
-            allocation_tracking_.erase(it);
+        if (timestamp == 0 || tracking.timestamp == 0 || timestamp < tracking.timestamp) {
+            return;
+        }
+        uint64_t lifetime = timestamp - tracking.timestamp;
+        site.freed_count += tracking.weight;
+        site.freed_bytes += static_cast<double>(tracking.bytes);
+        site.lifetime_histogram.Record(lifetime, tracking.weight);
+        if (lifetime < short_lived_threshold_ns_.load(std::memory_order_relaxed)) {
+            site.short_lived_count += tracking.weight;
+            site.short_lived_bytes += static_cast<double>(tracking.bytes);
+            shard.top_short_lived.Add(tracking.stack_id, static_cast<double>(tracking.bytes));
         }
+        shard.last_timestamp = std::max(shard.last_timestamp, timestamp);
     }
 
-    std::vector<FunctionStats> GetFunctionStats(int limit) {
-        std::lock_guard<std::mutex> lock(mutex_);
+    void SetShortLivedThreshold(uint64_t threshold_ns) {
+        short_lived_threshold_ns_.store(threshold_ns, std::memory_order_relaxed);
+    }
 
-        std::vector<FunctionStats> result;
-        for (const auto& [name, stats] : function_stats_) {
-            result.push_back(stats);
+    uint64_t GetShortLivedThreshold() const {
+        return short_lived_threshold_ns_.load(std::memory_order_relaxed);
+    }
+
+    std::vector<LifetimeStats> GetShortLivedSites(int limit) {
+        std::vector<capture::StackId> candidates;
+        bool use_top_k = UseTopK(limit);
+        if (use_top_k) {
+            for (auto& shard : shards_) {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                shard.top_short_lived.GetTop(limit, &candidates);
+            }
+            std::sort(candidates.begin(), candidates.end());
+            candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
         }
 
-        // 按总分配大小排序
-        std::sort(result.begin(), result.end(),
-            [](const FunctionStats& a, const FunctionStats& b) {
-                return a.total_allocated > b.total_allocated;
-            });
+        std::unordered_map<capture::StackId, SiteCounters> merged;
+        uint64_t first_timestamp = UINT64_MAX;
+        uint64_t last_timestamp = 0;
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            first_timestamp = std::min(first_timestamp, shard.first_timestamp);
+            last_timestamp = std::max(last_timestamp, shard.last_timestamp);
+            if (use_top_k) {
+                for (capture::StackId id : candidates) {
+                    auto it = shard.sites.find(id);
+                    if (it != shard.sites.end()) {
+                        merged[id].Merge(it->second);
+                    }
+                }
+            } else {
+                for (const auto& [id, site] : shard.sites) {
+                    if (site.short_lived_count > 0) {
+                        merged[id].Merge(site);
+                    }
+                }
+            }
+        }
 
-        if (limit > 0 && result.size() > static_cast<size_t>(limit)) {
-            result.resize(limit);
+        // 速率按整个采集时段计算，各调用点之间可以直接比较
+        double seconds = last_timestamp > first_timestamp ? (last_timestamp - first_timestamp) / 1e9 : 0.0;
+        std::vector<LifetimeStats> result;
+        result.reserve(merged.size());
+        for (auto& [id, site] : merged) {
+            if (site.short_lived_count <= 0) {
+                continue;
+            }
+            LifetimeStats stats;
+            stats.stack_id = id;
+            stats.allocation_count = site.allocation_count;
+            stats.allocated_bytes = site.allocated_bytes;
+            stats.freed_count = site.freed_count;
+            stats.freed_bytes = site.freed_bytes;
+            stats.short_lived_count = site.short_lived_count;
+            stats.short_lived_bytes = site.short_lived_bytes;
+            if (seconds > 0) {
+                stats.allocation_rate = site.allocation_count / seconds;
+                stats.churn_bytes_per_sec = site.freed_bytes / seconds;
+                stats.short_lived_bytes_per_sec = site.short_lived_bytes / seconds;
+            }
+            stats.lifetime_histogram = std::move(site.lifetime_histogram);
+            result.push_back(std::move(stats));
         }
 
+        size_t count = limit > 0 ? std::min(result.size(), static_cast<size_t>(limit)) : result.size();
+        std::partial_sort(result.begin(), result.begin() + count, result.end(),
+            [](const LifetimeStats& a, const LifetimeStats& b) { return a.short_lived_bytes > b.short_lived_bytes; });
+        result.resize(count);
+        return result;
+    }
+
+    std::vector<FunctionStats> GetFunctionStats(int limit) {
+        return GetTopFunctions(FunctionRanking::TOTAL_BYTES, limit);
+    }
+
+    std::vector<FunctionStats> GetTopFunctions(FunctionRanking ranking, int limit) {
+        std::vector<uint32_t> ids = RankFunctions(ranking, limit);
+
+        // 只为入选的函数合并大小直方图
+        std::vector<FunctionCounters> merged = MergeCounters(&Shard::functions, ids);
+
+        std::vector<FunctionStats> result;
+        result.reserve(ids.size());
+        std::lock_guard<std::mutex> lock(names_mutex_);
+        for (size_t i = 0; i < ids.size(); ++i) {
+            result.push_back(MakeFunctionStats(*names_[ids[i]], merged[i]));
+        }
         return result;
     }
 
     FunctionStats GetFunctionStats(const std::string& function_name) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        auto it = function_stats_.find(function_name);
-        if (it != function_stats_.end()) {
-            return it->second;
+        NameEntry* entry = FindName(function_name);
+        if (!entry) {
+            return FunctionStats();
         }
-        return FunctionStats();
+
+        FunctionCounters merged;
+        bool found = false;
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto it = shard.functions.find(entry->id);
+            if (it != shard.functions.end()) {
+                merged.Merge(it->second);
+                found = true;
+            }
+        }
+        return found ? MakeFunctionStats(*entry, merged) : FunctionStats();
     }
 
     std::vector<FileStats> GetFileStats(int limit) {
-        std::lock_guard<std::mutex> lock(mutex_);
-
-        std::vector<FileStats> result;
-        for (const auto& [path, stats] : file_stats_) {
-            result.push_back(stats);
+        // 先只合并字节数排出名次，再为入选的文件合并各函数计数
+        std::vector<uint32_t> candidates;
+        bool use_top_k = UseTopK(limit);
+        if (use_top_k) {
+            candidates = GetCandidates(&Shard::top_file_bytes, limit);
+        }
+        std::vector<uint32_t> ids;
+        if (use_top_k) {
+            std::unordered_map<uint32_t, double> bytes;
+            for (auto& shard : shards_) {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                for (uint32_t id : candidates) {
+                    auto it = shard.files.find(id);
+                    if (it != shard.files.end()) {
+                        bytes[id] += it->second.estimated_bytes;
+                    }
+                }
+            }
+            ids = SelectTop(bytes, limit);
+        } else {
+            DenseValues bytes = MapShards<DenseValues>(
+                [](const Shard& shard, DenseValues* partial) {
+                    for (const auto& [id, counters] : shard.files) {
+                        partial->Add(id, counters.estimated_bytes);
+                    }
+                },
+                [](DenseValues* result, DenseValues&& partial) { result->Merge(partial); });
+            ids = SelectTop(bytes, limit);
         }
 
-        // 按总分配大小排序
-        std::sort(result.begin(), result.end(),
-            [](const FileStats& a, const FileStats& b) {
-                return a.total_allocated > b.total_allocated;
-            });
+        std::vector<FileCounters> merged = MergeCounters(&Shard::files, ids);
 
-        if (limit > 0 && result.size() > static_cast<size_t>(limit)) {
-            result.resize(limit);
+        std::vector<FileStats> result;
+        result.reserve(ids.size());
+        std::lock_guard<std::mutex> lock(names_mutex_);
+        for (size_t i = 0; i < ids.size(); ++i) {
+            const FileCounters& counters = merged[i];
+            FileStats stats;
+            stats.file_path = names_[ids[i]]->name;
+            stats.estimated_count = counters.estimated_count;
+            stats.estimated_bytes = counters.estimated_bytes;
+            stats.allocation_count = RoundToSize(counters.estimated_count);
+            stats.total_allocated = RoundToSize(counters.estimated_bytes);
+            stats.current_allocated = counters.live_bytes > 0 ? static_cast<size_t>(counters.live_bytes) : 0;
+            for (const auto& [function_id, count] : counters.function_counts) {
+                stats.function_counts[names_[function_id]->name] += count;
+            }
+            result.push_back(std::move(stats));
         }
-
         return result;
     }
 
     std::vector<SizeBucketStats> GetSizeDistributionStats() {
-        std::lock_guard<std::mutex> lock(mutex_);
+        SizeHistogram heap_sizes;
+        SizeHistogram mmap_sizes;
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            heap_sizes.Merge(shard.heap_sizes);
+            mmap_sizes.Merge(shard.mmap_sizes);
+        }
 
         // 定义大小区间
         std::vector<SizeBucketStats> buckets = {
@@ -144,19 +314,16 @@ public:
             SizeBucketStats(16384, 65536),
             SizeBucketStats(65536, SIZE_MAX),
         };
+        FillBuckets(heap_sizes, buckets);
 
-        // 统计所有函数的大小分布
-        for (const auto& [func, stats] : function_stats_) {
-            for (const auto& [size, count] : stats.size_distribution) {
-                for (auto& bucket : buckets) {
-                    if (size >= bucket.min_size && size < bucket.max_size) {
-                        bucket.count += count;
-                        bucket.total_size += size * count;
-                        break;
-                    }
-                }
-            }
-        }
+        // mmap 映射通常以页为单位且远大于堆分配，按普通页、大页、GB 级划分
+        std::vector<SizeBucketStats> mmap_buckets = {
+            SizeBucketStats(0, size_t(2) << 20, true),
+            SizeBucketStats(size_t(2) << 20, size_t(1) << 30, true),
+            SizeBucketStats(size_t(1) << 30, SIZE_MAX, true),
+        };
+        FillBuckets(mmap_sizes, mmap_buckets);
+        buckets.insert(buckets.end(), mmap_buckets.begin(), mmap_buckets.end());
 
         // 移除空区间
         buckets.erase(
@@ -167,41 +334,219 @@ public:
         return buckets;
     }
 
+    SizeHistogram GetSizeHistogram() {
+        SizeHistogram result;
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            result.Merge(shard.heap_sizes);
+            result.Merge(shard.mmap_sizes);
+        }
+        return result;
+    }
+
     std::vector<std::pair<std::string, size_t>> GetMemoryHotspots(int limit) {
-        auto func_stats = GetFunctionStats(0);
+        // 只需要名字和总字节数，不构造 FunctionStats
+        std::vector<uint32_t> ids = RankFunctions(FunctionRanking::TOTAL_BYTES, limit);
+        std::unordered_map<uint32_t, double> bytes;
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (uint32_t id : ids) {
+                auto it = shard.functions.find(id);
+                if (it != shard.functions.end()) {
+                    bytes[id] += it->second.estimated_bytes;
+                }
+            }
+        }
 
         std::vector<std::pair<std::string, size_t>> hotspots;
-        for (const auto& stats : func_stats) {
-            hotspots.push_back({stats.function_name, stats.total_allocated});
+        hotspots.reserve(ids.size());
+        std::lock_guard<std::mutex> lock(names_mutex_);
+        for (uint32_t id : ids) {
+            hotspots.push_back({names_[id]->name, RoundToSize(bytes[id])});
+        }
+        return hotspots;
+    }
+
+    std::map<std::string, size_t> GetCallStackStats() {
+        auto by_id = GetCallStackStatsById();
+
+        // 只在读取时符号化，按 PC 共享缓存
+        std::map<std::string, size_t> result;
+        for (const auto& [stack_id, count] : by_id) {
+            result[BuildStackKey(stack_id)] += count;
         }
+        return result;
+    }
 
-        std::sort(hotspots.begin(), hotspots.end(),
-            [](const auto& a, const auto& b) { return a.second > b.second; });
+    std::unordered_map<capture::StackId, size_t> GetCallStackStatsById() {
+        std::unordered_map<capture::StackId, double> merged;
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (const auto& [stack_id, site] : shard.sites) {
+                merged[stack_id] += site.allocation_count;
+            }
+        }
 
-        if (limit > 0 && hotspots.size() > static_cast<size_t>(limit)) {
-            hotspots.resize(limit);
+        std::unordered_map<capture::StackId, size_t> result;
+        result.reserve(merged.size());
+        for (const auto& [stack_id, count] : merged) {
+            result[stack_id] = static_cast<size_t>(std::llround(count));
         }
+        return result;
+    }
 
-        return hotspots;
+    std::vector<StackStats> GetStackStats() {
+        std::unordered_map<capture::StackId, StackStats> merged;
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (const auto& [stack_id, site] : shard.sites) {
+                StackStats& stats = merged[stack_id];
+                stats.allocation_count += site.allocation_count;
+                stats.allocated_bytes += site.allocated_bytes;
+                stats.live_bytes += static_cast<double>(site.live_bytes);
+            }
+        }
+
+        std::vector<StackStats> result;
+        result.reserve(merged.size());
+        for (auto& [stack_id, stats] : merged) {
+            stats.stack_id = stack_id;
+            stats.live_bytes = std::max(stats.live_bytes, 0.0);
+            result.push_back(stats);
+        }
+        std::sort(result.begin(), result.end(),
+            [](const StackStats& a, const StackStats& b) { return a.stack_id < b.stack_id; });
+        return result;
     }
 
-    std::map<std::string, size_t> GetCallStackStats() {
-        std::lock_guard<std::mutex> lock(mutex_);
-        return call_stack_stats_;
+    SamplingStats GetSamplingStats() {
+        double count_variance = 0;
+        double bytes_variance = 0;
+        SamplingStats result;
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            result.sampled_records += shard.sampled_records;
+            result.estimated_count += shard.total_allocations;
+            result.estimated_bytes += shard.total_memory_allocated;
+            count_variance += shard.count_variance;
+            bytes_variance += shard.bytes_variance;
+        }
+        result.sample_interval = sample_interval_.load(std::memory_order_relaxed);
+        result.count_error = kConfidenceZ * std::sqrt(count_variance);
+        result.bytes_error = kConfidenceZ * std::sqrt(bytes_variance);
+        return result;
+    }
+
+    LiveStats GetLiveStats() {
+        LiveStats result;
+        result.current_bytes = ClampLive(total_live_.live_bytes.load(std::memory_order_relaxed));
+        result.peak_bytes = ClampLive(total_live_.peak_bytes.load(std::memory_order_relaxed));
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            result.live_blocks += shard.live.Size();
+        }
+        return result;
+    }
+
+    MetricsSnapshot GetMetricsSnapshot() const {
+        MetricsSnapshot result;
+        for (const auto& shard : shards_) {
+            shard.metrics.AddTo(&result);
+        }
+        result.live_bytes = ClampLive(total_live_.live_bytes.load(std::memory_order_relaxed));
+        result.peak_bytes = ClampLive(total_live_.peak_bytes.load(std::memory_order_relaxed));
+        result.sample_interval = sample_interval_.load(std::memory_order_relaxed);
+        return result;
+    }
+
+    std::vector<TimelinePoint> GetTimeline(uint64_t bucket_size_ns) {
+        size_t level = TimelineSeries::SelectLevel(bucket_size_ns);
+        const TimelineSeries::Level& config = TimelineSeries::kLevels[level];
+        uint64_t group = std::max<uint64_t>(bucket_size_ns / config.resolution_ns, 1);
+
+        // 锁住全部分片，桶与当前未释放字节数取自同一时刻
+        std::vector<std::unique_lock<std::mutex>> locks;
+        locks.reserve(kShardCount);
+        uint64_t latest = 0;
+        bool has_data = false;
+        for (auto& shard : shards_) {
+            locks.emplace_back(shard.mutex);
+            uint64_t index = shard.timeline.GetLatestIndex(level);
+            if (index != UINT64_MAX) {
+                latest = has_data ? std::max(latest, index) : index;
+                has_data = true;
+            }
+        }
+        if (!has_data) {
+            return {};
+        }
+
+        uint64_t first = latest + 1 >= config.capacity ? latest + 1 - config.capacity : 0;
+        std::vector<TimelineBucket> buckets(latest - first + 1);
+        int64_t live_bytes = 0;
+        for (const auto& shard : shards_) {
+            shard.timeline.AddTo(level, first, &buckets);
+            live_bytes += shard.timeline.GetLiveBytes();
+        }
+        locks.clear();
+
+        // 从当前值倒推每个桶结束时的未释放字节数
+        std::vector<int64_t> live_at_end(buckets.size());
+        for (size_t i = buckets.size(); i-- > 0;) {
+            live_at_end[i] = live_bytes;
+            live_bytes -= buckets[i].allocated_bytes - buckets[i].freed_bytes;
+        }
+
+        size_t start = 0;
+        while (start < buckets.size() && buckets[start].allocation_count == 0 && buckets[start].free_count == 0) {
+            ++start;
+        }
+
+        std::vector<TimelinePoint> result;
+        for (size_t i = start; i < buckets.size(); ++i) {
+            uint64_t index = first + i;
+            uint64_t group_index = index / group;
+            if (result.empty() || result.back().timestamp != group_index * group * config.resolution_ns) {
+                result.emplace_back();
+                result.back().timestamp = group_index * group * config.resolution_ns;
+            }
+            TimelinePoint& point = result.back();
+            point.allocation_count += buckets[i].allocation_count;
+            point.free_count += buckets[i].free_count;
+            point.allocated_bytes += ClampLive(buckets[i].allocated_bytes);
+            point.freed_bytes += ClampLive(buckets[i].freed_bytes);
+            point.live_bytes = ClampLive(live_at_end[i]);
+        }
+        return result;
     }
 
     std::string GenerateReport() {
-        std::lock_guard<std::mutex> lock(mutex_);
+        size_t function_count = CountNames(&Shard::functions);
+        size_t file_count = CountNames(&Shard::files);
+        SamplingStats sampling = GetSamplingStats();
+        LiveStats live = GetLiveStats();
+
         std::ostringstream oss;
 
         oss << "======================================\n";
         oss << "       Memory Tracer Report\n";
         oss << "======================================\n\n";
 
-        oss << "Total Allocations: " << total_allocations_ << "\n";
-        oss << "Total Memory Allocated: " << FormatSize(total_memory_allocated_) << "\n";
-        oss << "Unique Functions: " << function_stats_.size() << "\n";
-        oss << "Unique Files: " << file_stats_.size() << "\n\n";
+        oss << "Total Allocations: " << std::llround(sampling.estimated_count) << "\n";
+        oss << "Total Memory Allocated: " << FormatSize(RoundToSize(sampling.estimated_bytes)) << "\n";
+        oss << "Live Memory: " << FormatSize(live.current_bytes) << " (peak " << FormatSize(live.peak_bytes) << ")\n";
+        oss << "Unique Functions: " << function_count << "\n";
+        oss << "Unique Files: " << file_count << "\n\n";
+
+        if (sampling.sample_interval > 0) {
+            oss << "--- Sampling ---\n";
+            oss << "Mean Interval: 1 sample per " << FormatSize(sampling.sample_interval) << "\n";
+            oss << "Sampled Records: " << sampling.sampled_records << "\n";
+            oss << "Estimated Allocations: " << std::llround(sampling.estimated_count)
+                << " +/- " << std::llround(sampling.count_error) << " (95%)\n";
+            oss << "Estimated Memory: " << FormatSize(RoundToSize(sampling.estimated_bytes))
+                << " +/- " << FormatSize(RoundToSize(sampling.bytes_error)) << " (95%)\n\n";
+        }
 
         oss << "--- Top 10 Functions by Allocation Size ---\n";
         auto func_stats = GetFunctionStats(10);
@@ -211,10 +556,32 @@ public:
             oss << "   Allocations: " << stats.allocation_count << "\n";
             oss << "   Total: " << FormatSize(stats.total_allocated) << "\n";
             oss << "   Current: " << FormatSize(stats.current_allocated) << "\n";
+            oss << "   Peak: " << FormatSize(stats.peak_allocated) << "\n";
             oss << "   Avg: " << FormatSize(static_cast<size_t>(stats.avg_size)) << "\n";
+            oss << "   Size p50/p99/max: " << FormatQuantiles(stats.size_histogram) << "\n";
+        }
+
+        uint64_t threshold = GetShortLivedThreshold();
+        auto short_lived = GetShortLivedSites(5);
+        if (!short_lived.empty()) {
+            oss << "\n--- Short-lived Allocation Sites (< " << FormatDuration(threshold) << ") ---\n";
+            for (size_t i = 0; i < short_lived.size(); ++i) {
+                const auto& site = short_lived[i];
+                oss << (i + 1) << ". " << BuildStackKey(site.stack_id) << "\n";
+                oss << "   Short-lived: " << std::llround(site.short_lived_count) << " allocs, "
+                    << FormatSize(RoundToSize(site.short_lived_bytes_per_sec)) << "/s\n";
+                oss << "   Rate: " << std::llround(site.allocation_rate) << " allocs/s, churn "
+                    << FormatSize(RoundToSize(site.churn_bytes_per_sec)) << "/s\n";
+                oss << "   Lifetime p50/p99: " << FormatDuration(site.lifetime_histogram.GetQuantile(0.5)) << " / "
+                    << FormatDuration(site.lifetime_histogram.GetQuantile(0.99)) << "\n";
+            }
         }
 
         oss << "\n--- Size Distribution ---\n";
+        SizeHistogram sizes = GetSizeHistogram();
+        if (!sizes.Empty()) {
+            oss << "p50/p99/max: " << FormatQuantiles(sizes) << "\n";
+        }
         auto size_dist = GetSizeDistributionStats();
         for (const auto& bucket : size_dist) {
             oss << "[" << FormatSize(bucket.min_size) << ", ";
@@ -223,37 +590,500 @@ public:
             } else {
                 oss << FormatSize(bucket.max_size) << ")";
             }
-            oss << ": " << bucket.count << " allocs, " << FormatSize(bucket.total_size) << "\n";
+            oss << ": " << bucket.count << (bucket.mmap_backed ? " mmaps, " : " allocs, ")
+                << FormatSize(bucket.total_size) << "\n";
         }
 
+        AppendTracerOverhead(oss);
+
         oss << "\n======================================\n";
 
         return oss.str();
     }
 
     std::string GetSummary() {
-        std::lock_guard<std::mutex> lock(mutex_);
+        SamplingStats sampling = GetSamplingStats();
+        LiveStats live = GetLiveStats();
 
         std::ostringstream oss;
-        oss << "Total allocations: " << total_allocations_ << "\n";
-        oss << "Total memory: " << FormatSize(total_memory_allocated_) << "\n";
-        oss << "Functions: " << function_stats_.size() << "\n";
+        oss << "Total allocations: " << std::llround(sampling.estimated_count) << "\n";
+        oss << "Total memory: " << FormatSize(RoundToSize(sampling.estimated_bytes)) << "\n";
+        oss << "Live memory: " << FormatSize(live.current_bytes) << " (peak " << FormatSize(live.peak_bytes) << ")\n";
+        if (sampling.sample_interval > 0) {
+            oss << "Sampling: 1 per " << FormatSize(sampling.sample_interval) << " (" << sampling.sampled_records
+                << " records)\n";
+        }
+        oss << "Functions: " << CountNames(&Shard::functions) << "\n";
 
         return oss.str();
     }
 
     void Reset() {
-        std::lock_guard<std::mutex> lock(mutex_);
-        function_stats_.clear();
-        file_stats_.clear();
-        call_stack_stats_.clear();
-        allocation_tracking_.clear();
-        total_allocations_ = 0;
-        total_memory_allocated_ = 0;
+        // 先锁住全部分片再清空名字表，与写入方的加锁顺序（分片 -> 名字表）一致
+        std::vector<std::unique_lock<std::mutex>> locks;
+        locks.reserve(kShardCount);
+        for (auto& shard : shards_) {
+            locks.emplace_back(shard.mutex);
+        }
+        for (auto& shard : shards_) {
+            shard.Clear();
+        }
+        std::lock_guard<std::mutex> lock(names_mutex_);
+        names_.clear();
+        name_ids_.clear();
+        total_live_.live_bytes = 0;
+        total_live_.peak_bytes = 0;
+        sample_interval_ = 0;
     }
 
 private:
-    std::string BuildStackKey(const std::vector<std::string>& stack_trace) {
+    // 函数名和文件名驻留为 ID，分片中的计数都以 ID 为键。
+    // 函数的当前/峰值未释放字节跨分片共享，用原子量维护，峰值是合并后总量的真实峰值
+    struct NameEntry {
+        uint32_t id;
+        std::string name;
+        std::atomic<int64_t> live_bytes;
+        std::atomic<int64_t> peak_bytes;
+
+        NameEntry(uint32_t entry_id, const std::string& entry_name)
+            : id(entry_id), name(entry_name), live_bytes(0), peak_bytes(0) {}
+    };
+
+    // 计数均为采样加权后的估计值
+    struct FunctionCounters {
+        size_t sampled_count = 0;
+        double estimated_count = 0;
+        double estimated_bytes = 0;
+        SizeHistogram size_histogram;
+
+        void Merge(const FunctionCounters& other) {
+            sampled_count += other.sampled_count;
+            estimated_count += other.estimated_count;
+            estimated_bytes += other.estimated_bytes;
+            size_histogram.Merge(other.size_histogram);
+        }
+    };
+
+    struct FileCounters {
+        double estimated_count = 0;
+        double estimated_bytes = 0;
+        int64_t live_bytes = 0;
+        std::unordered_map<uint32_t, size_t> function_counts;
+
+        void Merge(const FileCounters& other) {
+            estimated_count += other.estimated_count;
+            estimated_bytes += other.estimated_bytes;
+            live_bytes += other.live_bytes;
+            for (const auto& [id, count] : other.function_counts) {
+                function_counts[id] += count;
+            }
+        }
+    };
+
+    // 调用点的分配与生命周期，计数为采样加权后的估计值
+    struct SiteCounters {
+        double allocation_count = 0;
+        double allocated_bytes = 0;
+        double freed_count = 0;
+        double freed_bytes = 0;
+        double short_lived_count = 0;
+        double short_lived_bytes = 0;
+        int64_t live_bytes = 0;
+        SizeHistogram lifetime_histogram;   // 纳秒
+
+        void Merge(const SiteCounters& other) {
+            allocation_count += other.allocation_count;
+            allocated_bytes += other.allocated_bytes;
+            live_bytes += other.live_bytes;
+            freed_count += other.freed_count;
+            freed_bytes += other.freed_bytes;
+            short_lived_count += other.short_lived_count;
+            short_lived_bytes += other.short_lived_bytes;
+            lifetime_histogram.Merge(other.lifetime_histogram);
+        }
+    };
+
+    struct AllocationTracking {
+        NameEntry* function;
+        uint32_t file_id;
+        int64_t bytes;      // 采样加权后的字节数
+        capture::StackId stack_id;
+        uint64_t timestamp;
+        double weight;
+    };
+
+    // 按地址分片，同一地址的分配与释放总在同一个分片内配对；读取时合并所有分片
+    // 分片的累计指标：只在分片锁内写入（单一写入方，load + store 即可），读取方不加锁
+    class ShardMetrics {
+    public:
+        ShardMetrics() { Clear(); }
+
+        void AddAllocation(size_t size, double weight, double bytes) {
+            Add(&allocation_count_, weight);
+            Add(&allocated_bytes_, bytes);
+            Add(&size_buckets_[GetBucketIndex(size)], weight);
+            live_blocks_.store(live_blocks_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+
+        void AddFree(double weight, double bytes) {
+            Add(&free_count_, weight);
+            Add(&freed_bytes_, bytes);
+            live_blocks_.store(live_blocks_.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+        }
+
+        void AddTo(MetricsSnapshot* snapshot) const {
+            snapshot->allocation_count += allocation_count_.load(std::memory_order_relaxed);
+            snapshot->allocated_bytes += allocated_bytes_.load(std::memory_order_relaxed);
+            snapshot->free_count += free_count_.load(std::memory_order_relaxed);
+            snapshot->freed_bytes += freed_bytes_.load(std::memory_order_relaxed);
+            snapshot->live_blocks += live_blocks_.load(std::memory_order_relaxed);
+            for (size_t i = 0; i < kMetricSizeBucketCount; ++i) {
+                snapshot->size_buckets[i] += size_buckets_[i].load(std::memory_order_relaxed);
+            }
+        }
+
+        void Clear() {
+            allocation_count_.store(0, std::memory_order_relaxed);
+            allocated_bytes_.store(0, std::memory_order_relaxed);
+            free_count_.store(0, std::memory_order_relaxed);
+            freed_bytes_.store(0, std::memory_order_relaxed);
+            live_blocks_.store(0, std::memory_order_relaxed);
+            for (auto& bucket : size_buckets_) {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+        }
+
+    private:
+        static void Add(std::atomic<double>* value, double delta) {
+            value->store(value->load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+        }
+
+        // 向上取整到 2 的幂的指数
+        static size_t GetBucketIndex(size_t size) {
+            size_t index = size <= 1 ? 0 : static_cast<size_t>(64 - __builtin_clzll(size - 1));
+            return std::min(index, kMetricSizeBucketCount - 1);
+        }
+
+        std::atomic<double> allocation_count_;
+        std::atomic<double> allocated_bytes_;
+        std::atomic<double> free_count_;
+        std::atomic<double> freed_bytes_;
+        std::atomic<uint64_t> live_blocks_;
+        std::atomic<double> size_buckets_[kMetricSizeBucketCount];
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<std::string, NameEntry*> name_cache;   // 避免每条记录都访问全局名字表
+        std::unordered_map<uint32_t, FunctionCounters> functions;
+        std::unordered_map<uint32_t, FileCounters> files;
+        std::unordered_map<capture::StackId, SiteCounters> sites;
+        uint64_t first_timestamp = UINT64_MAX;
+        uint64_t last_timestamp = 0;
+        SizeHistogram heap_sizes;
+        SizeHistogram mmap_sizes;
+        capture::LiveTable<AllocationTracking> live{4};   // 外层已加锁，内部分片不必多
+
+        // 排行候选，查询前 K 名时只合并这些键
+        SpaceSaving<uint32_t> top_function_bytes{kTopKCapacity};
+        SpaceSaving<uint32_t> top_function_counts{kTopKCapacity};
+        SpaceSaving<uint32_t> top_function_live{kTopKCapacity};
+        SpaceSaving<uint32_t> top_file_bytes{kTopKCapacity};
+        SpaceSaving<capture::StackId> top_short_lived{kTopKCapacity};   // 按短生命周期字节数
+        ShardMetrics metrics;
+        TimelineSeries timeline;
+
+        double total_allocations = 0;
+        double total_memory_allocated = 0;
+        double count_variance = 0;
+        double bytes_variance = 0;
+        size_t sampled_records = 0;
+
+        void Clear() {
+            name_cache.clear();
+            functions.clear();
+            files.clear();
+            sites.clear();
+            first_timestamp = UINT64_MAX;
+            last_timestamp = 0;
+            heap_sizes.Clear();
+            mmap_sizes.Clear();
+            live.Clear();
+            top_function_bytes.Clear();
+            top_function_counts.Clear();
+            top_function_live.Clear();
+            top_file_bytes.Clear();
+            top_short_lived.Clear();
+            metrics.Clear();
+            timeline.Clear();
+            total_allocations = 0;
+            total_memory_allocated = 0;
+            count_variance = 0;
+            bytes_variance = 0;
+            sampled_records = 0;
+        }
+    };
+
+    // 分片数为 2 的幂
+    static constexpr size_t kShardCount = 16;
+
+    // 每个分片的排行摘要容量，查询的前 K 名不超过该值时走摘要，否则合并全部键
+    static constexpr size_t kTopKCapacity = 1024;
+
+    // 合并计数时每个线程至少负责的键数
+    static constexpr size_t kMergeGrain = 256;
+
+    // 以名字 ID 为下标累加，分区结果逐项相加即可合并
+    struct DenseValues {
+        std::vector<double> values;
+        std::vector<uint8_t> present;
+
+        void Add(uint32_t id, double value) {
+            if (id >= values.size()) {
+                values.resize(id + 1, 0.0);
+                present.resize(id + 1, 0);
+            }
+            values[id] += value;
+            present[id] = 1;
+        }
+
+        void Merge(const DenseValues& other) {
+            if (other.values.size() > values.size()) {
+                values.resize(other.values.size(), 0.0);
+                present.resize(other.values.size(), 0);
+            }
+            for (size_t i = 0; i < other.values.size(); ++i) {
+                values[i] += other.values[i];
+                present[i] |= other.present[i];
+            }
+        }
+    };
+
+    static bool UseTopK(int limit) {
+        return limit > 0 && static_cast<size_t>(limit) <= kTopKCapacity;
+    }
+
+    // 各分片摘要中前 limit 名的并集。同一函数的分配按地址分散在各分片，
+    // 总量排在前 limit 的函数几乎总会进入某个分片的前 limit 名；最终名次按精确计数排出
+    std::vector<uint32_t> GetCandidates(SpaceSaving<uint32_t> Shard::*member, int limit) {
+        std::vector<uint32_t> candidates;
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            (shard.*member).GetTop(limit, &candidates);
+        }
+        std::sort(candidates.begin(), candidates.end());
+        candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+        return candidates;
+    }
+
+    // 按 value 从大到小取前 limit 个键，limit 不大于 0 时全部排序
+    static std::vector<uint32_t> SelectTop(const std::unordered_map<uint32_t, double>& values, int limit) {
+        std::vector<std::pair<double, uint32_t>> ranked;
+        ranked.reserve(values.size());
+        for (const auto& [id, value] : values) {
+            ranked.push_back({value, id});
+        }
+        return TakeTop(ranked, limit);
+    }
+
+    static std::vector<uint32_t> SelectTop(const DenseValues& values, int limit) {
+        std::vector<std::pair<double, uint32_t>> ranked;
+        for (size_t id = 0; id < values.values.size(); ++id) {
+            if (values.present[id]) {
+                ranked.push_back({values.values[id], static_cast<uint32_t>(id)});
+            }
+        }
+        return TakeTop(ranked, limit);
+    }
+
+    static std::vector<uint32_t> TakeTop(std::vector<std::pair<double, uint32_t>>& ranked, int limit) {
+        size_t count = limit > 0 ? std::min(ranked.size(), static_cast<size_t>(limit)) : ranked.size();
+        std::partial_sort(ranked.begin(), ranked.begin() + count, ranked.end(),
+            [](const auto& a, const auto& b) { return a.first > b.first; });
+
+        std::vector<uint32_t> ids;
+        ids.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            ids.push_back(ranked[i].second);
+        }
+        return ids;
+    }
+
+    // 函数排名：候选（摘要或全部函数）按精确计数排序取前 limit 名
+    std::vector<uint32_t> RankFunctions(FunctionRanking ranking, int limit) {
+        std::vector<uint32_t> candidates;
+        bool use_top_k = UseTopK(limit);
+        if (use_top_k) {
+            auto member = ranking == FunctionRanking::ALLOCATION_COUNT ? &Shard::top_function_counts
+                        : ranking == FunctionRanking::LIVE_BYTES     ? &Shard::top_function_live
+                                                                       : &Shard::top_function_bytes;
+            candidates = GetCandidates(member, limit);
+        }
+
+        auto metric = [ranking](const FunctionCounters& counters) {
+            return ranking == FunctionRanking::ALLOCATION_COUNT ? counters.estimated_count : counters.estimated_bytes;
+        };
+        // 未释放字节数跨分片共享，直接取精确值
+        auto live_bytes = [this](uint32_t id) {
+            return static_cast<double>(names_[id]->live_bytes.load(std::memory_order_relaxed));
+        };
+
+        if (!use_top_k) {
+            // 全部函数参与排名时按分片并行累加到以 ID 为下标的数组
+            DenseValues values = MapShards<DenseValues>(
+                [&](const Shard& shard, DenseValues* partial) {
+                    for (const auto& [id, counters] : shard.functions) {
+                        partial->Add(id, metric(counters));
+                    }
+                },
+                [](DenseValues* result, DenseValues&& partial) { result->Merge(partial); });
+            if (ranking == FunctionRanking::LIVE_BYTES) {
+                std::lock_guard<std::mutex> lock(names_mutex_);
+                for (size_t id = 0; id < values.values.size(); ++id) {
+                    if (values.present[id]) {
+                        values.values[id] = live_bytes(static_cast<uint32_t>(id));
+                    }
+                }
+            }
+            return SelectTop(values, limit);
+        }
+
+        std::unordered_map<uint32_t, double> values;
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (uint32_t id : candidates) {
+                auto it = shard.functions.find(id);
+                if (it != shard.functions.end()) {
+                    values[id] += metric(it->second);
+                }
+            }
+        }
+        if (ranking == FunctionRanking::LIVE_BYTES) {
+            std::lock_guard<std::mutex> lock(names_mutex_);
+            for (auto& [id, value] : values) {
+                value = live_bytes(id);
+            }
+        }
+        return SelectTop(values, limit);
+    }
+
+    // 分片按组并行执行 map(shard, &partial)（持有该分片的锁），再按分片顺序 merge(&result, partial)
+    template <typename Partial, typename Map, typename Merge>
+    Partial MapShards(Map map, Merge merge) {
+        return parallel::MapReduce<Partial>(kShardCount, 1,
+            [&](size_t begin, size_t end, Partial* partial) {
+                for (size_t i = begin; i < end; ++i) {
+                    std::lock_guard<std::mutex> lock(shards_[i].mutex);
+                    map(shards_[i], partial);
+                }
+            }, merge);
+    }
+
+    // 合并各分片中 ids 的计数，结果与 ids 一一对应。ids 按区间分给多个线程，
+    // 每个区间逐个分片加锁查找，各区间写入的结果互不重叠
+    template <typename Counters>
+    std::vector<Counters> MergeCounters(std::unordered_map<uint32_t, Counters> Shard::*member,
+                                        const std::vector<uint32_t>& ids) {
+        std::vector<Counters> merged(ids.size());
+        parallel::Executor& executor = parallel::Executor::GetInstance();
+        std::vector<parallel::Range> ranges = executor.Split(ids.size(), kMergeGrain);
+        executor.Run(ranges.size(), [&](size_t partition) {
+            const parallel::Range& range = ranges[partition];
+            for (auto& shard : shards_) {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                const auto& counters = shard.*member;
+                for (size_t i = range.begin; i < range.end; ++i) {
+                    auto it = counters.find(ids[i]);
+                    if (it != counters.end()) {
+                        merged[i].Merge(it->second);
+                    }
+                }
+            }
+        });
+        return merged;
+    }
+
+    Shard& GetShard(void* address) {
+        // 分配地址低位按对齐为 0，混合高位后取模
+        uint64_t key = reinterpret_cast<uintptr_t>(address);
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        return shards_[key & (kShardCount - 1)];
+    }
+
+    // 调用方持有 shard.mutex
+    NameEntry* InternName(Shard& shard, const std::string& name) {
+        auto cached = shard.name_cache.find(name);
+        if (cached != shard.name_cache.end()) {
+            return cached->second;
+        }
+
+        NameEntry* entry = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(names_mutex_);
+            auto it = name_ids_.find(name);
+            if (it != name_ids_.end()) {
+                entry = names_[it->second].get();
+            } else {
+                uint32_t id = static_cast<uint32_t>(names_.size());
+                names_.push_back(std::make_unique<NameEntry>(id, name));
+                name_ids_.emplace(name, id);
+                entry = names_.back().get();
+            }
+        }
+        shard.name_cache.emplace(name, entry);
+        return entry;
+    }
+
+    NameEntry* FindName(const std::string& name) {
+        std::lock_guard<std::mutex> lock(names_mutex_);
+        auto it = name_ids_.find(name);
+        return it != name_ids_.end() ? names_[it->second].get() : nullptr;
+    }
+
+    // 在 shards_ 中出现过的不同 ID 的个数
+    template <typename Map>
+    size_t CountNames(Map Shard::*member) {
+        std::unordered_set<uint32_t> ids;
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (const auto& entry : shard.*member) {
+                ids.insert(entry.first);
+            }
+        }
+        return ids.size();
+    }
+
+    static void AddLive(NameEntry* entry, int64_t bytes) {
+        int64_t current = entry->live_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        int64_t peak = entry->peak_bytes.load(std::memory_order_relaxed);
+        while (current > peak &&
+               !entry->peak_bytes.compare_exchange_weak(peak, current, std::memory_order_relaxed)) {
+        }
+    }
+
+    static size_t ClampLive(int64_t bytes) {
+        return bytes > 0 ? static_cast<size_t>(bytes) : 0;
+    }
+
+    static FunctionStats MakeFunctionStats(const NameEntry& entry, const FunctionCounters& counters) {
+        FunctionStats stats;
+        stats.function_name = entry.name;
+        stats.sampled_count = counters.sampled_count;
+        stats.estimated_count = counters.estimated_count;
+        stats.estimated_bytes = counters.estimated_bytes;
+        stats.allocation_count = RoundToSize(counters.estimated_count);
+        stats.total_allocated = RoundToSize(counters.estimated_bytes);
+        stats.current_allocated = ClampLive(entry.live_bytes.load(std::memory_order_relaxed));
+        stats.peak_allocated = ClampLive(entry.peak_bytes.load(std::memory_order_relaxed));
+        stats.avg_size = counters.estimated_count > 0 ? counters.estimated_bytes / counters.estimated_count : 0.0;
+        stats.size_histogram = counters.size_histogram;
+        return stats;
+    }
+
+    std::string BuildStackKey(capture::StackId stack_id) {
+        std::vector<std::string> stack_trace = capture::StackTable::GetInstance().Symbolize(stack_id);
         std::ostringstream oss;
         for (size_t i = 0; i < stack_trace.size() && i < 5; ++i) {
             if (i > 0) oss << " <- ";
@@ -262,6 +1092,77 @@ private:
         return oss.str();
     }
 
+    static size_t RoundToSize(double value) {
+        return value > 0 ? static_cast<size_t>(std::llround(value)) : 0;
+    }
+
+    static void FillBuckets(const SizeHistogram& histogram, std::vector<SizeBucketStats>& buckets) {
+        for (auto& bucket : buckets) {
+            double count = 0;
+            double bytes = 0;
+            histogram.Sum(bucket.min_size, bucket.max_size, &count, &bytes);
+            bucket.count = RoundToSize(count);
+            bucket.total_size = RoundToSize(bytes);
+        }
+    }
+
+    // 追踪器自身的计数、内存与热路径耗时
+    void AppendTracerOverhead(std::ostringstream& oss) {
+        using capture::TracerCounter;
+        capture::TracerStatsSnapshot tracer = capture::TracerStats::GetInstance().GetSnapshot();
+
+        oss << "\n--- Tracer Overhead ---\n";
+        oss << "Recorded Allocations: " << tracer.Get(TracerCounter::ALLOCATIONS_RECORDED) << "\n";
+        oss << "Recorded Frees: " << tracer.Get(TracerCounter::FREES_RECORDED) << "\n";
+        oss << "New Stacks: " << tracer.Get(TracerCounter::STACKS_INTERNED) << "\n";
+        oss << "Stack Cache Hits: " << tracer.Get(TracerCounter::STACK_CACHE_HITS) << "\n";
+        oss << "DWARF Unwinds: " << tracer.Get(TracerCounter::DWARF_UNWINDS) << " (cache hits "
+            << tracer.Get(TracerCounter::DWARF_CACHE_HITS) << ")\n";
+        oss << "Dropped Events: " << tracer.dropped_events << "\n";
+        oss << "Lock Contentions (capture/storage/stats): " << tracer.Get(TracerCounter::CAPTURE_LOCK_CONTENTIONS)
+            << " / " << tracer.Get(TracerCounter::STORAGE_LOCK_CONTENTIONS) << " / "
+            << tracer.Get(TracerCounter::STATS_LOCK_CONTENTIONS) << "\n";
+        oss << "Tracer Heap Allocations: " << tracer.Get(TracerCounter::TRACER_ALLOCATIONS) << ", "
+            << FormatSize(tracer.Get(TracerCounter::TRACER_ALLOCATED_BYTES)) << "\n";
+        oss << "Internal Arena: " << FormatSize(tracer.arena_used_bytes) << " used, "
+            << FormatSize(tracer.arena_reserved_bytes) << " reserved\n";
+
+        bool header = false;
+        for (size_t i = 0; i < capture::kTracerTimerCount; ++i) {
+            const capture::TracerTimerStats& timer = tracer.timers[i];
+            if (timer.count == 0) {
+                continue;
+            }
+            if (!header) {
+                oss << "Timing (calls, mean, p50/p99/max):\n";
+                header = true;
+            }
+            oss << "  " << std::left << std::setw(24) << capture::GetTracerTimerName(static_cast<capture::TracerTimer>(i))
+                << std::right << timer.count << ", " << FormatDuration(std::llround(timer.mean_ns)) << ", "
+                << FormatDuration(std::llround(timer.p50_ns)) << " / " << FormatDuration(std::llround(timer.p99_ns))
+                << " / " << FormatDuration(std::llround(timer.max_ns)) << "\n";
+        }
+    }
+
+    static std::string FormatDuration(uint64_t ns) {
+        std::ostringstream oss;
+        if (ns < 1000) {
+            oss << ns << " ns";
+        } else if (ns < 1000000) {
+            oss << std::fixed << std::setprecision(1) << ns / 1e3 << " us";
+        } else if (ns < 1000000000) {
+            oss << std::fixed << std::setprecision(1) << ns / 1e6 << " ms";
+        } else {
+            oss << std::fixed << std::setprecision(2) << ns / 1e9 << " s";
+        }
+        return oss.str();
+    }
+
+    std::string FormatQuantiles(const SizeHistogram& histogram) {
+        return FormatSize(histogram.GetQuantile(0.5)) + " / " + FormatSize(histogram.GetQuantile(0.99)) + " / " +
+               FormatSize(histogram.GetMax());
+    }
+
     std::string FormatSize(size_t size) {
         const char* units[] = {"B", "KB", "MB", "GB", "TB"};
         int unit = 0;
@@ -277,21 +1178,19 @@ private:
         return oss.str();
     }
 
-    std::map<std::string, FunctionStats> function_stats_;
-    std::map<std::string, FileStats> file_stats_;
-    std::map<std::string, size_t> call_stack_stats_;
+    Shard shards_[kShardCount];
 
-    struct AllocationTracking {
-        std::string function;
-        size_t size;
-        std::vector<std::string> stack_trace;
-    };
-    std::map<void*, AllocationTracking> allocation_tracking_;
+    // 名字表只在首次出现新名字时加锁；NameEntry 地址稳定，分片缓存直接保存指针
+    std::vector<std::unique_ptr<NameEntry>> names_;
+    std::unordered_map<std::string, uint32_t> name_ids_;
+    std::mutex names_mutex_;
 
-    size_t total_allocations_ = 0;
-    size_t total_memory_allocated_ = 0;
+    NameEntry total_live_{0, std::string()};   // 全部函数合计的未释放字节
+    std::atomic<size_t> sample_interval_{0};   // 最近一条记录的采样间隔
+    std::atomic<uint64_t> short_lived_threshold_ns_{kDefaultShortLivedThresholdNs};
 
-    mutable std::mutex mutex_;
+    static constexpr double kConfidenceZ = 1.96;
+    static constexpr uint64_t kDefaultShortLivedThresholdNs = 100000;   // 100 微秒
 };
 
 Stats::Stats() : pimpl_(std::make_unique<Impl>()) {}
@@ -302,27 +1201,60 @@ Stats& Stats::GetInstance() {
     return instance;
 }
 
-void Stats::Initialize() { pimpl_->Initialize(); }
-void Stats::Shutdown() { pimpl_->Shutdown(); }
-void Stats::AddAllocation(const capture::AllocationInfo& info) { pimpl_->AddAllocation(info); }
+void Stats::Initialize() { capture::TracerScope scope; pimpl_->Initialize(); }
+void Stats::Shutdown() { capture::TracerScope scope; pimpl_->Shutdown(); }
+void Stats::AddAllocation(const capture::AllocationInfo& info) { capture::TracerScope scope; pimpl_->AddAllocation(info); }
 void Stats::AddAllocations(const std::vector<capture::AllocationInfo>& allocations) {
+    capture::TracerScope scope;
     for (const auto& info : allocations) {
         pimpl_->AddAllocation(info);
     }
 }
-std::vector<FunctionStats> Stats::GetFunctionStats(int limit) { return pimpl_->GetFunctionStats(limit); }
+void Stats::RecordDeallocation(void* address) { capture::TracerScope scope; pimpl_->RecordDeallocation(address, 0); }
+void Stats::RecordDeallocation(void* address, uint64_t timestamp) {
+    capture::TracerScope scope;
+    pimpl_->RecordDeallocation(address, timestamp);
+}
+void Stats::AddEvents(const capture::CaptureEvent* events, size_t count) {
+    capture::TracerScope scope;
+    capture::ScopedTracerTimer timer(capture::TracerTimer::STATS_ADD_EVENTS);
+    for (size_t i = 0; i < count; ++i) {
+        if (events[i].type == capture::EventType::ALLOC) {
+            pimpl_->AddAllocation(capture::MakeAllocationInfo(events[i]));
+        } else {
+            pimpl_->RecordDeallocation(events[i].address, events[i].timestamp);
+        }
+    }
+}
+std::vector<FunctionStats> Stats::GetFunctionStats(int limit) { capture::TracerScope scope; return pimpl_->GetFunctionStats(limit); }
+std::vector<FunctionStats> Stats::GetTopFunctions(FunctionRanking ranking, int limit) {
+    capture::TracerScope scope;
+    return pimpl_->GetTopFunctions(ranking, limit);
+}
 FunctionStats Stats::GetFunctionStats(const std::string& function_name) {
+    capture::TracerScope scope;
     return pimpl_->GetFunctionStats(function_name);
 }
-std::vector<FileStats> Stats::GetFileStats(int limit) { return pimpl_->GetFileStats(limit); }
-std::vector<SizeBucketStats> Stats::GetSizeDistributionStats() { return pimpl_->GetSizeDistributionStats(); }
+std::vector<FileStats> Stats::GetFileStats(int limit) { capture::TracerScope scope; return pimpl_->GetFileStats(limit); }
+std::vector<SizeBucketStats> Stats::GetSizeDistributionStats() { capture::TracerScope scope; return pimpl_->GetSizeDistributionStats(); }
 std::vector<std::pair<std::string, size_t>> Stats::GetMemoryHotspots(int limit) {
+    capture::TracerScope scope;
     return pimpl_->GetMemoryHotspots(limit);
 }
-std::map<std::string, size_t> Stats::GetCallStackStats() { return pimpl_->GetCallStackStats(); }
-std::string Stats::GenerateReport() { return pimpl_->GenerateReport(); }
-std::string Stats::GetSummary() { return pimpl_->GetSummary(); }
-void Stats::Reset() { pimpl_->Reset(); }
+std::map<std::string, size_t> Stats::GetCallStackStats() { capture::TracerScope scope; return pimpl_->GetCallStackStats(); }
+std::unordered_map<capture::StackId, size_t> Stats::GetCallStackStatsById() { capture::TracerScope scope; return pimpl_->GetCallStackStatsById(); }
+std::vector<StackStats> Stats::GetStackStats() { capture::TracerScope scope; return pimpl_->GetStackStats(); }
+SamplingStats Stats::GetSamplingStats() { capture::TracerScope scope; return pimpl_->GetSamplingStats(); }
+SizeHistogram Stats::GetSizeHistogram() { capture::TracerScope scope; return pimpl_->GetSizeHistogram(); }
+void Stats::SetShortLivedThreshold(uint64_t threshold_ns) { pimpl_->SetShortLivedThreshold(threshold_ns); }
+uint64_t Stats::GetShortLivedThreshold() const { return pimpl_->GetShortLivedThreshold(); }
+std::vector<LifetimeStats> Stats::GetShortLivedSites(int limit) { capture::TracerScope scope; return pimpl_->GetShortLivedSites(limit); }
+LiveStats Stats::GetLiveStats() { capture::TracerScope scope; return pimpl_->GetLiveStats(); }
+MetricsSnapshot Stats::GetMetricsSnapshot() const { capture::TracerScope scope; return pimpl_->GetMetricsSnapshot(); }
+std::vector<TimelinePoint> Stats::GetTimeline(uint64_t bucket_size_ns) { capture::TracerScope scope; return pimpl_->GetTimeline(bucket_size_ns); }
+std::string Stats::GenerateReport() { capture::TracerScope scope; return pimpl_->GenerateReport(); }
+std::string Stats::GetSummary() { capture::TracerScope scope; return pimpl_->GetSummary(); }
+void Stats::Reset() { capture::TracerScope scope; pimpl_->Reset(); }
 
 } // namespace stats
 } // namespace memory_tracer
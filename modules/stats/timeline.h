@@ -0,0 +1,132 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace memory_tracer {
+namespace stats {
+
+// 一个时间桶内的分配与释放，字节数为采样加权后取整的值
+struct TimelineBucket {
+    uint64_t index = UINT64_MAX;    // 时间戳 / 分辨率，UINT64_MAX 表示空槽
+    double allocation_count = 0;
+    double free_count = 0;
+    int64_t allocated_bytes = 0;
+    int64_t freed_bytes = 0;
+
+    void Add(const TimelineBucket& other) {
+        allocation_count += other.allocation_count;
+        free_count += other.free_count;
+        allocated_bytes += other.allocated_bytes;
+        freed_bytes += other.freed_bytes;
+    }
+};
+
+// 多分辨率时间序列：每一级是固定容量的环形桶，新桶覆盖最旧的桶，内存有上界，写入 O(级数)。
+// 桶内只记增量，某一时刻的未释放字节数由当前值减去之后各桶的净增量倒推，因此读取为 O(桶数)。
+// 调用方负责加锁
+class TimelineSeries {
+public:
+    struct Level {
+        uint64_t resolution_ns;
+        size_t capacity;
+    };
+
+    // 1 秒保留 10 分钟、1 分钟保留 1 天、1 小时保留 30 天
+    static constexpr size_t kLevelCount = 3;
+    static constexpr Level kLevels[kLevelCount] = {
+        {1000000000ULL, 600},
+        {60000000000ULL, 1440},
+        {3600000000000ULL, 720},
+    };
+
+    // 不超过 bucket_size_ns 的最粗一级，都超过时取最细一级
+    static size_t SelectLevel(uint64_t bucket_size_ns) {
+        size_t level = 0;
+        for (size_t i = 1; i < kLevelCount; ++i) {
+            if (kLevels[i].resolution_ns <= bucket_size_ns) {
+                level = i;
+            }
+        }
+        return level;
+    }
+
+    // timestamp 为 0 时记入最近的桶
+    void RecordAllocation(uint64_t timestamp, double weight, int64_t bytes) {
+        TimelineBucket delta;
+        delta.allocation_count = weight;
+        delta.allocated_bytes = bytes;
+        Record(timestamp, delta);
+        live_bytes_ += bytes;
+    }
+
+    void RecordFree(uint64_t timestamp, double weight, int64_t bytes) {
+        TimelineBucket delta;
+        delta.free_count = weight;
+        delta.freed_bytes = bytes;
+        Record(timestamp, delta);
+        live_bytes_ -= bytes;
+    }
+
+    int64_t GetLiveBytes() const { return live_bytes_; }
+
+    // 该级最新的桶序号，没有数据时返回 UINT64_MAX
+    uint64_t GetLatestIndex(size_t level) const {
+        return levels_[level].empty() ? UINT64_MAX : latest_index_[level];
+    }
+
+    // 把 [first, first + out->size()) 范围内的桶累加到 out
+    void AddTo(size_t level, uint64_t first, std::vector<TimelineBucket>* out) const {
+        for (const auto& bucket : levels_[level]) {
+            if (bucket.index != UINT64_MAX && bucket.index >= first && bucket.index - first < out->size()) {
+                (*out)[bucket.index - first].Add(bucket);
+            }
+        }
+    }
+
+    void Clear() {
+        for (size_t i = 0; i < kLevelCount; ++i) {
+            levels_[i].clear();
+            latest_index_[i] = 0;
+        }
+        latest_timestamp_ = 0;
+        live_bytes_ = 0;
+    }
+
+private:
+    void Record(uint64_t timestamp, const TimelineBucket& delta) {
+        if (timestamp == 0) {
+            timestamp = latest_timestamp_;
+        }
+        latest_timestamp_ = std::max(latest_timestamp_, timestamp);
+
+        for (size_t i = 0; i < kLevelCount; ++i) {
+            auto& buckets = levels_[i];
+            if (buckets.empty()) {
+                buckets.resize(kLevels[i].capacity);   // 首次写入时才分配
+            }
+            uint64_t index = timestamp / kLevels[i].resolution_ns;
+            TimelineBucket& bucket = buckets[index % buckets.size()];
+            if (bucket.index != index) {
+                // 槽位已被更新的桶占用：事件早于该级的保留窗口，只计入更粗的级
+                if (bucket.index != UINT64_MAX && bucket.index > index) {
+                    continue;
+                }
+                bucket = TimelineBucket();
+                bucket.index = index;
+            }
+            bucket.Add(delta);
+            latest_index_[i] = std::max(latest_index_[i], index);
+        }
+    }
+
+    std::vector<TimelineBucket> levels_[kLevelCount];
+    uint64_t latest_index_[kLevelCount] = {};
+    uint64_t latest_timestamp_ = 0;
+    int64_t live_bytes_ = 0;
+};
+
+} // namespace stats
+} // namespace memory_tracer
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace memory_tracer {
+namespace stats {
+
+// Space-Saving 重击者摘要：最多监控 capacity 个键，键表满时新键顶替计数最小的键并继承其计数，
+// 因此计数只会高估。计数超过总量 1/capacity 的键一定在摘要中。
+// 更新为 O(log capacity)，与出现过的不同键个数无关；调用方负责加锁
+template <typename Key>
+class SpaceSaving {
+public:
+    explicit SpaceSaving(size_t capacity) : capacity_(capacity) {}
+
+    void Add(const Key& key, double weight) {
+        auto it = positions_.find(key);
+        if (it != positions_.end()) {
+            heap_[it->second].count += weight;
+            SiftDown(it->second);
+            return;
+        }
+        if (heap_.size() < capacity_) {
+            heap_.push_back({key, weight});
+            positions_[key] = heap_.size() - 1;
+            SiftUp(heap_.size() - 1);
+            return;
+        }
+        if (capacity_ == 0) {
+            return;
+        }
+
+        // 顶替计数最小的键
+        positions_.erase(heap_[0].key);
+        heap_[0].key = key;
+        heap_[0].count += weight;
+        positions_[key] = 0;
+        SiftDown(0);
+    }
+
+    // 只作用于仍在监控中的键（如释放后的未释放字节数），计数不低于 0
+    void Subtract(const Key& key, double weight) {
+        auto it = positions_.find(key);
+        if (it == positions_.end()) {
+            return;
+        }
+        Entry& entry = heap_[it->second];
+        entry.count = entry.count > weight ? entry.count - weight : 0;
+        SiftUp(it->second);
+    }
+
+    // 按计数从大到小追加前 limit 个键
+    void GetTop(size_t limit, std::vector<Key>* keys) const {
+        std::vector<const Entry*> entries;
+        entries.reserve(heap_.size());
+        for (const auto& entry : heap_) {
+            entries.push_back(&entry);
+        }
+        limit = std::min(limit, entries.size());
+        std::partial_sort(entries.begin(), entries.begin() + limit, entries.end(),
+            [](const Entry* a, const Entry* b) { return a->count > b->count; });
+        for (size_t i = 0; i < limit; ++i) {
+            keys->push_back(entries[i]->key);
+        }
+    }
+
+    size_t Size() const { return heap_.size(); }
+
+    void Clear() {
+        heap_.clear();
+        positions_.clear();
+    }
+
+private:
+    struct Entry {
+        Key key;
+        double count;
+    };
+
+    // heap_ 为按 count 排列的最小堆，positions_ 记录每个键在堆中的下标
+    void SiftUp(size_t index) {
+        while (index > 0) {
+            size_t parent = (index - 1) / 2;
+            if (heap_[parent].count <= heap_[index].count) {
+                break;
+            }
+            Swap(parent, index);
+            index = parent;
+        }
+    }
+
+    void SiftDown(size_t index) {
+        while (true) {
+            size_t smallest = index;
+            size_t left = index * 2 + 1;
+            size_t right = left + 1;
+            if (left < heap_.size() && heap_[left].count < heap_[smallest].count) {
+                smallest = left;
+            }
+            if (right < heap_.size() && heap_[right].count < heap_[smallest].count) {
+                smallest = right;
+            }
+            if (smallest == index) {
+                break;
+            }
+            Swap(smallest, index);
+            index = smallest;
+        }
+    }
+
+    void Swap(size_t a, size_t b) {
+        std::swap(heap_[a], heap_[b]);
+        positions_[heap_[a].key] = a;
+        positions_[heap_[b].key] = b;
+    }
+
+    size_t capacity_;
+    std::vector<Entry> heap_;
+    std::unordered_map<Key, size_t> positions_;
+};
+
+} // namespace stats
+} // namespace memory_tracer
@@ -0,0 +1,253 @@
+#include "column_store.h"
+#include <algorithm>
+#include <vector>
+
+namespace memory_tracer {
+namespace storage {
+
+void ColumnRecordStore::AppendRecord(RecordHandle handle, const capture::AllocationInfo& info) {
+    if (chunks_.empty() || handle - chunks_.back()->base == kChunkSize) {
+        // 值初始化，未写入的槽位和释放位图均为零
+        std::shared_ptr<Chunk> chunk(new Chunk());
+        chunk->base = handle;
+        chunks_.push_back(std::move(chunk));
+    }
+
+    // 追加只写入新的槽位，快照不会读取到
+    Chunk& chunk = *chunks_.back();
+    size_t i = static_cast<size_t>(handle - chunk.base);
+    chunk.timestamps[i] = info.timestamp;
+    chunk.sizes[i] = info.size;
+    chunk.addresses[i] = reinterpret_cast<uintptr_t>(info.address);
+    chunk.stack_ids[i] = info.stack_id;
+    chunk.thread_ids[i] = info.thread_id;
+    chunk.function_ids[i] = strings_->Intern(info.function);
+    chunk.file_ids[i] = strings_->Intern(info.file);
+    chunk.lines[i] = info.line;
+    chunk.sample_intervals[i] = info.sample_interval;
+    chunk.kinds[i] = static_cast<uint8_t>(info.kind);
+    if (info.address == nullptr) {
+        chunk.freed[i / kWordBits] |= uint64_t(1) << (i % kWordBits);
+    }
+}
+
+void ColumnRecordStore::PopFront(RecordHandle handle) {
+    const Chunk& chunk = *chunks_.front();
+    size_t i = static_cast<size_t>(handle - chunk.base);
+    NotifyEvict(handle, {
+        strings_->Get(chunk.function_ids[i]),
+        strings_->Get(chunk.file_ids[i]),
+        chunk.stack_ids[i],
+        IsFreed(chunk, i) ? nullptr : reinterpret_cast<void*>(static_cast<uintptr_t>(chunk.addresses[i])),
+        chunk.timestamps[i],
+        chunk.sizes[i],
+        chunk.thread_ids[i]
+    });
+
+    if (i + 1 == kChunkSize) {
+        chunks_.pop_front();
+    }
+}
+
+void ColumnRecordStore::ClearRecords() {
+    chunks_.clear();
+    strings_ = std::make_shared<StringTable>();
+}
+
+std::unique_ptr<RecordStore> ColumnRecordStore::Snapshot() const {
+    std::unique_ptr<ColumnRecordStore> snapshot(new ColumnRecordStore(capacity_, strings_));
+    snapshot->first_ = first_;
+    snapshot->next_ = next_;
+    snapshot->chunks_ = chunks_;
+    return snapshot;
+}
+
+std::unique_ptr<RecordStore> ColumnRecordStore::Slice(RecordHandle begin, RecordHandle end) const {
+    std::unique_ptr<ColumnRecordStore> slice(new ColumnRecordStore(capacity_, strings_));
+    slice->first_ = std::max(begin, first_);
+    slice->next_ = std::max(slice->first_, std::min(end, next_));
+    for (const auto& chunk : chunks_) {
+        if (chunk->base < slice->next_ && chunk->base + kChunkSize > slice->first_) {
+            slice->chunks_.push_back(chunk);
+        }
+    }
+    return slice;
+}
+
+bool ColumnRecordStore::Locate(RecordHandle handle, size_t* chunk_index, size_t* index) const {
+    if (!Contains(handle)) {
+        return false;
+    }
+    size_t offset = static_cast<size_t>(handle - chunks_.front()->base);
+    *chunk_index = offset / kChunkSize;
+    *index = offset % kChunkSize;
+    return true;
+}
+
+void ColumnRecordStore::MakeView(const Chunk& chunk, size_t i, RecordView* view) const {
+    view->handle = chunk.base + i;
+    view->timestamp = chunk.timestamps[i];
+    view->address = IsFreed(chunk, i) ? nullptr : reinterpret_cast<void*>(static_cast<uintptr_t>(chunk.addresses[i]));
+    view->size = chunk.sizes[i];
+    view->function = strings_->Get(chunk.function_ids[i]);
+    view->file = strings_->Get(chunk.file_ids[i]);
+    view->line = chunk.lines[i];
+    view->thread_id = chunk.thread_ids[i];
+    view->stack_id = chunk.stack_ids[i];
+    view->kind = static_cast<capture::AllocationKind>(chunk.kinds[i]);
+    view->sample_interval = chunk.sample_intervals[i];
+}
+
+bool ColumnRecordStore::View(RecordHandle handle, RecordView* view) const {
+    size_t chunk_index = 0;
+    size_t i = 0;
+    if (!Locate(handle, &chunk_index, &i)) return false;
+    if (view) MakeView(*chunks_[chunk_index], i, view);
+    return true;
+}
+
+size_t ColumnRecordStore::GetRecordSize(RecordHandle handle) const {
+    size_t chunk_index = 0;
+    size_t i = 0;
+    return Locate(handle, &chunk_index, &i) ? chunks_[chunk_index]->sizes[i] : 0;
+}
+
+bool ColumnRecordStore::MarkFreed(RecordHandle handle) {
+    size_t chunk_index = 0;
+    size_t i = 0;
+    if (!Locate(handle, &chunk_index, &i)) return false;
+
+    auto& chunk = chunks_[chunk_index];
+    if (chunk.use_count() > 1) {
+        // 快照仍在读取该块，复制后再修改
+        chunk = std::shared_ptr<Chunk>(new Chunk(*chunk));
+    }
+    chunk->freed[i / kWordBits] |= uint64_t(1) << (i % kWordBits);
+    return true;
+}
+
+void ColumnRecordStore::VisitAll(const RecordVisitor& visitor) const {
+    ScanWords([&](const Chunk& chunk, size_t word, uint64_t range) {
+        return EmitMatches(chunk, word, range, visitor);
+    });
+}
+
+uint64_t ColumnRecordStore::RangeMask(size_t word, size_t begin, size_t end) {
+    size_t lo = std::max(begin, word * kWordBits) - word * kWordBits;
+    size_t hi = std::min(end, (word + 1) * kWordBits) - word * kWordBits;
+    uint64_t upper = hi == kWordBits ? ~uint64_t(0) : (uint64_t(1) << hi) - 1;
+    uint64_t lower = (uint64_t(1) << lo) - 1;
+    return upper & ~lower;
+}
+
+void ColumnRecordStore::VisitSizeRange(size_t min_size, size_t max_size, const RecordVisitor& visitor) const {
+    if (min_size > max_size) {
+        return;
+    }
+    // 无符号减法把区间判断合并为一次比较
+    uint64_t span = max_size - min_size;
+    ScanWords([&](const Chunk& chunk, size_t word, uint64_t range) {
+        const uint64_t* sizes = chunk.sizes + word * kWordBits;
+        uint64_t mask = 0;
+        for (size_t j = 0; j < kWordBits; ++j) {
+            mask |= uint64_t(sizes[j] - min_size <= span) << j;
+        }
+        return EmitMatches(chunk, word, mask & range & ~chunk.freed[word], visitor);
+    });
+}
+
+void ColumnRecordStore::VisitTimeRange(uint64_t start_time, uint64_t end_time, const RecordVisitor& visitor) const {
+    if (start_time > end_time) {
+        return;
+    }
+    uint64_t span = end_time - start_time;
+    ScanWords([&](const Chunk& chunk, size_t word, uint64_t range) {
+        const uint64_t* timestamps = chunk.timestamps + word * kWordBits;
+        uint64_t mask = 0;
+        for (size_t j = 0; j < kWordBits; ++j) {
+            mask |= uint64_t(timestamps[j] - start_time <= span) << j;
+        }
+        return EmitMatches(chunk, word, mask & range, visitor);
+    });
+}
+
+void ColumnRecordStore::VisitLive(const RecordVisitor& visitor) const {
+    ScanWords([&](const Chunk& chunk, size_t word, uint64_t range) {
+        return EmitMatches(chunk, word, range & ~chunk.freed[word], visitor);
+    });
+}
+
+uint64_t ColumnRecordStore::GetMinTimestamp() const {
+    uint64_t min_time = UINT64_MAX;
+    ScanWords([&](const Chunk& chunk, size_t word, uint64_t range) {
+        const uint64_t* timestamps = chunk.timestamps + word * kWordBits;
+        for (size_t j = 0; j < kWordBits; ++j) {
+            if ((range >> j) & 1) {
+                min_time = std::min(min_time, timestamps[j]);
+            }
+        }
+        return true;
+    });
+    return min_time;
+}
+
+std::map<uint64_t, size_t> ColumnRecordStore::BuildTimeline(uint64_t bucket_size_ns, uint64_t origin) const {
+    std::map<uint64_t, size_t> timeline;
+    if (Empty() || bucket_size_ns == 0) {
+        return timeline;
+    }
+
+    uint64_t min_time = UINT64_MAX;
+    uint64_t max_time = 0;
+    ScanWords([&](const Chunk& chunk, size_t word, uint64_t range) {
+        const uint64_t* timestamps = chunk.timestamps + word * kWordBits;
+        for (size_t j = 0; j < kWordBits; ++j) {
+            if ((range >> j) & 1) {
+                min_time = std::min(min_time, timestamps[j]);
+                max_time = std::max(max_time, timestamps[j]);
+            }
+        }
+        return true;
+    });
+    if (max_time < origin) {
+        return timeline;
+    }
+    min_time = std::max(min_time, origin);
+
+    // 桶数有限时先累加到连续数组，避免每条记录一次 map 查找；数组从本存储最早的桶开始
+    constexpr uint64_t kMaxDenseBuckets = 1 << 20;
+    uint64_t first_bucket = (min_time - origin) / bucket_size_ns;
+    uint64_t bucket_count = (max_time - origin) / bucket_size_ns - first_bucket + 1;
+    std::vector<size_t> dense;
+    if (bucket_count <= kMaxDenseBuckets) {
+        dense.assign(bucket_count, 0);
+    }
+
+    ScanWords([&](const Chunk& chunk, size_t word, uint64_t range) {
+        uint64_t live = range & ~chunk.freed[word];
+        while (live) {
+            size_t j = word * kWordBits + static_cast<size_t>(__builtin_ctzll(live));
+            live &= live - 1;
+            if (chunk.timestamps[j] < origin) {
+                continue;
+            }
+            uint64_t bucket = (chunk.timestamps[j] - origin) / bucket_size_ns;
+            if (!dense.empty()) {
+                dense[bucket - first_bucket] += chunk.sizes[j];
+            } else {
+                timeline[bucket * bucket_size_ns + origin] += chunk.sizes[j];
+            }
+        }
+        return true;
+    });
+
+    for (size_t i = 0; i < dense.size(); ++i) {
+        if (dense[i]) {
+            timeline[(first_bucket + i) * bucket_size_ns + origin] = dense[i];
+        }
+    }
+    return timeline;
+}
+
+} // namespace storage
+} // namespace memory_tracer
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+
+#include "record_store.h"
+#include "string_table.h"
+
+namespace memory_tracer {
+namespace storage {
+
+// 列式布局：每个块按字段分别保存定长数组，函数名/文件名驻留为 ID，
+// 释放状态保存在位图中。范围扫描只读取相关的列，每次处理 64 条记录生成匹配位掩码
+class ColumnRecordStore : public RecordStore {
+public:
+    explicit ColumnRecordStore(size_t capacity)
+        : RecordStore(capacity), strings_(std::make_shared<StringTable>()) {}
+
+    StorageLayout GetLayout() const override { return StorageLayout::COLUMNAR; }
+    std::unique_ptr<RecordStore> Snapshot() const override;
+    std::unique_ptr<RecordStore> Slice(RecordHandle begin, RecordHandle end) const override;
+    bool View(RecordHandle handle, RecordView* view) const override;
+    size_t GetRecordSize(RecordHandle handle) const override;
+    bool MarkFreed(RecordHandle handle) override;
+    void VisitAll(const RecordVisitor& visitor) const override;
+    void VisitSizeRange(size_t min_size, size_t max_size, const RecordVisitor& visitor) const override;
+    void VisitTimeRange(uint64_t start_time, uint64_t end_time, const RecordVisitor& visitor) const override;
+    void VisitLive(const RecordVisitor& visitor) const override;
+    uint64_t GetMinTimestamp() const override;
+    using RecordStore::BuildTimeline;
+    std::map<uint64_t, size_t> BuildTimeline(uint64_t bucket_size_ns, uint64_t origin) const override;
+
+protected:
+    void AppendRecord(RecordHandle handle, const capture::AllocationInfo& info) override;
+    void PopFront(RecordHandle handle) override;
+    void ClearRecords() override;
+
+private:
+    // 快照与源存储共享字符串表
+    ColumnRecordStore(size_t capacity, std::shared_ptr<StringTable> strings)
+        : RecordStore(capacity), strings_(std::move(strings)) {}
+
+    static constexpr size_t kWordBits = 64;
+    static constexpr size_t kWordCount = kChunkSize / kWordBits;
+
+    struct Chunk {
+        RecordHandle base;   // 块内第一条记录的序号
+        uint64_t timestamps[kChunkSize];
+        uint64_t sizes[kChunkSize];
+        uint64_t addresses[kChunkSize];   // 分配时的地址，释放后保留
+        uint64_t stack_ids[kChunkSize];
+        uint32_t thread_ids[kChunkSize];
+        uint32_t function_ids[kChunkSize];
+        uint32_t file_ids[kChunkSize];
+        int32_t lines[kChunkSize];
+        uint32_t sample_intervals[kChunkSize];
+        uint8_t kinds[kChunkSize];
+        uint64_t freed[kWordCount];       // 已释放位图
+    };
+
+    bool Locate(RecordHandle handle, size_t* chunk_index, size_t* index) const;
+
+    bool IsFreed(const Chunk& chunk, size_t index) const {
+        return (chunk.freed[index / kWordBits] >> (index % kWordBits)) & 1;
+    }
+
+    void MakeView(const Chunk& chunk, size_t index, RecordView* view) const;
+
+    // 块内 [begin, end) 与第 word 个 64 位字重叠部分的位掩码
+    static uint64_t RangeMask(size_t word, size_t begin, size_t end);
+
+    // 对每个块的有效区间按 64 条一组调用 match(chunk, word, range_mask)，返回 false 时停止
+    template <typename Match>
+    void ScanWords(Match match) const {
+        for (const auto& chunk_ptr : chunks_) {
+            const Chunk& chunk = *chunk_ptr;
+            size_t begin = 0;
+            size_t end = 0;
+            GetChunkRange(chunk.base, &begin, &end);
+            for (size_t word = begin / kWordBits; word * kWordBits < end; ++word) {
+                if (!match(chunk, word, RangeMask(word, begin, end))) return;
+            }
+        }
+    }
+
+    // 对 mask 中每个置位的记录构造视图并回调，返回 visitor 是否要求继续
+    bool EmitMatches(const Chunk& chunk, size_t word, uint64_t mask, const RecordVisitor& visitor) const {
+        RecordView view;
+        while (mask) {
+            size_t index = word * kWordBits + static_cast<size_t>(__builtin_ctzll(mask));
+            MakeView(chunk, index, &view);
+            if (!visitor(view)) return false;
+            mask &= mask - 1;
+        }
+        return true;
+    }
+
+    std::deque<std::shared_ptr<Chunk>> chunks_;
+    std::shared_ptr<StringTable> strings_;  // 与快照共享，清空时换新表而不是原地清空
+};
+
+} // namespace storage
+} // namespace memory_tracer
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "storage/storage.h"
+
+namespace memory_tracer {
+namespace storage {
+
+// 按调用栈聚合的未释放内存，随分配与释放增量维护。count/bytes 为按采样权重还原的估计值，
+// 释放时减去分配时加上的同一数值
+// 调用栈按 ID 分到固定数量的桶中，每个桶由 shared_ptr 持有：Snapshot 只复制桶指针，
+// 之后写入方修改仍被快照引用的桶时先复制该桶（写时复制），快照本身不再改变。
+// 两个快照之间没有变化的桶是同一个对象，对比时直接跳过。调用方负责加锁
+class HeapProfile {
+public:
+    HeapProfile() : buckets_(kBucketCount), total_count_(0), total_bytes_(0), stack_count_(0) {}
+
+    void Add(uint64_t stack_id, uint64_t count, uint64_t bytes) {
+        StackUsage& usage = GetMutableBucket(stack_id)[stack_id];
+        if (usage.count == 0) {
+            stack_count_++;
+        }
+        usage.stack_id = stack_id;
+        usage.count += count;
+        usage.bytes += bytes;
+        total_count_ += count;
+        total_bytes_ += bytes;
+    }
+
+    void Remove(uint64_t stack_id, uint64_t count, uint64_t bytes) {
+        auto& bucket = buckets_[GetBucketIndex(stack_id)];
+        if (!bucket || bucket->find(stack_id) == bucket->end()) {
+            return;
+        }
+        Bucket& mutable_bucket = GetMutableBucket(stack_id);
+        auto it = mutable_bucket.find(stack_id);
+        StackUsage& usage = it->second;
+        usage.count -= count < usage.count ? count : usage.count;
+        usage.bytes -= bytes < usage.bytes ? bytes : usage.bytes;
+        if (usage.count == 0) {
+            mutable_bucket.erase(it);
+            stack_count_--;
+        }
+        total_count_ -= count < total_count_ ? count : total_count_;
+        total_bytes_ -= bytes < total_bytes_ ? bytes : total_bytes_;
+    }
+
+    // 与当前内容相同的只读副本，复制代价与桶数成正比，与调用栈和记录数无关
+    HeapProfile Snapshot() const { return *this; }
+
+    void Clear() {
+        for (auto& bucket : buckets_) {
+            bucket.reset();
+        }
+        total_count_ = 0;
+        total_bytes_ = 0;
+        stack_count_ = 0;
+    }
+
+    uint64_t GetTotalCount() const { return total_count_; }
+    uint64_t GetTotalBytes() const { return total_bytes_; }
+    size_t GetStackCount() const { return stack_count_; }
+
+    // 不存在时返回全 0
+    StackUsage Find(uint64_t stack_id) const {
+        const auto& bucket = buckets_[GetBucketIndex(stack_id)];
+        if (bucket) {
+            auto it = bucket->find(stack_id);
+            if (it != bucket->end()) {
+                return it->second;
+            }
+        }
+        return StackUsage();
+    }
+
+    template <typename Func>
+    void ForEach(Func func) const {
+        for (const auto& bucket : buckets_) {
+            if (bucket) {
+                for (const auto& [stack_id, usage] : *bucket) {
+                    func(usage);
+                }
+            }
+        }
+    }
+
+    // 对 from 到 to 之间有变化的调用栈回调 func(stack_id, from_usage, to_usage)，
+    // 不存在的一侧为全 0
+    template <typename Func>
+    static void Diff(const HeapProfile& from, const HeapProfile& to, Func func) {
+        static const Bucket kEmpty;
+        for (size_t i = 0; i < kBucketCount; ++i) {
+            if (from.buckets_[i] == to.buckets_[i]) {
+                continue;
+            }
+            const Bucket& before = from.buckets_[i] ? *from.buckets_[i] : kEmpty;
+            const Bucket& after = to.buckets_[i] ? *to.buckets_[i] : kEmpty;
+            for (const auto& [stack_id, usage] : after) {
+                auto it = before.find(stack_id);
+                StackUsage old_usage = it != before.end() ? it->second : StackUsage();
+                if (old_usage.count != usage.count || old_usage.bytes != usage.bytes) {
+                    func(stack_id, old_usage, usage);
+                }
+            }
+            for (const auto& [stack_id, usage] : before) {
+                if (after.find(stack_id) == after.end()) {
+                    func(stack_id, usage, StackUsage());
+                }
+            }
+        }
+    }
+
+private:
+    using Bucket = std::unordered_map<uint64_t, StackUsage>;
+
+    static constexpr size_t kBucketCount = 256;
+
+    static size_t GetBucketIndex(uint64_t stack_id) {
+        return (stack_id * 0x9e3779b97f4a7c15ULL) >> 56;
+    }
+
+    Bucket& GetMutableBucket(uint64_t stack_id) {
+        auto& bucket = buckets_[GetBucketIndex(stack_id)];
+        if (!bucket) {
+            bucket = std::make_shared<Bucket>();
+        } else if (bucket.use_count() > 1) {
+            bucket = std::make_shared<Bucket>(*bucket);
+        }
+        return *bucket;
+    }
+
+    std::vector<std::shared_ptr<Bucket>> buckets_;
+    uint64_t total_count_;
+    uint64_t total_bytes_;
+    size_t stack_count_;
+};
+
+} // namespace storage
+} // namespace memory_tracer
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
 #include <functional>
@@ -13,6 +14,16 @@ namespace storage {
 
 using json = nlohmann::json;
 
+// 记录句柄：单调递增的序号，记录被淘汰后句柄失效但不会被复用
+using RecordHandle = uint64_t;
+constexpr RecordHandle kInvalidRecordHandle = UINT64_MAX;
+
+// 记录的存储布局
+enum class StorageLayout {
+    ROW,       // 每条记录完整保存（默认）
+    COLUMNAR   // 按字段分列保存，字符串驻留为 ID，适合大范围扫描与时间线统计
+};
+
 struct QueryResult {
     std::vector<capture::AllocationInfo> allocations;
     size_t total_count;
@@ -22,6 +33,82 @@ struct QueryResult {
     QueryResult() : total_count(0), total_size(0), peak_usage(0) {}
 };
 
+// 只读记录视图：字段直接引用存储中的数据，只在访问回调内有效
+struct RecordView {
+    RecordHandle handle;
+    uint64_t timestamp;
+    void* address;                   // 已释放的记录为 nullptr
+    size_t size;
+    std::string_view function;
+    std::string_view file;
+    int line;
+    uint32_t thread_id;
+    uint64_t stack_id;
+    capture::AllocationKind kind;
+    uint32_t sample_interval;
+
+    // 需要在回调之外保留时复制为完整记录
+    capture::AllocationInfo ToAllocationInfo() const;
+};
+
+// 查询的聚合结果，无需构造结果集即可得到
+struct QueryAggregate {
+    size_t total_count;
+    size_t total_size;   // 只统计未释放的记录
+    size_t peak_usage;   // 单条记录的最大大小
+
+    QueryAggregate() : total_count(0), total_size(0), peak_usage(0) {}
+};
+
+// 记录访问回调，返回 false 提前结束遍历
+using RecordVisitor = std::function<bool(const RecordView&)>;
+
+// 一个调用栈上未释放的分配，count/bytes 为按采样权重还原的估计值（未采样时即为实际值）
+struct StackUsage {
+    uint64_t stack_id;
+    uint64_t count;
+    uint64_t bytes;
+
+    StackUsage() : stack_id(0), count(0), bytes(0) {}
+};
+
+// 两个堆快照之间某个调用栈的变化，count/bytes 为后一个快照中的值
+struct StackGrowth {
+    uint64_t stack_id;
+    int64_t count_delta;
+    int64_t bytes_delta;
+    uint64_t count;
+    uint64_t bytes;
+
+    StackGrowth() : stack_id(0), count_delta(0), bytes_delta(0), count(0), bytes(0) {}
+};
+
+// 开启采样时 live_count/live_bytes 与各调用栈的用量都是按 capture::GetSampleWeight 还原的估计值，
+// 与 Stats 的口径一致：小对象的每条采样记录代表更多次分配
+struct HeapSnapshotInfo {
+    uint64_t id;
+    std::string label;
+    uint64_t timestamp;      // 纳秒时间戳，与分配记录的时钟相同
+    uint64_t live_count;     // 未释放的分配数（估计值）
+    uint64_t live_bytes;     // 未释放的字节数（估计值）
+    size_t stack_count;      // 有未释放分配的调用栈数
+
+    HeapSnapshotInfo() : id(0), timestamp(0), live_count(0), live_bytes(0), stack_count(0) {}
+};
+
+// 后台分段写入的配置，分段文件写在数据目录下
+struct SegmentOptions {
+    uint64_t max_segment_bytes;     // 单个分段的大小上限
+    uint64_t max_segment_seconds;   // 单个分段的时长上限，0 表示不按时长滚动
+    uint64_t flush_interval_ms;     // 写出并刷新到文件的周期
+    size_t max_segments;            // 保留的分段数，0 表示全部保留
+    bool retain_records;            // 为 false 时 AddEvents 只写分段，不再保存到内存中的记录
+
+    SegmentOptions()
+        : max_segment_bytes(64ULL << 20), max_segment_seconds(600), flush_interval_ms(1000), max_segments(0),
+          retain_records(true) {}
+};
+
 class Storage {
 public:
     static Storage& GetInstance();
@@ -32,27 +119,57 @@ public:
     // 关闭存储模块
     void Shutdown();
 
-    // 添加内存分配记录
-    void AddAllocation(const capture::AllocationInfo& info);
+    // 添加内存分配记录，返回其句柄（存储上限为 0 时返回 kInvalidRecordHandle）
+    RecordHandle AddAllocation(const capture::AllocationInfo& info);
+
+    // 按句柄读取记录，已被淘汰时返回 false
+    bool GetRecord(RecordHandle handle, capture::AllocationInfo* info);
 
     // 批量添加内存分配记录
     void AddAllocations(const std::vector<capture::AllocationInfo>& allocations);
 
+    // 写入捕获事件流（分配事件新增记录，释放事件标记对应记录为已释放）
+    void AddEvents(const capture::CaptureEvent* events, size_t count);
+
+    // 将地址对应的记录标记为已释放
+    void RecordDeallocation(void* address);
+
     // 根据函数名查询
     QueryResult QueryByFunction(const std::string& function_name);
 
     // 根据文件名查询
     QueryResult QueryByFile(const std::string& file_path);
 
+    // 根据调用栈 ID 查询
+    QueryResult QueryByStack(uint64_t stack_id);
+
     // 根据大小范围查询
     QueryResult QueryBySizeRange(size_t min_size, size_t max_size);
 
     // 根据时间范围查询
     QueryResult QueryByTimeRange(uint64_t start_time, uint64_t end_time);
 
+    // 根据线程 ID 查询
+    QueryResult QueryByThread(uint32_t thread_id);
+
+    // 查询与地址区间 [begin, end) 重叠的分配
+    QueryResult QueryByAddressRange(uintptr_t begin, uintptr_t end);
+
     // 获取所有内存泄漏（未释放的分配）
     std::vector<capture::AllocationInfo> GetLeaks();
 
+    // 以下 Visit* 接口在快照上遍历与对应 Query* 相同的记录，不复制记录内容；
+    // 遍历期间不持有存储锁，写入可以继续进行。visitor 为空时只计算聚合结果。
+    // 大小、时间、线程和地址区间查询走二级索引，代价与命中的记录数成正比；命中大部分记录时改为扫描
+    QueryAggregate VisitByFunction(const std::string& function_name, const RecordVisitor& visitor = nullptr);
+    QueryAggregate VisitByFile(const std::string& file_path, const RecordVisitor& visitor = nullptr);
+    QueryAggregate VisitByStack(uint64_t stack_id, const RecordVisitor& visitor = nullptr);
+    QueryAggregate VisitBySizeRange(size_t min_size, size_t max_size, const RecordVisitor& visitor = nullptr);
+    QueryAggregate VisitByTimeRange(uint64_t start_time, uint64_t end_time, const RecordVisitor& visitor = nullptr);
+    QueryAggregate VisitByThread(uint32_t thread_id, const RecordVisitor& visitor = nullptr);
+    QueryAggregate VisitByAddressRange(uintptr_t begin, uintptr_t end, const RecordVisitor& visitor = nullptr);
+    QueryAggregate VisitLeaks(const RecordVisitor& visitor = nullptr);
+
     // 获取统计摘要
     json GetSummary();
 
@@ -62,10 +179,54 @@ public:
     // 从 JSON 文件导入
     bool ImportFromJson(const std::string& filepath);
 
-    // 获取分配时间线
+    // 导出为二进制 trace 文件（见 trace_file.h），Shutdown 时默认保存为该格式
+    bool ExportToTrace(const std::string& filepath);
+
+    // 流式回放二进制 trace 文件
+    bool ImportFromTrace(const std::string& filepath);
+
+    // 以 mmap 只读打开二进制 trace，打开时只读取文件头和索引，不加载记录。
+    // 打开期间 Query*/Visit*/GetLeaks/GetAllocationTimeline 直接读取映射的文件，
+    // 写入、GetRecord、摘要和导出仍作用于内存中的记录
+    bool OpenTrace(const std::string& filepath);
+    void CloseTrace();
+    bool IsTraceOpen() const;
+
+    // 启动后台分段写入：之后 AddEvents 收到的事件同时追加到数据目录下滚动的 segment-<序号>.trace，
+    // 写入线程按 flush_interval_ms 刷新到文件，进程崩溃后可以按序号回放已写出的分段
+    void StartSegmentWriter(const SegmentOptions& options = SegmentOptions());
+    void StopSegmentWriter();
+
+    // 分段文件无法打开而未能写出的事件数（累计所有启动过的分段写入）
+    uint64_t GetSegmentDroppedEventCount() const;
+
+    // 堆快照：记录当前按调用栈聚合的未释放内存。聚合随写入增量维护，快照按桶写时复制，
+    // 代价与记录数无关。最多保留 64 个快照，超出时丢弃最旧的。返回快照 ID
+    uint64_t TakeHeapSnapshot(const std::string& label = std::string());
+    std::vector<HeapSnapshotInfo> GetHeapSnapshots();
+    std::vector<StackUsage> GetHeapSnapshot(uint64_t snapshot_id);
+    void DropHeapSnapshot(uint64_t snapshot_id);
+
+    // 两个快照之间各调用栈的变化，按字节增长从大到小排序；limit 为 0 时返回全部
+    std::vector<StackGrowth> DiffHeapSnapshots(uint64_t from_id, uint64_t to_id, size_t limit = 0);
+
+    // 最近 snapshot_count 个快照中未释放字节数从不减少且总体增长的调用栈（长时间运行时的泄漏特征），
+    // 变化量为这些快照首尾之差
+    std::vector<StackGrowth> GetGrowingStacks(size_t snapshot_count = 3, size_t limit = 0);
+
+    // 收到 signum 时自动拍摄快照并在日志中输出与上一个快照的差异
+    bool EnableSnapshotSignal(int signum);
+    void DisableSnapshotSignal();
+
+    // 按分配时间分桶的仍保留记录的字节数，每次调用都扫描记录；适合离线 trace，
+    // 运行中的未释放内存随时间的变化见 Stats::GetTimeline
     json GetAllocationTimeline(size_t bucket_size_ns = 1000000000);  // 默认 1秒
 
-    // 设置存储上限（防止内存占用过大）
+    // 切换存储布局，已有记录会迁移到新布局且句柄保持不变
+    void SetLayout(StorageLayout layout);
+    StorageLayout GetLayout() const;
+
+    // 设置存储上限（防止内存占用过大），超出时淘汰最旧的记录
     void SetMaxAllocations(size_t max_allocations);
 
     // 清空所有存储
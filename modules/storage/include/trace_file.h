@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "capture/capture.h"
+#include "storage/storage.h"
+
+namespace memory_tracer {
+namespace storage {
+
+// 二进制 trace 文件的流式写入器
+// 字符串、调用栈和符号只写一次，记录按块做差值 + 变长编码，关闭时写出块索引
+// 写入过程中只缓存当前块，不持有全部记录
+class TraceWriter {
+public:
+    TraceWriter();
+    ~TraceWriter();
+
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+
+    // first_alloc_index 为本文件第一条分配的序号，滚动写出的分段据此延续上一分段的编号，
+    // 释放事件可以引用之前分段中的分配。失败时不记录日志，由调用方决定如何报告
+    bool Open(const std::string& filepath, uint64_t first_alloc_index = 0);
+    bool IsOpen() const;
+
+    // 写入一条分配记录，address 为 nullptr 的记录视为已释放；返回分配序号
+    uint64_t WriteRecord(const RecordView& record);
+    uint64_t WriteAllocation(const capture::AllocationInfo& info);
+
+    // 释放事件，引用之前写入的分配序号
+    void WriteFree(uint64_t timestamp, uint64_t alloc_index);
+
+    // 写入捕获事件，释放事件按地址关联到之前的分配（未登记的地址忽略）
+    void WriteEvents(const capture::CaptureEvent* events, size_t count);
+
+    // 立即写出当前块并刷新到文件，进程异常退出时已刷新的部分可以回放
+    void Flush();
+
+    // 写出剩余的块和索引并关闭文件
+    bool Close();
+
+    // 本文件写入的分配数
+    uint64_t GetAllocationCount() const;
+
+    // 已写入文件的字节数（不含尚未写出的当前块）
+    uint64_t GetBytesWritten() const;
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> pimpl_;
+};
+
+// 回放时的回调，分配记录中已释放的 address 为 nullptr
+struct TraceHandler {
+    std::function<void(const capture::AllocationInfo&)> on_allocation;
+    std::function<void(uint64_t timestamp, void* address)> on_free;
+};
+
+// 二进制 trace 文件的流式读取器：逐块读取并回放，只保留字符串表和尚未释放的分配
+// 调用栈重新登记到 StackTable，符号预填充到 Symbolizer
+class TraceReader {
+public:
+    TraceReader();
+    ~TraceReader();
+
+    TraceReader(const TraceReader&) = delete;
+    TraceReader& operator=(const TraceReader&) = delete;
+
+    bool Open(const std::string& filepath);
+    uint32_t GetVersion() const;
+
+    // 从头回放全部事件；文件被截断（如进程崩溃）时回放已完整写出的块并返回 false
+    // 按顺序回放同一次采集的多个分段时复用同一个 reader，跨分段的释放事件可以关联到之前分段中的分配
+    bool Replay(const TraceHandler& handler);
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> pimpl_;
+};
+
+} // namespace storage
+} // namespace memory_tracer
@@ -0,0 +1,439 @@
+#include "mapped_trace.h"
+#include "capture/symbolizer.h"
+#include "logger/logger.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace memory_tracer {
+namespace storage {
+
+using namespace trace;
+
+MappedTrace::MappedTrace()
+    : data_(nullptr), size_(0), entries_(nullptr), entry_count_(0), alloc_begin_(0), alloc_end_(0),
+      freed_(nullptr), freed_words_(0), loaded_(false) {}
+
+MappedTrace::~MappedTrace() {
+    if (data_) {
+        munmap(const_cast<uint8_t*>(data_), size_);
+    }
+}
+
+bool MappedTrace::Open(const std::string& filepath) {
+    int fd = open(filepath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LOG_ERROR("Failed to open trace file: {}", filepath);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(FileHeader) + sizeof(Trailer)) {
+        LOG_ERROR("Not a memory tracer trace file: {}", filepath);
+        close(fd);
+        return false;
+    }
+
+    size_t size = static_cast<size_t>(st.st_size);
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        LOG_ERROR("Failed to map trace file: {}", filepath);
+        return false;
+    }
+    data_ = static_cast<const uint8_t*>(data);
+    size_ = size;
+    filepath_ = filepath;
+
+    FileHeader header;
+    std::memcpy(&header, data_, sizeof(header));
+    if (std::memcmp(header.magic, kFileMagic, sizeof(header.magic)) != 0 || header.version > kVersion) {
+        LOG_ERROR("Not a supported memory tracer trace file: {}", filepath);
+        return false;
+    }
+
+    // 只读取尾部和索引块，不触碰记录块。
+    // 偏移和长度来自文件，边界检查一律写成减法形式，损坏的数值不会让加法或乘法回绕
+    Trailer trailer;
+    ChunkHeader footer;
+    uint64_t entry_count = 0;
+    if (size_ < sizeof(trailer)) {
+        LOG_ERROR("Not a memory tracer trace file: {}", filepath);
+        return false;
+    }
+    const size_t limit = size_ - sizeof(trailer);
+    std::memcpy(&trailer, data_ + limit, sizeof(trailer));
+    if (std::memcmp(trailer.magic, kTrailerMagic, sizeof(trailer.magic)) != 0 ||
+        trailer.footer_offset > limit ||
+        limit - trailer.footer_offset < sizeof(footer) + sizeof(entry_count)) {
+        LOG_ERROR("Trace file {} has no index footer, replay it with ImportFromTrace instead", filepath);
+        return false;
+    }
+    const uint8_t* p = data_ + trailer.footer_offset;
+    std::memcpy(&footer, p, sizeof(footer));
+    std::memcpy(&entry_count, p + sizeof(footer), sizeof(entry_count));
+    if (footer.type != static_cast<uint32_t>(ChunkType::FOOTER) ||
+        footer.size < sizeof(entry_count) ||
+        footer.size > limit - trailer.footer_offset - sizeof(footer) ||
+        entry_count > (footer.size - sizeof(entry_count)) / sizeof(FooterEntry)) {
+        LOG_ERROR("Corrupted index footer in trace file: {}", filepath);
+        return false;
+    }
+    entries_ = p + sizeof(footer) + sizeof(entry_count);
+    entry_count_ = static_cast<size_t>(entry_count);
+
+    // 索引项按写出顺序排列，FREED 块紧接在最后一个记录块之后，其中记录了本文件的序号区间
+    for (size_t i = entry_count_; i > 0; --i) {
+        FooterEntry entry = GetEntry(i - 1);
+        if (entry.type == static_cast<uint32_t>(ChunkType::FREED)) {
+            const uint8_t* payload = nullptr;
+            size_t payload_size = 0;
+            if (GetPayload(entry, &payload, &payload_size)) {
+                freed_ = payload;
+                freed_words_ = payload_size / sizeof(uint64_t);
+                alloc_begin_ = entry.first_index;
+                alloc_end_ = entry.first_index + entry.alloc_count;
+            }
+        } else if (entry.type == static_cast<uint32_t>(ChunkType::RECORDS)) {
+            if (!freed_) {
+                alloc_end_ = entry.first_index + entry.alloc_count;
+            }
+            break;
+        }
+    }
+    if (!freed_) {
+        for (size_t i = 0; i < entry_count_; ++i) {
+            FooterEntry entry = GetEntry(i);
+            if (entry.type == static_cast<uint32_t>(ChunkType::RECORDS)) {
+                alloc_begin_ = entry.first_index;
+                break;
+            }
+        }
+    }
+
+    LOG_INFO("Mapped trace {} ({} allocations, {} bytes)", filepath, GetAllocationCount(), size_);
+    return true;
+}
+
+FooterEntry MappedTrace::GetEntry(size_t i) const {
+    FooterEntry entry;
+    std::memcpy(&entry, entries_ + i * sizeof(FooterEntry), sizeof(entry));
+    return entry;
+}
+
+bool MappedTrace::GetPayload(const FooterEntry& entry, const uint8_t** payload, size_t* size) const {
+    if (entry.offset > size_ - sizeof(ChunkHeader)) {
+        return false;
+    }
+    ChunkHeader header;
+    std::memcpy(&header, data_ + entry.offset, sizeof(header));
+    if (header.type != entry.type || header.size > size_ - entry.offset - sizeof(header)) {
+        return false;
+    }
+    *payload = data_ + entry.offset + sizeof(header);
+    *size = header.size;
+    return true;
+}
+
+bool MappedTrace::IsFreed(uint64_t alloc_index) const {
+    uint64_t bit = alloc_index - alloc_begin_;
+    size_t word = static_cast<size_t>(bit / 64);
+    uint64_t bits = 0;
+    if (freed_) {
+        if (word >= freed_words_) return false;
+        std::memcpy(&bits, freed_ + word * sizeof(uint64_t), sizeof(bits));
+    } else {
+        if (word >= computed_freed_.size()) return false;
+        bits = computed_freed_[word];
+    }
+    return (bits >> (bit % 64)) & 1;
+}
+
+bool MappedTrace::LoadTables() {
+    std::call_once(load_once_, [this] {
+        stacks_.assign(1, capture::kInvalidStackId);
+        bool ok = true;
+        for (size_t i = 0; i < entry_count_ && ok; ++i) {
+            FooterEntry entry = GetEntry(i);
+            const uint8_t* payload = nullptr;
+            size_t size = 0;
+            switch (static_cast<ChunkType>(entry.type)) {
+                case ChunkType::STRINGS:
+                    ok = GetPayload(entry, &payload, &size) && LoadStrings(payload, payload + size);
+                    break;
+                case ChunkType::STACKS:
+                    ok = GetPayload(entry, &payload, &size) && LoadStacks(payload, payload + size);
+                    break;
+                case ChunkType::SYMBOLS:
+                    ok = GetPayload(entry, &payload, &size) && LoadSymbols(payload, payload + size);
+                    break;
+                default:
+                    break;
+            }
+        }
+        if (ok && !freed_) {
+            ok = ComputeFreed();
+        }
+        if (!ok) {
+            LOG_ERROR("Corrupted tables in trace file: {}", filepath_);
+        }
+        loaded_ = ok;
+    });
+    return loaded_;
+}
+
+bool MappedTrace::LoadStrings(const uint8_t* p, const uint8_t* end) {
+    uint64_t first = 0;
+    uint64_t count = 0;
+    if (!GetVarint(&p, end, &first) || !GetVarint(&p, end, &count) || first != strings_.size()) {
+        return false;
+    }
+    for (uint64_t i = 0; i < count; ++i) {
+        uint64_t length = 0;
+        if (!GetVarint(&p, end, &length) || length > static_cast<uint64_t>(end - p)) {
+            return false;
+        }
+        std::string_view value(reinterpret_cast<const char*>(p), static_cast<size_t>(length));
+        string_ids_.emplace(value, strings_.size());
+        strings_.push_back(value);
+        p += length;
+    }
+    return true;
+}
+
+bool MappedTrace::LoadStacks(const uint8_t* p, const uint8_t* end) {
+    uint64_t first = 0;
+    uint64_t count = 0;
+    if (!GetVarint(&p, end, &first) || !GetVarint(&p, end, &count) || first != stacks_.size()) {
+        return false;
+    }
+    std::vector<void*> frames;
+    for (uint64_t i = 0; i < count; ++i) {
+        uint64_t depth = 0;
+        if (!GetVarint(&p, end, &depth) || depth > static_cast<uint64_t>(end - p)) {
+            return false;
+        }
+        frames.clear();
+        uint64_t address = 0;
+        for (uint64_t j = 0; j < depth; ++j) {
+            uint64_t delta = 0;
+            if (!GetVarint(&p, end, &delta)) return false;
+            address += static_cast<uint64_t>(ZigZagDecode(delta));
+            frames.push_back(reinterpret_cast<void*>(static_cast<uintptr_t>(address)));
+        }
+        stacks_.push_back(capture::StackTable::GetInstance().Intern(frames.data(), frames.size()));
+    }
+    return true;
+}
+
+bool MappedTrace::LoadSymbols(const uint8_t* p, const uint8_t* end) {
+    uint64_t count = 0;
+    if (!GetVarint(&p, end, &count)) {
+        return false;
+    }
+    uint64_t address = 0;
+    for (uint64_t i = 0; i < count; ++i) {
+        uint64_t delta = 0;
+        uint64_t symbol_id = 0;
+        if (!GetVarint(&p, end, &delta) || !GetVarint(&p, end, &symbol_id) || symbol_id >= strings_.size()) {
+            return false;
+        }
+        address += static_cast<uint64_t>(ZigZagDecode(delta));
+        capture::Symbolizer::GetInstance().AddSymbol(reinterpret_cast<void*>(static_cast<uintptr_t>(address)),
+                                                     std::string(strings_[symbol_id]));
+    }
+    return true;
+}
+
+bool MappedTrace::ComputeFreed() {
+    computed_freed_.assign(static_cast<size_t>((GetAllocationCount() + 63) / 64), 0);
+    RecordDecoder decoder;
+    DecodedEvent event;
+    for (size_t i = 0; i < entry_count_; ++i) {
+        FooterEntry entry = GetEntry(i);
+        if (entry.type != static_cast<uint32_t>(ChunkType::RECORDS)) continue;
+        const uint8_t* payload = nullptr;
+        size_t size = 0;
+        if (!GetPayload(entry, &payload, &size) || !decoder.Reset(payload, size)) {
+            return false;
+        }
+        while (decoder.Next(&event)) {
+            if ((event.type == kEventFree || event.type == kEventAllocFreed) &&
+                event.alloc_index >= alloc_begin_ && event.alloc_index < alloc_end_) {
+                uint64_t bit = event.alloc_index - alloc_begin_;
+                computed_freed_[bit / 64] |= uint64_t(1) << (bit % 64);
+            }
+        }
+    }
+    return true;
+}
+
+void MappedTrace::MakeView(const DecodedEvent& event, bool freed, RecordView* view) const {
+    view->handle = event.alloc_index;
+    view->timestamp = event.timestamp;
+    view->address = freed ? nullptr : reinterpret_cast<void*>(static_cast<uintptr_t>(event.address));
+    view->size = static_cast<size_t>(event.size);
+    view->function = strings_[event.function_id];
+    view->file = strings_[event.file_id];
+    view->line = static_cast<int>(event.line);
+    view->thread_id = static_cast<uint32_t>(event.thread_id);
+    view->stack_id = stacks_[event.stack_index];
+    view->kind = static_cast<capture::AllocationKind>(event.kind);
+    view->sample_interval = static_cast<uint32_t>(event.sample_interval);
+}
+
+template <typename Filter>
+void MappedTrace::Scan(uint64_t start_time, uint64_t end_time, Filter filter, const RecordVisitor& visitor) {
+    if (!LoadTables()) {
+        return;
+    }
+
+    RecordDecoder decoder;
+    DecodedEvent event;
+    RecordView view;
+    for (size_t i = 0; i < entry_count_; ++i) {
+        FooterEntry entry = GetEntry(i);
+        if (entry.type != static_cast<uint32_t>(ChunkType::RECORDS) ||
+            entry.max_timestamp < start_time || entry.min_timestamp > end_time) {
+            continue;
+        }
+        const uint8_t* payload = nullptr;
+        size_t size = 0;
+        if (!GetPayload(entry, &payload, &size) || !decoder.Reset(payload, size)) {
+            LOG_ERROR("Corrupted record chunk at offset {} in {}", entry.offset, filepath_);
+            return;
+        }
+
+        while (decoder.Next(&event)) {
+            if (event.type == kEventFree || event.timestamp < start_time || event.timestamp > end_time) {
+                continue;
+            }
+            if (event.function_id >= strings_.size() || event.file_id >= strings_.size() ||
+                event.stack_index >= stacks_.size()) {
+                LOG_ERROR("Corrupted record chunk at offset {} in {}", entry.offset, filepath_);
+                return;
+            }
+            bool freed = IsFreed(event.alloc_index);
+            if (!filter(event, freed)) {
+                continue;
+            }
+            MakeView(event, freed, &view);
+            if (!visitor(view)) {
+                return;
+            }
+        }
+    }
+}
+
+bool MappedTrace::FindString(const std::string& value, uint64_t* id) const {
+    auto it = string_ids_.find(value);
+    if (it == string_ids_.end()) {
+        return false;
+    }
+    *id = it->second;
+    return true;
+}
+
+void MappedTrace::VisitByFunction(const std::string& function_name, const RecordVisitor& visitor) {
+    uint64_t id = 0;
+    if (!LoadTables() || !FindString(function_name, &id)) {
+        return;
+    }
+    Scan(0, UINT64_MAX, [id](const DecodedEvent& event, bool freed) {
+        return !freed && event.function_id == id;
+    }, visitor);
+}
+
+void MappedTrace::VisitByFile(const std::string& file_path, const RecordVisitor& visitor) {
+    uint64_t id = 0;
+    if (!LoadTables() || !FindString(file_path, &id)) {
+        return;
+    }
+    Scan(0, UINT64_MAX, [id](const DecodedEvent& event, bool freed) {
+        return !freed && event.file_id == id;
+    }, visitor);
+}
+
+void MappedTrace::VisitByStack(uint64_t stack_id, const RecordVisitor& visitor) {
+    Scan(0, UINT64_MAX, [this, stack_id](const DecodedEvent& event, bool freed) {
+        return !freed && stacks_[event.stack_index] == stack_id;
+    }, visitor);
+}
+
+void MappedTrace::VisitSizeRange(size_t min_size, size_t max_size, const RecordVisitor& visitor) {
+    Scan(0, UINT64_MAX, [min_size, max_size](const DecodedEvent& event, bool freed) {
+        return !freed && event.size >= min_size && event.size <= max_size;
+    }, visitor);
+}
+
+void MappedTrace::VisitTimeRange(uint64_t start_time, uint64_t end_time, const RecordVisitor& visitor) {
+    Scan(start_time, end_time, [](const DecodedEvent&, bool) { return true; }, visitor);
+}
+
+void MappedTrace::VisitByThread(uint32_t thread_id, const RecordVisitor& visitor) {
+    Scan(0, UINT64_MAX, [thread_id](const DecodedEvent& event, bool freed) {
+        return !freed && event.thread_id == thread_id;
+    }, visitor);
+}
+
+void MappedTrace::VisitAddressRange(uintptr_t begin, uintptr_t end, const RecordVisitor& visitor) {
+    Scan(0, UINT64_MAX, [begin, end](const DecodedEvent& event, bool freed) {
+        return !freed && event.address < end && (event.address >= begin || event.address + event.size > begin);
+    }, visitor);
+}
+
+void MappedTrace::VisitLive(const RecordVisitor& visitor) {
+    Scan(0, UINT64_MAX, [](const DecodedEvent&, bool freed) { return !freed; }, visitor);
+}
+
+std::map<uint64_t, size_t> MappedTrace::BuildTimeline(uint64_t bucket_size_ns) {
+    std::map<uint64_t, size_t> timeline;
+    if (bucket_size_ns == 0 || alloc_end_ == alloc_begin_) {
+        return timeline;
+    }
+
+    // 时间范围直接取自索引
+    uint64_t min_time = UINT64_MAX;
+    uint64_t max_time = 0;
+    for (size_t i = 0; i < entry_count_; ++i) {
+        FooterEntry entry = GetEntry(i);
+        if (entry.type == static_cast<uint32_t>(ChunkType::RECORDS) && entry.alloc_count > 0) {
+            min_time = std::min(min_time, entry.min_timestamp);
+            max_time = std::max(max_time, entry.max_timestamp);
+        }
+    }
+    if (min_time > max_time) {
+        return timeline;
+    }
+
+    constexpr uint64_t kMaxDenseBuckets = 1 << 20;
+    uint64_t bucket_count = (max_time - min_time) / bucket_size_ns + 1;
+    std::vector<size_t> dense;
+    if (bucket_count <= kMaxDenseBuckets) {
+        dense.assign(bucket_count, 0);
+    }
+
+    Scan(0, UINT64_MAX, [&](const DecodedEvent& event, bool freed) {
+        if (!freed) {
+            uint64_t bucket = (event.timestamp - min_time) / bucket_size_ns;
+            if (!dense.empty()) {
+                dense[bucket] += event.size;
+            } else {
+                timeline[bucket * bucket_size_ns + min_time] += event.size;
+            }
+        }
+        return false;
+    }, [](const RecordView&) { return true; });
+
+    for (size_t i = 0; i < dense.size(); ++i) {
+        if (dense[i]) {
+            timeline[i * bucket_size_ns + min_time] = dense[i];
+        }
+    }
+    return timeline;
+}
+
+} // namespace storage
+} // namespace memory_tracer
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "capture/stack_table.h"
+#include "storage/storage.h"
+#include "trace_codec.h"
+
+namespace memory_tracer {
+namespace storage {
+
+// 通过 mmap 只读打开二进制 trace，查询直接在映射的页面上解码
+// 打开时只校验文件头、尾部和索引块；字符串表和调用栈在第一次查询时建立，
+// 记录块按需解码，由页缓存负责读入。视图中的字符串直接指向映射的内存
+// 打开后只读，可以被多个线程同时查询
+class MappedTrace {
+public:
+    MappedTrace();
+    ~MappedTrace();
+
+    MappedTrace(const MappedTrace&) = delete;
+    MappedTrace& operator=(const MappedTrace&) = delete;
+
+    // 文件必须有完整的索引（正常关闭的 TraceWriter 写出）
+    bool Open(const std::string& filepath);
+
+    const std::string& GetPath() const { return filepath_; }
+    uint64_t GetAllocationCount() const { return alloc_end_ - alloc_begin_; }
+
+    // 与 RecordStore 的同名接口含义相同，视图的 handle 为分配序号
+    void VisitByFunction(const std::string& function_name, const RecordVisitor& visitor);
+    void VisitByFile(const std::string& file_path, const RecordVisitor& visitor);
+    void VisitByStack(uint64_t stack_id, const RecordVisitor& visitor);
+    void VisitSizeRange(size_t min_size, size_t max_size, const RecordVisitor& visitor);
+    void VisitTimeRange(uint64_t start_time, uint64_t end_time, const RecordVisitor& visitor);
+    void VisitByThread(uint32_t thread_id, const RecordVisitor& visitor);
+    void VisitAddressRange(uintptr_t begin, uintptr_t end, const RecordVisitor& visitor);
+    void VisitLive(const RecordVisitor& visitor);
+    std::map<uint64_t, size_t> BuildTimeline(uint64_t bucket_size_ns);
+
+private:
+    trace::FooterEntry GetEntry(size_t i) const;
+
+    // 块的 payload，越界时返回 false
+    bool GetPayload(const trace::FooterEntry& entry, const uint8_t** payload, size_t* size) const;
+
+    bool IsFreed(uint64_t alloc_index) const;
+
+    // 第一次查询时建立字符串表、调用栈映射，旧文件没有 FREED 块时扫描一遍释放事件
+    bool LoadTables();
+    bool LoadStrings(const uint8_t* p, const uint8_t* end);
+    bool LoadStacks(const uint8_t* p, const uint8_t* end);
+    bool LoadSymbols(const uint8_t* p, const uint8_t* end);
+    bool ComputeFreed();
+
+    void MakeView(const trace::DecodedEvent& event, bool freed, RecordView* view) const;
+
+    // 按时间范围跳过块，对每条满足 filter(event, freed) 的分配构造视图并回调
+    template <typename Filter>
+    void Scan(uint64_t start_time, uint64_t end_time, Filter filter, const RecordVisitor& visitor);
+
+    // 字符串不存在时返回 false
+    bool FindString(const std::string& value, uint64_t* id) const;
+
+    std::string filepath_;
+    const uint8_t* data_;
+    size_t size_;
+    const uint8_t* entries_;   // 索引块中的 FooterEntry 数组（可能未对齐）
+    size_t entry_count_;
+    uint64_t alloc_begin_;     // 本文件的分配序号区间 [alloc_begin_, alloc_end_)，分段文件不从 0 开始
+    uint64_t alloc_end_;
+    const uint8_t* freed_;     // 映射中的 FREED 位图，第 i 位对应序号 alloc_begin_ + i
+    size_t freed_words_;
+
+    std::once_flag load_once_;
+    bool loaded_;
+    std::vector<std::string_view> strings_;
+    std::unordered_map<std::string_view, uint64_t> string_ids_;
+    std::vector<capture::StackId> stacks_;   // 文件内序号 -> 本进程的调用栈 ID
+    std::vector<uint64_t> computed_freed_;
+};
+
+} // namespace storage
+} // namespace memory_tracer
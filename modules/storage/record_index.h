@@ -0,0 +1,192 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iterator>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "storage/storage.h"
+
+namespace memory_tracer {
+namespace storage {
+
+// 按时间戳的二级索引，保存 (timestamp, handle)
+// 时间戳几乎按追加顺序到达（各线程的事件分批汇入），因此把记录放入若干条按时间有序的追加序列：
+// 新记录接在末尾时间戳不大于它、且最接近它的序列之后，找不到时开一条新序列。
+// 单线程写入时只有一条序列，多线程交错时序列数约为交错的线程数，超过 kMaxRuns 的乱序记录放入 late_。
+// 每条序列内句柄也是升序的，范围查询在每条序列上二分；被淘汰的最旧记录总在某条序列的队首。调用方负责加锁
+class TimeIndex {
+public:
+    void Add(uint64_t timestamp, RecordHandle handle) {
+        Run* best = nullptr;
+        for (auto& run : runs_) {
+            uint64_t last = run.back().timestamp;
+            if (last <= timestamp && (!best || last > best->back().timestamp)) {
+                best = &run;
+            }
+        }
+        if (best) {
+            best->push_back({timestamp, handle});
+        } else if (runs_.size() < kMaxRuns) {
+            runs_.emplace_back();
+            runs_.back().push_back({timestamp, handle});
+        } else {
+            late_.emplace(timestamp, handle);
+        }
+    }
+
+    // 移除最旧的记录
+    void Remove(uint64_t timestamp, RecordHandle handle) {
+        for (auto it = runs_.begin(); it != runs_.end(); ++it) {
+            if (it->front().handle == handle) {
+                it->pop_front();
+                if (it->empty()) {
+                    runs_.erase(it);
+                }
+                return;
+            }
+        }
+        auto range = late_.equal_range(timestamp);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == handle) {
+                late_.erase(it);
+                return;
+            }
+        }
+    }
+
+    // 时间戳位于 [start_time, end_time] 的记录数
+    size_t Count(uint64_t start_time, uint64_t end_time) const {
+        size_t count = 0;
+        for (const auto& run : runs_) {
+            auto [first, last] = FindRange(run, start_time, end_time);
+            count += static_cast<size_t>(last - first);
+        }
+        auto first = late_.lower_bound(start_time);
+        auto last = late_.upper_bound(end_time);
+        return count + static_cast<size_t>(std::distance(first, last));
+    }
+
+    // 追加时间戳位于 [start_time, end_time] 的记录句柄，按句柄升序
+    void Find(uint64_t start_time, uint64_t end_time, std::vector<RecordHandle>* handles) const {
+        size_t begin = handles->size();
+        for (const auto& run : runs_) {
+            auto [first, last] = FindRange(run, start_time, end_time);
+            for (auto it = first; it != last; ++it) {
+                handles->push_back(it->handle);
+            }
+        }
+        auto last = late_.upper_bound(end_time);
+        for (auto it = late_.lower_bound(start_time); it != last; ++it) {
+            handles->push_back(it->second);
+        }
+        if (runs_.size() > 1 || !late_.empty()) {
+            std::sort(handles->begin() + begin, handles->end());
+        }
+    }
+
+    void Clear() {
+        runs_.clear();
+        late_.clear();
+    }
+
+private:
+    struct Entry {
+        uint64_t timestamp;
+        RecordHandle handle;
+    };
+    using Run = std::deque<Entry>;
+
+    static constexpr size_t kMaxRuns = 16;
+
+    static std::pair<Run::const_iterator, Run::const_iterator> FindRange(const Run& run, uint64_t start_time,
+                                                                         uint64_t end_time) {
+        auto first = std::lower_bound(run.begin(), run.end(), start_time,
+            [](const Entry& entry, uint64_t time) { return entry.timestamp < time; });
+        auto last = std::upper_bound(first, run.end(), end_time,
+            [](uint64_t time, const Entry& entry) { return time < entry.timestamp; });
+        return {first, last};
+    }
+
+    std::vector<Run> runs_;
+    std::multimap<uint64_t, RecordHandle> late_;
+};
+
+// 按大小类的二级索引：大小类按 2 的幂划分，每个 2 的幂再线性划分 16 类（与 SizeHistogram 的子桶相同），
+// 每类按追加顺序保存句柄。区间查询只访问与区间相交的大小类，边界上的两类可能含有区间外的记录，
+// 由调用方按实际大小过滤。调用方负责加锁
+class SizeIndex {
+public:
+    void Add(size_t size, RecordHandle handle) {
+        classes_[GetSizeClass(size)].push_back(handle);
+    }
+
+    // 移除最旧的记录
+    void Remove(size_t size, RecordHandle handle) {
+        auto it = classes_.find(GetSizeClass(size));
+        if (it == classes_.end()) {
+            return;
+        }
+        auto& handles = it->second;
+        while (!handles.empty() && handles.front() <= handle) {
+            handles.pop_front();
+        }
+        if (handles.empty()) {
+            classes_.erase(it);
+        }
+    }
+
+    // 与 [min_size, max_size] 相交的大小类中的记录数
+    size_t Count(size_t min_size, size_t max_size) const {
+        size_t count = 0;
+        ForEachClass(min_size, max_size, [&](const std::deque<RecordHandle>& handles) { count += handles.size(); });
+        return count;
+    }
+
+    // 追加候选句柄，按句柄升序
+    void Find(size_t min_size, size_t max_size, std::vector<RecordHandle>* handles) const {
+        size_t begin = handles->size();
+        size_t classes = 0;
+        ForEachClass(min_size, max_size, [&](const std::deque<RecordHandle>& class_handles) {
+            handles->insert(handles->end(), class_handles.begin(), class_handles.end());
+            classes++;
+        });
+        if (classes > 1) {
+            std::sort(handles->begin() + begin, handles->end());
+        }
+    }
+
+    void Clear() { classes_.clear(); }
+
+    // 所在大小类的下界
+    static size_t GetSizeClass(size_t size) {
+        if (size < kSubClassCount) {
+            return size;
+        }
+        int shift = 63 - __builtin_clzll(size) - kSubClassBits;
+        return (size >> shift) << shift;
+    }
+
+private:
+    static constexpr int kSubClassBits = 4;
+    static constexpr size_t kSubClassCount = size_t(1) << kSubClassBits;
+
+    template <typename Func>
+    void ForEachClass(size_t min_size, size_t max_size, Func func) const {
+        if (min_size > max_size) {
+            return;
+        }
+        for (auto it = classes_.lower_bound(GetSizeClass(min_size)); it != classes_.end() && it->first <= max_size; ++it) {
+            func(it->second);
+        }
+    }
+
+    std::map<size_t, std::deque<RecordHandle>> classes_;
+};
+
+} // namespace storage
+} // namespace memory_tracer
@@ -0,0 +1,147 @@
+#include "record_store.h"
+#include <algorithm>
+
+namespace memory_tracer {
+namespace storage {
+
+void RowRecordStore::AppendRecord(RecordHandle handle, const capture::AllocationInfo& info) {
+    if (chunks_.empty() || handle - chunks_.back()->base == kChunkSize) {
+        auto chunk = std::make_shared<Chunk>();
+        chunk->base = handle;
+        chunk->records.reserve(kChunkSize);
+        chunks_.push_back(std::move(chunk));
+    }
+    chunks_.back()->records.push_back(info);
+}
+
+void RowRecordStore::PopFront(RecordHandle handle) {
+    Chunk& chunk = *chunks_.front();
+    const capture::AllocationInfo& info = chunk.records[handle - chunk.base];
+    NotifyEvict(handle, {info.function, info.file, info.stack_id, info.address, info.timestamp, info.size,
+                         info.thread_id});
+
+    // 整块都已淘汰时释放该块（快照仍持有时由快照释放）
+    if (handle + 1 - chunk.base == kChunkSize) {
+        chunks_.pop_front();
+    }
+}
+
+std::unique_ptr<RecordStore> RowRecordStore::Snapshot() const {
+    auto snapshot = std::make_unique<RowRecordStore>(capacity_);
+    snapshot->first_ = first_;
+    snapshot->next_ = next_;
+    snapshot->chunks_ = chunks_;
+    return snapshot;
+}
+
+std::unique_ptr<RecordStore> RowRecordStore::Slice(RecordHandle begin, RecordHandle end) const {
+    auto slice = std::make_unique<RowRecordStore>(capacity_);
+    slice->first_ = std::max(begin, first_);
+    slice->next_ = std::max(slice->first_, std::min(end, next_));
+    for (const auto& chunk : chunks_) {
+        if (chunk->base < slice->next_ && chunk->base + kChunkSize > slice->first_) {
+            slice->chunks_.push_back(chunk);
+        }
+    }
+    return slice;
+}
+
+const capture::AllocationInfo* RowRecordStore::Find(RecordHandle handle) const {
+    if (!Contains(handle)) {
+        return nullptr;
+    }
+    size_t offset = static_cast<size_t>(handle - chunks_.front()->base);
+    return &chunks_[offset / kChunkSize]->records[offset % kChunkSize];
+}
+
+void RowRecordStore::MakeView(RecordHandle handle, const capture::AllocationInfo& info, RecordView* view) {
+    view->handle = handle;
+    view->timestamp = info.timestamp;
+    view->address = info.address;
+    view->size = info.size;
+    view->function = info.function;
+    view->file = info.file;
+    view->line = info.line;
+    view->thread_id = info.thread_id;
+    view->stack_id = info.stack_id;
+    view->kind = info.kind;
+    view->sample_interval = info.sample_interval;
+}
+
+bool RowRecordStore::View(RecordHandle handle, RecordView* view) const {
+    const capture::AllocationInfo* record = Find(handle);
+    if (!record) return false;
+    if (view) MakeView(handle, *record, view);
+    return true;
+}
+
+size_t RowRecordStore::GetRecordSize(RecordHandle handle) const {
+    const capture::AllocationInfo* record = Find(handle);
+    return record ? record->size : 0;
+}
+
+bool RowRecordStore::MarkFreed(RecordHandle handle) {
+    if (!Contains(handle)) {
+        return false;
+    }
+    size_t offset = static_cast<size_t>(handle - chunks_.front()->base);
+    auto& chunk = chunks_[offset / kChunkSize];
+    if (chunk.use_count() > 1) {
+        // 快照仍在读取该块，复制后再修改
+        auto copy = std::make_shared<Chunk>();
+        copy->base = chunk->base;
+        copy->records.reserve(kChunkSize);
+        copy->records = chunk->records;
+        chunk = std::move(copy);
+    }
+    chunk->records[offset % kChunkSize].address = nullptr;
+    return true;
+}
+
+void RowRecordStore::VisitAll(const RecordVisitor& visitor) const {
+    VisitIf([](const capture::AllocationInfo&) { return true; }, visitor);
+}
+
+void RowRecordStore::VisitSizeRange(size_t min_size, size_t max_size, const RecordVisitor& visitor) const {
+    VisitIf([&](const capture::AllocationInfo& info) {
+        return info.address != nullptr && info.size >= min_size && info.size <= max_size;
+    }, visitor);
+}
+
+void RowRecordStore::VisitTimeRange(uint64_t start_time, uint64_t end_time, const RecordVisitor& visitor) const {
+    VisitIf([&](const capture::AllocationInfo& info) {
+        return info.timestamp >= start_time && info.timestamp <= end_time;
+    }, visitor);
+}
+
+void RowRecordStore::VisitLive(const RecordVisitor& visitor) const {
+    VisitIf([](const capture::AllocationInfo& info) { return info.address != nullptr; }, visitor);
+}
+
+uint64_t RowRecordStore::GetMinTimestamp() const {
+    uint64_t min_time = UINT64_MAX;
+    ForEachRecord([&](RecordHandle, const capture::AllocationInfo& info) {
+        min_time = std::min(min_time, info.timestamp);
+        return true;
+    });
+    return min_time;
+}
+
+std::map<uint64_t, size_t> RowRecordStore::BuildTimeline(uint64_t bucket_size_ns, uint64_t origin) const {
+    std::map<uint64_t, size_t> timeline;
+    if (Empty() || bucket_size_ns == 0) {
+        return timeline;
+    }
+
+    ForEachRecord([&](RecordHandle, const capture::AllocationInfo& info) {
+        if (info.address != nullptr && info.timestamp >= origin) {
+            uint64_t bucket = ((info.timestamp - origin) / bucket_size_ns) * bucket_size_ns + origin;
+            timeline[bucket] += info.size;
+        }
+        return true;
+    });
+    return timeline;
+}
+
+} // namespace storage
+} // namespace memory_tracer
@@ -0,0 +1,227 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "capture/capture.h"
+#include "storage/storage.h"
+
+namespace memory_tracer {
+namespace storage {
+
+// 淘汰记录时用于维护索引的键，引用在回调返回前有效
+struct RecordKeys {
+    const std::string& function;
+    const std::string& file;
+    uint64_t stack_id;
+    void* address;  // 已释放的记录为 nullptr
+    uint64_t timestamp;
+    size_t size;
+    uint32_t thread_id;
+};
+
+// 有界的环形记录存储：按固定大小的块追加，超出容量时从最旧的记录开始淘汰
+// 每条记录的句柄是单调递增的序号，淘汰和清空都不会复用，因此句柄始终稳定
+// 具体的记录布局（行式/列式）由子类实现
+//
+// 块以 shared_ptr 持有，Snapshot() 只复制块指针。快照只读取创建时的句柄区间，
+// 之后的追加写入新的槽位；修改快照仍引用的块时先复制（写时复制），因此快照可以在不持锁的情况下遍历
+class RecordStore {
+public:
+    static constexpr size_t kChunkSize = 4096;
+
+    using EvictCallback = std::function<void(RecordHandle, const RecordKeys&)>;
+
+    explicit RecordStore(size_t capacity) : capacity_(capacity), first_(0), next_(0) {}
+    virtual ~RecordStore() = default;
+
+    RecordStore(const RecordStore&) = delete;
+    RecordStore& operator=(const RecordStore&) = delete;
+
+    // 被淘汰的记录移除前调用
+    void SetEvictCallback(EvictCallback callback) { on_evict_ = std::move(callback); }
+
+    // 追加一条记录，address 为 nullptr 的记录视为已释放
+    RecordHandle Append(const capture::AllocationInfo& info) {
+        if (capacity_ == 0) {
+            return kInvalidRecordHandle;
+        }
+        Trim(capacity_ - 1);
+        AppendRecord(next_, info);
+        return next_++;
+    }
+
+    void SetCapacity(size_t capacity) {
+        capacity_ = capacity;
+        Trim(capacity_);
+    }
+
+    // 从指定序号开始分配句柄，切换布局迁移记录时用于保留原句柄（只能在空存储上调用）
+    void SetNextHandle(RecordHandle handle) {
+        first_ = handle;
+        next_ = handle;
+    }
+
+    // 清空全部记录，序号继续递增
+    void Clear() {
+        ClearRecords();
+        first_ = next_;
+    }
+
+    bool Contains(RecordHandle handle) const { return handle >= first_ && handle < next_; }
+    size_t Size() const { return static_cast<size_t>(next_ - first_); }
+    bool Empty() const { return first_ == next_; }
+    size_t GetCapacity() const { return capacity_; }
+    RecordHandle FirstHandle() const { return first_; }
+    RecordHandle EndHandle() const { return next_; }
+
+    // 读取完整记录，已释放的记录 address 为 nullptr
+    bool Get(RecordHandle handle, capture::AllocationInfo* info) const {
+        RecordView view;
+        if (!View(handle, &view)) return false;
+        if (info) *info = view.ToAllocationInfo();
+        return true;
+    }
+
+    virtual StorageLayout GetLayout() const = 0;
+
+    // 当前全部记录的只读快照，快照上只能调用只读接口
+    virtual std::unique_ptr<RecordStore> Snapshot() const = 0;
+
+    // 句柄区间 [begin, end) 与当前记录交集的只读快照，用于把一次扫描切成多个分区并行执行
+    virtual std::unique_ptr<RecordStore> Slice(RecordHandle begin, RecordHandle end) const = 0;
+
+    virtual bool View(RecordHandle handle, RecordView* view) const = 0;
+
+    // 记录的分配大小，句柄无效时返回 0
+    virtual size_t GetRecordSize(RecordHandle handle) const = 0;
+
+    // 标记为已释放
+    virtual bool MarkFreed(RecordHandle handle) = 0;
+
+    // 以下遍历接口按追加顺序调用 visitor，visitor 返回 false 时停止
+    virtual void VisitAll(const RecordVisitor& visitor) const = 0;
+
+    // 未释放且大小位于 [min_size, max_size] 的记录
+    virtual void VisitSizeRange(size_t min_size, size_t max_size, const RecordVisitor& visitor) const = 0;
+
+    // 时间戳位于 [start_time, end_time] 的记录（包括已释放的）
+    virtual void VisitTimeRange(uint64_t start_time, uint64_t end_time, const RecordVisitor& visitor) const = 0;
+
+    // 全部未释放的记录
+    virtual void VisitLive(const RecordVisitor& visitor) const = 0;
+
+    // 最早的时间戳，没有记录时返回 UINT64_MAX
+    virtual uint64_t GetMinTimestamp() const = 0;
+
+    // 以 origin 为起点按 bucket_size_ns 分桶，累加未释放记录的大小；
+    // 各分区使用相同的 origin 时，分桶结果可以直接相加
+    virtual std::map<uint64_t, size_t> BuildTimeline(uint64_t bucket_size_ns, uint64_t origin) const = 0;
+
+    // 以最早的时间戳为起点分桶
+    std::map<uint64_t, size_t> BuildTimeline(uint64_t bucket_size_ns) const {
+        return BuildTimeline(bucket_size_ns, GetMinTimestamp());
+    }
+
+protected:
+    virtual void AppendRecord(RecordHandle handle, const capture::AllocationInfo& info) = 0;
+
+    // 移除最旧的记录 handle，移除前需调用 NotifyEvict
+    virtual void PopFront(RecordHandle handle) = 0;
+
+    virtual void ClearRecords() = 0;
+
+    void NotifyEvict(RecordHandle handle, const RecordKeys& keys) {
+        if (on_evict_) on_evict_(handle, keys);
+    }
+
+    // 块内的有效区间 [begin, end)，只依赖本对象的句柄区间，不读取块的当前长度
+    void GetChunkRange(RecordHandle base, size_t* begin, size_t* end) const {
+        *begin = first_ > base ? static_cast<size_t>(first_ - base) : 0;
+        *end = next_ - base < kChunkSize ? static_cast<size_t>(next_ - base) : kChunkSize;
+    }
+
+    size_t capacity_;
+    RecordHandle first_;  // 最旧的有效记录
+    RecordHandle next_;   // 下一条记录的序号
+
+private:
+    void Trim(size_t capacity) {
+        while (Size() > capacity) {
+            PopFront(first_);
+            ++first_;
+        }
+    }
+
+    EvictCallback on_evict_;
+};
+
+// 行式布局：每条记录完整保存一个 AllocationInfo
+class RowRecordStore : public RecordStore {
+public:
+    explicit RowRecordStore(size_t capacity) : RecordStore(capacity) {}
+
+    StorageLayout GetLayout() const override { return StorageLayout::ROW; }
+    std::unique_ptr<RecordStore> Snapshot() const override;
+    std::unique_ptr<RecordStore> Slice(RecordHandle begin, RecordHandle end) const override;
+    bool View(RecordHandle handle, RecordView* view) const override;
+    size_t GetRecordSize(RecordHandle handle) const override;
+    bool MarkFreed(RecordHandle handle) override;
+    void VisitAll(const RecordVisitor& visitor) const override;
+    void VisitSizeRange(size_t min_size, size_t max_size, const RecordVisitor& visitor) const override;
+    void VisitTimeRange(uint64_t start_time, uint64_t end_time, const RecordVisitor& visitor) const override;
+    void VisitLive(const RecordVisitor& visitor) const override;
+    uint64_t GetMinTimestamp() const override;
+    using RecordStore::BuildTimeline;
+    std::map<uint64_t, size_t> BuildTimeline(uint64_t bucket_size_ns, uint64_t origin) const override;
+
+protected:
+    void AppendRecord(RecordHandle handle, const capture::AllocationInfo& info) override;
+    void PopFront(RecordHandle handle) override;
+    void ClearRecords() override { chunks_.clear(); }
+
+private:
+    struct Chunk {
+        RecordHandle base;  // 块内第一条记录的序号
+        std::vector<capture::AllocationInfo> records;  // 预留 kChunkSize，追加不会搬移已有记录
+    };
+
+    const capture::AllocationInfo* Find(RecordHandle handle) const;
+
+    static void MakeView(RecordHandle handle, const capture::AllocationInfo& info, RecordView* view);
+
+    // func(handle, info) 返回 false 时停止
+    template <typename Func>
+    void ForEachRecord(Func func) const {
+        for (const auto& chunk : chunks_) {
+            size_t begin = 0;
+            size_t end = 0;
+            GetChunkRange(chunk->base, &begin, &end);
+            for (size_t i = begin; i < end; ++i) {
+                if (!func(chunk->base + i, chunk->records[i])) return;
+            }
+        }
+    }
+
+    // 按条件过滤后构造视图交给 visitor
+    template <typename Predicate>
+    void VisitIf(Predicate predicate, const RecordVisitor& visitor) const {
+        RecordView view;
+        ForEachRecord([&](RecordHandle handle, const capture::AllocationInfo& info) {
+            if (!predicate(info)) return true;
+            MakeView(handle, info, &view);
+            return visitor(view);
+        });
+    }
+
+    std::deque<std::shared_ptr<Chunk>> chunks_;
+};
+
+} // namespace storage
+} // namespace memory_tracer
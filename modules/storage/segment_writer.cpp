@@ -0,0 +1,187 @@
+#include "segment_writer.h"
+#include "logger/logger.h"
+#include <cinttypes>
+#include <cstdio>
+#include <dirent.h>
+#include <unistd.h>
+
+namespace memory_tracer {
+namespace storage {
+
+SegmentWriter::SegmentWriter(const std::string& directory, const SegmentOptions& options)
+    : directory_(directory), options_(options), running_(false), dropped_(0), next_alloc_(0), sequence_(0),
+      open_failed_(false) {}
+
+SegmentWriter::~SegmentWriter() {
+    Stop();
+}
+
+void SegmentWriter::Start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_) {
+        return;
+    }
+    sequence_ = FindLastSequence();
+    running_ = true;
+    thread_ = std::thread([this]() { Run(); });
+    LOG_INFO("Segment writer started, directory: {}", directory_);
+}
+
+void SegmentWriter::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) {
+            return;
+        }
+        running_ = false;
+    }
+    work_cv_.notify_all();
+    space_cv_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    LOG_INFO("Segment writer stopped");
+}
+
+void SegmentWriter::Append(const capture::CaptureEvent* events, size_t count) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    space_cv_.wait(lock, [this]() { return !running_ || pending_.size() < kMaxPendingEvents; });
+    if (!running_) {
+        return;
+    }
+    pending_.insert(pending_.end(), events, events + count);
+    if (pending_.size() >= kMaxPendingEvents / 2) {
+        work_cv_.notify_one();
+    }
+}
+
+void SegmentWriter::Run() {
+    // 写入线程产生的分配属于追踪器自身
+    capture::TracerScope scope;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        work_cv_.wait_for(lock, std::chrono::milliseconds(options_.flush_interval_ms), [this]() {
+            return !running_ || pending_.size() >= kMaxPendingEvents / 2;
+        });
+        bool stopping = !running_;
+        writing_.swap(pending_);
+        lock.unlock();
+        space_cv_.notify_all();
+
+        WriteBatch(writing_);
+        writing_.clear();
+        if (stopping) {
+            SealSegment();
+            return;
+        }
+        lock.lock();
+    }
+}
+
+uint64_t SegmentWriter::GetDroppedEventCount() const {
+    return dropped_.load(std::memory_order_relaxed);
+}
+
+void SegmentWriter::WriteBatch(const std::vector<capture::CaptureEvent>& batch) {
+    for (size_t i = 0; i < batch.size(); ++i) {
+        const auto& event = batch[i];
+        // 分段无法打开时本批其余事件无处写入，计入丢弃数，下一批再重试
+        if (event.type == capture::EventType::ALLOC) {
+            if (!writer_.IsOpen() && !OpenSegment()) {
+                dropped_.fetch_add(batch.size() - i, std::memory_order_relaxed);
+                return;
+            }
+            uint64_t index = writer_.WriteAllocation(capture::MakeAllocationInfo(event));
+            if (index == UINT64_MAX) {
+                continue;
+            }
+            next_alloc_ = index + 1;
+            if (event.address != nullptr) {
+                live_.Insert(event.address, index);
+            }
+        } else {
+            uint64_t index = 0;
+            if (live_.Erase(event.address, &index)) {
+                if (!writer_.IsOpen() && !OpenSegment()) {
+                    dropped_.fetch_add(batch.size() - i, std::memory_order_relaxed);
+                    return;
+                }
+                writer_.WriteFree(event.timestamp, index);
+            }
+        }
+
+        if (writer_.IsOpen() && writer_.GetBytesWritten() >= options_.max_segment_bytes) {
+            SealSegment();
+        }
+    }
+
+    if (!writer_.IsOpen()) {
+        return;
+    }
+    auto elapsed = std::chrono::steady_clock::now() - segment_start_;
+    if (options_.max_segment_seconds > 0 && elapsed >= std::chrono::seconds(options_.max_segment_seconds)) {
+        SealSegment();
+    } else {
+        // 每个写出周期刷新一次，异常退出时最多丢失一个周期的事件
+        writer_.Flush();
+    }
+}
+
+bool SegmentWriter::OpenSegment() {
+    // 打开失败时不占用序号，下次重试同一个文件
+    char name[64];
+    snprintf(name, sizeof(name), "/segment-%06" PRIu64 ".trace", sequence_ + 1);
+    std::string path = directory_ + name;
+    if (!writer_.Open(path, next_alloc_)) {
+        if (!open_failed_) {
+            LOG_ERROR("Failed to open segment {}, dropping events until a segment can be opened", path);
+            open_failed_ = true;
+        }
+        return false;
+    }
+    if (open_failed_) {
+        LOG_INFO("Segment {} opened, {} events dropped so far", path, GetDroppedEventCount());
+        open_failed_ = false;
+    }
+    ++sequence_;
+    segment_start_ = std::chrono::steady_clock::now();
+    segments_.push_back(path);
+    RemoveOldSegments();
+    return true;
+}
+
+void SegmentWriter::SealSegment() {
+    if (writer_.IsOpen()) {
+        writer_.Close();
+    }
+}
+
+void SegmentWriter::RemoveOldSegments() {
+    while (options_.max_segments > 0 && segments_.size() > options_.max_segments) {
+        unlink(segments_.front().c_str());
+        LOG_INFO("Removed old segment {}", segments_.front());
+        segments_.pop_front();
+    }
+}
+
+uint64_t SegmentWriter::FindLastSequence() const {
+    uint64_t last = 0;
+    DIR* dir = opendir(directory_.c_str());
+    if (!dir) {
+        return last;
+    }
+    while (struct dirent* entry = readdir(dir)) {
+        uint64_t sequence = 0;
+        char suffix[8] = {0};
+        if (sscanf(entry->d_name, "segment-%" SCNu64 ".%7s", &sequence, suffix) == 2 &&
+            std::string(suffix) == "trace" && sequence > last) {
+            last = sequence;
+        }
+    }
+    closedir(dir);
+    return last;
+}
+
+} // namespace storage
+} // namespace memory_tracer
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "capture/capture.h"
+#include "capture/live_table.h"
+#include "storage/storage.h"
+#include "storage/trace_file.h"
+
+namespace memory_tracer {
+namespace storage {
+
+// 后台分段写入：捕获事件先追加到内存中的批次，后台线程定期把批次写入当前分段并刷新到文件，
+// 分段达到大小或时长上限后封存（写出索引）并开始下一个分段。
+// 分段文件为 <directory>/segment-<序号>.trace，分配序号跨分段连续，释放事件可以引用之前分段中的分配
+class SegmentWriter {
+public:
+    SegmentWriter(const std::string& directory, const SegmentOptions& options);
+    ~SegmentWriter();
+
+    SegmentWriter(const SegmentWriter&) = delete;
+    SegmentWriter& operator=(const SegmentWriter&) = delete;
+
+    void Start();
+
+    // 写出剩余的事件并封存当前分段
+    void Stop();
+
+    // 追加事件；待写出的事件超过上限时等待后台线程写出
+    void Append(const capture::CaptureEvent* events, size_t count);
+
+    // 分段无法打开而丢弃的事件数
+    uint64_t GetDroppedEventCount() const;
+
+private:
+    static constexpr size_t kMaxPendingEvents = 1 << 20;
+
+    void Run();
+    void WriteBatch(const std::vector<capture::CaptureEvent>& batch);
+    bool OpenSegment();
+    void SealSegment();
+    void RemoveOldSegments();
+
+    // 目录中已有分段的最大序号，重启后从下一个序号继续
+    uint64_t FindLastSequence() const;
+
+    std::string directory_;
+    SegmentOptions options_;
+
+    std::mutex mutex_;
+    std::condition_variable work_cv_;    // 通知后台线程
+    std::condition_variable space_cv_;   // 通知等待的写入方
+    std::vector<capture::CaptureEvent> pending_;
+    bool running_;
+    std::thread thread_;
+    std::atomic<uint64_t> dropped_;
+
+    // 以下只由后台线程访问
+    std::vector<capture::CaptureEvent> writing_;
+    TraceWriter writer_;
+    capture::LiveTable<uint64_t> live_;  // 未释放的地址 -> 分配序号
+    uint64_t next_alloc_;
+    uint64_t sequence_;
+    bool open_failed_;                   // 已记录打开失败的日志，成功打开后重置
+    std::chrono::steady_clock::time_point segment_start_;
+    std::deque<std::string> segments_;   // 本次运行写出的分段，用于按数量淘汰
+};
+
+} // namespace storage
+} // namespace memory_tracer
@@ -1,18 +1,77 @@
 #include "storage/storage.h"
+#include "storage/trace_file.h"
+#include "record_store.h"
+#include "record_index.h"
+#include "column_store.h"
+#include "heap_profile.h"
+#include "mapped_trace.h"
+#include "segment_writer.h"
+#include "capture/live_table.h"
+#include "capture/stack_table.h"
+#include "capture/symbolizer.h"
+#include "capture/internal_allocator.h"
+#include "capture/tracer_stats.h"
 #include "logger/logger.h"
+#include "parallel/parallel.h"
 #include <fstream>
 #include <algorithm>
+#include <iterator>
+#include <deque>
+#include <map>
 #include <mutex>
 #include <unordered_map>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <fcntl.h>
+#include <thread>
+#include <unistd.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
 namespace memory_tracer {
 namespace storage {
 
+namespace {
+
+// 快照信号处理函数只向管道写入一个字节，由后台线程拍摄快照
+std::atomic<int> g_snapshot_pipe{-1};
+
+void HandleSnapshotSignal(int) {
+    int saved_errno = errno;
+    int fd = g_snapshot_pipe.load(std::memory_order_relaxed);
+    if (fd >= 0) {
+        char request = 1;
+        ssize_t written = write(fd, &request, 1);
+        (void)written;
+    }
+    errno = saved_errno;
+}
+
+} // namespace
+
+capture::AllocationInfo RecordView::ToAllocationInfo() const {
+    capture::AllocationInfo info;
+    info.timestamp = timestamp;
+    info.address = address;
+    info.size = size;
+    info.function.assign(function.data(), function.size());
+    info.file.assign(file.data(), file.size());
+    info.line = line;
+    info.thread_id = thread_id;
+    info.stack_id = stack_id;
+    info.kind = kind;
+    info.sample_interval = sample_interval;
+    return info;
+}
+
 class Storage::Impl {
 public:
-    Impl() : max_allocations_(1000000) {}
+    Impl() {
+        SetRecordStore(std::make_unique<RowRecordStore>(kDefaultMaxAllocations));
+    }
 
     void Initialize(const std::string& data_dir) {
         data_dir_ = data_dir;
@@ -24,29 +83,22 @@ public:
     }
 
     void Shutdown() {
+        DisableSnapshotSignal();
+        StopSegmentWriter();
         SaveToFile();
         Clear();
         LOG_INFO("Storage module shutdown");
     }
 
-    void AddAllocation(const capture::AllocationInfo& info) {
-        std::lock_guard<std::mutex> lock(mutex_);
-
-        if (allocations_.size() >= max_allocations_) {
-            // 达到上限，移除最旧的记录
-            allocations_.erase(allocations_.begin());
-        }
-
-        allocations_.push_back(info);
-
-        // 更新索引
-        function_index_[info.function].push_back(allocations_.size() - 1);
-        file_index_[info.file].push_back(allocations_.size() - 1);
-        time_index_.push_back({info.timestamp, allocations_.size() - 1});
+    RecordHandle AddAllocation(const capture::AllocationInfo& info) {
+        capture::ScopedTracerTimer timer(capture::TracerTimer::STORAGE_ADD_ALLOCATION);
+        capture::CountedLockGuard<std::mutex> lock(mutex_, capture::TracerCounter::STORAGE_LOCK_CONTENTIONS);
+        return AppendRecord(info);
+    }
 
-        // 按时间排序
-        std::sort(time_index_.begin(), time_index_.end(),
-            [](const auto& a, const auto& b) { return a.first < b.first; });
+    bool GetRecord(RecordHandle handle, capture::AllocationInfo* info) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return records_->Get(handle, info);
     }
 
     void AddAllocations(const std::vector<capture::AllocationInfo>& allocations) {
@@ -55,98 +107,200 @@ public:
         }
     }
 
-    QueryResult QueryByFunction(const std::string& function_name) {
-        QueryResult result;
+    void AddEvents(const capture::CaptureEvent* events, size_t count) {
+        capture::ScopedTracerTimer timer(capture::TracerTimer::STORAGE_ADD_EVENTS);
+        std::shared_ptr<SegmentWriter> segments;
+        bool retain_records = true;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            segments = segments_;
+            retain_records = !segments_ || segments_retain_records_;
+        }
+        if (segments) {
+            segments->Append(events, count);
+        }
+        if (!retain_records) {
+            return;
+        }
 
-        std::lock_guard<std::mutex> lock(mutex_);
-        auto it = function_index_.find(function_name);
-        if (it == function_index_.end()) {
-            return result;
-        }
-
-        for (size_t idx : it->second) {
-            if (idx < allocations_.size()) {
-                const auto& info = allocations_[idx];
-                if (info.address != nullptr) {  // 只统计未释放的
-                    result.allocations.push_back(info);
-                    result.total_count++;
-                    result.total_size += info.size;
-                }
+        for (size_t i = 0; i < count; ++i) {
+            const auto& event = events[i];
+            if (event.type == capture::EventType::ALLOC) {
+                AddAllocation(capture::MakeAllocationInfo(event));
+            } else {
+                RecordDeallocation(event.address);
             }
         }
-
-        CalculatePeakUsage(result);
-        return result;
     }
 
-    QueryResult QueryByFile(const std::string& file_path) {
-        QueryResult result;
+    void RecordDeallocation(void* address) {
+        capture::CountedLockGuard<std::mutex> lock(mutex_, capture::TracerCounter::STORAGE_LOCK_CONTENTIONS);
+        FreeRecord(address);
+    }
 
-        std::lock_guard<std::mutex> lock(mutex_);
-        auto it = file_index_.find(file_path);
-        if (it == file_index_.end()) {
-            return result;
-        }
-
-        for (size_t idx : it->second) {
-            if (idx < allocations_.size()) {
-                const auto& info = allocations_[idx];
-                if (info.address != nullptr) {
-                    result.allocations.push_back(info);
-                    result.total_count++;
-                    result.total_size += info.size;
-                }
-            }
+    QueryAggregate VisitByFunction(const std::string& function_name, const RecordVisitor& visitor) {
+        QueryAggregate aggregate;
+        if (VisitTrace([&](MappedTrace& trace, const RecordVisitor& trace_visitor) {
+                trace.VisitByFunction(function_name, trace_visitor);
+            }, visitor, &aggregate)) {
+            return aggregate;
         }
+        return VisitByIndex(function_index_, function_name, visitor);
+    }
 
-        CalculatePeakUsage(result);
-        return result;
+    QueryAggregate VisitByFile(const std::string& file_path, const RecordVisitor& visitor) {
+        QueryAggregate aggregate;
+        if (VisitTrace([&](MappedTrace& trace, const RecordVisitor& trace_visitor) {
+                trace.VisitByFile(file_path, trace_visitor);
+            }, visitor, &aggregate)) {
+            return aggregate;
+        }
+        return VisitByIndex(file_index_, file_path, visitor);
     }
 
-    QueryResult QueryBySizeRange(size_t min_size, size_t max_size) {
-        QueryResult result;
+    QueryAggregate VisitByStack(uint64_t stack_id, const RecordVisitor& visitor) {
+        QueryAggregate aggregate;
+        if (VisitTrace([&](MappedTrace& trace, const RecordVisitor& trace_visitor) {
+                trace.VisitByStack(stack_id, trace_visitor);
+            }, visitor, &aggregate)) {
+            return aggregate;
+        }
+        return VisitByIndex(stack_index_, stack_id, visitor);
+    }
 
-        std::lock_guard<std::mutex> lock(mutex_);
-        for (const auto& info : allocations_) {
-            if (info.address != nullptr && info.size >= min_size && info.size <= max_size) {
-                result.allocations.push_back(info);
-                result.total_count++;
-                result.total_size += info.size;
-            }
+    QueryAggregate VisitBySizeRange(size_t min_size, size_t max_size, const RecordVisitor& visitor) {
+        QueryAggregate aggregate;
+        if (VisitTrace([&](MappedTrace& trace, const RecordVisitor& trace_visitor) {
+                trace.VisitSizeRange(min_size, max_size, trace_visitor);
+            }, visitor, &aggregate)) {
+            return aggregate;
         }
+        if (UseIndex([&]() { return size_index_.Count(min_size, max_size); })) {
+            return VisitCandidates([&](std::vector<RecordHandle>* handles) {
+                size_index_.Find(min_size, max_size, handles);
+            }, [&](const RecordView& view) {
+                return view.address != nullptr && view.size >= min_size && view.size <= max_size;
+            }, visitor);
+        }
+        return VisitScan([&](const RecordStore& store, const RecordVisitor& scan_visitor) {
+            store.VisitSizeRange(min_size, max_size, scan_visitor);
+        }, visitor);
+    }
 
-        CalculatePeakUsage(result);
-        return result;
+    QueryAggregate VisitByTimeRange(uint64_t start_time, uint64_t end_time, const RecordVisitor& visitor) {
+        QueryAggregate aggregate;
+        if (VisitTrace([&](MappedTrace& trace, const RecordVisitor& trace_visitor) {
+                trace.VisitTimeRange(start_time, end_time, trace_visitor);
+            }, visitor, &aggregate)) {
+            return aggregate;
+        }
+        if (UseIndex([&]() { return time_index_.Count(start_time, end_time); })) {
+            return VisitCandidates([&](std::vector<RecordHandle>* handles) {
+                time_index_.Find(start_time, end_time, handles);
+            }, [](const RecordView&) { return true; }, visitor);
+        }
+        return VisitScan([&](const RecordStore& store, const RecordVisitor& scan_visitor) {
+            store.VisitTimeRange(start_time, end_time, scan_visitor);
+        }, visitor);
     }
 
-    QueryResult QueryByTimeRange(uint64_t start_time, uint64_t end_time) {
-        QueryResult result;
+    QueryAggregate VisitByThread(uint32_t thread_id, const RecordVisitor& visitor) {
+        QueryAggregate aggregate;
+        if (VisitTrace([&](MappedTrace& trace, const RecordVisitor& trace_visitor) {
+                trace.VisitByThread(thread_id, trace_visitor);
+            }, visitor, &aggregate)) {
+            return aggregate;
+        }
+        return VisitByIndex(thread_index_, thread_id, visitor);
+    }
 
-        std::lock_guard<std::mutex> lock(mutex_);
-        for (const auto& info : allocations_) {
-            if (info.timestamp >= start_time && info.timestamp <= end_time) {
-                result.allocations.push_back(info);
-                result.total_count++;
-                if (info.address != nullptr) {
-                    result.total_size += info.size;
+    QueryAggregate VisitByAddressRange(uintptr_t begin, uintptr_t end, const RecordVisitor& visitor) {
+        QueryAggregate aggregate;
+        if (VisitTrace([&](MappedTrace& trace, const RecordVisitor& trace_visitor) {
+                trace.VisitAddressRange(begin, end, trace_visitor);
+            }, visitor, &aggregate)) {
+            return aggregate;
+        }
+        return VisitCandidates([&](std::vector<RecordHandle>* handles) {
+            if (begin >= end) {
+                return;
+            }
+            // 未释放的分配互不重叠，起始地址在 begin 之前的只有前一个可能与区间重叠
+            auto it = address_index_.lower_bound(begin);
+            if (it != address_index_.begin()) {
+                auto previous = std::prev(it);
+                if (previous->first + previous->second.size > begin) {
+                    handles->push_back(previous->second.handle);
                 }
             }
+            for (; it != address_index_.end() && it->first < end; ++it) {
+                handles->push_back(it->second.handle);
+            }
+            std::sort(handles->begin(), handles->end());
+        }, [](const RecordView& view) { return view.address != nullptr; }, visitor);
+    }
+
+    QueryAggregate VisitLeaks(const RecordVisitor& visitor) {
+        QueryAggregate aggregate;
+        if (VisitTrace([&](MappedTrace& trace, const RecordVisitor& trace_visitor) {
+                trace.VisitLive(trace_visitor);
+            }, visitor, &aggregate)) {
+            return aggregate;
         }
+        return VisitScan([](const RecordStore& store, const RecordVisitor& scan_visitor) {
+            store.VisitLive(scan_visitor);
+        }, visitor);
+    }
 
-        CalculatePeakUsage(result);
-        return result;
+    QueryResult QueryByFunction(const std::string& function_name) {
+        return Collect([&](const RecordVisitor& visitor) { return VisitByFunction(function_name, visitor); });
     }
 
-    std::vector<capture::AllocationInfo> GetLeaks() {
-        std::vector<capture::AllocationInfo> leaks;
+    QueryResult QueryByFile(const std::string& file_path) {
+        return Collect([&](const RecordVisitor& visitor) { return VisitByFile(file_path, visitor); });
+    }
 
-        std::lock_guard<std::mutex> lock(mutex_);
-        for (const auto& info : allocations_) {
-            if (info.address != nullptr) {
-                leaks.push_back(info);
-            }
+    QueryResult QueryByStack(uint64_t stack_id) {
+        return Collect([&](const RecordVisitor& visitor) { return VisitByStack(stack_id, visitor); });
+    }
+
+    QueryResult QueryBySizeRange(size_t min_size, size_t max_size) {
+        if (!IsTraceOpen() && !UseIndex([&]() { return size_index_.Count(min_size, max_size); })) {
+            return CollectScan([&](const RecordStore& store, const RecordVisitor& scan_visitor) {
+                store.VisitSizeRange(min_size, max_size, scan_visitor);
+            });
+        }
+        return Collect([&](const RecordVisitor& visitor) { return VisitBySizeRange(min_size, max_size, visitor); });
+    }
+
+    QueryResult QueryByTimeRange(uint64_t start_time, uint64_t end_time) {
+        if (!IsTraceOpen() && !UseIndex([&]() { return time_index_.Count(start_time, end_time); })) {
+            return CollectScan([&](const RecordStore& store, const RecordVisitor& scan_visitor) {
+                store.VisitTimeRange(start_time, end_time, scan_visitor);
+            });
         }
+        return Collect([&](const RecordVisitor& visitor) { return VisitByTimeRange(start_time, end_time, visitor); });
+    }
+
+    QueryResult QueryByThread(uint32_t thread_id) {
+        return Collect([&](const RecordVisitor& visitor) { return VisitByThread(thread_id, visitor); });
+    }
+
+    QueryResult QueryByAddressRange(uintptr_t begin, uintptr_t end) {
+        return Collect([&](const RecordVisitor& visitor) { return VisitByAddressRange(begin, end, visitor); });
+    }
 
+    std::vector<capture::AllocationInfo> GetLeaks() {
+        if (!IsTraceOpen()) {
+            return CollectScan([](const RecordStore& store, const RecordVisitor& scan_visitor) {
+                store.VisitLive(scan_visitor);
+            }).allocations;
+        }
+        std::vector<capture::AllocationInfo> leaks;
+        VisitLeaks([&](const RecordView& view) {
+            leaks.push_back(view.ToAllocationInfo());
+            return true;
+        });
         return leaks;
     }
 
@@ -154,19 +308,20 @@ public:
         std::lock_guard<std::mutex> lock(mutex_);
 
         json summary;
-        summary["total_allocations"] = allocations_.size();
+        summary["total_allocations"] = records_->Size();
+        summary["layout"] = records_->GetLayout() == StorageLayout::COLUMNAR ? "columnar" : "row";
         summary["unique_functions"] = function_index_.size();
         summary["data_dir"] = data_dir_;
 
         // 统计每个函数的分配情况
         json functions = json::object();
-        for (const auto& [func, indices] : function_index_) {
+        for (const auto& [func, handles] : function_index_) {
             size_t count = 0;
             size_t total_size = 0;
-            for (size_t idx : indices) {
-                if (idx < allocations_.size()) {
+            for (RecordHandle handle : handles) {
+                if (records_->Contains(handle)) {
                     count++;
-                    total_size += allocations_[idx].size;
+                    total_size += records_->GetRecordSize(handle);
                 }
             }
             functions[func] = {
@@ -180,30 +335,54 @@ public:
     }
 
     bool ExportToJson(const std::string& filepath) {
-        std::lock_guard<std::mutex> lock(mutex_);
+        // 在快照上导出，不阻塞写入
+        std::unique_ptr<RecordStore> snapshot = TakeSnapshot();
 
         try {
             json j;
             j["allocations"] = json::array();
+            j["stacks"] = json::object();
 
-            for (const auto& info : allocations_) {
+            auto& stack_table = capture::StackTable::GetInstance();
+            auto& symbolizer = capture::Symbolizer::GetInstance();
+
+            snapshot->VisitAll([&](const RecordView& view) {
                 j["allocations"].push_back({
-                    {"timestamp", info.timestamp},
-                    {"address", reinterpret_cast<uint64_t>(info.address)},
-                    {"size", info.size},
-                    {"function", info.function},
-                    {"file", info.file},
-                    {"line", info.line},
-                    {"thread_id", info.thread_id},
-                    {"stack_trace", info.stack_trace}
+                    {"timestamp", view.timestamp},
+                    {"address", reinterpret_cast<uint64_t>(view.address)},
+                    {"size", view.size},
+                    {"function", view.function},
+                    {"file", view.file},
+                    {"line", view.line},
+                    {"thread_id", view.thread_id},
+                    {"stack_id", view.stack_id},
+                    {"kind", static_cast<int>(view.kind)},
+                    {"sample_interval", view.sample_interval}
                 });
-            }
+
+                // 每个调用栈只写一次，符号化在导出时进行
+                std::string stack_key = std::to_string(view.stack_id);
+                if (view.stack_id == capture::kInvalidStackId || j["stacks"].contains(stack_key)) {
+                    return true;
+                }
+                std::vector<uint64_t> frames;
+                std::vector<std::string> symbols;
+                for (void* pc : stack_table.GetFrames(view.stack_id)) {
+                    frames.push_back(reinterpret_cast<uint64_t>(pc));
+                    symbols.push_back(symbolizer.Resolve(pc));
+                }
+                j["stacks"][stack_key] = {
+                    {"frames", frames},
+                    {"symbols", symbols}
+                };
+                return true;
+            });
 
             std::ofstream file(filepath);
             file << j.dump(2);
             file.close();
 
-            LOG_INFO("Exported {} allocations to {}", allocations_.size(), filepath);
+            LOG_INFO("Exported {} allocations to {}", snapshot->Size(), filepath);
             return true;
         } catch (const std::exception& e) {
             LOG_ERROR("Failed to export to JSON: {}", e.what());
@@ -222,6 +401,24 @@ public:
             json j;
             file >> j;
 
+            // 重新登记调用栈，并用导出时的符号预填充缓存
+            std::unordered_map<uint64_t, capture::StackId> stack_ids;
+            if (j.contains("stacks")) {
+                for (const auto& [key, stack] : j["stacks"].items()) {
+                    std::vector<void*> frames;
+                    for (const auto& frame : stack["frames"]) {
+                        frames.push_back(reinterpret_cast<void*>(static_cast<uintptr_t>(frame.get<uint64_t>())));
+                    }
+                    const auto& symbols = stack["symbols"];
+                    for (size_t i = 0; i < frames.size() && i < symbols.size(); ++i) {
+                        capture::Symbolizer::GetInstance().AddSymbol(frames[i], symbols[i].get<std::string>());
+                    }
+                    stack_ids[std::stoull(key)] =
+                        capture::StackTable::GetInstance().Intern(frames.data(), frames.size());
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(mutex_);
             if (j.contains("allocations")) {
                 for (const auto& item : j["allocations"]) {
                     capture::AllocationInfo info;
@@ -232,14 +429,20 @@ public:
                     info.file = item["file"];
                     info.line = item["line"];
                     info.thread_id = item["thread_id"];
-                    info.stack_trace = item["stack_trace"].get<std::vector<std::string>>();
+                    if (item.contains("sample_interval")) {
+                        info.sample_interval = item["sample_interval"];
+                    }
+                    if (item.contains("kind")) {
+                        info.kind = static_cast<capture::AllocationKind>(item["kind"].get<int>());
+                    }
+                    if (item.contains("stack_id")) {
+                        auto it = stack_ids.find(item["stack_id"].get<uint64_t>());
+                        if (it != stack_ids.end()) {
+                            info.stack_id = it->second;
+                        }
+                    }
 
-                    allocations_.push_back(info);
-
-                    // 更新索引
-                    function_index_[info.function].push_back(allocations_.size() - 1);
-                    file_index_[info.file].push_back(allocations_.size() - 1);
-                    time_index_.push_back({info.timestamp, allocations_.size() - 1});
+                    AppendRecord(info);
                 }
             }
 
@@ -251,27 +454,96 @@ public:
         }
     }
 
-    json GetAllocationTimeline(size_t bucket_size_ns) {
+    bool ExportToTrace(const std::string& filepath) {
+        // 在快照上逐条写出，不构造整份文档
+        std::unique_ptr<RecordStore> snapshot = TakeSnapshot();
+
+        TraceWriter writer;
+        if (!writer.Open(filepath)) {
+            LOG_ERROR("Failed to open trace file: {}", filepath);
+            return false;
+        }
+        snapshot->VisitAll([&](const RecordView& view) {
+            writer.WriteRecord(view);
+            return true;
+        });
+        return writer.Close();
+    }
+
+    bool ImportFromTrace(const std::string& filepath) {
+        TraceReader reader;
+        if (!reader.Open(filepath)) {
+            return false;
+        }
+
         std::lock_guard<std::mutex> lock(mutex_);
+        TraceHandler handler;
+        handler.on_allocation = [this](const capture::AllocationInfo& info) { AppendRecord(info); };
+        handler.on_free = [this](uint64_t, void* address) { FreeRecord(address); };
+        bool complete = reader.Replay(handler);
 
-        if (allocations_.empty()) {
-            return json::array();
+        LOG_INFO("Imported allocations from {}", filepath);
+        return complete;
+    }
+
+    bool OpenTrace(const std::string& filepath) {
+        auto trace = std::make_shared<MappedTrace>();
+        if (!trace->Open(filepath)) {
+            return false;
         }
+        std::lock_guard<std::mutex> lock(mutex_);
+        trace_ = std::move(trace);
+        return true;
+    }
 
-        uint64_t min_time = std::min_element(allocations_.begin(), allocations_.end(),
-            [](const auto& a, const auto& b) { return a.timestamp < b.timestamp; })->timestamp;
+    void CloseTrace() {
+        std::shared_ptr<MappedTrace> trace;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            trace.swap(trace_);
+        }
+        // 仍在进行的查询持有引用，最后一个引用释放时解除映射
+        if (trace) {
+            LOG_INFO("Closed trace {}", trace->GetPath());
+        }
+    }
 
-        uint64_t max_time = std::max_element(allocations_.begin(), allocations_.end(),
-            [](const auto& a, const auto& b) { return a.timestamp < b.timestamp; })->timestamp;
+    bool IsTraceOpen() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return trace_ != nullptr;
+    }
 
-        std::map<uint64_t, size_t> timeline;
+    void StartSegmentWriter(const SegmentOptions& options) {
+        StopSegmentWriter();
+        auto segments = std::make_shared<SegmentWriter>(data_dir_, options);
+        segments->Start();
+        std::lock_guard<std::mutex> lock(mutex_);
+        segments_ = segments;
+        segments_retain_records_ = options.retain_records;
+    }
 
-        for (const auto& info : allocations_) {
-            if (info.address != nullptr) {
-                uint64_t bucket = ((info.timestamp - min_time) / bucket_size_ns) * bucket_size_ns + min_time;
-                timeline[bucket] += info.size;
-            }
+    void StopSegmentWriter() {
+        std::shared_ptr<SegmentWriter> segments;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            segments.swap(segments_);
+        }
+        if (segments) {
+            segments->Stop();
+            std::lock_guard<std::mutex> lock(mutex_);
+            retired_segment_dropped_ += segments->GetDroppedEventCount();
         }
+    }
+
+    uint64_t GetSegmentDroppedEventCount() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return retired_segment_dropped_ + (segments_ ? segments_->GetDroppedEventCount() : 0);
+    }
+
+    json GetAllocationTimeline(size_t bucket_size_ns) {
+        std::shared_ptr<MappedTrace> trace = GetTrace();
+        std::map<uint64_t, size_t> timeline = trace ? trace->BuildTimeline(bucket_size_ns)
+                                                    : BuildTimeline(*TakeSnapshot(), bucket_size_ns);
 
         json result = json::array();
         for (const auto& [time, size] : timeline) {
@@ -285,40 +557,577 @@ public:
     }
 
     void SetMaxAllocations(size_t max_allocations) {
-        max_allocations_ = max_allocations;
+        std::lock_guard<std::mutex> lock(mutex_);
+        records_->SetCapacity(max_allocations);
+    }
+
+    void SetLayout(StorageLayout layout) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (records_->GetLayout() == layout) {
+            return;
+        }
+
+        std::unique_ptr<RecordStore> store;
+        if (layout == StorageLayout::COLUMNAR) {
+            store = std::make_unique<ColumnRecordStore>(records_->GetCapacity());
+        } else {
+            store = std::make_unique<RowRecordStore>(records_->GetCapacity());
+        }
+
+        // 按原顺序迁移，句柄与索引保持不变
+        store->SetNextHandle(records_->FirstHandle());
+        records_->VisitAll([&](const RecordView& view) {
+            store->Append(view.ToAllocationInfo());
+            return true;
+        });
+        SetRecordStore(std::move(store));
+        LOG_INFO("Storage layout switched to {}", layout == StorageLayout::COLUMNAR ? "columnar" : "row");
+    }
+
+    StorageLayout GetLayout() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return records_->GetLayout();
     }
 
     void Clear() {
         std::lock_guard<std::mutex> lock(mutex_);
-        allocations_.clear();
+        records_->Clear();
         function_index_.clear();
         file_index_.clear();
-        time_index_.clear();
+        stack_index_.clear();
+        thread_index_.clear();
+        time_index_.Clear();
+        size_index_.Clear();
+        live_index_.Clear();
+        address_index_.clear();
+        heap_profile_.Clear();
+        heap_snapshots_.clear();
+    }
+
+    uint64_t TakeHeapSnapshot(const std::string& label) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        HeapSnapshot snapshot;
+        snapshot.info.id = next_snapshot_id_++;
+        snapshot.info.label = label;
+        snapshot.info.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+        snapshot.info.live_count = heap_profile_.GetTotalCount();
+        snapshot.info.live_bytes = heap_profile_.GetTotalBytes();
+        snapshot.info.stack_count = heap_profile_.GetStackCount();
+        snapshot.profile = heap_profile_.Snapshot();
+        heap_snapshots_.push_back(std::move(snapshot));
+        if (heap_snapshots_.size() > kMaxHeapSnapshots) {
+            heap_snapshots_.pop_front();
+        }
+        return heap_snapshots_.back().info.id;
+    }
+
+    std::vector<HeapSnapshotInfo> GetHeapSnapshots() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<HeapSnapshotInfo> result;
+        result.reserve(heap_snapshots_.size());
+        for (const auto& snapshot : heap_snapshots_) {
+            result.push_back(snapshot.info);
+        }
+        return result;
+    }
+
+    std::vector<StackUsage> GetHeapSnapshot(uint64_t snapshot_id) {
+        HeapProfile profile;
+        if (!FindHeapSnapshot(snapshot_id, &profile)) {
+            return {};
+        }
+
+        std::vector<StackUsage> result;
+        result.reserve(profile.GetStackCount());
+        profile.ForEach([&](const StackUsage& usage) { result.push_back(usage); });
+        std::sort(result.begin(), result.end(),
+            [](const StackUsage& a, const StackUsage& b) { return a.bytes > b.bytes; });
+        return result;
+    }
+
+    void DropHeapSnapshot(uint64_t snapshot_id) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        heap_snapshots_.erase(
+            std::remove_if(heap_snapshots_.begin(), heap_snapshots_.end(),
+                [&](const HeapSnapshot& snapshot) { return snapshot.info.id == snapshot_id; }),
+            heap_snapshots_.end());
+    }
+
+    std::vector<StackGrowth> DiffHeapSnapshots(uint64_t from_id, uint64_t to_id, size_t limit) {
+        HeapProfile from;
+        HeapProfile to;
+        if (!FindHeapSnapshot(from_id, &from) || !FindHeapSnapshot(to_id, &to)) {
+            return {};
+        }
+
+        std::vector<StackGrowth> result;
+        HeapProfile::Diff(from, to, [&](uint64_t stack_id, const StackUsage& before, const StackUsage& after) {
+            result.push_back(MakeGrowth(stack_id, before, after));
+        });
+        SortGrowth(&result, limit);
+        return result;
+    }
+
+    std::vector<StackGrowth> GetGrowingStacks(size_t snapshot_count, size_t limit) {
+        // 快照拷贝只复制桶指针，比较在锁外进行
+        std::vector<HeapProfile> profiles;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            size_t count = std::min(snapshot_count, heap_snapshots_.size());
+            for (size_t i = heap_snapshots_.size() - count; i < heap_snapshots_.size(); ++i) {
+                profiles.push_back(heap_snapshots_[i].profile);
+            }
+        }
+        if (profiles.size() < 2) {
+            return {};
+        }
+
+        std::vector<StackGrowth> result;
+        HeapProfile::Diff(profiles.front(), profiles.back(),
+            [&](uint64_t stack_id, const StackUsage& before, const StackUsage& after) {
+                if (after.bytes <= before.bytes) {
+                    return;
+                }
+                // 中间任意一次减少都说明不是持续增长
+                uint64_t previous = before.bytes;
+                for (size_t i = 1; i + 1 < profiles.size(); ++i) {
+                    uint64_t bytes = profiles[i].Find(stack_id).bytes;
+                    if (bytes < previous) {
+                        return;
+                    }
+                    previous = bytes;
+                }
+                result.push_back(MakeGrowth(stack_id, before, after));
+            });
+        SortGrowth(&result, limit);
+        return result;
+    }
+
+    bool EnableSnapshotSignal(int signum) {
+        std::lock_guard<std::mutex> lock(signal_mutex_);
+        if (snapshot_signal_ != 0) {
+            LOG_WARN("Heap snapshot signal already enabled: {}", snapshot_signal_);
+            return false;
+        }
+        if (pipe2(snapshot_pipe_, O_CLOEXEC | O_NONBLOCK) != 0) {
+            LOG_ERROR("Failed to create heap snapshot pipe");
+            return false;
+        }
+        // 读端阻塞等待，写端保持非阻塞，信号处理函数不会卡住
+        fcntl(snapshot_pipe_[0], F_SETFL, 0);
+        g_snapshot_pipe.store(snapshot_pipe_[1]);
+
+        struct sigaction action = {};
+        action.sa_handler = HandleSnapshotSignal;
+        action.sa_flags = SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        if (sigaction(signum, &action, &old_snapshot_action_) != 0) {
+            LOG_ERROR("Failed to install heap snapshot handler for signal {}", signum);
+            g_snapshot_pipe.store(-1);
+            close(snapshot_pipe_[0]);
+            close(snapshot_pipe_[1]);
+            return false;
+        }
+        snapshot_signal_ = signum;
+        snapshot_thread_ = std::thread([this]() { RunSnapshotSignal(); });
+        LOG_INFO("Heap snapshot on signal {} enabled", signum);
+        return true;
+    }
+
+    void DisableSnapshotSignal() {
+        std::lock_guard<std::mutex> lock(signal_mutex_);
+        if (snapshot_signal_ == 0) {
+            return;
+        }
+        sigaction(snapshot_signal_, &old_snapshot_action_, nullptr);
+        g_snapshot_pipe.store(-1);
+
+        // 写入 0 通知后台线程退出
+        char stop = 0;
+        while (write(snapshot_pipe_[1], &stop, 1) < 0 && errno == EINTR) {
+        }
+        if (snapshot_thread_.joinable()) {
+            snapshot_thread_.join();
+        }
+        close(snapshot_pipe_[0]);
+        close(snapshot_pipe_[1]);
+        snapshot_signal_ = 0;
+        LOG_INFO("Heap snapshot signal disabled");
     }
 
 private:
-    void CalculatePeakUsage(QueryResult& result) {
-        size_t peak = 0;
-        for (const auto& info : result.allocations) {
-            if (info.size > peak) {
-                peak = info.size;
+    // 调用方持有 mutex_
+    RecordHandle AppendRecord(const capture::AllocationInfo& info) {
+        RecordHandle handle = records_->Append(info);
+        if (handle == kInvalidRecordHandle) {
+            return handle;
+        }
+
+        // 句柄单调递增，每个索引内部天然有序
+        function_index_[info.function].push_back(handle);
+        file_index_[info.file].push_back(handle);
+        stack_index_[info.stack_id].push_back(handle);
+        thread_index_[info.thread_id].push_back(handle);
+        time_index_.Add(info.timestamp, handle);
+        size_index_.Add(info.size, handle);
+        if (info.address != nullptr) {
+            // 漏掉释放事件时地址会被再次分配，先撤销旧记录的聚合
+            LiveRecord previous;
+            if (live_index_.Find(info.address, &previous)) {
+                heap_profile_.Remove(previous.stack_id, previous.count, previous.bytes);
+            }
+            // 与 Stats 相同，采样记录按权重还原为估计的分配次数和字节数
+            double weight = capture::GetSampleWeight(info.size, info.sample_interval);
+            LiveRecord live = {handle, info.stack_id, info.size,
+                               static_cast<uint64_t>(std::llround(weight)),
+                               static_cast<uint64_t>(std::llround(weight * static_cast<double>(info.size)))};
+            live_index_.Insert(info.address, live);
+            address_index_[reinterpret_cast<uintptr_t>(info.address)] = live;
+            heap_profile_.Add(live.stack_id, live.count, live.bytes);
+        }
+        return handle;
+    }
+
+    // 被淘汰的总是全局最旧的记录，因此也位于它所在每个索引的队首
+    void EvictRecord(RecordHandle handle, const RecordKeys& keys) {
+        PopIndex(function_index_, keys.function, handle);
+        PopIndex(file_index_, keys.file, handle);
+        PopIndex(stack_index_, keys.stack_id, handle);
+        PopIndex(thread_index_, keys.thread_id, handle);
+        time_index_.Remove(keys.timestamp, handle);
+        size_index_.Remove(keys.size, handle);
+
+        // 地址可能已被之后的分配复用，只删除仍指向本记录的登记
+        LiveRecord live;
+        if (keys.address != nullptr && live_index_.Find(keys.address, &live) && live.handle == handle) {
+            live_index_.Erase(keys.address);
+            address_index_.erase(reinterpret_cast<uintptr_t>(keys.address));
+            heap_profile_.Remove(live.stack_id, live.count, live.bytes);
+        }
+    }
+
+    void SetRecordStore(std::unique_ptr<RecordStore> store) {
+        store->SetEvictCallback([this](RecordHandle handle, const RecordKeys& keys) { EvictRecord(handle, keys); });
+        records_ = std::move(store);
+    }
+
+    std::unique_ptr<RecordStore> TakeSnapshot() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return records_->Snapshot();
+    }
+
+    std::shared_ptr<MappedTrace> GetTrace() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return trace_;
+    }
+
+    // 已打开 trace 时由 visit(trace, visitor) 回答查询，返回 false 表示应查询内存中的记录
+    template <typename Visit>
+    bool VisitTrace(Visit visit, const RecordVisitor& visitor, QueryAggregate* aggregate) {
+        std::shared_ptr<MappedTrace> trace = GetTrace();
+        if (!trace) {
+            return false;
+        }
+        visit(*trace, [&](const RecordView& view) {
+            Accumulate(view, aggregate);
+            return !visitor || visitor(view);
+        });
+        return true;
+    }
+
+    static void Accumulate(const RecordView& view, QueryAggregate* aggregate) {
+        aggregate->total_count++;
+        if (view.address != nullptr) {
+            aggregate->total_size += view.size;
+        }
+        aggregate->peak_usage = std::max(aggregate->peak_usage, view.size);
+    }
+
+    static void MergeAggregate(QueryAggregate* result, const QueryAggregate& partial) {
+        result->total_count += partial.total_count;
+        result->total_size += partial.total_size;
+        result->peak_usage = std::max(result->peak_usage, partial.peak_usage);
+    }
+
+    template <typename Scan>
+    static QueryAggregate ScanStore(const RecordStore& store, Scan scan, const RecordVisitor& visitor) {
+        QueryAggregate aggregate;
+        scan(store, [&](const RecordView& view) {
+            Accumulate(view, &aggregate);
+            return !visitor || visitor(view);
+        });
+        return aggregate;
+    }
+
+    // 把快照按句柄区间切成分区，并行执行 map(slice, &partial)，再按区间顺序 merge(&result, partial)
+    template <typename Partial, typename Map, typename Merge>
+    static Partial MapSlices(const RecordStore& snapshot, Map map, Merge merge) {
+        RecordHandle first = snapshot.FirstHandle();
+        return parallel::MapReduce<Partial>(snapshot.Size(), kPartitionRecords,
+            [&](size_t begin, size_t end, Partial* partial) {
+                std::unique_ptr<RecordStore> slice = snapshot.Slice(first + begin, first + end);
+                map(*slice, partial);
+            }, merge);
+    }
+
+    // 在快照上执行 scan(store, visitor)，遍历期间不持锁
+    // 只需要聚合结果时按分区并行扫描；visitor 不要求线程安全，有 visitor 时按追加顺序串行回调
+    template <typename Scan>
+    QueryAggregate VisitScan(Scan scan, const RecordVisitor& visitor) {
+        std::unique_ptr<RecordStore> snapshot = TakeSnapshot();
+        if (visitor) {
+            return ScanStore(*snapshot, scan, visitor);
+        }
+        return MapSlices<QueryAggregate>(*snapshot,
+            [&](const RecordStore& slice, QueryAggregate* partial) {
+                *partial = ScanStore(slice, scan, nullptr);
+            },
+            [](QueryAggregate* result, QueryAggregate&& partial) { MergeAggregate(result, partial); });
+    }
+
+    // 各分区分别复制结果集，按区间顺序拼接，结果与串行扫描的顺序一致
+    template <typename Scan>
+    QueryResult CollectScan(Scan scan) {
+        std::unique_ptr<RecordStore> snapshot = TakeSnapshot();
+        return MapSlices<QueryResult>(*snapshot,
+            [&](const RecordStore& slice, QueryResult* partial) {
+                *partial = Collect([&](const RecordVisitor& visitor) { return ScanStore(slice, scan, visitor); });
+            },
+            [](QueryResult* result, QueryResult&& partial) {
+                result->allocations.insert(result->allocations.end(),
+                    std::make_move_iterator(partial.allocations.begin()),
+                    std::make_move_iterator(partial.allocations.end()));
+                result->total_count += partial.total_count;
+                result->total_size += partial.total_size;
+                result->peak_usage = std::max(result->peak_usage, partial.peak_usage);
+            });
+    }
+
+    // 先求全局最早的时间戳作为共同的分桶起点，各分区的时间线再按桶相加
+    static std::map<uint64_t, size_t> BuildTimeline(const RecordStore& snapshot, uint64_t bucket_size_ns) {
+        using Timeline = std::map<uint64_t, size_t>;
+        if (snapshot.Empty() || bucket_size_ns == 0) {
+            return Timeline();
+        }
+        uint64_t origin = MapSlices<uint64_t>(snapshot,
+            [](const RecordStore& slice, uint64_t* partial) { *partial = slice.GetMinTimestamp(); },
+            [](uint64_t* result, uint64_t partial) { *result = std::min(*result, partial); });
+        return MapSlices<Timeline>(snapshot,
+            [&](const RecordStore& slice, Timeline* partial) { *partial = slice.BuildTimeline(bucket_size_ns, origin); },
+            [](Timeline* result, Timeline&& partial) {
+                for (const auto& [bucket, size] : partial) {
+                    (*result)[bucket] += size;
+                }
+            });
+    }
+
+    template <typename Index, typename Key>
+    QueryAggregate VisitByIndex(const Index& index, const Key& key, const RecordVisitor& visitor) {
+        return VisitCandidates([&](std::vector<RecordHandle>* handles) {
+            auto it = index.find(key);
+            if (it != index.end()) {
+                handles->assign(it->second.begin(), it->second.end());
+            }
+        }, [](const RecordView& view) { return view.address != nullptr; }, visitor);  // 只统计未释放的
+    }
+
+    // 二级索引的候选数 count() 不超过记录数的 1/kIndexScanRatio 时按索引读取，否则扫描整个快照更快
+    template <typename Count>
+    bool UseIndex(Count count) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return count() * kIndexScanRatio <= records_->Size();
+    }
+
+    // 持锁由 find(&handles) 从索引中复制按升序排列的候选句柄并拍摄快照，
+    // 之后在快照上逐条读取，只访问满足 predicate 的记录
+    template <typename Find, typename Predicate>
+    QueryAggregate VisitCandidates(Find find, Predicate predicate, const RecordVisitor& visitor) {
+        std::vector<RecordHandle> handles;
+        std::unique_ptr<RecordStore> snapshot;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            find(&handles);
+            if (handles.empty()) {
+                return QueryAggregate();
+            }
+            snapshot = records_->Snapshot();
+        }
+
+        QueryAggregate aggregate;
+        RecordView view;
+        for (RecordHandle handle : handles) {
+            if (!snapshot->View(handle, &view) || !predicate(view)) {
+                continue;
+            }
+            Accumulate(view, &aggregate);
+            if (visitor && !visitor(view)) {
+                break;
+            }
+        }
+        return aggregate;
+    }
+
+    // 通过 visit(visitor) 复制出完整的结果集
+    template <typename Visit>
+    static QueryResult Collect(Visit visit) {
+        QueryResult result;
+        QueryAggregate aggregate = visit([&](const RecordView& view) {
+            result.allocations.push_back(view.ToAllocationInfo());
+            return true;
+        });
+        result.total_count = aggregate.total_count;
+        result.total_size = aggregate.total_size;
+        result.peak_usage = aggregate.peak_usage;
+        return result;
+    }
+
+    template <typename Index, typename Key>
+    static void PopIndex(Index& index, const Key& key, RecordHandle handle) {
+        auto it = index.find(key);
+        if (it == index.end()) {
+            return;
+        }
+        auto& handles = it->second;
+        while (!handles.empty() && handles.front() <= handle) {
+            handles.pop_front();
+        }
+        if (handles.empty()) {
+            index.erase(it);
+        }
+    }
+
+    // 调用方持有 mutex_
+    void FreeRecord(void* address) {
+        LiveRecord live;
+        if (live_index_.Erase(address, &live)) {
+            address_index_.erase(reinterpret_cast<uintptr_t>(address));
+            records_->MarkFreed(live.handle);
+            heap_profile_.Remove(live.stack_id, live.count, live.bytes);
+        }
+    }
+
+    bool FindHeapSnapshot(uint64_t snapshot_id, HeapProfile* profile) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& snapshot : heap_snapshots_) {
+            if (snapshot.info.id == snapshot_id) {
+                *profile = snapshot.profile;
+                return true;
+            }
+        }
+        LOG_WARN("Heap snapshot not found: {}", snapshot_id);
+        return false;
+    }
+
+    static StackGrowth MakeGrowth(uint64_t stack_id, const StackUsage& before, const StackUsage& after) {
+        StackGrowth growth;
+        growth.stack_id = stack_id;
+        growth.count_delta = static_cast<int64_t>(after.count) - static_cast<int64_t>(before.count);
+        growth.bytes_delta = static_cast<int64_t>(after.bytes) - static_cast<int64_t>(before.bytes);
+        growth.count = after.count;
+        growth.bytes = after.bytes;
+        return growth;
+    }
+
+    static void SortGrowth(std::vector<StackGrowth>* growth, size_t limit) {
+        size_t count = limit > 0 ? std::min(limit, growth->size()) : growth->size();
+        std::partial_sort(growth->begin(), growth->begin() + count, growth->end(),
+            [](const StackGrowth& a, const StackGrowth& b) { return a.bytes_delta > b.bytes_delta; });
+        growth->resize(count);
+    }
+
+    void RunSnapshotSignal() {
+        capture::TracerScope scope;
+        char request = 0;
+        while (true) {
+            ssize_t n = read(snapshot_pipe_[0], &request, 1);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0 || request == 0) {
+                return;
+            }
+
+            uint64_t previous_id = 0;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!heap_snapshots_.empty()) {
+                    previous_id = heap_snapshots_.back().info.id;
+                }
+            }
+            uint64_t id = TakeHeapSnapshot("signal");
+            auto snapshots = GetHeapSnapshots();
+            const HeapSnapshotInfo& info = snapshots.back();
+            LOG_INFO("Heap snapshot {}: {} live blocks, {} bytes in {} stacks", id, info.live_count,
+                     info.live_bytes, info.stack_count);
+            if (previous_id == 0) {
+                continue;
+            }
+            for (const auto& growth : DiffHeapSnapshots(previous_id, id, 5)) {
+                if (growth.bytes_delta <= 0) {
+                    break;
+                }
+                LOG_INFO("  stack {:#x}: {:+} bytes, {:+} blocks since snapshot {}", growth.stack_id,
+                         growth.bytes_delta, growth.count_delta, previous_id);
             }
         }
-        result.peak_usage = peak;
     }
 
     bool SaveToFile() {
-        std::string filepath = data_dir_ + "/allocations.json";
-        return ExportToJson(filepath);
+        std::string filepath = data_dir_ + "/allocations.trace";
+        return ExportToTrace(filepath);
     }
 
+    static constexpr size_t kDefaultMaxAllocations = 1000000;
+    static constexpr size_t kMaxHeapSnapshots = 64;
+
+    // 并行扫描的最小分区，更小的扫描直接在调用方线程完成
+    static constexpr size_t kPartitionRecords = 16 * RecordStore::kChunkSize;
+
+    // 命中记录超过总数的 1/8 时范围查询改为扫描
+    static constexpr size_t kIndexScanRatio = 8;
+
+    // 未释放地址 -> 记录句柄，附带聚合所需的调用栈和大小
+    struct LiveRecord {
+        RecordHandle handle;
+        uint64_t stack_id;
+        size_t size;
+        uint64_t count;     // 计入堆快照的估计分配次数
+        uint64_t bytes;     // 计入堆快照的估计字节数
+    };
+
+    struct HeapSnapshot {
+        HeapSnapshotInfo info;
+        HeapProfile profile;
+    };
+
     std::string data_dir_;
-    std::vector<capture::AllocationInfo> allocations_;
-    std::unordered_map<std::string, std::vector<size_t>> function_index_;
-    std::unordered_map<std::string, std::vector<size_t>> file_index_;
-    std::vector<std::pair<uint64_t, size_t>> time_index_;
-    size_t max_allocations_;
+    std::unique_ptr<RecordStore> records_;
+    std::shared_ptr<MappedTrace> trace_;   // OpenTrace 打开的只读 trace
+    std::shared_ptr<SegmentWriter> segments_;   // 后台分段写入，未启动时为空
+    uint64_t retired_segment_dropped_ = 0;      // 已停止的分段写入丢弃的事件数
+    bool segments_retain_records_ = true;
+
+    // 索引保存记录句柄，随记录一起淘汰
+    std::unordered_map<std::string, std::deque<RecordHandle>> function_index_;
+    std::unordered_map<std::string, std::deque<RecordHandle>> file_index_;
+    std::unordered_map<uint64_t, std::deque<RecordHandle>> stack_index_;
+    std::unordered_map<uint32_t, std::deque<RecordHandle>> thread_index_;
+    TimeIndex time_index_;
+    SizeIndex size_index_;
+    capture::LiveTable<LiveRecord> live_index_;
+    std::map<uintptr_t, LiveRecord> address_index_;   // 与 live_index_ 相同的内容按地址排序，用于地址区间查询
+    HeapProfile heap_profile_;   // 未释放内存按调用栈的聚合，与 live_index_ 同步维护
+    std::deque<HeapSnapshot> heap_snapshots_;
+    uint64_t next_snapshot_id_ = 1;
     mutable std::mutex mutex_;
+
+    // 快照信号，由 signal_mutex_ 保护
+    std::mutex signal_mutex_;
+    int snapshot_signal_ = 0;
+    int snapshot_pipe_[2] = {-1, -1};
+    struct sigaction old_snapshot_action_ = {};
+    std::thread snapshot_thread_;
 };
 
 Storage::Storage() : pimpl_(std::make_unique<Impl>()) {}
@@ -329,21 +1138,59 @@ Storage& Storage::GetInstance() {
     return instance;
 }
 
-void Storage::Initialize(const std::string& data_dir) { pimpl_->Initialize(data_dir); }
-void Storage::Shutdown() { pimpl_->Shutdown(); }
-void Storage::AddAllocation(const capture::AllocationInfo& info) { pimpl_->AddAllocation(info); }
-void Storage::AddAllocations(const std::vector<capture::AllocationInfo>& allocations) { pimpl_->AddAllocations(allocations); }
-QueryResult Storage::QueryByFunction(const std::string& function_name) { return pimpl_->QueryByFunction(function_name); }
-QueryResult Storage::QueryByFile(const std::string& file_path) { return pimpl_->QueryByFile(file_path); }
-QueryResult Storage::QueryBySizeRange(size_t min_size, size_t max_size) { return pimpl_->QueryBySizeRange(min_size, max_size); }
-QueryResult Storage::QueryByTimeRange(uint64_t start_time, uint64_t end_time) { return pimpl_->QueryByTimeRange(start_time, end_time); }
-std::vector<capture::AllocationInfo> Storage::GetLeaks() { return pimpl_->GetLeaks(); }
-json Storage::GetSummary() { return pimpl_->GetSummary(); }
-bool Storage::ExportToJson(const std::string& filepath) { return pimpl_->ExportToJson(filepath); }
-bool Storage::ImportFromJson(const std::string& filepath) { return pimpl_->ImportFromJson(filepath); }
-json Storage::GetAllocationTimeline(size_t bucket_size_ns) { return pimpl_->GetAllocationTimeline(bucket_size_ns); }
-void Storage::SetMaxAllocations(size_t max_allocations) { pimpl_->SetMaxAllocations(max_allocations); }
-void Storage::Clear() { pimpl_->Clear(); }
+void Storage::Initialize(const std::string& data_dir) { capture::TracerScope scope; pimpl_->Initialize(data_dir); }
+void Storage::Shutdown() { capture::TracerScope scope; pimpl_->Shutdown(); }
+RecordHandle Storage::AddAllocation(const capture::AllocationInfo& info) { capture::TracerScope scope; return pimpl_->AddAllocation(info); }
+bool Storage::GetRecord(RecordHandle handle, capture::AllocationInfo* info) { capture::TracerScope scope; return pimpl_->GetRecord(handle, info); }
+void Storage::AddAllocations(const std::vector<capture::AllocationInfo>& allocations) { capture::TracerScope scope; pimpl_->AddAllocations(allocations); }
+void Storage::AddEvents(const capture::CaptureEvent* events, size_t count) { capture::TracerScope scope; pimpl_->AddEvents(events, count); }
+void Storage::RecordDeallocation(void* address) { capture::TracerScope scope; pimpl_->RecordDeallocation(address); }
+QueryResult Storage::QueryByFunction(const std::string& function_name) { capture::TracerScope scope; return pimpl_->QueryByFunction(function_name); }
+QueryResult Storage::QueryByFile(const std::string& file_path) { capture::TracerScope scope; return pimpl_->QueryByFile(file_path); }
+QueryResult Storage::QueryByStack(uint64_t stack_id) { capture::TracerScope scope; return pimpl_->QueryByStack(stack_id); }
+QueryResult Storage::QueryBySizeRange(size_t min_size, size_t max_size) { capture::TracerScope scope; return pimpl_->QueryBySizeRange(min_size, max_size); }
+QueryResult Storage::QueryByTimeRange(uint64_t start_time, uint64_t end_time) { capture::TracerScope scope; return pimpl_->QueryByTimeRange(start_time, end_time); }
+QueryResult Storage::QueryByThread(uint32_t thread_id) { capture::TracerScope scope; return pimpl_->QueryByThread(thread_id); }
+QueryResult Storage::QueryByAddressRange(uintptr_t begin, uintptr_t end) { capture::TracerScope scope; return pimpl_->QueryByAddressRange(begin, end); }
+std::vector<capture::AllocationInfo> Storage::GetLeaks() { capture::TracerScope scope; return pimpl_->GetLeaks(); }
+QueryAggregate Storage::VisitByFunction(const std::string& function_name, const RecordVisitor& visitor) { capture::TracerScope scope; return pimpl_->VisitByFunction(function_name, visitor); }
+QueryAggregate Storage::VisitByFile(const std::string& file_path, const RecordVisitor& visitor) { capture::TracerScope scope; return pimpl_->VisitByFile(file_path, visitor); }
+QueryAggregate Storage::VisitByStack(uint64_t stack_id, const RecordVisitor& visitor) { capture::TracerScope scope; return pimpl_->VisitByStack(stack_id, visitor); }
+QueryAggregate Storage::VisitBySizeRange(size_t min_size, size_t max_size, const RecordVisitor& visitor) { capture::TracerScope scope; return pimpl_->VisitBySizeRange(min_size, max_size, visitor); }
+QueryAggregate Storage::VisitByTimeRange(uint64_t start_time, uint64_t end_time, const RecordVisitor& visitor) { capture::TracerScope scope; return pimpl_->VisitByTimeRange(start_time, end_time, visitor); }
+QueryAggregate Storage::VisitByThread(uint32_t thread_id, const RecordVisitor& visitor) { capture::TracerScope scope; return pimpl_->VisitByThread(thread_id, visitor); }
+QueryAggregate Storage::VisitByAddressRange(uintptr_t begin, uintptr_t end, const RecordVisitor& visitor) { capture::TracerScope scope; return pimpl_->VisitByAddressRange(begin, end, visitor); }
+QueryAggregate Storage::VisitLeaks(const RecordVisitor& visitor) { capture::TracerScope scope; return pimpl_->VisitLeaks(visitor); }
+json Storage::GetSummary() { capture::TracerScope scope; return pimpl_->GetSummary(); }
+bool Storage::ExportToJson(const std::string& filepath) { capture::TracerScope scope; return pimpl_->ExportToJson(filepath); }
+bool Storage::ImportFromJson(const std::string& filepath) { capture::TracerScope scope; return pimpl_->ImportFromJson(filepath); }
+bool Storage::ExportToTrace(const std::string& filepath) { capture::TracerScope scope; return pimpl_->ExportToTrace(filepath); }
+bool Storage::ImportFromTrace(const std::string& filepath) { capture::TracerScope scope; return pimpl_->ImportFromTrace(filepath); }
+bool Storage::OpenTrace(const std::string& filepath) { capture::TracerScope scope; return pimpl_->OpenTrace(filepath); }
+void Storage::CloseTrace() { capture::TracerScope scope; pimpl_->CloseTrace(); }
+bool Storage::IsTraceOpen() const { return pimpl_->IsTraceOpen(); }
+void Storage::StartSegmentWriter(const SegmentOptions& options) { capture::TracerScope scope; pimpl_->StartSegmentWriter(options); }
+void Storage::StopSegmentWriter() { capture::TracerScope scope; pimpl_->StopSegmentWriter(); }
+uint64_t Storage::GetSegmentDroppedEventCount() const { return pimpl_->GetSegmentDroppedEventCount(); }
+uint64_t Storage::TakeHeapSnapshot(const std::string& label) { capture::TracerScope scope; return pimpl_->TakeHeapSnapshot(label); }
+std::vector<HeapSnapshotInfo> Storage::GetHeapSnapshots() { capture::TracerScope scope; return pimpl_->GetHeapSnapshots(); }
+std::vector<StackUsage> Storage::GetHeapSnapshot(uint64_t snapshot_id) { capture::TracerScope scope; return pimpl_->GetHeapSnapshot(snapshot_id); }
+void Storage::DropHeapSnapshot(uint64_t snapshot_id) { capture::TracerScope scope; pimpl_->DropHeapSnapshot(snapshot_id); }
+std::vector<StackGrowth> Storage::DiffHeapSnapshots(uint64_t from_id, uint64_t to_id, size_t limit) {
+    capture::TracerScope scope;
+    return pimpl_->DiffHeapSnapshots(from_id, to_id, limit);
+}
+std::vector<StackGrowth> Storage::GetGrowingStacks(size_t snapshot_count, size_t limit) {
+    capture::TracerScope scope;
+    return pimpl_->GetGrowingStacks(snapshot_count, limit);
+}
+bool Storage::EnableSnapshotSignal(int signum) { capture::TracerScope scope; return pimpl_->EnableSnapshotSignal(signum); }
+void Storage::DisableSnapshotSignal() { capture::TracerScope scope; pimpl_->DisableSnapshotSignal(); }
+json Storage::GetAllocationTimeline(size_t bucket_size_ns) { capture::TracerScope scope; return pimpl_->GetAllocationTimeline(bucket_size_ns); }
+void Storage::SetLayout(StorageLayout layout) { capture::TracerScope scope; pimpl_->SetLayout(layout); }
+StorageLayout Storage::GetLayout() const { return pimpl_->GetLayout(); }
+void Storage::SetMaxAllocations(size_t max_allocations) { capture::TracerScope scope; pimpl_->SetMaxAllocations(max_allocations); }
+void Storage::Clear() { capture::TracerScope scope; pimpl_->Clear(); }
 
 } // namespace storage
 } // namespace memory_tracer
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace memory_tracer {
+namespace storage {
+
+// 字符串驻留表：相同的函数名/文件名只保存一份，记录中只存 32 位 ID
+// 字符串按块保存且块表预先分配，已有字符串的地址永不改变。
+// Intern 由写入方在存储锁内调用；Get 只读取已发布的 ID，快照可以不加锁并发读取
+class StringTable {
+public:
+    static constexpr uint32_t kOverflowId = 0;  // 超出容量时统一映射到空字符串
+
+    StringTable() : blocks_(kMaxBlocks), size_(0) {
+        Intern(std::string());
+    }
+
+    StringTable(const StringTable&) = delete;
+    StringTable& operator=(const StringTable&) = delete;
+
+    uint32_t Intern(const std::string& value) {
+        auto it = ids_.find(value);
+        if (it != ids_.end()) {
+            return it->second;
+        }
+        if (size_ == kMaxBlocks * kBlockSize) {
+            return kOverflowId;
+        }
+
+        uint32_t id = size_++;
+        auto& block = blocks_[id / kBlockSize];
+        if (!block) {
+            block.reset(new std::string[kBlockSize]);
+        }
+        std::string& slot = block[id % kBlockSize];
+        slot = value;
+        ids_.emplace(slot, id);
+        return id;
+    }
+
+    const std::string& Get(uint32_t id) const { return blocks_[id / kBlockSize][id % kBlockSize]; }
+
+    size_t Size() const { return size_; }
+
+private:
+    static constexpr uint32_t kBlockSize = 1 << 14;
+    static constexpr uint32_t kMaxBlocks = 1 << 12;
+
+    std::vector<std::unique_ptr<std::string[]>> blocks_;
+    std::unordered_map<std::string_view, uint32_t> ids_;
+    uint32_t size_;
+};
+
+} // namespace storage
+} // namespace memory_tracer
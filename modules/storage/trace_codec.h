@@ -0,0 +1,204 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace memory_tracer {
+namespace storage {
+namespace trace {
+
+// 二进制 trace 文件布局（小端）：
+//   FileHeader
+//   Chunk*      每个块为 ChunkHeader + payload，字符串/调用栈/符号块总在引用它们的记录块之前写出
+//   Chunk(FREED) + Chunk(FOOTER) + Trailer   正常关闭时写出，FOOTER 按偏移索引其余全部块
+// 变长整数使用 LEB128，有符号差值先做 zigzag 编码
+
+constexpr char kFileMagic[8] = {'M', 'T', 'T', 'R', 'A', 'C', 'E', '\0'};
+constexpr char kTrailerMagic[8] = {'M', 'T', 'T', 'R', 'I', 'D', 'X', '\0'};
+constexpr uint32_t kVersion = 1;
+
+enum class ChunkType : uint32_t {
+    STRINGS = 1,   // varint 起始 ID、varint 个数，之后每项为 varint 长度 + 字节
+    STACKS = 2,    // varint 起始序号、varint 个数，之后每项为 varint 深度 + zigzag 帧地址差值
+    SYMBOLS = 3,   // varint 个数，之后每项为 zigzag 地址差值 + varint 字符串 ID
+    RECORDS = 4,   // RecordsHeader + 事件
+    FOOTER = 5,    // uint64 项数 + FooterEntry[]
+    FREED = 6      // 关闭时写出：按分配序号索引的已释放位图（uint64 字数组）
+};
+
+// 事件标签：低 2 位为事件类型，其余位为 AllocationKind
+constexpr uint8_t kEventAlloc = 0;        // 未释放的分配
+constexpr uint8_t kEventAllocFreed = 1;   // 写出时已释放的分配
+constexpr uint8_t kEventFree = 2;         // 释放事件，引用之前的分配序号
+constexpr uint8_t kEventTypeMask = 0x3;
+constexpr uint8_t kEventKindShift = 2;
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+};
+
+struct ChunkHeader {
+    uint32_t type;
+    uint32_t size;   // payload 字节数
+};
+
+// 记录块内的分配按序号连续编号，时间戳与地址相对块内上一事件做差值编码，
+// 每个块的差值基准都从 0 开始，因此可以单独解码
+struct RecordsHeader {
+    uint64_t first_alloc;    // 块内第一条分配的序号
+    uint32_t alloc_count;
+    uint32_t event_count;
+    uint64_t min_timestamp;
+    uint64_t max_timestamp;
+};
+
+struct FooterEntry {
+    uint32_t type;
+    uint32_t count;          // 块内的条目数（记录块为事件数）
+    uint64_t offset;         // ChunkHeader 在文件中的偏移
+    uint64_t first_index;    // 第一个字符串 ID / 调用栈序号 / 分配序号
+    uint64_t alloc_count;    // 记录块内的分配数；FREED 块为位图覆盖的分配数
+    uint64_t min_timestamp;  // 仅记录块有效
+    uint64_t max_timestamp;
+};
+
+struct Trailer {
+    uint64_t footer_offset;
+    char magic[8];
+};
+
+static_assert(sizeof(FileHeader) == 16, "unexpected FileHeader layout");
+static_assert(sizeof(ChunkHeader) == 8, "unexpected ChunkHeader layout");
+static_assert(sizeof(RecordsHeader) == 32, "unexpected RecordsHeader layout");
+static_assert(sizeof(FooterEntry) == 48, "unexpected FooterEntry layout");
+static_assert(sizeof(Trailer) == 16, "unexpected Trailer layout");
+
+inline uint64_t ZigZagEncode(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+inline int64_t ZigZagDecode(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+inline void PutVarint(std::string* out, uint64_t value) {
+    while (value >= 0x80) {
+        out->push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out->push_back(static_cast<char>(value));
+}
+
+inline bool GetVarint(const uint8_t** p, const uint8_t* end, uint64_t* value) {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64 && *p < end; shift += 7) {
+        uint8_t byte = *(*p)++;
+        result |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename T>
+inline void PutFixed(std::string* out, const T& value) {
+    out->append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+inline bool GetFixed(const uint8_t** p, const uint8_t* end, T* value) {
+    if (static_cast<size_t>(end - *p) < sizeof(T)) return false;
+    std::memcpy(value, *p, sizeof(T));
+    *p += sizeof(T);
+    return true;
+}
+
+// 解码后的一条事件，字符串和调用栈仍是文件内的 ID
+struct DecodedEvent {
+    uint8_t type;
+    uint8_t kind;
+    uint64_t timestamp;
+    uint64_t address;       // 分配时的地址
+    uint64_t size;
+    uint64_t function_id;
+    uint64_t file_id;
+    int64_t line;
+    uint64_t thread_id;
+    uint64_t stack_index;   // 0 表示没有调用栈
+    uint64_t sample_interval;
+    uint64_t alloc_index;   // 分配事件为自身序号，释放事件为所释放的分配序号
+};
+
+// 顺序解码一个记录块的 payload
+class RecordDecoder {
+public:
+    RecordDecoder() : p_(nullptr), end_(nullptr), next_alloc_(0), timestamp_(0), address_(0) {}
+
+    bool Reset(const uint8_t* payload, size_t size) {
+        p_ = payload;
+        end_ = payload + size;
+        if (!GetFixed(&p_, end_, &header_)) return false;
+        next_alloc_ = header_.first_alloc;
+        timestamp_ = 0;
+        address_ = 0;
+        return true;
+    }
+
+    const RecordsHeader& GetHeader() const { return header_; }
+
+    bool Done() const { return p_ == end_; }
+
+    // payload 损坏时返回 false
+    bool Next(DecodedEvent* event) {
+        if (p_ >= end_) return false;
+        uint8_t tag = *p_++;
+        event->type = tag & kEventTypeMask;
+        event->kind = tag >> kEventKindShift;
+
+        uint64_t value = 0;
+        if (!GetVarint(&p_, end_, &value)) return false;
+        timestamp_ += static_cast<uint64_t>(ZigZagDecode(value));
+        event->timestamp = timestamp_;
+
+        if (event->type == kEventFree) {
+            if (!GetVarint(&p_, end_, &value) || value >= next_alloc_) return false;
+            event->alloc_index = next_alloc_ - 1 - value;
+            return true;
+        }
+
+        uint64_t line = 0;
+        if (!GetVarint(&p_, end_, &value)) return false;
+        address_ += static_cast<uint64_t>(ZigZagDecode(value));
+        event->address = address_;
+        if (!GetVarint(&p_, end_, &event->size) ||
+            !GetVarint(&p_, end_, &event->function_id) ||
+            !GetVarint(&p_, end_, &event->file_id) ||
+            !GetVarint(&p_, end_, &line) ||
+            !GetVarint(&p_, end_, &event->thread_id) ||
+            !GetVarint(&p_, end_, &event->stack_index) ||
+            !GetVarint(&p_, end_, &event->sample_interval)) {
+            return false;
+        }
+        event->line = ZigZagDecode(line);
+        event->alloc_index = next_alloc_++;
+        return true;
+    }
+
+private:
+    const uint8_t* p_;
+    const uint8_t* end_;
+    RecordsHeader header_;
+    uint64_t next_alloc_;
+    uint64_t timestamp_;
+    uint64_t address_;
+};
+
+} // namespace trace
+} // namespace storage
+} // namespace memory_tracer
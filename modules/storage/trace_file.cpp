@@ -0,0 +1,603 @@
+#include "storage/trace_file.h"
+#include "trace_codec.h"
+#include "capture/live_table.h"
+#include "capture/stack_table.h"
+#include "capture/symbolizer.h"
+#include "logger/logger.h"
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace memory_tracer {
+namespace storage {
+
+using namespace trace;
+
+class TraceWriter::Impl {
+public:
+    ~Impl() {
+        if (file_.is_open()) {
+            Close();
+        }
+    }
+
+    bool Open(const std::string& filepath, uint64_t first_alloc_index) {
+        if (file_.is_open()) {
+            Close();
+        }
+        Reset(first_alloc_index);
+
+        file_.open(filepath, std::ios::binary | std::ios::trunc);
+        if (!file_.is_open()) {
+            return false;
+        }
+        filepath_ = filepath;
+
+        FileHeader header;
+        std::memcpy(header.magic, kFileMagic, sizeof(header.magic));
+        header.version = kVersion;
+        header.flags = 0;
+        WriteBytes(&header, sizeof(header));
+        return true;
+    }
+
+    bool IsOpen() const { return file_.is_open(); }
+
+    uint64_t WriteRecord(const RecordView& record) {
+        if (!file_.is_open()) {
+            return UINT64_MAX;
+        }
+
+        uint64_t function_id = InternString(record.function);
+        uint64_t file_id = InternString(record.file);
+        uint64_t stack_index = InternStack(record.stack_id);
+        uint64_t address = reinterpret_cast<uintptr_t>(record.address);
+
+        BeginEvent(record.timestamp);
+        uint8_t type = record.address != nullptr ? kEventAlloc : kEventAllocFreed;
+        records_.push_back(static_cast<char>(type | (static_cast<uint8_t>(record.kind) << kEventKindShift)));
+        PutVarint(&records_, ZigZagEncode(static_cast<int64_t>(record.timestamp - timestamp_)));
+        PutVarint(&records_, ZigZagEncode(static_cast<int64_t>(address - address_)));
+        PutVarint(&records_, record.size);
+        PutVarint(&records_, function_id);
+        PutVarint(&records_, file_id);
+        PutVarint(&records_, ZigZagEncode(record.line));
+        PutVarint(&records_, record.thread_id);
+        PutVarint(&records_, stack_index);
+        PutVarint(&records_, record.sample_interval);
+        timestamp_ = record.timestamp;
+        address_ = address;
+
+        uint64_t index = next_alloc_++;
+        chunk_.alloc_count++;
+        if ((index - first_alloc_) / 64 >= freed_.size()) {
+            freed_.push_back(0);
+        }
+        if (type == kEventAllocFreed) {
+            MarkFreed(index);
+        }
+        EndEvent();
+        return index;
+    }
+
+    void WriteFree(uint64_t timestamp, uint64_t alloc_index) {
+        if (!file_.is_open() || alloc_index >= next_alloc_) {
+            return;
+        }
+
+        BeginEvent(timestamp);
+        records_.push_back(static_cast<char>(kEventFree));
+        PutVarint(&records_, ZigZagEncode(static_cast<int64_t>(timestamp - timestamp_)));
+        PutVarint(&records_, next_alloc_ - 1 - alloc_index);
+        timestamp_ = timestamp;
+        MarkFreed(alloc_index);
+        EndEvent();
+    }
+
+    void WriteEvents(const capture::CaptureEvent* events, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            const auto& event = events[i];
+            if (event.type == capture::EventType::ALLOC) {
+                uint64_t index = WriteAllocation(capture::MakeAllocationInfo(event));
+                if (index != UINT64_MAX && event.address != nullptr) {
+                    live_.Insert(event.address, index);
+                }
+            } else {
+                uint64_t index = 0;
+                if (live_.Erase(event.address, &index)) {
+                    WriteFree(event.timestamp, index);
+                }
+            }
+        }
+    }
+
+    uint64_t WriteAllocation(const capture::AllocationInfo& info) {
+        RecordView view;
+        view.handle = kInvalidRecordHandle;
+        view.timestamp = info.timestamp;
+        view.address = info.address;
+        view.size = info.size;
+        view.function = info.function;
+        view.file = info.file;
+        view.line = info.line;
+        view.thread_id = info.thread_id;
+        view.stack_id = info.stack_id;
+        view.kind = info.kind;
+        view.sample_interval = info.sample_interval;
+        return WriteRecord(view);
+    }
+
+    void Flush() {
+        if (!file_.is_open()) {
+            return;
+        }
+        FlushChunk();
+        file_.flush();
+    }
+
+    bool Close() {
+        if (!file_.is_open()) {
+            return false;
+        }
+
+        FlushChunk();
+
+        // 随机访问的读取方据此判断分配是否已释放，无需先扫描全部释放事件
+        std::string freed(reinterpret_cast<const char*>(freed_.data()), freed_.size() * sizeof(uint64_t));
+        FooterEntry freed_entry = MakeEntry(0, first_alloc_);
+        freed_entry.alloc_count = next_alloc_ - first_alloc_;
+        WriteChunk(ChunkType::FREED, std::string(), freed, &freed_entry);
+
+        // 索引块不登记自身
+        uint64_t footer_offset = offset_;
+        std::string footer;
+        PutFixed(&footer, static_cast<uint64_t>(entries_.size()));
+        footer.append(reinterpret_cast<const char*>(entries_.data()), entries_.size() * sizeof(FooterEntry));
+        WriteChunk(ChunkType::FOOTER, std::string(), footer, nullptr);
+
+        Trailer trailer;
+        trailer.footer_offset = footer_offset;
+        std::memcpy(trailer.magic, kTrailerMagic, sizeof(trailer.magic));
+        WriteBytes(&trailer, sizeof(trailer));
+
+        file_.close();
+        bool ok = !file_.fail();
+        if (ok) {
+            LOG_INFO("Wrote trace with {} allocations to {}", next_alloc_ - first_alloc_, filepath_);
+        } else {
+            LOG_ERROR("Failed to write trace file: {}", filepath_);
+        }
+        return ok;
+    }
+
+    uint64_t GetAllocationCount() const { return next_alloc_ - first_alloc_; }
+    uint64_t GetBytesWritten() const { return offset_; }
+
+private:
+    static constexpr uint32_t kEventsPerChunk = 4096;
+
+    void Reset(uint64_t first_alloc_index) {
+        offset_ = 0;
+        first_alloc_ = first_alloc_index;
+        next_alloc_ = first_alloc_index;
+        strings_.clear();
+        string_ids_.clear();
+        pending_strings_.clear();
+        pending_string_count_ = 0;
+        stack_indices_.clear();
+        pending_stacks_.clear();
+        pending_stack_count_ = 0;
+        symbolized_.clear();
+        pending_symbols_.clear();
+        pending_symbol_count_ = 0;
+        symbol_address_ = 0;
+        records_.clear();
+        chunk_ = RecordsHeader();
+        entries_.clear();
+        freed_.clear();
+        live_.Clear();
+    }
+
+    // 位图只覆盖本文件的分配，引用之前分段的释放只记录事件
+    void MarkFreed(uint64_t alloc_index) {
+        if (alloc_index < first_alloc_) {
+            return;
+        }
+        uint64_t bit = alloc_index - first_alloc_;
+        freed_[bit / 64] |= uint64_t(1) << (bit % 64);
+    }
+
+    void WriteBytes(const void* data, size_t size) {
+        file_.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        offset_ += size;
+    }
+
+    void WriteChunk(ChunkType type, const std::string& prefix, const std::string& body, FooterEntry* entry) {
+        if (entry) {
+            entry->type = static_cast<uint32_t>(type);
+            entry->offset = offset_;
+            entries_.push_back(*entry);
+        }
+        ChunkHeader header;
+        header.type = static_cast<uint32_t>(type);
+        header.size = static_cast<uint32_t>(prefix.size() + body.size());
+        WriteBytes(&header, sizeof(header));
+        WriteBytes(prefix.data(), prefix.size());
+        WriteBytes(body.data(), body.size());
+    }
+
+    uint64_t InternString(std::string_view value) {
+        auto it = string_ids_.find(value);
+        if (it != string_ids_.end()) {
+            return it->second;
+        }
+        uint64_t id = strings_.size();
+        strings_.emplace_back(value);
+        string_ids_.emplace(strings_.back(), id);
+
+        PutVarint(&pending_strings_, value.size());
+        pending_strings_.append(value.data(), value.size());
+        pending_string_count_++;
+        return id;
+    }
+
+    // 文件内的调用栈序号从 1 开始，0 表示没有调用栈
+    uint64_t InternStack(uint64_t stack_id) {
+        if (stack_id == capture::kInvalidStackId) {
+            return 0;
+        }
+        auto it = stack_indices_.find(stack_id);
+        if (it != stack_indices_.end()) {
+            return it->second;
+        }
+        uint64_t index = stack_indices_.size() + 1;
+        stack_indices_.emplace(stack_id, index);
+
+        // 每个地址第一次出现时写出符号，符号化在写出时进行
+        std::vector<void*> frames = capture::StackTable::GetInstance().GetFrames(stack_id);
+        PutVarint(&pending_stacks_, frames.size());
+        uint64_t previous = 0;
+        for (void* pc : frames) {
+            uint64_t address = reinterpret_cast<uintptr_t>(pc);
+            PutVarint(&pending_stacks_, ZigZagEncode(static_cast<int64_t>(address - previous)));
+            previous = address;
+
+            if (symbolized_.insert(address).second) {
+                uint64_t symbol_id = InternString(capture::Symbolizer::GetInstance().Resolve(pc));
+                PutVarint(&pending_symbols_, ZigZagEncode(static_cast<int64_t>(address - symbol_address_)));
+                PutVarint(&pending_symbols_, symbol_id);
+                symbol_address_ = address;
+                pending_symbol_count_++;
+            }
+        }
+        pending_stack_count_++;
+        return index;
+    }
+
+    void BeginEvent(uint64_t timestamp) {
+        if (chunk_.event_count == 0) {
+            chunk_.first_alloc = next_alloc_;
+            chunk_.min_timestamp = timestamp;
+            chunk_.max_timestamp = timestamp;
+            timestamp_ = 0;
+            address_ = 0;
+        }
+        chunk_.min_timestamp = std::min(chunk_.min_timestamp, timestamp);
+        chunk_.max_timestamp = std::max(chunk_.max_timestamp, timestamp);
+    }
+
+    void EndEvent() {
+        if (++chunk_.event_count == kEventsPerChunk) {
+            FlushChunk();
+        }
+    }
+
+    // 先写出本块引用到的新字符串、调用栈和符号，再写出记录块
+    void FlushChunk() {
+        if (pending_string_count_ > 0) {
+            std::string prefix;
+            PutVarint(&prefix, strings_.size() - pending_string_count_);
+            PutVarint(&prefix, pending_string_count_);
+            FooterEntry entry = MakeEntry(pending_string_count_, strings_.size() - pending_string_count_);
+            WriteChunk(ChunkType::STRINGS, prefix, pending_strings_, &entry);
+            pending_strings_.clear();
+            pending_string_count_ = 0;
+        }
+        if (pending_stack_count_ > 0) {
+            uint64_t first = stack_indices_.size() + 1 - pending_stack_count_;
+            std::string prefix;
+            PutVarint(&prefix, first);
+            PutVarint(&prefix, pending_stack_count_);
+            FooterEntry entry = MakeEntry(pending_stack_count_, first);
+            WriteChunk(ChunkType::STACKS, prefix, pending_stacks_, &entry);
+            pending_stacks_.clear();
+            pending_stack_count_ = 0;
+        }
+        if (pending_symbol_count_ > 0) {
+            std::string prefix;
+            PutVarint(&prefix, pending_symbol_count_);
+            FooterEntry entry = MakeEntry(pending_symbol_count_, 0);
+            WriteChunk(ChunkType::SYMBOLS, prefix, pending_symbols_, &entry);
+            pending_symbols_.clear();
+            pending_symbol_count_ = 0;
+            symbol_address_ = 0;
+        }
+        if (chunk_.event_count > 0) {
+            std::string prefix;
+            PutFixed(&prefix, chunk_);
+            FooterEntry entry = MakeEntry(chunk_.event_count, chunk_.first_alloc);
+            entry.alloc_count = chunk_.alloc_count;
+            entry.min_timestamp = chunk_.min_timestamp;
+            entry.max_timestamp = chunk_.max_timestamp;
+            WriteChunk(ChunkType::RECORDS, prefix, records_, &entry);
+            records_.clear();
+            chunk_ = RecordsHeader();
+        }
+    }
+
+    static FooterEntry MakeEntry(uint64_t count, uint64_t first_index) {
+        FooterEntry entry = FooterEntry();
+        entry.count = static_cast<uint32_t>(count);
+        entry.first_index = first_index;
+        return entry;
+    }
+
+    std::ofstream file_;
+    std::string filepath_;
+    uint64_t offset_ = 0;
+    uint64_t first_alloc_ = 0;
+    uint64_t next_alloc_ = 0;
+
+    // 字符串保存在 deque 中，作为 string_view 键时地址不变
+    std::deque<std::string> strings_;
+    std::unordered_map<std::string_view, uint64_t> string_ids_;
+    std::string pending_strings_;
+    uint64_t pending_string_count_ = 0;
+
+    std::unordered_map<uint64_t, uint64_t> stack_indices_;
+    std::string pending_stacks_;
+    uint64_t pending_stack_count_ = 0;
+
+    std::unordered_set<uint64_t> symbolized_;
+    std::string pending_symbols_;
+    uint64_t pending_symbol_count_ = 0;
+    uint64_t symbol_address_ = 0;
+
+    // 当前记录块
+    std::string records_;
+    RecordsHeader chunk_ = RecordsHeader();
+    uint64_t timestamp_ = 0;
+    uint64_t address_ = 0;
+
+    std::vector<FooterEntry> entries_;
+    std::vector<uint64_t> freed_;        // 已释放位图，每条分配 1 位
+    capture::LiveTable<uint64_t> live_;  // WriteEvents 中未释放的地址 -> 分配序号
+};
+
+class TraceReader::Impl {
+public:
+    bool Open(const std::string& filepath) {
+        file_.close();
+        file_.clear();
+        file_.open(filepath, std::ios::binary);
+        if (!file_.is_open()) {
+            LOG_ERROR("Failed to open trace file: {}", filepath);
+            return false;
+        }
+        filepath_ = filepath;
+
+        FileHeader header;
+        if (!file_.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+            std::memcmp(header.magic, kFileMagic, sizeof(header.magic)) != 0) {
+            LOG_ERROR("Not a memory tracer trace file: {}", filepath);
+            file_.close();
+            return false;
+        }
+        if (header.version > kVersion) {
+            LOG_ERROR("Unsupported trace version {} in {}", header.version, filepath);
+            file_.close();
+            return false;
+        }
+        version_ = header.version;
+        return true;
+    }
+
+    uint32_t GetVersion() const { return version_; }
+
+    bool Replay(const TraceHandler& handler) {
+        if (!file_.is_open()) {
+            return false;
+        }
+        file_.clear();
+        file_.seekg(sizeof(FileHeader));
+
+        strings_.clear();
+        stacks_.assign(1, capture::kInvalidStackId);
+        bool first_records = true;
+
+        ChunkHeader header;
+        std::string payload;
+        uint64_t offset = sizeof(FileHeader);
+        while (file_.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+            payload.resize(header.size);
+            if (!file_.read(&payload[0], header.size)) {
+                break;
+            }
+
+            const uint8_t* p = reinterpret_cast<const uint8_t*>(payload.data());
+            const uint8_t* end = p + payload.size();
+            bool ok = true;
+            switch (static_cast<ChunkType>(header.type)) {
+                case ChunkType::STRINGS: ok = ReadStrings(p, end); break;
+                case ChunkType::STACKS: ok = ReadStacks(p, end); break;
+                case ChunkType::SYMBOLS: ok = ReadSymbols(p, end); break;
+                case ChunkType::RECORDS:
+                    // 序号从 0 开始的文件是一次新的采集，不再关联之前回放的分配
+                    if (first_records) {
+                        RecordsHeader records;
+                        const uint8_t* q = p;
+                        if (GetFixed(&q, end, &records) && records.first_alloc == 0) {
+                            live_.clear();
+                        }
+                    }
+                    first_records = false;
+                    ok = ReadRecords(p, end, handler);
+                    break;
+                case ChunkType::FOOTER: return true;
+                case ChunkType::FREED: break;  // 回放时由释放事件得到同样的信息
+                default: break;  // 未知的块直接跳过
+            }
+            if (!ok) {
+                LOG_ERROR("Corrupted trace chunk at offset {} in {}", offset, filepath_);
+                return false;
+            }
+            offset += sizeof(header) + header.size;
+        }
+
+        LOG_WARN("Trace file {} is truncated after offset {}", filepath_, offset);
+        return false;
+    }
+
+private:
+    bool ReadStrings(const uint8_t* p, const uint8_t* end) {
+        uint64_t first = 0;
+        uint64_t count = 0;
+        if (!GetVarint(&p, end, &first) || !GetVarint(&p, end, &count) || first != strings_.size()) {
+            return false;
+        }
+        for (uint64_t i = 0; i < count; ++i) {
+            uint64_t length = 0;
+            if (!GetVarint(&p, end, &length) || length > static_cast<uint64_t>(end - p)) {
+                return false;
+            }
+            strings_.emplace_back(reinterpret_cast<const char*>(p), static_cast<size_t>(length));
+            p += length;
+        }
+        return true;
+    }
+
+    bool ReadStacks(const uint8_t* p, const uint8_t* end) {
+        uint64_t first = 0;
+        uint64_t count = 0;
+        if (!GetVarint(&p, end, &first) || !GetVarint(&p, end, &count) || first != stacks_.size()) {
+            return false;
+        }
+        std::vector<void*> frames;
+        for (uint64_t i = 0; i < count; ++i) {
+            uint64_t depth = 0;
+            if (!GetVarint(&p, end, &depth) || depth > static_cast<uint64_t>(end - p)) {
+                return false;
+            }
+            frames.clear();
+            uint64_t address = 0;
+            for (uint64_t j = 0; j < depth; ++j) {
+                uint64_t delta = 0;
+                if (!GetVarint(&p, end, &delta)) return false;
+                address += static_cast<uint64_t>(ZigZagDecode(delta));
+                frames.push_back(reinterpret_cast<void*>(static_cast<uintptr_t>(address)));
+            }
+            stacks_.push_back(capture::StackTable::GetInstance().Intern(frames.data(), frames.size()));
+        }
+        return true;
+    }
+
+    bool ReadSymbols(const uint8_t* p, const uint8_t* end) {
+        uint64_t count = 0;
+        if (!GetVarint(&p, end, &count)) {
+            return false;
+        }
+        uint64_t address = 0;
+        for (uint64_t i = 0; i < count; ++i) {
+            uint64_t delta = 0;
+            uint64_t symbol_id = 0;
+            if (!GetVarint(&p, end, &delta) || !GetVarint(&p, end, &symbol_id) || symbol_id >= strings_.size()) {
+                return false;
+            }
+            address += static_cast<uint64_t>(ZigZagDecode(delta));
+            capture::Symbolizer::GetInstance().AddSymbol(reinterpret_cast<void*>(static_cast<uintptr_t>(address)),
+                                                         strings_[symbol_id]);
+        }
+        return true;
+    }
+
+    bool ReadRecords(const uint8_t* p, const uint8_t* end, const TraceHandler& handler) {
+        RecordDecoder decoder;
+        if (!decoder.Reset(p, static_cast<size_t>(end - p))) {
+            return false;
+        }
+
+        DecodedEvent event;
+        for (uint32_t i = 0; i < decoder.GetHeader().event_count; ++i) {
+            if (!decoder.Next(&event)) {
+                return false;
+            }
+
+            if (event.type == kEventFree) {
+                auto it = live_.find(event.alloc_index);
+                if (it != live_.end()) {
+                    if (handler.on_free) handler.on_free(event.timestamp, it->second);
+                    live_.erase(it);
+                }
+                continue;
+            }
+
+            if (event.function_id >= strings_.size() || event.file_id >= strings_.size() ||
+                event.stack_index >= stacks_.size()) {
+                return false;
+            }
+            info_.timestamp = event.timestamp;
+            info_.address = nullptr;
+            info_.size = static_cast<size_t>(event.size);
+            info_.function = strings_[event.function_id];
+            info_.file = strings_[event.file_id];
+            info_.line = static_cast<int>(event.line);
+            info_.thread_id = static_cast<uint32_t>(event.thread_id);
+            info_.stack_id = stacks_[event.stack_index];
+            info_.kind = static_cast<capture::AllocationKind>(event.kind);
+            info_.sample_interval = static_cast<uint32_t>(event.sample_interval);
+            if (event.type == kEventAlloc) {
+                info_.address = reinterpret_cast<void*>(static_cast<uintptr_t>(event.address));
+                live_[event.alloc_index] = info_.address;
+            }
+            if (handler.on_allocation) handler.on_allocation(info_);
+        }
+        return decoder.Done();
+    }
+
+    std::ifstream file_;
+    std::string filepath_;
+    uint32_t version_ = 0;
+
+    std::vector<std::string> strings_;
+    std::vector<capture::StackId> stacks_;              // 文件内序号 -> 本进程的调用栈 ID
+    std::unordered_map<uint64_t, void*> live_;          // 尚未释放的分配序号 -> 地址
+    capture::AllocationInfo info_;
+};
+
+TraceWriter::TraceWriter() : pimpl_(std::make_unique<Impl>()) {}
+TraceWriter::~TraceWriter() = default;
+
+bool TraceWriter::Open(const std::string& filepath, uint64_t first_alloc_index) { return pimpl_->Open(filepath, first_alloc_index); }
+bool TraceWriter::IsOpen() const { return pimpl_->IsOpen(); }
+uint64_t TraceWriter::WriteRecord(const RecordView& record) { return pimpl_->WriteRecord(record); }
+uint64_t TraceWriter::WriteAllocation(const capture::AllocationInfo& info) { return pimpl_->WriteAllocation(info); }
+void TraceWriter::WriteFree(uint64_t timestamp, uint64_t alloc_index) { pimpl_->WriteFree(timestamp, alloc_index); }
+void TraceWriter::WriteEvents(const capture::CaptureEvent* events, size_t count) { pimpl_->WriteEvents(events, count); }
+void TraceWriter::Flush() { pimpl_->Flush(); }
+bool TraceWriter::Close() { return pimpl_->Close(); }
+uint64_t TraceWriter::GetAllocationCount() const { return pimpl_->GetAllocationCount(); }
+uint64_t TraceWriter::GetBytesWritten() const { return pimpl_->GetBytesWritten(); }
+
+TraceReader::TraceReader() : pimpl_(std::make_unique<Impl>()) {}
+TraceReader::~TraceReader() = default;
+
+bool TraceReader::Open(const std::string& filepath) { return pimpl_->Open(filepath); }
+uint32_t TraceReader::GetVersion() const { return pimpl_->GetVersion(); }
+bool TraceReader::Replay(const TraceHandler& handler) { return pimpl_->Replay(handler); }
+
+} // namespace storage
+} // namespace memory_tracer
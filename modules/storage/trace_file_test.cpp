@@ -0,0 +1,355 @@
+// 二进制 trace 格式的往返与损坏输入测试：变长整数、记录块、FREED 位图和索引块，
+// 以及 TraceReader / MappedTrace 对截断、错误魔数和损坏索引的拒绝
+//
+//   bazel test //modules/storage:trace_file_test
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "capture/capture.h"
+#include "capture/stack_table.h"
+#include "mapped_trace.h"
+#include "storage/trace_file.h"
+#include "trace_codec.h"
+
+namespace memory_tracer {
+namespace storage {
+namespace {
+
+using capture::AllocationInfo;
+using capture::AllocationKind;
+using namespace trace;
+
+std::string TempPath(const std::string& name) {
+    return ::testing::TempDir() + "/trace_file_test_" + std::to_string(getpid()) + "_" + name;
+}
+
+std::string ReadFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+void WriteFile(const std::string& path, const std::string& data) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+// 覆盖差值编码的边界：时间戳和地址都有回退（负差值），数值取到变长整数的最大宽度
+std::vector<AllocationInfo> MakeRecords() {
+    void* frames[] = {reinterpret_cast<void*>(0x7f0000001000), reinterpret_cast<void*>(0x400100),
+                      reinterpret_cast<void*>(0x7f0000000010)};
+    capture::StackId stack = capture::StackTable::GetInstance().Intern(frames, 3);
+
+    std::vector<AllocationInfo> records(5);
+    records[0].timestamp = 1000;
+    records[0].address = reinterpret_cast<void*>(0x7f0000100000);
+    records[0].size = 64;
+    records[0].function = "malloc";
+    records[0].file = "src/a.cpp";
+    records[0].line = 12;
+    records[0].thread_id = 1;
+    records[0].stack_id = stack;
+    records[0].kind = AllocationKind::MALLOC;
+
+    records[1].timestamp = 10;                                              // 时间戳回退
+    records[1].address = reinterpret_cast<void*>(0x1000);                   // 地址回退
+    records[1].size = std::numeric_limits<size_t>::max();
+    records[1].function = "operator new";
+    records[1].file = "src/b.cpp";
+    records[1].line = -7;
+    records[1].thread_id = std::numeric_limits<uint32_t>::max();
+    records[1].kind = AllocationKind::NEW_ARRAY_ALIGNED;
+    records[1].sample_interval = std::numeric_limits<uint32_t>::max();
+
+    records[2].timestamp = std::numeric_limits<uint64_t>::max();
+    records[2].address = reinterpret_cast<void*>(std::numeric_limits<uintptr_t>::max() & ~uintptr_t(0xf));
+    records[2].size = 0;
+    records[2].function = "malloc";                                         // 复用已写出的字符串
+    records[2].file = "";
+    records[2].line = std::numeric_limits<int>::min();
+    records[2].thread_id = 0;
+    records[2].stack_id = stack;
+    records[2].kind = AllocationKind::MMAP;
+
+    records[3].timestamp = 0;
+    records[3].address = nullptr;                                           // 写入时已释放
+    records[3].size = 128;
+    records[3].function = "calloc";
+    records[3].file = "src/a.cpp";
+    records[3].line = std::numeric_limits<int>::max();
+    records[3].thread_id = 2;
+    records[3].kind = AllocationKind::CALLOC;
+
+    records[4].timestamp = 5000;
+    records[4].address = reinterpret_cast<void*>(0x7f0000100000);
+    records[4].size = 32;
+    records[4].function = "realloc";
+    records[4].file = "src/c.cpp";
+    records[4].line = 0;
+    records[4].thread_id = 3;
+    records[4].kind = AllocationKind::REALLOC;
+    return records;
+}
+
+// 写出 MakeRecords 的记录，并用释放事件释放第 4 条
+std::string WriteTrace(const std::string& name, const std::vector<AllocationInfo>& records) {
+    std::string path = TempPath(name);
+    TraceWriter writer;
+    EXPECT_TRUE(writer.Open(path));
+    for (const auto& record : records) {
+        writer.WriteAllocation(record);
+    }
+    writer.WriteFree(6000, 4);
+    EXPECT_EQ(writer.GetAllocationCount(), records.size());
+    EXPECT_TRUE(writer.Close());
+    return path;
+}
+
+void ExpectSameRecord(const AllocationInfo& expected, const AllocationInfo& actual, bool freed) {
+    EXPECT_EQ(actual.timestamp, expected.timestamp);
+    EXPECT_EQ(actual.address, freed ? nullptr : expected.address);
+    EXPECT_EQ(actual.size, expected.size);
+    EXPECT_EQ(actual.function, expected.function);
+    EXPECT_EQ(actual.file, expected.file);
+    EXPECT_EQ(actual.line, expected.line);
+    EXPECT_EQ(actual.thread_id, expected.thread_id);
+    EXPECT_EQ(actual.stack_id, expected.stack_id);
+    EXPECT_EQ(actual.kind, expected.kind);
+    EXPECT_EQ(actual.sample_interval, expected.sample_interval);
+}
+
+struct Replayed {
+    std::vector<AllocationInfo> allocations;
+    std::vector<std::pair<uint64_t, void*>> frees;
+};
+
+bool Replay(const std::string& path, Replayed* replayed) {
+    TraceReader reader;
+    if (!reader.Open(path)) {
+        return false;
+    }
+    TraceHandler handler;
+    handler.on_allocation = [replayed](const AllocationInfo& info) { replayed->allocations.push_back(info); };
+    handler.on_free = [replayed](uint64_t timestamp, void* address) { replayed->frees.emplace_back(timestamp, address); };
+    return reader.Replay(handler);
+}
+
+TEST(TraceCodecTest, VarintRoundTrip) {
+    const uint64_t values[] = {0, 1, 0x7f, 0x80, 0x3fff, 0x4000, uint64_t(1) << 63,
+                               std::numeric_limits<uint64_t>::max()};
+    for (uint64_t value : values) {
+        std::string encoded;
+        PutVarint(&encoded, value);
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(encoded.data());
+        const uint8_t* end = p + encoded.size();
+        uint64_t decoded = 0;
+        ASSERT_TRUE(GetVarint(&p, end, &decoded)) << value;
+        EXPECT_EQ(decoded, value);
+        EXPECT_EQ(p, end);
+    }
+
+    // 最大宽度为 10 字节
+    std::string encoded;
+    PutVarint(&encoded, std::numeric_limits<uint64_t>::max());
+    EXPECT_EQ(encoded.size(), 10u);
+}
+
+TEST(TraceCodecTest, VarintRejectsTruncatedAndOverlongInput) {
+    std::string encoded;
+    PutVarint(&encoded, std::numeric_limits<uint64_t>::max());
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(encoded.data());
+    uint64_t value = 0;
+    EXPECT_FALSE(GetVarint(&p, p + encoded.size() - 1, &value));
+
+    // 超过 10 字节仍未结束的编码
+    std::string overlong(11, static_cast<char>(0x80));
+    overlong.push_back(0);
+    p = reinterpret_cast<const uint8_t*>(overlong.data());
+    EXPECT_FALSE(GetVarint(&p, p + overlong.size(), &value));
+}
+
+TEST(TraceCodecTest, ZigZagRoundTrip) {
+    const int64_t values[] = {0, 1, -1, 63, -64, std::numeric_limits<int64_t>::max(),
+                              std::numeric_limits<int64_t>::min()};
+    for (int64_t value : values) {
+        EXPECT_EQ(ZigZagDecode(ZigZagEncode(value)), value);
+    }
+    // 小的负数编码为小的无符号数
+    EXPECT_EQ(ZigZagEncode(-1), 1u);
+    EXPECT_EQ(ZigZagEncode(1), 2u);
+}
+
+TEST(TraceFileTest, ReplayRoundTrip) {
+    std::vector<AllocationInfo> records = MakeRecords();
+    std::string path = WriteTrace("replay.trace", records);
+
+    Replayed replayed;
+    ASSERT_TRUE(Replay(path, &replayed));
+    ASSERT_EQ(replayed.allocations.size(), records.size());
+    for (size_t i = 0; i < records.size(); ++i) {
+        SCOPED_TRACE(i);
+        ExpectSameRecord(records[i], replayed.allocations[i], i == 3);
+    }
+    ASSERT_EQ(replayed.frees.size(), 1u);
+    EXPECT_EQ(replayed.frees[0].first, 6000u);
+    EXPECT_EQ(replayed.frees[0].second, records[4].address);
+
+    std::vector<void*> frames = capture::StackTable::GetInstance().GetFrames(replayed.allocations[0].stack_id);
+    ASSERT_EQ(frames.size(), 3u);
+    EXPECT_EQ(frames[1], reinterpret_cast<void*>(0x400100));
+    std::remove(path.c_str());
+}
+
+TEST(TraceFileTest, RejectsBadMagic) {
+    std::string path = WriteTrace("magic.trace", MakeRecords());
+    std::string data = ReadFile(path);
+    data[0] = 'X';
+    WriteFile(path, data);
+
+    TraceReader reader;
+    EXPECT_FALSE(reader.Open(path));
+    MappedTrace mapped;
+    EXPECT_FALSE(mapped.Open(path));
+    std::remove(path.c_str());
+}
+
+TEST(TraceFileTest, TruncatedFileReplaysOnlyCompleteChunks) {
+    std::vector<AllocationInfo> records = MakeRecords();
+    std::string path = WriteTrace("truncated.trace", records);
+    std::string data = ReadFile(path);
+
+    // 截掉索引块和尾部之后，记录块仍完整，回放全部记录但报告文件不完整
+    size_t footer_offset = 0;
+    std::memcpy(&footer_offset, data.data() + data.size() - sizeof(Trailer), sizeof(uint64_t));
+    ASSERT_LT(footer_offset, data.size());
+    WriteFile(path, data.substr(0, footer_offset - 1));
+    Replayed replayed;
+    EXPECT_FALSE(Replay(path, &replayed));
+    EXPECT_LE(replayed.allocations.size(), records.size());
+    MappedTrace mapped;
+    EXPECT_FALSE(mapped.Open(path));
+
+    // 截断在文件头之后：没有任何完整的块
+    WriteFile(path, data.substr(0, sizeof(FileHeader) + 3));
+    replayed = Replayed();
+    EXPECT_FALSE(Replay(path, &replayed));
+    EXPECT_TRUE(replayed.allocations.empty());
+    MappedTrace mapped_header_only;
+    EXPECT_FALSE(mapped_header_only.Open(path));
+    std::remove(path.c_str());
+}
+
+TEST(MappedTraceTest, VisitMatchesWrittenRecords) {
+    std::vector<AllocationInfo> records = MakeRecords();
+    std::string path = WriteTrace("mapped.trace", records);
+
+    MappedTrace mapped;
+    ASSERT_TRUE(mapped.Open(path));
+    EXPECT_EQ(mapped.GetAllocationCount(), records.size());
+
+    std::vector<AllocationInfo> visited;
+    mapped.VisitTimeRange(0, std::numeric_limits<uint64_t>::max(),
+        [&visited](const RecordView& view) {
+            visited.push_back(view.ToAllocationInfo());
+            return true;
+        });
+    ASSERT_EQ(visited.size(), records.size());
+    for (size_t i = 0; i < records.size(); ++i) {
+        SCOPED_TRACE(i);
+        // 第 4 条由释放事件释放，FREED 位图同样标记
+        ExpectSameRecord(records[i], visited[i], i == 3 || i == 4);
+    }
+
+    size_t live = 0;
+    mapped.VisitLive([&live](const RecordView&) { ++live; return true; });
+    EXPECT_EQ(live, 3u);
+
+    size_t malloc_count = 0;
+    mapped.VisitByFunction("malloc", [&malloc_count](const RecordView&) { ++malloc_count; return true; });
+    EXPECT_EQ(malloc_count, 2u);
+    std::remove(path.c_str());
+}
+
+// 改写尾部或索引块头中的字段后重新打开
+class CorruptedFooterTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        path_ = WriteTrace("footer.trace", MakeRecords());
+        data_ = ReadFile(path_);
+        std::memcpy(&footer_offset_, data_.data() + data_.size() - sizeof(Trailer), sizeof(footer_offset_));
+        ASSERT_LT(footer_offset_, data_.size());
+    }
+
+    void TearDown() override { std::remove(path_.c_str()); }
+
+    template <typename T>
+    void Patch(size_t offset, T value) {
+        std::memcpy(&data_[offset], &value, sizeof(value));
+    }
+
+    bool Open() {
+        WriteFile(path_, data_);
+        MappedTrace mapped;
+        return mapped.Open(path_);
+    }
+
+    std::string path_;
+    std::string data_;
+    uint64_t footer_offset_ = 0;
+};
+
+TEST_F(CorruptedFooterTest, IntactFooterOpens) {
+    EXPECT_TRUE(Open());
+}
+
+TEST_F(CorruptedFooterTest, RejectsBadTrailerMagic) {
+    data_[data_.size() - 1] = 'X';
+    EXPECT_FALSE(Open());
+}
+
+TEST_F(CorruptedFooterTest, RejectsFooterOffsetOutOfRange) {
+    const size_t trailer = data_.size() - sizeof(Trailer);
+    Patch<uint64_t>(trailer, data_.size());
+    EXPECT_FALSE(Open());
+    // footer_offset 加上块头长度会回绕
+    Patch<uint64_t>(trailer, std::numeric_limits<uint64_t>::max() - 4);
+    EXPECT_FALSE(Open());
+}
+
+TEST_F(CorruptedFooterTest, RejectsWrongFooterType) {
+    Patch<uint32_t>(footer_offset_, static_cast<uint32_t>(ChunkType::RECORDS));
+    EXPECT_FALSE(Open());
+}
+
+TEST_F(CorruptedFooterTest, RejectsFooterSizeOutOfRange) {
+    Patch<uint32_t>(footer_offset_ + sizeof(uint32_t), std::numeric_limits<uint32_t>::max());
+    EXPECT_FALSE(Open());
+    // 小于项数字段本身
+    Patch<uint32_t>(footer_offset_ + sizeof(uint32_t), sizeof(uint64_t) - 1);
+    EXPECT_FALSE(Open());
+}
+
+TEST_F(CorruptedFooterTest, RejectsEntryCountOverflow) {
+    const size_t count_offset = footer_offset_ + sizeof(ChunkHeader);
+    uint64_t entry_count = 0;
+    std::memcpy(&entry_count, data_.data() + count_offset, sizeof(entry_count));
+    Patch<uint64_t>(count_offset, entry_count + 1);
+    EXPECT_FALSE(Open());
+    // entry_count * sizeof(FooterEntry) 回绕后恰好等于原来的长度
+    const uint64_t wrap = uint64_t(1) << 60;
+    ASSERT_EQ(wrap * sizeof(FooterEntry), 0u);
+    Patch<uint64_t>(count_offset, wrap + entry_count);
+    EXPECT_FALSE(Open());
+}
+
+} // namespace
+} // namespace storage
+} // namespace memory_tracer
@@ -0,0 +1,201 @@
+#include "elf_symbols.h"
+#include "logger/logger.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cxxabi.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace memory_tracer {
+namespace transport {
+
+namespace {
+
+size_t AlignNote(size_t size) {
+    return (size + 3) & ~static_cast<size_t>(3);
+}
+
+// 只读映射整个文件，析构时解除映射
+class MappedFile {
+public:
+    ~MappedFile() {
+        if (data_ != nullptr) {
+            munmap(const_cast<uint8_t*>(data_), size_);
+        }
+    }
+
+    bool Open(const std::string& path) {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+            close(fd);
+            return false;
+        }
+        void* data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED) {
+            return false;
+        }
+        data_ = static_cast<const uint8_t*>(data);
+        size_ = static_cast<size_t>(st.st_size);
+        return true;
+    }
+
+    // [offset, offset + length) 在文件内时返回其起始地址，边界检查写成减法形式
+    const uint8_t* Get(uint64_t offset, uint64_t length) const {
+        if (offset > size_ || length > size_ - offset) {
+            return nullptr;
+        }
+        return data_ + offset;
+    }
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+std::string Demangle(const char* name) {
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+    if (status != 0 || demangled == nullptr) {
+        return name;
+    }
+    std::string result(demangled);
+    std::free(demangled);
+    return result;
+}
+
+} // namespace
+
+std::string ReadBuildId(const uint8_t* notes, size_t size) {
+    size_t offset = 0;
+    while (size - offset >= sizeof(Elf64_Nhdr)) {
+        Elf64_Nhdr note;
+        std::memcpy(&note, notes + offset, sizeof(note));
+        offset += sizeof(note);
+        size_t name_size = AlignNote(note.n_namesz);
+        size_t desc_size = AlignNote(note.n_descsz);
+        if (name_size > size - offset || desc_size > size - offset - name_size) {
+            break;
+        }
+        if (note.n_type == NT_GNU_BUILD_ID && note.n_namesz == 4 && std::memcmp(notes + offset, "GNU", 4) == 0) {
+            return std::string(reinterpret_cast<const char*>(notes + offset + name_size), note.n_descsz);
+        }
+        offset += name_size + desc_size;
+    }
+    return std::string();
+}
+
+bool ElfSymbols::Load(const std::string& path, const std::string& build_id) {
+    symbols_.clear();
+    names_.clear();
+
+    MappedFile file;
+    if (!file.Open(path)) {
+        // vDSO 等没有对应文件的模块，帧退回为“模块名+偏移”
+        LOG_DEBUG("Cannot open {} for symbolization", path);
+        return false;
+    }
+    const uint8_t* data = file.Get(0, sizeof(Elf64_Ehdr));
+    Elf64_Ehdr ehdr;
+    if (data != nullptr) {
+        std::memcpy(&ehdr, data, sizeof(ehdr));
+    }
+    if (data == nullptr || std::memcmp(ehdr.e_ident, ELFMAG, SELFMAG) != 0 || ehdr.e_ident[EI_CLASS] != ELFCLASS64 ||
+        ehdr.e_shentsize != sizeof(Elf64_Shdr)) {
+        LOG_WARN("{} is not a 64-bit ELF file", path);
+        return false;
+    }
+    const uint8_t* section_table = file.Get(ehdr.e_shoff, static_cast<uint64_t>(ehdr.e_shnum) * sizeof(Elf64_Shdr));
+    if (section_table == nullptr) {
+        LOG_WARN("{} has no readable section table", path);
+        return false;
+    }
+    std::vector<Elf64_Shdr> sections(ehdr.e_shnum);
+    std::memcpy(sections.data(), section_table, sections.size() * sizeof(Elf64_Shdr));
+
+    if (!build_id.empty()) {
+        std::string file_build_id;
+        for (const auto& section : sections) {
+            if (section.sh_type != SHT_NOTE) continue;
+            if (const uint8_t* notes = file.Get(section.sh_offset, section.sh_size)) {
+                file_build_id = ReadBuildId(notes, static_cast<size_t>(section.sh_size));
+                if (!file_build_id.empty()) break;
+            }
+        }
+        if (file_build_id != build_id) {
+            LOG_WARN("Build ID of {} does not match the traced process, skipping its symbols", path);
+            return false;
+        }
+    }
+
+    // 优先使用完整的 .symtab，被 strip 的文件退回到 .dynsym
+    const Elf64_Shdr* symtab = nullptr;
+    for (uint32_t type : {static_cast<uint32_t>(SHT_SYMTAB), static_cast<uint32_t>(SHT_DYNSYM)}) {
+        for (const auto& section : sections) {
+            if (section.sh_type == type && section.sh_entsize == sizeof(Elf64_Sym) && section.sh_link < sections.size()) {
+                symtab = &section;
+                break;
+            }
+        }
+        if (symtab != nullptr) break;
+    }
+    if (symtab == nullptr) {
+        LOG_WARN("{} has no symbol table", path);
+        return false;
+    }
+    const Elf64_Shdr& strtab = sections[symtab->sh_link];
+    const uint8_t* symbol_data = file.Get(symtab->sh_offset, symtab->sh_size);
+    const uint8_t* string_data = file.Get(strtab.sh_offset, strtab.sh_size);
+    if (symbol_data == nullptr || string_data == nullptr || strtab.sh_size == 0) {
+        LOG_WARN("{} has a corrupted symbol table", path);
+        return false;
+    }
+
+    size_t count = static_cast<size_t>(symtab->sh_size / sizeof(Elf64_Sym));
+    for (size_t i = 0; i < count; ++i) {
+        Elf64_Sym sym;
+        std::memcpy(&sym, symbol_data + i * sizeof(Elf64_Sym), sizeof(sym));
+        uint8_t type = ELF64_ST_TYPE(sym.st_info);
+        if ((type != STT_FUNC && type != STT_GNU_IFUNC) || sym.st_shndx == SHN_UNDEF || sym.st_value == 0 ||
+            sym.st_name >= strtab.sh_size) {
+            continue;
+        }
+        const char* name = reinterpret_cast<const char*>(string_data + sym.st_name);
+        size_t length = strnlen(name, static_cast<size_t>(strtab.sh_size - sym.st_name));
+        if (length == 0 || length == strtab.sh_size - sym.st_name) {
+            continue;
+        }
+        symbols_.push_back({sym.st_value, sym.st_size, static_cast<uint32_t>(names_.size())});
+        names_.append(name, length);
+        names_.push_back('\0');
+    }
+    std::sort(symbols_.begin(), symbols_.end(),
+              [](const Symbol& a, const Symbol& b) { return a.address < b.address; });
+    LOG_DEBUG("Loaded {} symbols from {}", symbols_.size(), path);
+    return true;
+}
+
+std::string ElfSymbols::Lookup(uint64_t address) const {
+    auto it = std::upper_bound(symbols_.begin(), symbols_.end(), address,
+                               [](uint64_t value, const Symbol& symbol) { return value < symbol.address; });
+    if (it == symbols_.begin()) {
+        return std::string();
+    }
+    --it;
+    // 大小已知时地址必须落在符号之内，否则是两个函数之间的填充或未导出的代码
+    if (it->size != 0 && address - it->address >= it->size) {
+        return std::string();
+    }
+    return Demangle(names_.c_str() + it->name);
+}
+
+} // namespace transport
+} // namespace memory_tracer
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace memory_tracer {
+namespace transport {
+
+// 收集器一侧读取生产者模块文件的函数符号（.symtab，没有时用 .dynsym），
+// 用于在不进入被追踪进程的情况下把返回地址还原为函数名
+class ElfSymbols {
+public:
+    // 读取 ELF 文件；build_id 非空时要求与文件的 NT_GNU_BUILD_ID 一致（文件在进程启动后被替换时拒绝）
+    bool Load(const std::string& path, const std::string& build_id);
+
+    // 文件内虚拟地址所在的函数名（已还原 C++ 名字），找不到时返回空字符串
+    std::string Lookup(uint64_t address) const;
+
+    size_t GetSymbolCount() const { return symbols_.size(); }
+
+private:
+    struct Symbol {
+        uint64_t address;
+        uint64_t size;       // 0 表示未知，此时取地址之前最近的符号
+        uint32_t name;       // names_ 中的偏移
+    };
+
+    std::vector<Symbol> symbols_;   // 按地址排序
+    std::string names_;             // 以 '\0' 分隔的符号名
+};
+
+// 从内存中的 ELF note 段读取 NT_GNU_BUILD_ID，没有时返回空字符串
+std::string ReadBuildId(const uint8_t* notes, size_t size);
+
+} // namespace transport
+} // namespace memory_tracer
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "capture/capture.h"
+
+namespace memory_tracer {
+namespace transport {
+
+// 共享内存名的默认前缀，生产者为 /<前缀>.<pid>
+constexpr const char* kDefaultShmPrefix = "memory_tracer";
+
+struct PublisherOptions {
+    std::string prefix;      // 共享内存名前缀，收集器按前缀发现生产者
+    size_t ring_bytes;       // 环的大小，向上取整为 2 的幂
+    bool send_modules;       // 同时发送已加载模块的地址区间、build-id 和路径，收集器据此符号化
+
+    PublisherOptions() : prefix(kDefaultShmPrefix), ring_bytes(64u << 20), send_modules(true) {}
+};
+
+// 被追踪进程一侧：作为 Capture 的事件监听器，把合并后的事件按原样写入共享内存环，
+// 调用栈（原始返回地址）和所在模块在首次出现时随事件一起发送，被追踪进程中不做符号化。
+// Storage/Stats 等不必在被追踪进程中运行；环写满时丢弃事件并计数，不会阻塞合并线程
+class ShmPublisher {
+public:
+    static ShmPublisher& GetInstance();
+
+    // 创建共享内存并注册为 Capture 的事件监听器，失败时返回 false
+    bool Start(const PublisherOptions& options = PublisherOptions());
+
+    // 标记环已关闭，收集器读完剩余事件后删除共享内存。应在 StopCapture 之后调用
+    void Stop();
+
+    bool IsRunning() const;
+
+    // 共享内存名（含前导 '/'），未启动时为空
+    std::string GetName() const;
+
+    // 因环写满而丢弃的事件数
+    uint64_t GetDroppedCount() const;
+
+    void Publish(const capture::CaptureEvent* events, size_t count);
+
+private:
+    ShmPublisher();
+    ~ShmPublisher();
+    ShmPublisher(const ShmPublisher&) = delete;
+    ShmPublisher& operator=(const ShmPublisher&) = delete;
+
+    class Impl;
+    std::unique_ptr<Impl> pimpl_;
+};
+
+struct CollectorOptions {
+    std::string prefix;      // 自动发现 /dev/shm 下以 <前缀>. 开头的生产者，为空时只读取 Attach 的环
+    int poll_interval_ms;    // 所有环都为空时的等待间隔
+
+    CollectorOptions() : prefix(kDefaultShmPrefix), poll_interval_ms(10) {}
+};
+
+// 收集器一侧：在独立进程中读取一个或多个生产者的环，按生产者发送的模块读取其 ELF 文件的符号表，
+// 把调用栈和符号登记到本进程的 StackTable/Symbolizer，再把事件投递给监听器（通常是 Storage::AddEvents
+// 和 Stats::AddEvents）。多个进程的地址可能重叠，第 n 个连接的生产者的事件地址和帧地址高 16 位置为 n
+// （第一个生产者的地址不变）。65536 个序号用尽后复用最早退出的生产者的序号，复用前清除它的符号，
+// 此后该生产者的调用栈只显示地址
+class ShmCollector {
+public:
+    static ShmCollector& GetInstance();
+
+    // 注册事件批量监听器，在收集线程中按环内顺序投递
+    void AddEventListener(capture::Capture::EventBatchCallback callback);
+
+    // 手动连接一个生产者的共享内存
+    bool Attach(const std::string& name);
+
+    // 启动收集线程
+    void Start(const CollectorOptions& options = CollectorOptions());
+
+    // 停止收集线程，读完各环中已有的事件
+    void Stop();
+
+    // 读取一遍所有环（Start 之后由收集线程调用），返回投递的事件数
+    size_t Poll();
+
+    // 当前连接的生产者数
+    size_t GetProducerCount() const;
+
+    // 各生产者累计丢弃的事件数
+    uint64_t GetDroppedCount() const;
+
+private:
+    ShmCollector();
+    ~ShmCollector();
+    ShmCollector(const ShmCollector&) = delete;
+    ShmCollector& operator=(const ShmCollector&) = delete;
+
+    class Impl;
+    std::unique_ptr<Impl> pimpl_;
+};
+
+} // namespace transport
+} // namespace memory_tracer
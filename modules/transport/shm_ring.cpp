@@ -0,0 +1,164 @@
+#include "shm_ring.h"
+#include "capture/capture.h"
+#include "logger/logger.h"
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace memory_tracer {
+namespace transport {
+
+namespace {
+
+// 数据区紧跟在头部之后，按缓存行对齐
+constexpr size_t kDataOffset = (sizeof(RingHeader) + 63) & ~static_cast<size_t>(63);
+
+size_t AlignMessage(size_t size) {
+    return (size + 7) & ~static_cast<size_t>(7);
+}
+
+size_t RoundUpToPowerOfTwo(size_t value) {
+    size_t result = 4096;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+} // namespace
+
+ShmRing::~ShmRing() {
+    Close();
+}
+
+bool ShmRing::Create(const std::string& name, size_t capacity) {
+    Close();
+    capacity = RoundUpToPowerOfTwo(capacity);
+    size_t size = kDataOffset + capacity;
+
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        LOG_ERROR("Failed to create shared memory {}: {}", name, std::strerror(errno));
+        return false;
+    }
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        LOG_ERROR("Failed to size shared memory {}: {}", name, std::strerror(errno));
+        close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+    bool mapped = Map(fd, size);
+    close(fd);
+    if (!mapped) {
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    header_ = new (header_) RingHeader();
+    header_->magic = kRingMagic;
+    header_->version = kRingVersion;
+    header_->event_size = sizeof(capture::CaptureEvent);
+    header_->capacity = capacity;
+    header_->pid = getpid();
+    header_->write_pos.store(0, std::memory_order_relaxed);
+    header_->read_pos.store(0, std::memory_order_relaxed);
+    header_->dropped_events.store(0, std::memory_order_relaxed);
+    capacity_ = capacity;
+    mask_ = capacity - 1;
+    header_->state.store(RING_OPEN, std::memory_order_release);
+    return true;
+}
+
+bool ShmRing::Open(const std::string& name) {
+    Close();
+    int fd = shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < kDataOffset || !Map(fd, st.st_size)) {
+        close(fd);
+        return false;
+    }
+    close(fd);
+
+    // 生产者可能尚未写完头部
+    if (header_->state.load(std::memory_order_acquire) == RING_INITIALIZING || header_->magic != kRingMagic) {
+        Close();
+        return false;
+    }
+    if (header_->version != kRingVersion || header_->event_size != sizeof(capture::CaptureEvent) ||
+        kDataOffset + header_->capacity != mapped_size_ || (header_->capacity & (header_->capacity - 1)) != 0) {
+        LOG_WARN("Ignoring incompatible shared memory ring {}", name);
+        Close();
+        return false;
+    }
+    capacity_ = header_->capacity;
+    mask_ = capacity_ - 1;
+    return true;
+}
+
+void ShmRing::Close() {
+    if (header_ != nullptr) {
+        munmap(header_, mapped_size_);
+    }
+    header_ = nullptr;
+    data_ = nullptr;
+    capacity_ = 0;
+    mask_ = 0;
+    mapped_size_ = 0;
+}
+
+bool ShmRing::Map(int fd, size_t size) {
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED) {
+        LOG_ERROR("Failed to map shared memory: {}", std::strerror(errno));
+        return false;
+    }
+    header_ = static_cast<RingHeader*>(memory);
+    data_ = static_cast<char*>(memory) + kDataOffset;
+    mapped_size_ = size;
+    return true;
+}
+
+bool ShmRing::Write(MessageType type, const void* first, size_t first_size, const void* second,
+                    size_t second_size) {
+    size_t size = AlignMessage(sizeof(MessageHeader) + first_size + second_size);
+    if (size > GetMaxMessageSize()) {
+        return false;
+    }
+
+    uint64_t write = header_->write_pos.load(std::memory_order_relaxed);
+    uint64_t read = header_->read_pos.load(std::memory_order_acquire);
+    size_t offset = write & mask_;
+    size_t tail = capacity_ - offset;
+    size_t padding = tail < size ? tail : 0;
+    if (capacity_ - (write - read) < padding + size) {
+        return false;
+    }
+
+    if (padding > 0) {
+        auto* pad = reinterpret_cast<MessageHeader*>(data_ + offset);
+        pad->size = static_cast<uint32_t>(padding);
+        pad->type = MessageType::PAD;
+        offset = 0;
+    }
+    auto* message = reinterpret_cast<MessageHeader*>(data_ + offset);
+    message->size = static_cast<uint32_t>(size);
+    message->type = type;
+    char* payload = reinterpret_cast<char*>(message + 1);
+    std::memcpy(payload, first, first_size);
+    if (second_size > 0) {
+        std::memcpy(payload + first_size, second, second_size);
+    }
+    header_->write_pos.store(write + padding + size, std::memory_order_release);
+    return true;
+}
+
+} // namespace transport
+} // namespace memory_tracer
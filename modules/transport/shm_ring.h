@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace memory_tracer {
+namespace transport {
+
+// 共享内存中的消息类型
+enum class MessageType : uint32_t {
+    PAD = 0,      // 环尾部不足一条消息时的填充
+    EVENTS = 1,   // 一批 CaptureEvent
+    STACK = 2,    // 调用栈定义：StackId + 帧数 + 帧地址
+    MODULE = 3    // 已加载模块的可执行段：地址区间 + 装载偏移 + build-id + 文件路径
+};
+
+// 单生产者单消费者的字节环：消息以 8 字节对齐的 MessageHeader 开头，写不下时在尾部填充后从头写。
+// 读写位置单调递增，各自只由一方写入；生产者写满时不等待，由调用方计入丢弃
+struct RingHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t event_size;           // sizeof(CaptureEvent)，两端的构建不一致时拒绝连接
+    uint64_t capacity;             // 数据区字节数，2 的幂
+    int32_t pid;                   // 生产者进程
+    std::atomic<uint32_t> state;   // RingState
+    alignas(64) std::atomic<uint64_t> write_pos;
+    alignas(64) std::atomic<uint64_t> read_pos;
+    alignas(64) std::atomic<uint64_t> dropped_events;
+};
+
+enum RingState : uint32_t {
+    RING_INITIALIZING = 0,
+    RING_OPEN = 1,
+    RING_CLOSED = 2      // 生产者已停止，消费者读完后可以删除
+};
+
+struct MessageHeader {
+    uint32_t size;       // 含头部、按 8 字节对齐后的长度
+    MessageType type;
+};
+
+constexpr uint64_t kRingMagic = 0x474e4952544d454dULL;   // "MEMTRING"
+constexpr uint32_t kRingVersion = 2;
+
+// 映射一块共享内存中的环，创建方为生产者，打开方为消费者
+class ShmRing {
+public:
+    ShmRing() = default;
+    ~ShmRing();
+
+    ShmRing(const ShmRing&) = delete;
+    ShmRing& operator=(const ShmRing&) = delete;
+
+    // 创建 /dev/shm 下的共享内存（已存在时覆盖），capacity 向上取整为 2 的幂
+    bool Create(const std::string& name, size_t capacity);
+
+    // 打开已有的共享内存并校验头部
+    bool Open(const std::string& name);
+
+    void Close();
+    bool IsOpen() const { return header_ != nullptr; }
+    RingHeader* GetHeader() const { return header_; }
+
+    // 生产者：写入一条由两段数据拼成的消息，空间不足时返回 false
+    bool Write(MessageType type, const void* first, size_t first_size, const void* second = nullptr,
+               size_t second_size = 0);
+
+    // 消费者：依次回调已写入的消息（跳过填充），返回处理的消息数
+    template <typename Handler>
+    size_t Read(Handler&& handler) {
+        uint64_t read = header_->read_pos.load(std::memory_order_relaxed);
+        uint64_t write = header_->write_pos.load(std::memory_order_acquire);
+        size_t messages = 0;
+        while (read < write) {
+            const auto* message = reinterpret_cast<const MessageHeader*>(data_ + (read & mask_));
+            if (message->size < sizeof(MessageHeader) || message->size > write - read) {
+                // 消息头损坏，丢弃已写入的全部数据
+                read = write;
+                break;
+            }
+            if (message->type != MessageType::PAD) {
+                handler(message->type, reinterpret_cast<const char*>(message + 1),
+                        message->size - sizeof(MessageHeader));
+                ++messages;
+            }
+            read += message->size;
+        }
+        header_->read_pos.store(read, std::memory_order_release);
+        return messages;
+    }
+
+    bool Empty() const {
+        return header_->read_pos.load(std::memory_order_acquire) == header_->write_pos.load(std::memory_order_acquire);
+    }
+
+    // 单条消息的长度上限（数据区的一半），保证填充后总能写下
+    size_t GetMaxMessageSize() const { return capacity_ / 2; }
+
+private:
+    bool Map(int fd, size_t size);
+
+    RingHeader* header_ = nullptr;
+    char* data_ = nullptr;
+    size_t capacity_ = 0;
+    size_t mask_ = 0;
+    size_t mapped_size_ = 0;
+};
+
+} // namespace transport
+} // namespace memory_tracer
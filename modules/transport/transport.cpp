@@ -0,0 +1,674 @@
+#include "transport/transport.h"
+#include "elf_symbols.h"
+#include "shm_ring.h"
+#include "capture/internal_allocator.h"
+#include "capture/stack_table.h"
+#include "capture/symbolizer.h"
+#include "logger/logger.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <dirent.h>
+#include <link.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace memory_tracer {
+namespace transport {
+
+namespace {
+
+// 一条 EVENTS 消息最多携带的事件数
+constexpr size_t kEventsPerMessage = 2048;
+
+struct EventsMessage {
+    uint64_t count;
+};
+
+struct StackMessage {
+    uint64_t stack_id;
+    uint64_t frame_count;
+};
+
+// 之后依次是 build-id 和文件路径（不以 '\0' 结尾）
+struct ModuleMessage {
+    uint64_t start;          // 可执行段 [start, end)
+    uint64_t end;
+    uint64_t load_bias;      // 段内地址减去装载偏移即为 ELF 文件中的虚拟地址
+    uint32_t build_id_size;
+    uint32_t path_size;
+};
+
+// 常见的 build-id 为 20 字节（SHA-1），更长的不发送，收集器读取文件时不做校验
+constexpr size_t kMaxBuildIdSize = 64;
+
+// 生产者序号放在地址的高 16 位，用户态地址不超过 47 位
+constexpr int kProducerTagShift = 48;
+constexpr uint64_t kProducerTagCount = 1ULL << 16;
+
+} // namespace
+
+class ShmPublisher::Impl {
+public:
+    Impl()
+        : running_(false), listener_registered_(false), send_modules_(true), scanned_adds_(0), scanned_subs_(0),
+          dropped_(0) {}
+
+    ~Impl() {
+        Stop();
+    }
+
+    bool Start(const PublisherOptions& options) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (running_) {
+            return true;
+        }
+
+        name_ = "/" + options.prefix + "." + std::to_string(getpid());
+        if (!ring_.Create(name_, options.ring_bytes)) {
+            name_.clear();
+            return false;
+        }
+        send_modules_ = options.send_modules;
+        sent_stacks_.clear();
+        module_ranges_.clear();
+        pending_modules_.clear();
+        scanned_adds_ = 0;
+        scanned_subs_ = 0;
+        dropped_ = 0;
+        events_per_message_ = std::min(kEventsPerMessage,
+            (ring_.GetMaxMessageSize() - sizeof(MessageHeader) - sizeof(EventsMessage)) / sizeof(capture::CaptureEvent));
+        running_ = true;
+
+        // 主程序在 dl_iterate_phdr 中没有名字，路径取自 /proc/self/exe
+        ssize_t length = readlink("/proc/self/exe", exe_path_, sizeof(exe_path_) - 1);
+        exe_path_[length > 0 ? length : 0] = '\0';
+        if (send_modules_) {
+            ScanModules();
+            SendPendingModules();
+        }
+
+        // Capture 不支持注销监听器，只注册一次，停止后收到的事件直接忽略
+        if (!listener_registered_) {
+            capture::Capture::GetInstance().AddEventListener([](const capture::CaptureEvent* events, size_t count) {
+                ShmPublisher::GetInstance().Publish(events, count);
+            });
+            listener_registered_ = true;
+        }
+        LOG_INFO("Shared memory publisher started: {} ({} bytes)", name_, ring_.GetHeader()->capacity);
+        return true;
+    }
+
+    void Stop() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) {
+            return;
+        }
+        running_ = false;
+        // 共享内存由收集器读完后删除
+        ring_.GetHeader()->state.store(RING_CLOSED, std::memory_order_release);
+        ring_.Close();
+        LOG_INFO("Shared memory publisher stopped: {}, {} events dropped", name_, dropped_.load());
+        name_.clear();
+    }
+
+    bool IsRunning() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return running_;
+    }
+
+    std::string GetName() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return name_;
+    }
+
+    uint64_t GetDroppedCount() const {
+        return dropped_.load(std::memory_order_relaxed);
+    }
+
+    void Publish(const capture::CaptureEvent* events, size_t count) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) {
+            return;
+        }
+
+        // 没有模块装载或卸载时扫描在第一个回调即结束，每批事件扫描一次即可覆盖之间的 dlopen/dlclose
+        if (send_modules_) {
+            ScanModules();
+        }
+        SendPendingModules();
+        for (size_t first = 0; first < count; first += events_per_message_) {
+            size_t chunk = std::min(events_per_message_, count - first);
+            // 先发送本批事件引用的新调用栈，收集器总是先收到定义。
+            // 环满写不下的定义留到下次引用时重发，事件照常发送，收集器把未定义的调用栈记为无调用栈
+            for (size_t i = first; i < first + chunk; ++i) {
+                const auto& event = events[i];
+                if (event.stack_id != capture::kInvalidStackId && !sent_stacks_.count(event.stack_id)) {
+                    SendStack(event.stack_id);
+                }
+            }
+
+            EventsMessage message{chunk};
+            if (!ring_.Write(MessageType::EVENTS, &message, sizeof(message), events + first,
+                             chunk * sizeof(capture::CaptureEvent))) {
+                dropped_.fetch_add(chunk, std::memory_order_relaxed);
+                ring_.GetHeader()->dropped_events.fetch_add(chunk, std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    struct ModuleRange {
+        uintptr_t start;
+        uintptr_t end;
+        uintptr_t load_bias;
+        std::string build_id;
+        std::string path;
+    };
+
+    // 只发送原始地址，不在被追踪进程中符号化；帧所在的模块在本批开始时已经发送
+    bool SendStack(capture::StackId stack_id) {
+        std::vector<void*> frames = capture::StackTable::GetInstance().GetFrames(stack_id);
+        size_t max_frames = (ring_.GetMaxMessageSize() - sizeof(MessageHeader) - sizeof(StackMessage)) / sizeof(void*);
+        StackMessage stack{stack_id, std::min(frames.size(), max_frames)};
+        if (!ring_.Write(MessageType::STACK, &stack, sizeof(stack), frames.data(), stack.frame_count * sizeof(void*))) {
+            return false;
+        }
+        sent_stacks_.insert(stack_id);
+        return true;
+    }
+
+    // 按 dl_iterate_phdr 登记当前装载模块的可执行段，build-id 直接从内存中的 note 段读取，不读文件。
+    // 新出现的段和同一地址上换成其他文件的段（dlclose 后 dlopen 到原地址）重新发送，已卸载的段不再登记
+    void ScanModules() {
+        scanning_ranges_.clear();
+        scan_changed_ = false;
+        dl_iterate_phdr([](dl_phdr_info* info, size_t, void* data) { return static_cast<Impl*>(data)->AddModule(info); },
+                        this);
+        if (!scan_changed_) {
+            return;
+        }
+        std::sort(scanning_ranges_.begin(), scanning_ranges_.end(),
+                  [](const ModuleRange& a, const ModuleRange& b) { return a.start < b.start; });
+        for (const auto& range : scanning_ranges_) {
+            auto it = std::lower_bound(module_ranges_.begin(), module_ranges_.end(), range.start,
+                                       [](const ModuleRange& value, uintptr_t start) { return value.start < start; });
+            bool known = it != module_ranges_.end() && it->start == range.start && it->end == range.end &&
+                         it->build_id == range.build_id && it->path == range.path;
+            if (!known) {
+                pending_modules_.push_back(EncodeModule(range));
+            }
+        }
+        module_ranges_.swap(scanning_ranges_);
+        scanning_ranges_.clear();
+    }
+
+    int AddModule(dl_phdr_info* info) {
+        // dlpi_adds/dlpi_subs 对所有模块相同：自上次扫描后没有装载或卸载过模块时第一个回调即结束
+        if (!scan_changed_) {
+            if (info->dlpi_adds == scanned_adds_ && info->dlpi_subs == scanned_subs_) {
+                return 1;
+            }
+            scan_changed_ = true;
+            scanned_adds_ = info->dlpi_adds;
+            scanned_subs_ = info->dlpi_subs;
+        }
+
+        std::string build_id;
+        for (ElfW(Half) i = 0; i < info->dlpi_phnum && build_id.empty(); ++i) {
+            const ElfW(Phdr)& phdr = info->dlpi_phdr[i];
+            if (phdr.p_type == PT_NOTE) {
+                build_id = ReadBuildId(reinterpret_cast<const uint8_t*>(info->dlpi_addr + phdr.p_vaddr), phdr.p_memsz);
+            }
+        }
+        if (build_id.size() > kMaxBuildIdSize) {
+            build_id.clear();
+        }
+        const char* path = info->dlpi_name != nullptr && info->dlpi_name[0] != '\0' ? info->dlpi_name : exe_path_;
+
+        for (ElfW(Half) i = 0; i < info->dlpi_phnum; ++i) {
+            const ElfW(Phdr)& phdr = info->dlpi_phdr[i];
+            if (phdr.p_type == PT_LOAD && (phdr.p_flags & PF_X)) {
+                scanning_ranges_.push_back({info->dlpi_addr + phdr.p_vaddr, info->dlpi_addr + phdr.p_vaddr + phdr.p_memsz,
+                                            info->dlpi_addr, build_id, path});
+            }
+        }
+        return 0;
+    }
+    // 路径过长时保留结尾部分，消息总不超过环的单条上限
+    std::string EncodeModule(const ModuleRange& range) const {
+        size_t limit = ring_.GetMaxMessageSize() - sizeof(MessageHeader) - sizeof(ModuleMessage) - range.build_id.size();
+        size_t offset = range.path.size() > limit ? range.path.size() - limit : 0;
+        size_t path_size = range.path.size() - offset;
+        ModuleMessage module{range.start, range.end, range.load_bias, static_cast<uint32_t>(range.build_id.size()),
+                             static_cast<uint32_t>(path_size)};
+        std::string message(reinterpret_cast<const char*>(&module), sizeof(module));
+        message.append(range.build_id);
+        message.append(range.path, offset, path_size);
+        return message;
+    }
+
+    // 环满时保留未写出的模块，按顺序重试
+    void SendPendingModules() {
+        size_t sent = 0;
+        while (sent < pending_modules_.size() &&
+               ring_.Write(MessageType::MODULE, pending_modules_[sent].data(), pending_modules_[sent].size())) {
+            ++sent;
+        }
+        pending_modules_.erase(pending_modules_.begin(), pending_modules_.begin() + sent);
+    }
+
+    mutable std::mutex mutex_;
+    ShmRing ring_;
+    std::string name_;
+    bool running_;
+    bool listener_registered_;
+    bool send_modules_;
+    size_t events_per_message_ = kEventsPerMessage;
+    std::unordered_set<capture::StackId> sent_stacks_;
+    std::vector<ModuleRange> module_ranges_;      // 已登记的可执行段，按起始地址排序
+    std::vector<ModuleRange> scanning_ranges_;    // 本次扫描收集到的可执行段
+    std::vector<std::string> pending_modules_;    // 尚未写入环的 MODULE 消息
+    unsigned long long scanned_adds_;             // 上次扫描时的 dlpi_adds/dlpi_subs
+    unsigned long long scanned_subs_;
+    bool scan_changed_ = false;
+    char exe_path_[PATH_MAX] = {};
+    std::atomic<uint64_t> dropped_;
+};
+
+class ShmCollector::Impl {
+public:
+    Impl() : running_(false), next_tag_(0), retired_dropped_(0) {}
+
+    ~Impl() {
+        Stop();
+    }
+
+    void AddEventListener(capture::Capture::EventBatchCallback callback) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        listeners_.push_back(callback);
+    }
+
+    bool Attach(const std::string& name) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return AttachLocked(name);
+    }
+
+    void Start(const CollectorOptions& options) {
+        if (running_) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            options_ = options;
+        }
+        running_ = true;
+        thread_ = std::thread([this]() {
+            while (running_) {
+                if (Poll() == 0) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(std::max(options_.poll_interval_ms, 1)));
+                }
+            }
+        });
+        LOG_INFO("Shared memory collector started, prefix: {}", options.prefix);
+    }
+
+    void Stop() {
+        if (!running_.exchange(false)) {
+            return;
+        }
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+        Poll();
+        LOG_INFO("Shared memory collector stopped");
+    }
+
+    size_t Poll() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Discover();
+
+        size_t delivered = 0;
+        for (auto it = producers_.begin(); it != producers_.end();) {
+            Producer& producer = **it;
+            delivered += Drain(producer);
+
+            RingHeader* header = producer.ring.GetHeader();
+            bool closed = header->state.load(std::memory_order_acquire) == RING_CLOSED;
+            bool exited = !closed && kill(producer.pid, 0) != 0 && errno == ESRCH;
+            if ((closed || exited) && producer.ring.Empty()) {
+                if (exited) {
+                    LOG_WARN("Producer {} (pid {}) exited without closing its ring", producer.name, producer.pid);
+                } else {
+                    LOG_INFO("Producer {} (pid {}) detached, {} events dropped", producer.name, producer.pid,
+                             header->dropped_events.load(std::memory_order_relaxed));
+                }
+                retired_dropped_ += header->dropped_events.load(std::memory_order_relaxed);
+                producer.ring.Close();
+                shm_unlink(producer.name.c_str());
+                attached_.erase(producer.name);
+                // 已记录的调用栈仍引用该序号的符号，序号在再次分配时才清除
+                free_tags_.push_back(producer.tag);
+                tags_exhausted_ = false;
+                it = producers_.erase(it);
+                ReleaseSymbols();
+            } else {
+                ++it;
+            }
+        }
+        return delivered;
+    }
+
+    size_t GetProducerCount() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return producers_.size();
+    }
+
+    uint64_t GetDroppedCount() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint64_t dropped = retired_dropped_;
+        for (const auto& producer : producers_) {
+            dropped += producer->ring.GetHeader()->dropped_events.load(std::memory_order_relaxed);
+        }
+        return dropped;
+    }
+
+private:
+    struct Module {
+        uint64_t start;
+        uint64_t end;
+        uint64_t load_bias;
+        std::string path;
+        std::shared_ptr<const ElfSymbols> symbols;   // 文件无法读取或 build-id 不一致时为空
+    };
+
+    struct Producer {
+        std::string name;
+        ShmRing ring;
+        int32_t pid = 0;
+        uint64_t tag = 0;   // 置入事件地址和帧地址高位的生产者序号
+        std::unordered_map<capture::StackId, capture::StackId> stacks;   // 生产者的调用栈 ID -> 本进程的 ID
+        std::vector<Module> modules;        // 按起始地址排序
+        std::vector<uint64_t> unresolved;   // 收到时还没有模块覆盖的帧地址（生产者地址空间）
+        std::set<uint64_t> symbolized;      // 已登记到 Symbolizer 的帧地址（生产者地址空间）
+    };
+
+    bool AttachLocked(const std::string& name) {
+        if (attached_.count(name)) {
+            return true;
+        }
+        auto producer = std::make_unique<Producer>();
+        if (!producer->ring.Open(name)) {
+            return false;
+        }
+        if (!AllocateTag(&producer->tag)) {
+            if (!tags_exhausted_) {
+                LOG_WARN("All {} producer tags are in use, not attaching {}", kProducerTagCount, name);
+                tags_exhausted_ = true;
+            }
+            producer->ring.Close();
+            return false;
+        }
+        producer->name = name;
+        producer->pid = producer->ring.GetHeader()->pid;
+        attached_.insert(name);
+        LOG_INFO("Attached producer {} (pid {})", name, producer->pid);
+        producers_.push_back(std::move(producer));
+        return true;
+    }
+
+    // 先分配从未用过的序号；用尽后复用最早退出的生产者的序号，复用前清除它留下的符号
+    bool AllocateTag(uint64_t* tag) {
+        if (next_tag_ < kProducerTagCount) {
+            *tag = next_tag_++;
+            return true;
+        }
+        if (free_tags_.empty()) {
+            return false;
+        }
+        *tag = free_tags_.front();
+        free_tags_.pop_front();
+        capture::Symbolizer::GetInstance().RemoveSymbols(reinterpret_cast<void*>(*tag << kProducerTagShift),
+                                                         reinterpret_cast<void*>((*tag + 1) << kProducerTagShift));
+        return true;
+    }
+
+    // 每秒扫描一次 /dev/shm
+    void Discover() {
+        if (options_.prefix.empty()) {
+            return;
+        }
+        auto now = std::chrono::steady_clock::now();
+        if (now - last_discovery_ < std::chrono::seconds(1)) {
+            return;
+        }
+        last_discovery_ = now;
+
+        DIR* dir = opendir("/dev/shm");
+        if (dir == nullptr) {
+            return;
+        }
+        std::string prefix = options_.prefix + ".";
+        while (dirent* entry = readdir(dir)) {
+            if (std::strncmp(entry->d_name, prefix.c_str(), prefix.size()) == 0) {
+                AttachLocked(std::string("/") + entry->d_name);
+            }
+        }
+        closedir(dir);
+    }
+
+    // 同一文件只读取一次，多个生产者运行同一程序时共享
+    std::shared_ptr<const ElfSymbols> LoadSymbols(const std::string& path, const std::string& build_id) {
+        std::string key = path + '\0' + build_id;
+        auto it = elf_files_.find(key);
+        if (it == elf_files_.end()) {
+            auto symbols = std::make_shared<ElfSymbols>();
+            if (!symbols->Load(path, build_id)) {
+                symbols.reset();
+            }
+            it = elf_files_.emplace(std::move(key), std::move(symbols)).first;
+        }
+        return it->second;
+    }
+
+    // 释放已没有生产者使用的符号表
+    void ReleaseSymbols() {
+        for (auto it = elf_files_.begin(); it != elf_files_.end();) {
+            if (it->second.use_count() <= 1) {
+                it = elf_files_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    void AddModule(Producer& producer, const char* payload, size_t size) {
+        ModuleMessage message;
+        if (size < sizeof(message)) return;
+        std::memcpy(&message, payload, sizeof(message));
+        if (message.build_id_size > size - sizeof(message) ||
+            message.path_size > size - sizeof(message) - message.build_id_size || message.start >= message.end) {
+            return;
+        }
+        const char* build_id = payload + sizeof(message);
+        Module module{message.start, message.end, message.load_bias,
+                      std::string(build_id + message.build_id_size, message.path_size), nullptr};
+        module.symbols = LoadSymbols(module.path, std::string(build_id, message.build_id_size));
+
+        // 与新模块重叠的旧模块已被卸载：移除它们，按旧模块登记过的帧与未解析的帧一起重新符号化
+        auto first = std::lower_bound(producer.modules.begin(), producer.modules.end(), module.start,
+                                      [](const Module& value, uint64_t start) { return value.end <= start; });
+        auto last = first;
+        for (; last != producer.modules.end() && last->start < module.end; ++last) {
+            producer.unresolved.insert(producer.unresolved.end(), producer.symbolized.lower_bound(last->start),
+                                       producer.symbolized.lower_bound(last->end));
+        }
+        auto it = producer.modules.insert(producer.modules.erase(first, last), std::move(module));
+
+        // 补上之前缺少模块的帧
+        const Module& added = *it;
+        auto resolved = std::remove_if(producer.unresolved.begin(), producer.unresolved.end(), [&](uint64_t pc) {
+            if (pc < added.start || pc >= added.end) return false;
+            AddFrameSymbol(producer, added, pc);
+            return true;
+        });
+        producer.unresolved.erase(resolved, producer.unresolved.end());
+    }
+
+    const Module* FindModule(const Producer& producer, uint64_t pc) const {
+        auto it = std::upper_bound(producer.modules.begin(), producer.modules.end(), pc,
+                                   [](uint64_t value, const Module& module) { return value < module.start; });
+        if (it == producer.modules.begin() || pc >= (it - 1)->end) {
+            return nullptr;
+        }
+        return &*(it - 1);
+    }
+
+    // 找不到函数名（被 strip 或文件不可读）时记为 模块文件名+文件内地址
+    void AddFrameSymbol(const Producer& producer, const Module& module, uint64_t pc) {
+        uint64_t address = pc - module.load_bias;
+        std::string name = module.symbols != nullptr ? module.symbols->Lookup(address) : std::string();
+        if (name.empty()) {
+            size_t slash = module.path.rfind('/');
+            char offset[32];
+            std::snprintf(offset, sizeof(offset), "+0x%" PRIx64, address);
+            name = module.path.substr(slash == std::string::npos ? 0 : slash + 1) + offset;
+        }
+        capture::Symbolizer::GetInstance().AddSymbol(TagFrame(producer, pc), name);
+    }
+
+    static void* TagFrame(const Producer& producer, uint64_t pc) {
+        return reinterpret_cast<void*>(pc | (producer.tag << kProducerTagShift));
+    }
+
+    // 帧地址只在生产者的地址空间中有意义：按生产者的模块表符号化后以带生产者序号的地址登记，
+    // 收集器不会拿本进程的地址空间去解析这些地址
+    void AddStack(Producer& producer, const char* payload, size_t size) {
+        StackMessage stack;
+        if (size < sizeof(stack)) return;
+        std::memcpy(&stack, payload, sizeof(stack));
+        if (stack.frame_count > (size - sizeof(stack)) / sizeof(void*)) return;
+        void* frames[capture::kMaxStackFrames];
+        size_t count = std::min<size_t>(stack.frame_count, capture::kMaxStackFrames);
+        for (size_t i = 0; i < count; ++i) {
+            uint64_t pc = 0;
+            std::memcpy(&pc, payload + sizeof(stack) + i * sizeof(void*), sizeof(pc));
+            frames[i] = TagFrame(producer, pc);
+            if (!producer.symbolized.insert(pc).second) {
+                continue;
+            }
+            if (const Module* module = FindModule(producer, pc)) {
+                AddFrameSymbol(producer, *module, pc);
+            } else {
+                capture::Symbolizer::GetInstance().AddSymbol(frames[i], std::string());
+                producer.unresolved.push_back(pc);
+            }
+        }
+        producer.stacks[stack.stack_id] = capture::StackTable::GetInstance().Intern(frames, count);
+    }
+
+    size_t Drain(Producer& producer) {
+        size_t delivered = 0;
+        producer.ring.Read([&](MessageType type, const char* payload, size_t size) {
+            switch (type) {
+                case MessageType::MODULE:
+                    AddModule(producer, payload, size);
+                    break;
+                case MessageType::STACK:
+                    AddStack(producer, payload, size);
+                    break;
+                case MessageType::EVENTS: {
+                    EventsMessage message;
+                    if (size < sizeof(message)) break;
+                    std::memcpy(&message, payload, sizeof(message));
+                    if (message.count > (size - sizeof(message)) / sizeof(capture::CaptureEvent)) break;
+                    batch_.resize(message.count);
+                    std::memcpy(batch_.data(), payload + sizeof(message), message.count * sizeof(capture::CaptureEvent));
+                    for (auto& event : batch_) {
+                        auto it = producer.stacks.find(event.stack_id);
+                        event.stack_id = it != producer.stacks.end() ? it->second : capture::kInvalidStackId;
+                        event.address = reinterpret_cast<void*>(
+                            reinterpret_cast<uintptr_t>(event.address) | (producer.tag << kProducerTagShift));
+                    }
+                    for (auto listener : listeners_) {
+                        listener(batch_.data(), batch_.size());
+                    }
+                    delivered += batch_.size();
+                    break;
+                }
+                default:
+                    break;
+            }
+        });
+        return delivered;
+    }
+
+    mutable std::mutex mutex_;
+    CollectorOptions options_;
+    std::vector<capture::Capture::EventBatchCallback> listeners_;
+    std::vector<std::unique_ptr<Producer>> producers_;
+    std::unordered_set<std::string> attached_;
+    std::vector<capture::CaptureEvent> batch_;
+    std::unordered_map<std::string, std::shared_ptr<const ElfSymbols>> elf_files_;   // 路径 + build-id -> 符号表
+    std::chrono::steady_clock::time_point last_discovery_;
+    std::atomic<bool> running_;
+    std::thread thread_;
+    uint64_t next_tag_;                // 从未分配过的最小序号
+    std::deque<uint64_t> free_tags_;   // 已退出生产者的序号，按退出先后复用
+    bool tags_exhausted_ = false;
+    uint64_t retired_dropped_;
+};
+
+ShmPublisher::ShmPublisher() : pimpl_(std::make_unique<Impl>()) {}
+ShmPublisher::~ShmPublisher() = default;
+
+ShmPublisher& ShmPublisher::GetInstance() {
+    static ShmPublisher instance;
+    return instance;
+}
+
+bool ShmPublisher::Start(const PublisherOptions& options) { capture::TracerScope scope; return pimpl_->Start(options); }
+void ShmPublisher::Stop() { capture::TracerScope scope; pimpl_->Stop(); }
+bool ShmPublisher::IsRunning() const { return pimpl_->IsRunning(); }
+std::string ShmPublisher::GetName() const { capture::TracerScope scope; return pimpl_->GetName(); }
+uint64_t ShmPublisher::GetDroppedCount() const { return pimpl_->GetDroppedCount(); }
+void ShmPublisher::Publish(const capture::CaptureEvent* events, size_t count) {
+    capture::TracerScope scope;
+    pimpl_->Publish(events, count);
+}
+
+ShmCollector::ShmCollector() : pimpl_(std::make_unique<Impl>()) {}
+ShmCollector::~ShmCollector() = default;
+
+ShmCollector& ShmCollector::GetInstance() {
+    static ShmCollector instance;
+    return instance;
+}
+
+void ShmCollector::AddEventListener(capture::Capture::EventBatchCallback callback) {
+    capture::TracerScope scope;
+    pimpl_->AddEventListener(callback);
+}
+bool ShmCollector::Attach(const std::string& name) { capture::TracerScope scope; return pimpl_->Attach(name); }
+void ShmCollector::Start(const CollectorOptions& options) { capture::TracerScope scope; pimpl_->Start(options); }
+void ShmCollector::Stop() { capture::TracerScope scope; pimpl_->Stop(); }
+size_t ShmCollector::Poll() { capture::TracerScope scope; return pimpl_->Poll(); }
+size_t ShmCollector::GetProducerCount() const { return pimpl_->GetProducerCount(); }
+uint64_t ShmCollector::GetDroppedCount() const { return pimpl_->GetDroppedCount(); }
+
+} // namespace transport
+} // namespace memory_tracer
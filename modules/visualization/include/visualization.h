@@ -18,6 +18,13 @@ enum class ChartType {
     PIE
 };
 
+// 调用栈剖面的权重
+enum class ProfileWeight {
+    ALLOCATED_BYTES,    // 总分配字节数
+    ALLOCATION_COUNT,   // 分配次数
+    LIVE_BYTES          // 当前未释放字节数
+};
+
 class Visualization {
 public:
     static Visualization& GetInstance();
@@ -46,7 +53,11 @@ public:
     // 绘制文件级别的分配图
     void DrawFileAllocationChart(int limit = 10);
 
-    // 实时监控模式
+    // 绘制短生命周期分配最多的调用点（按每秒短生命周期字节数）
+    void DrawShortLivedSitesChart(int limit = 10);
+
+    // 实时监控模式：每个刷新周期只无锁读取 Stats 的累计量，按与上一周期的增量计算速率，
+    // 函数排行每秒刷新一次；整帧渲染进复用的缓冲区后一次写出，100 ms 的刷新间隔也不会明显占用 CPU
     void StartRealtimeMonitor(int refresh_interval_ms = 1000);
     void StopRealtimeMonitor();
 
@@ -59,6 +70,17 @@ public:
 
     std::string ExportReportToText();
 
+    // 调用栈剖面导出：在 Stats 按调用栈的聚合上一次遍历、边遍历边写出，代价与不同调用栈的个数成正比，
+    // 与分配次数无关。调用栈不截断，帧名按 PC 缓存符号化，无法解析的帧以地址表示
+    // 折叠栈格式（每行 "根;...;叶 权重"），可交给 flamegraph.pl、speedscope 等工具
+    bool ExportFoldedStacks(const std::string& filepath, ProfileWeight weight = ProfileWeight::ALLOCATED_BYTES);
+
+    // pprof 的 profile.proto（未压缩，pprof 可直接读取），包含 alloc_objects、alloc_space、inuse_space 三种数值
+    bool ExportPprof(const std::string& filepath);
+
+    // 自包含的交互式 SVG 火焰图：点击帧放大子树、Ctrl+F 按正则高亮，浏览器直接打开
+    bool ExportFlameGraph(const std::string& filepath, ProfileWeight weight = ProfileWeight::ALLOCATED_BYTES);
+
     // 设置输出流
     void SetOutputStream(std::ostream& stream);
 
@@ -0,0 +1,487 @@
+#include "profile_export.h"
+#include "capture/stack_table.h"
+#include "capture/symbolizer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+
+namespace memory_tracer {
+namespace visualization {
+
+namespace {
+
+const char* const kUnknownFrame = "[unknown]";
+// 火焰图中"没有帧"的栈使用的帧名 ID
+constexpr uint32_t kUnknownName = UINT32_MAX;
+
+// 折叠栈以 ';' 分隔帧、以最后一个空格分隔权重，帧名中的分号替换掉
+void WriteFoldedName(const std::string& name, std::ostream& out) {
+    if (name.find(';') == std::string::npos) {
+        out << name;
+        return;
+    }
+    std::string escaped = name;
+    std::replace(escaped.begin(), escaped.end(), ';', ',');
+    out << escaped;
+}
+
+void WriteXmlEscaped(const std::string& text, std::ostream& out) {
+    for (char c : text) {
+        switch (c) {
+            case '&':  out << "&amp;"; break;
+            case '<':  out << "&lt;"; break;
+            case '>':  out << "&gt;"; break;
+            case '"':  out << "&quot;"; break;
+            case '\'': out << "&apos;"; break;
+            default:   out << c; break;
+        }
+    }
+}
+
+// profile.proto 的最小编码器：只用到 varint 和长度前缀两种线格式
+class ProtoWriter {
+public:
+    void Varint(uint64_t value) {
+        while (value >= 0x80) {
+            buffer_.push_back(static_cast<char>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+        buffer_.push_back(static_cast<char>(value));
+    }
+
+    // 值为 0 时按 proto3 省略
+    void UintField(uint32_t field, uint64_t value) {
+        if (value == 0) {
+            return;
+        }
+        Varint(static_cast<uint64_t>(field) << 3);
+        Varint(value);
+    }
+
+    void IntField(uint32_t field, int64_t value) { UintField(field, static_cast<uint64_t>(value)); }
+
+    void BytesField(uint32_t field, const char* data, size_t size) {
+        Varint((static_cast<uint64_t>(field) << 3) | 2);
+        Varint(size);
+        buffer_.append(data, size);
+    }
+
+    void MessageField(uint32_t field, const ProtoWriter& message) {
+        BytesField(field, message.buffer_.data(), message.buffer_.size());
+    }
+
+    template <typename T>
+    void PackedField(uint32_t field, const std::vector<T>& values) {
+        if (values.empty()) {
+            return;
+        }
+        ProtoWriter packed;
+        for (T value : values) {
+            packed.Varint(static_cast<uint64_t>(value));
+        }
+        MessageField(field, packed);
+    }
+
+    // 写出后清空，缓冲区复用
+    void Flush(std::ostream& out) {
+        out.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+        buffer_.clear();
+    }
+
+    void Clear() { buffer_.clear(); }
+
+private:
+    std::string buffer_;
+};
+
+// profile.proto 字段号
+namespace pprof {
+constexpr uint32_t kProfileSampleType = 1;
+constexpr uint32_t kProfileSample = 2;
+constexpr uint32_t kProfileLocation = 4;
+constexpr uint32_t kProfileFunction = 5;
+constexpr uint32_t kProfileStringTable = 6;
+constexpr uint32_t kProfileTimeNanos = 9;
+constexpr uint32_t kProfilePeriodType = 11;
+constexpr uint32_t kProfilePeriod = 12;
+constexpr uint32_t kProfileDefaultSampleType = 14;
+constexpr uint32_t kValueTypeType = 1;
+constexpr uint32_t kValueTypeUnit = 2;
+constexpr uint32_t kSampleLocationId = 1;
+constexpr uint32_t kSampleValue = 2;
+constexpr uint32_t kLocationId = 1;
+constexpr uint32_t kLocationAddress = 3;
+constexpr uint32_t kLocationLine = 4;
+constexpr uint32_t kLineFunctionId = 1;
+constexpr uint32_t kFunctionId = 1;
+constexpr uint32_t kFunctionName = 2;
+constexpr uint32_t kFunctionSystemName = 3;
+} // namespace pprof
+
+// 火焰图按帧名合并成从根到叶的调用树
+struct FlameNode {
+    uint32_t name;
+    uint32_t depth;
+    double value;
+    std::vector<uint32_t> children;
+};
+
+constexpr double kFlameWidth = 1200;
+constexpr double kFlameMargin = 10;
+constexpr double kFrameHeight = 16;
+constexpr double kHeaderHeight = 40;
+// 窄于该宽度（像素）的帧及其子树不输出，控制大剖面的文件大小
+constexpr double kMinFrameWidth = 0.3;
+
+// 按帧名哈希取暖色，同名帧颜色相同
+void WriteFrameColor(const std::string& name, std::ostream& out) {
+    size_t hash = std::hash<std::string>()(name);
+    int red = 205 + static_cast<int>(hash % 51);
+    int green = static_cast<int>((hash >> 8) % 231);
+    int blue = static_cast<int>((hash >> 16) % 56);
+    out << "rgb(" << red << "," << green << "," << blue << ")";
+}
+
+const char* GetWeightUnit(ProfileWeight weight) {
+    return weight == ProfileWeight::ALLOCATION_COUNT ? "allocations" : "bytes";
+}
+
+const char* GetWeightTitle(ProfileWeight weight) {
+    switch (weight) {
+        case ProfileWeight::ALLOCATION_COUNT: return "Allocation Count";
+        case ProfileWeight::LIVE_BYTES:       return "Live Bytes";
+        default:                              return "Allocated Bytes";
+    }
+}
+
+// 点击放大、重置与正则搜索
+const char* const kFlameScript = R"JS(
+var svg = document.documentElement;
+var frames = Array.prototype.slice.call(document.querySelectorAll('g.f'));
+var W = +svg.getAttribute('data-w'), X = +svg.getAttribute('data-x');
+frames.forEach(function(g) {
+  var r = g.querySelector('rect');
+  g.ox = +r.getAttribute('x'); g.ow = +r.getAttribute('width'); g.d = +g.getAttribute('data-d');
+  g.onclick = function(e) { zoom(g); e.stopPropagation(); };
+});
+function fit(g) {
+  var r = g.querySelector('rect'), t = g.querySelector('text'), w = +r.getAttribute('width');
+  var n = Math.floor((w - 6) / 7), s = g.getAttribute('data-n');
+  t.setAttribute('x', +r.getAttribute('x') + 3);
+  t.textContent = n < 3 ? '' : (s.length <= n ? s : s.substring(0, n - 2) + '..');
+}
+function zoom(z) {
+  var k = W / z.ow;
+  frames.forEach(function(g) {
+    var r = g.querySelector('rect');
+    var inside = g.ox >= z.ox - 1e-6 && g.ox + g.ow <= z.ox + z.ow + 1e-6;
+    var above = g.d < z.d && g.ox <= z.ox + 1e-6 && g.ox + g.ow >= z.ox + z.ow - 1e-6;
+    g.style.display = (inside && g.d >= z.d) || above ? '' : 'none';
+    g.style.opacity = above ? 0.6 : 1;
+    if (inside && g.d >= z.d) { r.setAttribute('x', (g.ox - z.ox) * k + X); r.setAttribute('width', g.ow * k); }
+    else if (above) { r.setAttribute('x', X); r.setAttribute('width', W); }
+    fit(g);
+  });
+  document.getElementById('reset').style.display = '';
+}
+function reset() {
+  frames.forEach(function(g) {
+    var r = g.querySelector('rect');
+    r.setAttribute('x', g.ox); r.setAttribute('width', g.ow);
+    g.style.display = ''; g.style.opacity = 1; fit(g);
+  });
+  document.getElementById('reset').style.display = 'none';
+}
+function search() {
+  var term = prompt('Search frames (regular expression)', '');
+  var matched = document.getElementById('matched');
+  var ranges = [];
+  frames.forEach(function(g) {
+    var r = g.querySelector('rect');
+    if (!r.orig) r.orig = r.getAttribute('fill');
+    var hit = term && new RegExp(term).test(g.getAttribute('data-n'));
+    r.setAttribute('fill', hit ? 'rgb(230,0,230)' : r.orig);
+    if (hit) ranges.push([g.ox, g.ox + g.ow]);
+  });
+  ranges.sort(function(a, b) { return a[0] - b[0]; });
+  var covered = 0, end = -1;
+  ranges.forEach(function(r) { if (r[1] > end) { covered += r[1] - Math.max(r[0], end); end = r[1]; } });
+  matched.textContent = term ? 'Matched: ' + (covered / W * 100).toFixed(1) + '%' : '';
+}
+svg.onclick = reset;
+document.getElementById('reset').onclick = function(e) { reset(); e.stopPropagation(); };
+document.getElementById('search').onclick = function(e) { search(); e.stopPropagation(); };
+window.addEventListener('keydown', function(e) {
+  if ((e.ctrlKey || e.metaKey) && e.key === 'f') { e.preventDefault(); search(); }
+});
+frames.forEach(fit);
+)JS";
+
+} // namespace
+
+std::vector<void*> FrameNames::GetFrames(capture::StackId stack_id) const {
+    return capture::StackTable::GetInstance().GetFrames(stack_id);
+}
+
+uint32_t FrameNames::GetNameId(void* pc) {
+    auto it = pc_names_.find(pc);
+    if (it != pc_names_.end()) {
+        return it->second;
+    }
+
+    std::string name = capture::Symbolizer::GetInstance().Resolve(pc);
+    if (name.empty()) {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "0x%llx",
+                      static_cast<unsigned long long>(reinterpret_cast<uintptr_t>(pc)));
+        name = buffer;
+    }
+    uint32_t id = InternName(name);
+    pc_names_.emplace(pc, id);
+    return id;
+}
+
+uint32_t FrameNames::InternName(const std::string& name) {
+    auto it = name_ids_.find(name);
+    if (it != name_ids_.end()) {
+        return it->second;
+    }
+    uint32_t id = static_cast<uint32_t>(names_.size());
+    names_.push_back(name);
+    name_ids_.emplace(name, id);
+    return id;
+}
+
+double GetProfileWeight(const stats::StackStats& stack, ProfileWeight weight) {
+    switch (weight) {
+        case ProfileWeight::ALLOCATION_COUNT: return stack.allocation_count;
+        case ProfileWeight::LIVE_BYTES:       return stack.live_bytes;
+        default:                              return stack.allocated_bytes;
+    }
+}
+
+void WriteFoldedStacks(const std::vector<stats::StackStats>& stacks, ProfileWeight weight, std::ostream& out) {
+    FrameNames names;
+    for (const auto& stack : stacks) {
+        long long value = std::llround(GetProfileWeight(stack, weight));
+        if (value <= 0) {
+            continue;
+        }
+        std::vector<void*> frames = names.GetFrames(stack.stack_id);
+        if (frames.empty()) {
+            out << kUnknownFrame;
+        }
+        // 从根到叶
+        for (size_t i = frames.size(); i-- > 0;) {
+            WriteFoldedName(names.GetName(names.GetNameId(frames[i])), out);
+            if (i > 0) {
+                out << ';';
+            }
+        }
+        out << ' ' << value << '\n';
+    }
+}
+
+void WritePprof(const std::vector<stats::StackStats>& stacks, uint64_t sample_interval, std::ostream& out) {
+    // 字符串表第 0 项必须为空串
+    std::vector<std::string> strings = {""};
+    std::unordered_map<std::string, int64_t> string_ids = {{"", 0}};
+    auto intern = [&](const std::string& value) {
+        auto it = string_ids.find(value);
+        if (it != string_ids.end()) {
+            return it->second;
+        }
+        int64_t id = static_cast<int64_t>(strings.size());
+        strings.push_back(value);
+        string_ids.emplace(value, id);
+        return id;
+    };
+
+    ProtoWriter writer;
+    ProtoWriter message;
+    auto write_value_type = [&](uint32_t field, const char* type, const char* unit) {
+        message.Clear();
+        message.IntField(pprof::kValueTypeType, intern(type));
+        message.IntField(pprof::kValueTypeUnit, intern(unit));
+        writer.MessageField(field, message);
+    };
+    write_value_type(pprof::kProfileSampleType, "alloc_objects", "count");
+    write_value_type(pprof::kProfileSampleType, "alloc_space", "bytes");
+    write_value_type(pprof::kProfileSampleType, "inuse_space", "bytes");
+    writer.Flush(out);
+
+    // 样本逐条写出；location 按 PC 分配 ID（从 1 开始），最后统一写出
+    FrameNames names;
+    std::unordered_map<void*, uint64_t> location_ids;
+    std::vector<void*> locations;
+    std::vector<uint64_t> sample_locations;
+    std::vector<int64_t> sample_values;
+    for (const auto& stack : stacks) {
+        sample_values = {std::llround(stack.allocation_count), std::llround(stack.allocated_bytes),
+                         std::llround(stack.live_bytes)};
+        if (sample_values[0] <= 0 && sample_values[2] <= 0) {
+            continue;
+        }
+        // pprof 的 location_id 从叶到根，与原始帧顺序相同
+        sample_locations.clear();
+        for (void* pc : names.GetFrames(stack.stack_id)) {
+            auto [it, inserted] = location_ids.emplace(pc, locations.size() + 1);
+            if (inserted) {
+                locations.push_back(pc);
+            }
+            sample_locations.push_back(it->second);
+        }
+        message.Clear();
+        message.PackedField(pprof::kSampleLocationId, sample_locations);
+        message.PackedField(pprof::kSampleValue, sample_values);
+        writer.MessageField(pprof::kProfileSample, message);
+        writer.Flush(out);
+    }
+
+    // function 按帧名分配 ID（名字 ID + 1）
+    ProtoWriter line;
+    for (size_t i = 0; i < locations.size(); ++i) {
+        uint32_t name_id = names.GetNameId(locations[i]);
+        line.Clear();
+        line.UintField(pprof::kLineFunctionId, name_id + 1);
+        message.Clear();
+        message.UintField(pprof::kLocationId, i + 1);
+        message.UintField(pprof::kLocationAddress, reinterpret_cast<uintptr_t>(locations[i]));
+        message.MessageField(pprof::kLocationLine, line);
+        writer.MessageField(pprof::kProfileLocation, message);
+        writer.Flush(out);
+    }
+    for (size_t i = 0; i < names.Size(); ++i) {
+        int64_t name = intern(names.GetName(static_cast<uint32_t>(i)));
+        message.Clear();
+        message.UintField(pprof::kFunctionId, i + 1);
+        message.IntField(pprof::kFunctionName, name);
+        message.IntField(pprof::kFunctionSystemName, name);
+        writer.MessageField(pprof::kProfileFunction, message);
+    }
+    writer.Flush(out);
+
+    message.Clear();
+    message.IntField(pprof::kValueTypeType, intern("space"));
+    message.IntField(pprof::kValueTypeUnit, intern("bytes"));
+    writer.MessageField(pprof::kProfilePeriodType, message);
+    writer.IntField(pprof::kProfilePeriod, static_cast<int64_t>(sample_interval));
+    writer.IntField(pprof::kProfileTimeNanos, std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+    writer.IntField(pprof::kProfileDefaultSampleType, intern("alloc_space"));
+    for (const auto& value : strings) {
+        writer.BytesField(pprof::kProfileStringTable, value.data(), value.size());
+    }
+    writer.Flush(out);
+}
+
+void WriteFlameGraph(const std::vector<stats::StackStats>& stacks, ProfileWeight weight, std::ostream& out) {
+    // 合并调用树：键为 (父节点, 帧名)
+    FrameNames names;
+    std::vector<FlameNode> nodes = {{0, 0, 0.0, {}}};
+    std::unordered_map<uint64_t, uint32_t> child_ids;
+    auto get_child = [&](uint32_t parent, uint32_t name) {
+        uint64_t key = (static_cast<uint64_t>(parent) << 32) | name;
+        auto [it, inserted] = child_ids.emplace(key, static_cast<uint32_t>(nodes.size()));
+        if (inserted) {
+            nodes.push_back({name, nodes[parent].depth + 1, 0.0, {}});
+            nodes[parent].children.push_back(it->second);
+        }
+        return it->second;
+    };
+
+    for (const auto& stack : stacks) {
+        double value = GetProfileWeight(stack, weight);
+        if (value <= 0) {
+            continue;
+        }
+        std::vector<void*> frames = names.GetFrames(stack.stack_id);
+        uint32_t node = 0;
+        nodes[0].value += value;
+        if (frames.empty()) {
+            node = get_child(node, kUnknownName);
+            nodes[node].value += value;
+        }
+        for (size_t i = frames.size(); i-- > 0;) {
+            node = get_child(node, names.GetNameId(frames[i]));
+            nodes[node].value += value;
+        }
+    }
+
+    const std::string root_label = "all";
+    const std::string unknown_label = kUnknownFrame;
+    auto get_name = [&](const FlameNode& node) -> const std::string& {
+        if (&node == &nodes[0]) {
+            return root_label;
+        }
+        return node.name == kUnknownName ? unknown_label : names.GetName(node.name);
+    };
+
+    uint32_t max_depth = 0;
+    for (const auto& node : nodes) {
+        max_depth = std::max(max_depth, node.depth);
+    }
+    double total = nodes[0].value;
+    double scale = total > 0 ? kFlameWidth / total : 0.0;
+    double height = kHeaderHeight + (max_depth + 1) * kFrameHeight + kFlameMargin * 2;
+
+    out << "<?xml version=\"1.0\" standalone=\"no\"?>\n"
+        << "<svg version=\"1.1\" xmlns=\"http://www.w3.org/2000/svg\" width=\"" << kFlameWidth + kFlameMargin * 2
+        << "\" height=\"" << height << "\" viewBox=\"0 0 " << kFlameWidth + kFlameMargin * 2 << " " << height
+        << "\" data-w=\"" << kFlameWidth << "\" data-x=\"" << kFlameMargin << "\">\n"
+        << "<style>text { font-family: monospace; font-size: 12px; } g.f { cursor: pointer; }"
+        << " g.f:hover rect { stroke: #000; stroke-width: 0.5; } .ui { cursor: pointer; fill: #36c; }</style>\n"
+        << "<rect x=\"0\" y=\"0\" width=\"100%\" height=\"100%\" fill=\"#f8f8f8\"/>\n"
+        << "<text x=\"" << (kFlameWidth + kFlameMargin * 2) / 2 << "\" y=\"20\" text-anchor=\"middle\" "
+        << "style=\"font-size: 16px\">Memory Flame Graph: " << GetWeightTitle(weight) << "</text>\n"
+        << "<text id=\"reset\" class=\"ui\" x=\"" << kFlameMargin << "\" y=\"20\" style=\"display: none\">Reset Zoom</text>\n"
+        << "<text id=\"search\" class=\"ui\" x=\"" << kFlameWidth - 40 << "\" y=\"20\">Search</text>\n"
+        << "<text id=\"matched\" x=\"" << kFlameWidth - 160 << "\" y=\"36\"></text>\n";
+
+    // 深度优先布局，同一父节点下的子节点按帧名排序，根在底部
+    std::vector<std::pair<uint32_t, double>> pending = {{0, kFlameMargin}};
+    while (!pending.empty()) {
+        auto [index, x] = pending.back();
+        pending.pop_back();
+        const FlameNode& node = nodes[index];
+        double width = node.value * scale;
+        if (width < kMinFrameWidth) {
+            continue;
+        }
+
+        const std::string& name = get_name(node);
+        double y = height - kFlameMargin - (node.depth + 1) * kFrameHeight;
+        out << "<g class=\"f\" data-d=\"" << node.depth << "\" data-n=\"";
+        WriteXmlEscaped(name, out);
+        out << "\"><title>";
+        WriteXmlEscaped(name, out);
+        char summary[96];
+        std::snprintf(summary, sizeof(summary), " (%.0f %s, %.2f%%)", node.value, GetWeightUnit(weight),
+                      total > 0 ? node.value * 100.0 / total : 0.0);
+        out << summary << "</title><rect x=\"" << x << "\" y=\"" << y << "\" width=\"" << width << "\" height=\""
+            << kFrameHeight - 1 << "\" fill=\"";
+        WriteFrameColor(name, out);
+        out << "\"/><text x=\"" << x + 3 << "\" y=\"" << y + kFrameHeight - 4 << "\"></text></g>\n";
+
+        std::vector<uint32_t> children = node.children;
+        std::sort(children.begin(), children.end(), [&](uint32_t a, uint32_t b) {
+            return get_name(nodes[a]) < get_name(nodes[b]);
+        });
+        // 逆序压栈，按排序顺序从左到右布局
+        double child_x = x;
+        std::vector<std::pair<uint32_t, double>> placed;
+        placed.reserve(children.size());
+        for (uint32_t child : children) {
+            placed.push_back({child, child_x});
+            child_x += nodes[child].value * scale;
+        }
+        pending.insert(pending.end(), placed.rbegin(), placed.rend());
+    }
+
+    out << "<script type=\"text/ecmascript\"><![CDATA[" << kFlameScript << "]]></script>\n</svg>\n";
+}
+
+} // namespace visualization
+} // namespace memory_tracer
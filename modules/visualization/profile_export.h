@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "stats/stats.h"
+#include "visualization/visualization.h"
+
+namespace memory_tracer {
+namespace visualization {
+
+// 导出共用的帧名表：按 PC 缓存帧名 ID，同名的帧共用一个 ID，无法解析的帧以地址命名
+class FrameNames {
+public:
+    // 调用栈的原始帧，从叶到根（与 StackTable 相同）
+    std::vector<void*> GetFrames(capture::StackId stack_id) const;
+
+    uint32_t GetNameId(void* pc);
+    const std::string& GetName(uint32_t id) const { return names_[id]; }
+    size_t Size() const { return names_.size(); }
+
+private:
+    uint32_t InternName(const std::string& name);
+
+    std::unordered_map<void*, uint32_t> pc_names_;
+    std::unordered_map<std::string, uint32_t> name_ids_;
+    std::vector<std::string> names_;
+};
+
+double GetProfileWeight(const stats::StackStats& stack, ProfileWeight weight);
+
+// 以下写出函数都只遍历一次 stacks，边遍历边写出
+void WriteFoldedStacks(const std::vector<stats::StackStats>& stacks, ProfileWeight weight, std::ostream& out);
+void WritePprof(const std::vector<stats::StackStats>& stacks, uint64_t sample_interval, std::ostream& out);
+void WriteFlameGraph(const std::vector<stats::StackStats>& stacks, ProfileWeight weight, std::ostream& out);
+
+} // namespace visualization
+} // namespace memory_tracer
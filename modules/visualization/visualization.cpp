@@ -1,4 +1,7 @@
 #include "visualization/visualization.h"
+#include "profile_export.h"
+#include "capture/stack_table.h"
+#include "capture/internal_allocator.h"
 #include "logger/logger.h"
 #include <iostream>
 #include <sstream>
@@ -6,7 +9,14 @@
 #include <algorithm>
 #include <thread>
 #include <atomic>
+#include <chrono>
 #include <cmath>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <mutex>
 
 namespace memory_tracer {
 namespace visualization {
@@ -36,7 +46,9 @@ public:
 
         *output_stream_ << "\n========================================\n";
         *output_stream_ << "  Function Memory Allocation Chart\n";
-        *output_stream_ << "========================================\n\n";
+        *output_stream_ << "========================================\n";
+        DrawSamplingNote();
+        *output_stream_ << "\n";
 
         for (const auto& stats : func_stats) {
             double ratio = static_cast<double>(stats.total_allocated) / max_size;
@@ -76,13 +88,15 @@ public:
 
         *output_stream_ << "\n========================================\n";
         *output_stream_ << "  Size Distribution Histogram\n";
-        *output_stream_ << "========================================\n\n";
+        *output_stream_ << "========================================\n";
+        DrawSamplingNote();
+        *output_stream_ << "\n";
 
         for (const auto& bucket : buckets) {
             double ratio = static_cast<double>(bucket.count) / max_count;
             int bar_length = static_cast<int>(ratio * 40);
 
-            std::string label = FormatSize(bucket.min_size) + "-" +
+            std::string label = (bucket.mmap_backed ? "mmap " : "") + FormatSize(bucket.min_size) + "-" +
                               (bucket.max_size == SIZE_MAX ? "inf" : FormatSize(bucket.max_size));
             *output_stream_ << std::left << std::setw(20) << label;
             *output_stream_ << " |";
@@ -94,48 +108,59 @@ public:
                 *output_stream_ << " ";
             }
 
-            *output_stream_ << "| " << bucket.count << " allocs\n";
+            *output_stream_ << "| " << bucket.count << (bucket.mmap_backed ? " mmaps\n" : " allocs\n");
         }
 
-        *output_stream_ << "\n";
+        auto sizes = stats::Stats::GetInstance().GetSizeHistogram();
+        *output_stream_ << "\np50: " << FormatSize(sizes.GetQuantile(0.5))
+                        << "  p99: " << FormatSize(sizes.GetQuantile(0.99))
+                        << "  max: " << FormatSize(sizes.GetMax()) << "\n\n";
     }
 
     void DrawMemoryTimeline(size_t bucket_size_ns) {
-        auto timeline = storage::Storage::GetInstance().GetAllocationTimeline(bucket_size_ns);
+        // 时间线由 Stats 增量维护，这里只遍历最近的若干个桶
+        auto timeline = stats::Stats::GetInstance().GetTimeline(bucket_size_ns);
 
         if (timeline.empty()) {
             *output_stream_ << "No timeline data available.\n";
             return;
         }
 
+        size_t first = timeline.size() > kTimelineRows ? timeline.size() - kTimelineRows : 0;
+
         // 找出最大值用于缩放
-        uint64_t max_usage = 0;
-        for (const auto& point : timeline) {
-            if (point["memory_usage"] > max_usage) {
-                max_usage = point["memory_usage"];
-            }
+        size_t max_usage = 0;
+        for (size_t i = first; i < timeline.size(); ++i) {
+            max_usage = std::max(max_usage, timeline[i].live_bytes);
         }
 
         *output_stream_ << "\n========================================\n";
         *output_stream_ << "  Memory Usage Timeline\n";
-        *output_stream_ << "========================================\n\n";
+        *output_stream_ << "========================================\n";
+        DrawSamplingNote();
+        if (first > 0) {
+            *output_stream_ << "(latest " << timeline.size() - first << " of " << timeline.size() << " buckets)\n";
+        }
+        *output_stream_ << "\n";
 
-        for (const auto& point : timeline) {
-            uint64_t timestamp = point["timestamp"];
-            uint64_t usage = point["memory_usage"];
-            double ratio = static_cast<double>(usage) / max_usage;
-            int bar_length = static_cast<int>(ratio * 40);
+        uint64_t origin = timeline[first].timestamp;
+        for (size_t i = first; i < timeline.size(); ++i) {
+            const auto& point = timeline[i];
+            double ratio = max_usage > 0 ? static_cast<double>(point.live_bytes) / max_usage : 0.0;
+            int bar_length = static_cast<int>(ratio * kBarWidth);
 
-            *output_stream_ << std::setw(12) << FormatTimestamp(timestamp) << " |";
+            *output_stream_ << std::setw(12) << "+" + FormatTimestamp(point.timestamp - origin) << " |";
 
-            for (int i = 0; i < bar_length; ++i) {
+            for (int j = 0; j < bar_length; ++j) {
                 *output_stream_ << "█";
             }
-            for (int i = bar_length; i < 40; ++i) {
+            for (int j = bar_length; j < kBarWidth; ++j) {
                 *output_stream_ << " ";
             }
 
-            *output_stream_ << "| " << FormatSize(usage) << "\n";
+            *output_stream_ << "| " << std::setw(10) << FormatSize(point.live_bytes)
+                            << "  +" << FormatSize(point.allocated_bytes)
+                            << " -" << FormatSize(point.freed_bytes) << "\n";
         }
 
         *output_stream_ << "\nPeak usage: " << FormatSize(max_usage) << "\n\n";
@@ -153,7 +178,9 @@ public:
 
         *output_stream_ << "\n========================================\n";
         *output_stream_ << "  Memory Hotspots\n";
-        *output_stream_ << "========================================\n\n";
+        *output_stream_ << "========================================\n";
+        DrawSamplingNote();
+        *output_stream_ << "\n";
 
         for (size_t i = 0; i < hotspots.size(); ++i) {
             const auto& [func, size] = hotspots[i];
@@ -178,18 +205,15 @@ public:
     }
 
     void DrawCallStackFrequencyChart(int limit) {
-        auto call_stack_stats = stats::Stats::GetInstance().GetCallStackStats();
+        auto call_stack_stats = stats::Stats::GetInstance().GetCallStackStatsById();
 
         if (call_stack_stats.empty()) {
             *output_stream_ << "No call stack data available.\n";
             return;
         }
 
-        // 转换为 vector 并排序
-        std::vector<std::pair<std::string, size_t>> stacks;
-        for (const auto& [stack, count] : call_stack_stats) {
-            stacks.push_back({stack, count});
-        }
+        // 转换为 vector 并排序，只对展示的调用栈做符号化
+        std::vector<std::pair<capture::StackId, size_t>> stacks(call_stack_stats.begin(), call_stack_stats.end());
         std::sort(stacks.begin(), stacks.end(),
             [](const auto& a, const auto& b) { return a.second > b.second; });
 
@@ -201,7 +225,9 @@ public:
 
         *output_stream_ << "\n========================================\n";
         *output_stream_ << "  Top Call Stacks by Frequency\n";
-        *output_stream_ << "========================================\n\n";
+        *output_stream_ << "========================================\n";
+        DrawSamplingNote();
+        *output_stream_ << "\n";
 
         for (size_t i = 0; i < stacks.size(); ++i) {
             const auto& [stack, count] = stacks[i];
@@ -240,7 +266,9 @@ public:
 
         *output_stream_ << "\n========================================\n";
         *output_stream_ << "  File Memory Allocation Chart\n";
-        *output_stream_ << "========================================\n\n";
+        *output_stream_ << "========================================\n";
+        DrawSamplingNote();
+        *output_stream_ << "\n";
 
         for (const auto& stats : file_stats) {
             // 只显示文件名，不显示路径
@@ -264,6 +292,48 @@ public:
         *output_stream_ << "\n";
     }
 
+    void DrawShortLivedSitesChart(int limit) {
+        auto sites = stats::Stats::GetInstance().GetShortLivedSites(limit);
+
+        if (sites.empty()) {
+            *output_stream_ << "No short-lived allocation data available.\n";
+            return;
+        }
+
+        double max_rate = sites[0].short_lived_bytes_per_sec;
+        uint64_t threshold = stats::Stats::GetInstance().GetShortLivedThreshold();
+
+        *output_stream_ << "\n========================================\n";
+        *output_stream_ << "  Short-lived Allocation Sites (< " << threshold / 1000 << " us)\n";
+        *output_stream_ << "========================================\n";
+        DrawSamplingNote();
+        *output_stream_ << "\n";
+
+        for (size_t i = 0; i < sites.size(); ++i) {
+            const auto& site = sites[i];
+            // 采集时段不足以计算速率时按字节数缩放
+            double ratio = max_rate > 0 ? site.short_lived_bytes_per_sec / max_rate
+                                        : site.short_lived_bytes / sites[0].short_lived_bytes;
+            int bar_length = static_cast<int>(ratio * 30);
+
+            *output_stream_ << std::setw(3) << (i + 1) << ". ";
+            *output_stream_ << std::left << std::setw(30) << SimplifyStack(site.stack_id).substr(0, 29);
+            *output_stream_ << " |";
+
+            for (int j = 0; j < bar_length; ++j) {
+                *output_stream_ << "█";
+            }
+            for (int j = bar_length; j < 30; ++j) {
+                *output_stream_ << " ";
+            }
+
+            *output_stream_ << "| " << FormatSize(static_cast<size_t>(site.short_lived_bytes_per_sec)) << "/s, p50 "
+                            << FormatDuration(site.lifetime_histogram.GetQuantile(0.5)) << "\n";
+        }
+
+        *output_stream_ << "\n";
+    }
+
     void StartRealtimeMonitor(int refresh_interval_ms) {
         if (realtime_running_) {
             return;
@@ -271,15 +341,8 @@ public:
 
         realtime_running_ = true;
         realtime_thread_ = std::thread([this, refresh_interval_ms]() {
-            while (realtime_running_) {
-                // 清屏
-                *output_stream_ << "\033[2J\033[H";
-
-                // 绘制实时图表
-                DrawRealtimeDashboard();
-
-                std::this_thread::sleep_for(std::chrono::milliseconds(refresh_interval_ms));
-            }
+            capture::TracerScope scope;
+            RunRealtimeMonitor(std::max(refresh_interval_ms, 1));
         });
 
         LOG_INFO("Realtime monitor started");
@@ -287,7 +350,11 @@ public:
 
     void StopRealtimeMonitor() {
         if (realtime_running_) {
-            realtime_running_ = false;
+            {
+                std::lock_guard<std::mutex> lock(realtime_mutex_);
+                realtime_running_ = false;
+            }
+            realtime_cv_.notify_all();
             if (realtime_thread_.joinable()) {
                 realtime_thread_.join();
             }
@@ -323,21 +390,296 @@ public:
         return stats::Stats::GetInstance().GenerateReport();
     }
 
+    bool ExportFoldedStacks(const std::string& filepath, ProfileWeight weight) {
+        return ExportProfile(filepath, "folded stacks", [weight](const std::vector<stats::StackStats>& stacks,
+                                                                 std::ostream& out) {
+            WriteFoldedStacks(stacks, weight, out);
+        });
+    }
+
+    bool ExportPprof(const std::string& filepath) {
+        uint64_t sample_interval = stats::Stats::GetInstance().GetMetricsSnapshot().sample_interval;
+        return ExportProfile(filepath, "pprof profile", [sample_interval](const std::vector<stats::StackStats>& stacks,
+                                                                          std::ostream& out) {
+            WritePprof(stacks, sample_interval, out);
+        });
+    }
+
+    bool ExportFlameGraph(const std::string& filepath, ProfileWeight weight) {
+        return ExportProfile(filepath, "flame graph", [weight](const std::vector<stats::StackStats>& stacks,
+                                                               std::ostream& out) {
+            WriteFlameGraph(stacks, weight, out);
+        });
+    }
+
     void SetOutputStream(std::ostream& stream) {
         output_stream_ = &stream;
     }
 
 private:
-    void DrawRealtimeDashboard() {
-        auto summary = stats::Stats::GetInstance().GetSummary();
+    template <typename Writer>
+    bool ExportProfile(const std::string& filepath, const char* kind, Writer writer) {
+        std::vector<stats::StackStats> stacks = stats::Stats::GetInstance().GetStackStats();
+        std::ofstream file(filepath, std::ios::binary);
+        if (!file.is_open()) {
+            LOG_ERROR("Failed to open file: {}", filepath);
+            return false;
+        }
+        writer(stacks, file);
+        file.close();
+        if (!file) {
+            LOG_ERROR("Failed to write {} to {}", kind, filepath);
+            return false;
+        }
+        LOG_INFO("Exported {} of {} stacks to {}", kind, stacks.size(), filepath);
+        return true;
+    }
 
-        *output_stream_ << "\n========================================\n";
-        *output_stream_ << "  Realtime Memory Monitor\n";
-        *output_stream_ << "========================================\n\n";
-        *output_stream_ << summary << "\n";
+    // 实时监控的增量状态：每帧只读取 Stats 的无锁累计量，与上一帧相减得到本周期的增量和速率，
+    // 函数排行按 kRankingRefreshInterval 刷新。整帧渲染进复用的缓冲区，每帧只写一次输出流
+    struct MonitorState {
+        stats::MetricsSnapshot current;
+        stats::MetricsSnapshot delta;         // 本周期的增量
+        double seconds = 0;                   // 本周期的实际时长
+        bool has_current = false;
+        std::chrono::steady_clock::time_point time;
+        std::chrono::steady_clock::time_point ranking_time;
+        std::vector<std::pair<std::string, size_t>> hotspots;
+        std::deque<double> rate_history;      // 各周期的每秒分配次数
+        std::string frame;
+    };
+
+    static constexpr int kBarWidth = 40;
+    static constexpr size_t kTimelineRows = 60;       // 时间线最多显示最近的桶数
+    static constexpr size_t kRateHistoryLength = 60;
+    static constexpr size_t kFrameReserveBytes = 16384;
+    static constexpr std::chrono::milliseconds kRankingRefreshInterval{1000};
+
+    void RunRealtimeMonitor(int refresh_interval_ms) {
+        MonitorState state;
+        state.frame.reserve(kFrameReserveBytes);
+
+        // 只清屏一次，之后每帧回到左上角覆盖，逐行清除行尾残留
+        output_stream_->write("\033[2J", 4);
+        std::unique_lock<std::mutex> lock(realtime_mutex_);
+        while (realtime_running_) {
+            lock.unlock();
+            UpdateMonitorState(&state);
+            RenderRealtimeFrame(&state, refresh_interval_ms);
+            output_stream_->write(state.frame.data(), static_cast<std::streamsize>(state.frame.size()));
+            output_stream_->flush();
+            lock.lock();
+            realtime_cv_.wait_for(lock, std::chrono::milliseconds(refresh_interval_ms),
+                                  [this]() { return !realtime_running_; });
+        }
+    }
 
-        DrawMemoryHotspotsChart(5);
-        DrawSizeDistributionHistogram();
+    void UpdateMonitorState(MonitorState* state) {
+        stats::MetricsSnapshot snapshot = stats::Stats::GetInstance().GetMetricsSnapshot();
+        auto now = std::chrono::steady_clock::now();
+
+        // 第一帧或统计被重置后，以累计量本身作为增量
+        bool reset = !state->has_current || snapshot.allocation_count < state->current.allocation_count;
+        const stats::MetricsSnapshot& base = reset ? stats::MetricsSnapshot() : state->current;
+        state->delta.allocation_count = snapshot.allocation_count - base.allocation_count;
+        state->delta.allocated_bytes = snapshot.allocated_bytes - base.allocated_bytes;
+        state->delta.free_count = snapshot.free_count - base.free_count;
+        state->delta.freed_bytes = snapshot.freed_bytes - base.freed_bytes;
+        for (size_t i = 0; i < stats::kMetricSizeBucketCount; ++i) {
+            state->delta.size_buckets[i] = snapshot.size_buckets[i] - base.size_buckets[i];
+        }
+        state->seconds = state->has_current ? std::chrono::duration<double>(now - state->time).count() : 0.0;
+        state->current = std::move(snapshot);
+        state->time = now;
+        state->has_current = true;
+
+        if (state->seconds > 0) {
+            state->rate_history.push_back(state->delta.allocation_count / state->seconds);
+            if (state->rate_history.size() > kRateHistoryLength) {
+                state->rate_history.pop_front();
+            }
+        }
+
+        // 排行走 Stats 的前 K 名摘要，代价与函数个数无关，但仍要逐个取分片锁，因此降低频率
+        if (state->hotspots.empty() || reset || now - state->ranking_time >= kRankingRefreshInterval) {
+            state->hotspots = stats::Stats::GetInstance().GetMemoryHotspots(5);
+            state->ranking_time = now;
+        }
+    }
+
+    void RenderRealtimeFrame(MonitorState* state, int refresh_interval_ms) {
+        std::string* frame = &state->frame;
+        const stats::MetricsSnapshot& current = state->current;
+        const stats::MetricsSnapshot& delta = state->delta;
+        double seconds = state->seconds;
+
+        frame->clear();
+        frame->append("\033[H");
+        AppendLine(frame, "========================================");
+        AppendFormat(frame, "  Realtime Memory Monitor (every %d ms)", refresh_interval_ms);
+        EndLine(frame);
+        AppendLine(frame, "========================================");
+        EndLine(frame);
+
+        frame->append("Live:       ");
+        AppendSize(frame, static_cast<double>(current.live_bytes));
+        frame->append(" (peak ");
+        AppendSize(frame, static_cast<double>(current.peak_bytes));
+        AppendFormat(frame, "), %zu blocks", current.live_blocks);
+        EndLine(frame);
+
+        frame->append("Allocs:     ");
+        AppendRate(frame, delta.allocation_count, delta.allocated_bytes, seconds);
+        EndLine(frame);
+        frame->append("Frees:      ");
+        AppendRate(frame, delta.free_count, delta.freed_bytes, seconds);
+        EndLine(frame);
+
+        AppendFormat(frame, "Total:      %.0f allocations, ", current.allocation_count);
+        AppendSize(frame, current.allocated_bytes);
+        if (current.sample_interval > 0) {
+            frame->append(" (sampled 1 per ");
+            AppendSize(frame, static_cast<double>(current.sample_interval));
+            frame->append(")");
+        }
+        EndLine(frame);
+
+        frame->append("Allocs/s:   ");
+        AppendSparkline(frame, state->rate_history);
+        EndLine(frame);
+        EndLine(frame);
+
+        AppendLine(frame, "Memory Hotspots (total bytes)");
+        size_t max_hotspot = state->hotspots.empty() ? 0 : state->hotspots.front().second;
+        for (const auto& [name, bytes] : state->hotspots) {
+            AppendFormat(frame, "%-25.24s |", name.c_str());
+            AppendBar(frame, max_hotspot > 0 ? static_cast<double>(bytes) / max_hotspot : 0.0, kBarWidth);
+            frame->append("| ");
+            AppendSize(frame, static_cast<double>(bytes));
+            EndLine(frame);
+        }
+        EndLine(frame);
+
+        // 条形为本周期的分配次数，右侧为累计次数
+        AppendLine(frame, "Size Distribution (this interval | total)");
+        double max_delta = 0;
+        for (double count : delta.size_buckets) {
+            max_delta = std::max(max_delta, count);
+        }
+        for (size_t i = 0; i < current.size_buckets.size(); ++i) {
+            if (current.size_buckets[i] <= 0) {
+                continue;
+            }
+            size_t line_start = frame->size();
+            if (i + 1 < current.size_buckets.size()) {
+                frame->append("<= ");
+                AppendSize(frame, static_cast<double>(uint64_t(1) << i));
+            } else {
+                frame->append(">  ");
+                AppendSize(frame, static_cast<double>(uint64_t(1) << (i - 1)));
+            }
+            PadTo(frame, line_start, 14);
+            frame->append(" |");
+            AppendBar(frame, max_delta > 0 ? delta.size_buckets[i] / max_delta : 0.0, kBarWidth);
+            AppendFormat(frame, "| %.0f | %.0f", delta.size_buckets[i], current.size_buckets[i]);
+            EndLine(frame);
+        }
+        frame->append("\033[J");
+    }
+
+    // 帧内格式化都写入复用的缓冲区，不经过 ostream
+    static void AppendFormat(std::string* frame, const char* format, ...) __attribute__((format(printf, 2, 3))) {
+        char buffer[256];
+        va_list args;
+        va_start(args, format);
+        int length = std::vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+        if (length > 0) {
+            frame->append(buffer, std::min(static_cast<size_t>(length), sizeof(buffer) - 1));
+        }
+    }
+
+    // 清除行尾上一帧残留的字符
+    static void EndLine(std::string* frame) {
+        frame->append("\033[K\n");
+    }
+
+    static void AppendLine(std::string* frame, const char* text) {
+        frame->append(text);
+        EndLine(frame);
+    }
+
+    // 从 start 起补空格到 width 个字符
+    static void PadTo(std::string* frame, size_t start, size_t width) {
+        if (frame->size() < start + width) {
+            frame->append(start + width - frame->size(), ' ');
+        }
+    }
+
+    static void AppendSize(std::string* frame, double size) {
+        const char* units[] = {"B", "KB", "MB", "GB", "TB"};
+        int unit = 0;
+        while (size >= 1024 && unit < 4) {
+            size /= 1024;
+            unit++;
+        }
+        AppendFormat(frame, "%.2f %s", size, units[unit]);
+    }
+
+    static void AppendRate(std::string* frame, double count, double bytes, double seconds) {
+        if (seconds <= 0) {
+            frame->append("-");
+            return;
+        }
+        AppendFormat(frame, "%.0f /s, ", count / seconds);
+        AppendSize(frame, bytes / seconds);
+        frame->append("/s");
+    }
+
+    // 整段字形一次追加，不再逐字符写流
+    static void AppendBar(std::string* frame, double ratio, int width) {
+        static const std::string kFullBar = []() {
+            std::string bar;
+            for (int i = 0; i < kBarWidth; ++i) {
+                bar += "█";
+            }
+            return bar;
+        }();
+        static const size_t kGlyphBytes = kFullBar.size() / kBarWidth;
+
+        int length = std::clamp(static_cast<int>(ratio * width), 0, std::min(width, kBarWidth));
+        frame->append(kFullBar, 0, length * kGlyphBytes);
+        frame->append(width - length, ' ');
+    }
+
+    static void AppendSparkline(std::string* frame, const std::deque<double>& values) {
+        static const char* const kLevels[] = {"▁", "▂", "▃", "▄", "▅", "▆", "▇", "█"};
+        double max_value = 0;
+        for (double value : values) {
+            max_value = std::max(max_value, value);
+        }
+        for (double value : values) {
+            int level = max_value > 0 ? static_cast<int>(value / max_value * 7 + 0.5) : 0;
+            frame->append(kLevels[level]);
+        }
+        if (!values.empty()) {
+            AppendFormat(frame, " %.0f /s", values.back());
+        }
+    }
+
+    // 采样模式下的数值为估计值，在图表标题下注明采样率和误差
+    void DrawSamplingNote() {
+        auto sampling = stats::Stats::GetInstance().GetSamplingStats();
+        if (sampling.sample_interval == 0) {
+            return;
+        }
+
+        double relative_error = sampling.estimated_bytes > 0 ? sampling.bytes_error / sampling.estimated_bytes : 0.0;
+        std::ostringstream oss;
+        oss << "  Sampled: 1 per " << FormatSize(sampling.sample_interval)
+            << ", " << sampling.sampled_records << " records, bytes +/- "
+            << std::fixed << std::setprecision(1) << relative_error * 100 << "% (95%)\n";
+        *output_stream_ << oss.str();
     }
 
     std::string FormatSize(size_t size) {
@@ -362,13 +704,25 @@ private:
         return oss.str();
     }
 
-    std::string SimplifyStack(const std::string& stack) {
-        // 只保留最后一层调用
-        size_t pos = stack.rfind(" <- ");
-        if (pos == std::string::npos) {
-            return stack;
+    std::string FormatDuration(uint64_t ns) {
+        std::ostringstream oss;
+        if (ns < 1000) {
+            oss << ns << "ns";
+        } else if (ns < 1000000) {
+            oss << std::fixed << std::setprecision(1) << ns / 1e3 << "us";
+        } else {
+            oss << std::fixed << std::setprecision(1) << ns / 1e6 << "ms";
+        }
+        return oss.str();
+    }
+
+    std::string SimplifyStack(capture::StackId stack_id) {
+        // 只保留前 5 帧中的最后一层调用
+        auto frames = capture::StackTable::GetInstance().Symbolize(stack_id);
+        if (frames.empty()) {
+            return "<unknown>";
         }
-        return stack.substr(pos + 4);
+        return frames[std::min<size_t>(frames.size(), 5) - 1];
     }
 
     std::string ExtractFilename(const std::string& filepath) {
@@ -385,6 +739,8 @@ private:
     std::ostream* output_stream_;
     std::atomic<bool> realtime_running_;
     std::thread realtime_thread_;
+    std::mutex realtime_mutex_;
+    std::condition_variable realtime_cv_;
 };
 
 Visualization::Visualization() : pimpl_(std::make_unique<Impl>()) {}
@@ -395,21 +751,25 @@ Visualization& Visualization::GetInstance() {
     return instance;
 }
 
-void Visualization::Initialize() { pimpl_->Initialize(); }
-void Visualization::Shutdown() { pimpl_->Shutdown(); }
-void Visualization::DrawFunctionAllocationChart(int limit) { pimpl_->DrawFunctionAllocationChart(limit); }
-void Visualization::DrawSizeDistributionHistogram() { pimpl_->DrawSizeDistributionHistogram(); }
-void Visualization::DrawMemoryTimeline(size_t bucket_size_ns) { pimpl_->DrawMemoryTimeline(bucket_size_ns); }
-void Visualization::DrawMemoryHotspotsChart(int limit) { pimpl_->DrawMemoryHotspotsChart(limit); }
-void Visualization::DrawCallStackFrequencyChart(int limit) { pimpl_->DrawCallStackFrequencyChart(limit); }
-void Visualization::DrawFileAllocationChart(int limit) { pimpl_->DrawFileAllocationChart(limit); }
-void Visualization::StartRealtimeMonitor(int refresh_interval_ms) { pimpl_->StartRealtimeMonitor(refresh_interval_ms); }
-void Visualization::StopRealtimeMonitor() { pimpl_->StopRealtimeMonitor(); }
-std::string Visualization::ExportFunctionChartToText(int limit) { return pimpl_->ExportFunctionChartToText(limit); }
-std::string Visualization::ExportSizeDistributionToText() { return pimpl_->ExportSizeDistributionToText(); }
-std::string Visualization::ExportTimelineToText(size_t bucket_size_ns) { return pimpl_->ExportTimelineToText(bucket_size_ns); }
-std::string Visualization::ExportReportToText() { return pimpl_->ExportReportToText(); }
-void Visualization::SetOutputStream(std::ostream& stream) { pimpl_->SetOutputStream(stream); }
+void Visualization::Initialize() { capture::TracerScope scope; pimpl_->Initialize(); }
+void Visualization::Shutdown() { capture::TracerScope scope; pimpl_->Shutdown(); }
+void Visualization::DrawFunctionAllocationChart(int limit) { capture::TracerScope scope; pimpl_->DrawFunctionAllocationChart(limit); }
+void Visualization::DrawSizeDistributionHistogram() { capture::TracerScope scope; pimpl_->DrawSizeDistributionHistogram(); }
+void Visualization::DrawMemoryTimeline(size_t bucket_size_ns) { capture::TracerScope scope; pimpl_->DrawMemoryTimeline(bucket_size_ns); }
+void Visualization::DrawMemoryHotspotsChart(int limit) { capture::TracerScope scope; pimpl_->DrawMemoryHotspotsChart(limit); }
+void Visualization::DrawCallStackFrequencyChart(int limit) { capture::TracerScope scope; pimpl_->DrawCallStackFrequencyChart(limit); }
+void Visualization::DrawFileAllocationChart(int limit) { capture::TracerScope scope; pimpl_->DrawFileAllocationChart(limit); }
+void Visualization::DrawShortLivedSitesChart(int limit) { capture::TracerScope scope; pimpl_->DrawShortLivedSitesChart(limit); }
+void Visualization::StartRealtimeMonitor(int refresh_interval_ms) { capture::TracerScope scope; pimpl_->StartRealtimeMonitor(refresh_interval_ms); }
+void Visualization::StopRealtimeMonitor() { capture::TracerScope scope; pimpl_->StopRealtimeMonitor(); }
+std::string Visualization::ExportFunctionChartToText(int limit) { capture::TracerScope scope; return pimpl_->ExportFunctionChartToText(limit); }
+std::string Visualization::ExportSizeDistributionToText() { capture::TracerScope scope; return pimpl_->ExportSizeDistributionToText(); }
+std::string Visualization::ExportTimelineToText(size_t bucket_size_ns) { capture::TracerScope scope; return pimpl_->ExportTimelineToText(bucket_size_ns); }
+std::string Visualization::ExportReportToText() { capture::TracerScope scope; return pimpl_->ExportReportToText(); }
+bool Visualization::ExportFoldedStacks(const std::string& filepath, ProfileWeight weight) { capture::TracerScope scope; return pimpl_->ExportFoldedStacks(filepath, weight); }
+bool Visualization::ExportPprof(const std::string& filepath) { capture::TracerScope scope; return pimpl_->ExportPprof(filepath); }
+bool Visualization::ExportFlameGraph(const std::string& filepath, ProfileWeight weight) { capture::TracerScope scope; return pimpl_->ExportFlameGraph(filepath, weight); }
+void Visualization::SetOutputStream(std::ostream& stream) { capture::TracerScope scope; pimpl_->SetOutputStream(stream); }
 
 } // namespace visualization
 } // namespace memory_tracer